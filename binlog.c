@@ -0,0 +1,227 @@
+// binlog.c - Log record ring and its drain
+
+#include "binlog.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#ifndef BINLOG_HOST
+#include "hardware/sync.h"
+#endif
+
+#define RING_MASK (BINLOG_RING_WORDS - 1)
+
+_Static_assert((BINLOG_RING_WORDS & RING_MASK) == 0, "BINLOG_RING_WORDS must be a power of two");
+_Static_assert(BINLOG_MAX_FORMATS < 0xFFFF, "format ids are 16 bits");
+
+static uint32_t ring[BINLOG_RING_WORDS];
+static volatile uint32_t ring_head;     // Next word written (binlog_write)
+static volatile uint32_t ring_tail;     // Next word drained (binlog_drain)
+
+static const char *formats[BINLOG_MAX_FORMATS + 1];    // By id, 1-based
+static uint16_t format_count;
+static bool format_sent[BINLOG_MAX_FORMATS + 1];
+static bool binary_mode = BINLOG_BINARY_DEFAULT;
+static uint32_t reported_dropped;
+static binlog_stats_t stats;
+
+#ifdef BINLOG_HOST
+static inline bool on_log_core(void) { return true; }
+static inline uint32_t lock_ring(void) { return 0; }
+static inline void unlock_ring(uint32_t saved) { (void)saved; }
+static inline uint32_t now_us(void) { return (uint32_t)time_us_64(); }
+#else
+static inline bool on_log_core(void) { return get_core_num() == 0; }
+static inline uint32_t lock_ring(void) { return save_and_disable_interrupts(); }
+static inline void unlock_ring(uint32_t saved) { restore_interrupts(saved); }
+static inline uint32_t now_us(void) { return time_us_32(); }
+#endif
+
+void binlog_write(uint16_t *id, uint8_t level, const char *fmt, const uint32_t *args, uint8_t nargs) {
+    if (!on_log_core()) {
+        stats.dropped++;
+        return;
+    }
+    uint32_t saved = lock_ring();
+    if (*id == 0) {
+        // First record from this call site
+        if (format_count == BINLOG_MAX_FORMATS) {
+            stats.dropped++;
+            unlock_ring(saved);
+            return;
+        }
+        formats[++format_count] = fmt;
+        *id = format_count;
+    }
+
+    uint32_t head = ring_head;
+    uint32_t used = head - ring_tail;
+    if (used + 2 + nargs > BINLOG_RING_WORDS) {
+        stats.dropped++;
+        unlock_ring(saved);
+        return;
+    }
+    ring[head & RING_MASK] = BINLOG_HDR(*id, level, nargs);
+    ring[(head + 1) & RING_MASK] = now_us();
+    for (uint8_t i = 0; i < nargs; i++) {
+        ring[(head + 2 + i) & RING_MASK] = args[i];
+    }
+    ring_head = head + 2 + nargs;
+    stats.records++;
+    used += 2 + nargs;
+    if (used > stats.max_used_words) {
+        stats.max_used_words = used;
+    }
+    unlock_ring(saved);
+}
+
+// Format string for a #BLF line: one line, so newlines and backslashes escaped
+static void print_format_line(uint16_t id, uint8_t level) {
+    printf("%s %u %u ", BINLOG_FORMAT_TAG, id, level);
+    for (const char *p = formats[id]; *p; p++) {
+        if (*p == '\n') {
+            printf("\\n");
+        } else if (*p == '\\') {
+            printf("\\\\");
+        } else {
+            putchar(*p);
+        }
+    }
+    putchar('\n');
+}
+
+int binlog_drain(int max) {
+    int written = 0;
+    while ((max == 0 || written < max) && ring_tail != ring_head) {
+        uint32_t tail = ring_tail;
+        uint32_t hdr = ring[tail & RING_MASK];
+        uint32_t ts = ring[(tail + 1) & RING_MASK];
+        uint8_t nargs = BINLOG_HDR_NARGS(hdr);
+        uint32_t args[BINLOG_MAX_ARGS];
+        for (uint8_t i = 0; i < nargs; i++) {
+            args[i] = ring[(tail + 2 + i) & RING_MASK];
+        }
+        // The words are copied out, so the writer may reuse them
+        ring_tail = tail + 2 + nargs;
+
+        uint16_t id = BINLOG_HDR_ID(hdr);
+        if (binary_mode) {
+            if (!format_sent[id]) {
+                print_format_line(id, BINLOG_HDR_LEVEL(hdr));
+                format_sent[id] = true;
+            }
+            printf("%s %08lx %08lx", BINLOG_RECORD_TAG, (unsigned long)hdr, (unsigned long)ts);
+            for (uint8_t i = 0; i < nargs; i++) {
+                printf(" %08lx", (unsigned long)args[i]);
+            }
+            putchar('\n');
+        } else {
+            char line[192];
+            binlog_format(line, sizeof(line), formats[id], args, nargs);
+            fputs(line, stdout);
+        }
+        stats.drained++;
+        written++;
+    }
+
+    if (stats.dropped != reported_dropped) {
+        printf("[BINLOG] ⚠️ %lu log records dropped\n", (unsigned long)(stats.dropped - reported_dropped));
+        reported_dropped = stats.dropped;
+    }
+    return written;
+}
+
+void binlog_flush(void) {
+    binlog_drain(0);
+}
+
+void binlog_wait_ms(uint32_t ms) {
+    uint64_t end = time_us_64() + (uint64_t)ms * 1000;
+    while (time_us_64() < end && binlog_drain(1) > 0) {
+    }
+    uint64_t now = time_us_64();
+    if (now < end) {
+        sleep_us(end - now);
+    }
+}
+
+void binlog_set_binary(bool enabled) {
+    binlog_flush();
+    binary_mode = enabled;
+    memset(format_sent, 0, sizeof(format_sent));
+}
+
+int binlog_format(char *out, size_t size, const char *fmt, const uint32_t *args, uint8_t nargs) {
+    size_t len = 0;
+    uint8_t next = 0;
+    if (size == 0) {
+        return 0;
+    }
+    for (const char *p = fmt; *p && len + 1 < size;) {
+        if (*p != '%') {
+            out[len++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[len++] = '%';
+            p += 2;
+            continue;
+        }
+
+        // Rebuild the conversion without its length modifier: every
+        // argument is a 32-bit word
+        char spec[24];
+        size_t n = 0;
+        spec[n++] = *p++;
+        while (*p && strchr("-+ #0", *p) && n < 8) spec[n++] = *p++;
+        while ((*p >= '0' && *p <= '9') && n < 14) spec[n++] = *p++;
+        if (*p == '.') {
+            spec[n++] = *p++;
+            while ((*p >= '0' && *p <= '9') && n < 20) spec[n++] = *p++;
+        }
+        while (*p && strchr("hljztL", *p)) p++;
+        char conv = *p;
+        if (conv == '\0') {
+            break;
+        }
+        p++;
+        uint32_t arg = next < nargs ? args[next] : 0;
+        next++;
+
+        int w;
+        size_t room = size - len;
+        if (strchr("di", conv)) {
+            spec[n++] = 'd';
+            spec[n] = '\0';
+            w = snprintf(out + len, room, spec, (int)(int32_t)arg);
+        } else if (strchr("ouxXc", conv)) {
+            spec[n++] = conv;
+            spec[n] = '\0';
+            if (conv == 'c') {
+                w = snprintf(out + len, room, spec, (int)arg);
+            } else {
+                w = snprintf(out + len, room, spec, (unsigned)arg);
+            }
+        } else if (conv == 'p') {
+            w = snprintf(out + len, room, "0x%08x", (unsigned)arg);
+        } else {
+            // %s, %f, ... were never deferrable
+            w = snprintf(out + len, room, "<%%%c?>", conv);
+        }
+        if (w < 0) {
+            break;
+        }
+        len += (size_t)w < room ? (size_t)w : room - 1;
+    }
+    out[len] = '\0';
+    return (int)len;
+}
+
+void binlog_get_stats(binlog_stats_t *out) {
+    *out = stats;
+}
+
+void binlog_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+    reported_dropped = 0;
+}
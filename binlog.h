@@ -0,0 +1,115 @@
+// binlog.h - Deferred logging for the hot paths
+//
+// BLOG_DEBUG() .. BLOG_ERROR() take a printf format and up to
+// BINLOG_MAX_ARGS arguments, but only append a record to a RAM ring: the
+// call site's format id, a microsecond timestamp and the arguments as
+// 32-bit words. Formatting and the USB write happen later, in
+// binlog_drain() from the main loops and in binlog_wait_ms() while a send
+// paces its chunks. Levels below BINLOG_LEVEL compile to nothing.
+//
+// Arguments are stored as 32-bit words: integers, characters, %x values.
+// Strings (%s) and floats cannot be deferred - print those with printf, or
+// pass a scaled integer. Records are only taken on core0; a record from
+// core1 or one that finds the ring full is dropped and counted.
+//
+// In binary mode (binlog_set_binary()) the drain writes each record as a
+// line of hex words instead of text, and each format string once before
+// its first record. host/binlog_decode turns a capture of the console back
+// into text.
+//
+// printf() is not deferred and can overtake records still in the ring;
+// call binlog_flush() first where the order matters.
+
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define BINLOG_LEVEL_DEBUG  0
+#define BINLOG_LEVEL_INFO   1
+#define BINLOG_LEVEL_WARN   2
+#define BINLOG_LEVEL_ERROR  3
+
+#ifndef BINLOG_LEVEL
+#define BINLOG_LEVEL        BINLOG_LEVEL_INFO
+#endif
+
+#define BINLOG_RING_WORDS   1024    // Power of two; a record takes 2 + nargs words
+#define BINLOG_MAX_ARGS     6
+#define BINLOG_MAX_FORMATS  128     // Call sites that can log
+#define BINLOG_DRAIN_BATCH  4       // Records per binlog_drain() from a main loop
+
+#ifndef BINLOG_BINARY_DEFAULT
+#define BINLOG_BINARY_DEFAULT false  // Start in binary mode (see binlog_set_binary())
+#endif
+
+// Record header word: format id, level, argument count
+#define BINLOG_HDR(id, level, nargs)  (((uint32_t)(id) << 16) | ((uint32_t)(level) << 8) | (uint32_t)(nargs))
+#define BINLOG_HDR_ID(w)              ((uint16_t)((w) >> 16))
+#define BINLOG_HDR_LEVEL(w)           ((uint8_t)(((w) >> 8) & 0xFF))
+#define BINLOG_HDR_NARGS(w)           ((uint8_t)((w) & 0xFF))
+
+// Lines written in binary mode
+#define BINLOG_FORMAT_TAG   "#BLF"  // #BLF <id> <level> <format, \n and \\ escaped>
+#define BINLOG_RECORD_TAG   "#BL"   // #BL <header> <timestamp> <args...> in hex
+
+typedef struct {
+    uint32_t records;           // Taken into the ring
+    uint32_t dropped;           // Ring full, or logged from core1
+    uint32_t drained;           // Written to the console
+    uint32_t max_used_words;    // High-water mark of the ring
+} binlog_stats_t;
+
+// Use the macros below
+void binlog_write(uint16_t *id, uint8_t level, const char *fmt, const uint32_t *args, uint8_t nargs);
+
+#define BINLOG_AT(level, fmt, ...) do { \
+        static uint16_t binlog_id_; \
+        const uint32_t binlog_args_[] = { 0, ##__VA_ARGS__ }; \
+        _Static_assert(sizeof(binlog_args_) / sizeof(uint32_t) - 1 <= BINLOG_MAX_ARGS, "too many log arguments"); \
+        binlog_write(&binlog_id_, (level), (fmt), binlog_args_ + 1, \
+                     (uint8_t)(sizeof(binlog_args_) / sizeof(uint32_t) - 1)); \
+    } while (0)
+
+// A level compiled out still type-checks its arguments, without evaluating them
+#define BINLOG_OFF(fmt, ...) do { (void)sizeof((const uint32_t[]){ 0, ##__VA_ARGS__ }); } while (0)
+
+#if BINLOG_LEVEL <= BINLOG_LEVEL_DEBUG
+#define BLOG_DEBUG(fmt, ...) BINLOG_AT(BINLOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define BLOG_DEBUG(fmt, ...) BINLOG_OFF(fmt, ##__VA_ARGS__)
+#endif
+#if BINLOG_LEVEL <= BINLOG_LEVEL_INFO
+#define BLOG_INFO(fmt, ...) BINLOG_AT(BINLOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define BLOG_INFO(fmt, ...) BINLOG_OFF(fmt, ##__VA_ARGS__)
+#endif
+#if BINLOG_LEVEL <= BINLOG_LEVEL_WARN
+#define BLOG_WARN(fmt, ...) BINLOG_AT(BINLOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define BLOG_WARN(fmt, ...) BINLOG_OFF(fmt, ##__VA_ARGS__)
+#endif
+#define BLOG_ERROR(fmt, ...) BINLOG_AT(BINLOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+
+// Write out up to max records (0 = all). Returns the records written.
+int binlog_drain(int max);
+
+// Write out every record
+void binlog_flush(void);
+
+// sleep_ms() that writes out records while it waits
+void binlog_wait_ms(uint32_t ms);
+
+// Binary mode: hex records instead of text, for host/binlog_decode.
+// Switching it on sends the format strings again.
+void binlog_set_binary(bool enabled);
+
+// Format a record like printf would. Returns the length (truncated to size - 1).
+int binlog_format(char *out, size_t size, const char *fmt, const uint32_t *args, uint8_t nargs);
+
+void binlog_get_stats(binlog_stats_t *stats);
+void binlog_reset_stats(void);
+
+#endif // BINLOG_H
@@ -0,0 +1,298 @@
+// block_delta.c - rsync-style signatures, delta encoder and decoder
+
+#include "block_delta.h"
+#include "crc32c.h"
+#include <string.h>
+
+#define HASH_BITS  10
+#define HASH_SIZE  (1u << HASH_BITS)
+#define NO_SIG     0xFFFF
+#define MAX_LITERAL 0xFFFF
+
+// Publisher's signature set
+static uint32_t sig_weak[BLOCK_DELTA_MAX_SIGS];
+static uint32_t sig_strong[BLOCK_DELTA_MAX_SIGS];
+static uint16_t sig_next[BLOCK_DELTA_MAX_SIGS];     // Hash chain
+static uint16_t sig_heads[HASH_SIZE];
+static uint8_t sig_have[(BLOCK_DELTA_MAX_SIGS + 7) / 8];
+static uint32_t sig_basis_crc;
+static uint32_t sig_basis_len;
+static uint16_t sig_block_size;
+static uint16_t sig_count;         // Full blocks in the basis
+static uint16_t sig_received;
+
+static void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    put_le16(p, (uint16_t)v);
+    put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_le16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+static uint32_t weak_hash(uint32_t weak) {
+    return (weak * 2654435761u) >> (32 - HASH_BITS);
+}
+
+uint32_t block_delta_weak(const uint8_t *data, size_t len) {
+    uint32_t a = 0, b = 0;
+    for (size_t i = 0; i < len; i++) {
+        a += data[i];
+        b += (uint32_t)(len - i) * data[i];
+    }
+    return (a & 0xFFFF) | (b << 16);
+}
+
+// Slide the window one byte: drop out, take in
+static uint32_t weak_roll(uint32_t weak, uint8_t out, uint8_t in, size_t len) {
+    uint32_t a = weak & 0xFFFF;
+    uint32_t b = weak >> 16;
+    a = (a - out + in) & 0xFFFF;
+    b = (b - (uint32_t)len * out + a) & 0xFFFF;
+    return a | (b << 16);
+}
+
+uint16_t block_delta_block_size(size_t basis_len) {
+    uint16_t size = 64;
+    while (size < BLOCK_DELTA_MAX_BLOCK && basis_len / size > BLOCK_DELTA_MAX_SIGS) {
+        size *= 2;
+    }
+    return size;
+}
+
+size_t block_delta_signature_msg(const uint8_t *basis, size_t basis_len, uint16_t block_size,
+                                 uint16_t first, uint8_t *msg, size_t msg_size) {
+    size_t blocks = basis_len / block_size;
+    if (first >= blocks || msg_size < BLOCK_DELTA_SIG_HEADER + BLOCK_DELTA_SIG_SIZE) {
+        return 0;
+    }
+    size_t count = blocks - first;
+    if (count > BLOCK_DELTA_SIGS_PER_MSG) count = BLOCK_DELTA_SIGS_PER_MSG;
+    if (count > (msg_size - BLOCK_DELTA_SIG_HEADER) / BLOCK_DELTA_SIG_SIZE) {
+        count = (msg_size - BLOCK_DELTA_SIG_HEADER) / BLOCK_DELTA_SIG_SIZE;
+    }
+
+    put_le32(msg, crc32c(basis, basis_len));
+    put_le32(msg + 4, (uint32_t)basis_len);
+    put_le16(msg + 8, block_size);
+    put_le16(msg + 10, first);
+    put_le16(msg + 12, (uint16_t)count);
+
+    uint8_t *p = msg + BLOCK_DELTA_SIG_HEADER;
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *block = basis + (size_t)(first + i) * block_size;
+        put_le32(p, block_delta_weak(block, block_size));
+        put_le32(p + 4, crc32c(block, block_size));
+        p += BLOCK_DELTA_SIG_SIZE;
+    }
+    return p - msg;
+}
+
+void block_delta_reset(void) {
+    sig_basis_crc = 0;
+    sig_basis_len = 0;
+    sig_block_size = 0;
+    sig_count = 0;
+    sig_received = 0;
+    memset(sig_have, 0, sizeof(sig_have));
+    memset(sig_heads, 0xFF, sizeof(sig_heads));
+}
+
+int block_delta_add_signatures(const uint8_t *msg, size_t len) {
+    if (len < BLOCK_DELTA_SIG_HEADER) return -1;
+
+    uint32_t basis_crc = get_le32(msg);
+    uint32_t basis_len = get_le32(msg + 4);
+    uint16_t block_size = get_le16(msg + 8);
+    uint16_t first = get_le16(msg + 10);
+    uint16_t count = get_le16(msg + 12);
+    uint32_t blocks = block_size ? basis_len / block_size : 0;
+
+    if (block_size < BLOCK_DELTA_MIN_BLOCK || block_size > BLOCK_DELTA_MAX_BLOCK ||
+        blocks == 0 || blocks > BLOCK_DELTA_MAX_SIGS ||
+        (uint32_t)first + count > blocks ||
+        len != BLOCK_DELTA_SIG_HEADER + (size_t)count * BLOCK_DELTA_SIG_SIZE) {
+        return -1;
+    }
+
+    // A different basis replaces the stored set
+    if (basis_crc != sig_basis_crc || basis_len != sig_basis_len || block_size != sig_block_size) {
+        block_delta_reset();
+        sig_basis_crc = basis_crc;
+        sig_basis_len = basis_len;
+        sig_block_size = block_size;
+        sig_count = (uint16_t)blocks;
+    }
+
+    const uint8_t *p = msg + BLOCK_DELTA_SIG_HEADER;
+    for (uint16_t i = 0; i < count; i++, p += BLOCK_DELTA_SIG_SIZE) {
+        uint16_t index = first + i;
+        if (sig_have[index / 8] & (1u << (index % 8))) continue;  // Duplicate (QoS 1 resend)
+
+        sig_weak[index] = get_le32(p);
+        sig_strong[index] = get_le32(p + 4);
+        uint32_t h = weak_hash(sig_weak[index]);
+        sig_next[index] = sig_heads[h];
+        sig_heads[h] = index;
+        sig_have[index / 8] |= 1u << (index % 8);
+        sig_received++;
+    }
+    return sig_received == sig_count ? 1 : 0;
+}
+
+bool block_delta_ready(uint32_t *basis_crc, uint16_t *block_size) {
+    if (sig_count == 0 || sig_received != sig_count) return false;
+    if (basis_crc) *basis_crc = sig_basis_crc;
+    if (block_size) *block_size = sig_block_size;
+    return true;
+}
+
+typedef struct {
+    block_delta_sink_t sink;
+    void *ctx;
+    size_t count;
+    bool failed;
+    uint16_t copy_first;    // Pending run of copied blocks
+    uint16_t copy_count;
+} delta_writer_t;
+
+static void delta_put(delta_writer_t *w, const uint8_t *data, size_t len) {
+    if (w->sink && !w->failed && w->sink(w->ctx, data, len) != 0) {
+        w->failed = true;
+    }
+    w->count += len;
+}
+
+static void flush_copy(delta_writer_t *w) {
+    if (w->copy_count == 0) return;
+    uint8_t op[5] = { BLOCK_DELTA_OP_COPY };
+    put_le16(op + 1, w->copy_first);
+    put_le16(op + 3, w->copy_count);
+    delta_put(w, op, sizeof(op));
+    w->copy_count = 0;
+}
+
+static void emit_literal(delta_writer_t *w, const uint8_t *data, size_t len) {
+    flush_copy(w);
+    while (len > 0) {
+        size_t n = len > MAX_LITERAL ? MAX_LITERAL : len;
+        uint8_t op[3] = { BLOCK_DELTA_OP_LITERAL };
+        put_le16(op + 1, (uint16_t)n);
+        delta_put(w, op, sizeof(op));
+        delta_put(w, data, n);
+        data += n;
+        len -= n;
+    }
+}
+
+static void emit_copy(delta_writer_t *w, uint16_t index) {
+    if (w->copy_count > 0 && w->copy_first + w->copy_count == index && w->copy_count < 0xFFFF) {
+        w->copy_count++;
+        return;
+    }
+    flush_copy(w);
+    w->copy_first = index;
+    w->copy_count = 1;
+}
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t weak;
+    uint32_t strong;
+    bool have_strong;       // CRC-32C is only computed on a weak hit
+} window_t;
+
+static bool sig_matches(uint16_t index, window_t *win) {
+    if (sig_weak[index] != win->weak) return false;
+    if (!win->have_strong) {
+        win->strong = crc32c(win->data, sig_block_size);
+        win->have_strong = true;
+    }
+    return sig_strong[index] == win->strong;
+}
+
+// Find a basis block equal to the window. The block after the current copy
+// run is tried first so that unchanged stretches become a single instruction.
+static int find_block(const delta_writer_t *w, uint32_t weak, const uint8_t *data) {
+    window_t win = { data, weak, 0, false };
+    if (w->copy_count > 0) {
+        uint32_t next = (uint32_t)w->copy_first + w->copy_count;
+        if (next < sig_count && sig_matches((uint16_t)next, &win)) {
+            return (int)next;
+        }
+    }
+    for (uint16_t i = sig_heads[weak_hash(weak)]; i != NO_SIG; i = sig_next[i]) {
+        if (sig_matches(i, &win)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+long block_delta_encode(const uint8_t *src, size_t len, block_delta_sink_t sink, void *ctx) {
+    if (!block_delta_ready(NULL, NULL)) return -1;
+
+    delta_writer_t w = { sink, ctx, 0, false, 0, 0 };
+    size_t bs = sig_block_size;
+    size_t pos = 0;
+    size_t literal = 0;    // Start of bytes not yet emitted
+    uint32_t weak = len >= bs ? block_delta_weak(src, bs) : 0;
+
+    while (pos + bs <= len) {
+        int index = find_block(&w, weak, src + pos);
+        if (index >= 0) {
+            if (pos > literal) emit_literal(&w, src + literal, pos - literal);
+            emit_copy(&w, (uint16_t)index);
+            pos += bs;
+            literal = pos;
+            if (pos + bs <= len) weak = block_delta_weak(src + pos, bs);
+        } else {
+            if (pos + bs < len) weak = weak_roll(weak, src[pos], src[pos + bs], bs);
+            pos++;
+        }
+    }
+
+    if (len > literal) emit_literal(&w, src + literal, len - literal);
+    flush_copy(&w);
+    return w.failed ? -1 : (long)w.count;
+}
+
+long block_delta_apply(const uint8_t *basis, size_t basis_len, uint16_t block_size,
+                       const uint8_t *delta, size_t delta_len, uint8_t *out, size_t out_size) {
+    size_t pos = 0;
+    size_t out_len = 0;
+    size_t blocks = block_size ? basis_len / block_size : 0;
+
+    while (pos < delta_len) {
+        uint8_t op = delta[pos];
+        if (op == BLOCK_DELTA_OP_LITERAL) {
+            if (pos + 3 > delta_len) return -1;
+            size_t n = get_le16(delta + pos + 1);
+            pos += 3;
+            if (pos + n > delta_len || out_len + n > out_size) return -1;
+            memcpy(out + out_len, delta + pos, n);
+            pos += n;
+            out_len += n;
+        } else if (op == BLOCK_DELTA_OP_COPY) {
+            if (pos + 5 > delta_len) return -1;
+            size_t first = get_le16(delta + pos + 1);
+            size_t n = get_le16(delta + pos + 3);
+            pos += 5;
+            if (first + n > blocks || out_len + n * block_size > out_size) return -1;
+            memcpy(out + out_len, basis + first * block_size, n * block_size);
+            out_len += n * block_size;
+        } else {
+            return -1;
+        }
+    }
+    return (long)out_len;
+}
@@ -0,0 +1,80 @@
+// block_delta.h - rsync-style delta encoding against a subscriber's copy
+//
+// A subscriber that already holds an earlier version of a file (the basis)
+// publishes signatures of it on "pico/block_sig": for every full
+// block_size-byte block of the basis, a rolling weak checksum and a CRC-32C.
+// The publisher keeps the latest signature set and, when it next sends a
+// file, slides a window over it looking for blocks the subscriber already
+// has. The block then goes out as a delta stream - copy instructions for
+// matched blocks and literal bytes for everything else - instead of the
+// file itself.
+//
+// Signature message (all values little-endian):
+//
+//   [uint32 basis_crc][uint32 basis_len][uint16 block_size][uint16 first][uint16 count]
+//   [count x (uint32 weak, uint32 strong)]
+//
+// basis_crc is the CRC-32C of the whole basis; a message for a different
+// basis replaces the stored set. Signatures cover blocks first..first+count-1.
+//
+// Delta stream:
+//
+//   0x00 [uint16 len] [len bytes]    literal bytes
+//   0x01 [uint16 first] [uint16 n]   copy basis blocks first..first+n-1
+//
+// The encoder is deterministic, so the publisher runs it twice: once to
+// measure, then again streaming into chunks (as with block_lz).
+
+#ifndef BLOCK_DELTA_H
+#define BLOCK_DELTA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define BLOCK_DELTA_MAX_SIGS     600    // Signatures the publisher can hold (~4.8KB)
+#define BLOCK_DELTA_MIN_BLOCK    32
+#define BLOCK_DELTA_MAX_BLOCK    4096
+#define BLOCK_DELTA_SIG_HEADER   14     // Bytes before the signatures in a message
+#define BLOCK_DELTA_SIG_SIZE     8      // weak + strong
+#define BLOCK_DELTA_SIGS_PER_MSG 48     // Keeps a message under the 512-byte receive buffer
+
+#define BLOCK_DELTA_OP_LITERAL   0x00
+#define BLOCK_DELTA_OP_COPY      0x01
+
+// Receives delta stream bytes in order
+typedef int (*block_delta_sink_t)(void *ctx, const uint8_t *data, size_t len);
+
+// rsync weak checksum of len bytes
+uint32_t block_delta_weak(const uint8_t *data, size_t len);
+
+// Block size a subscriber should use for a basis of basis_len bytes
+uint16_t block_delta_block_size(size_t basis_len);
+
+// Build the signature message for blocks first.. of a basis (at most
+// BLOCK_DELTA_SIGS_PER_MSG). Returns the message size, 0 once first is past
+// the last full block.
+size_t block_delta_signature_msg(const uint8_t *basis, size_t basis_len, uint16_t block_size,
+                                 uint16_t first, uint8_t *msg, size_t msg_size);
+
+// Publisher: store a received signature message. Returns 1 once the set
+// for its basis is complete, 0 if more messages are needed, -1 if invalid.
+int block_delta_add_signatures(const uint8_t *msg, size_t len);
+
+// Publisher: drop the stored signature set
+void block_delta_reset(void);
+
+// Publisher: true if a complete signature set is held
+bool block_delta_ready(uint32_t *basis_crc, uint16_t *block_size);
+
+// Publisher: encode src against the stored signatures into the sink (NULL
+// sink just measures). Returns the delta size, or -1 if the sink failed or
+// no complete signature set is held.
+long block_delta_encode(const uint8_t *src, size_t len, block_delta_sink_t sink, void *ctx);
+
+// Rebuild the target from a basis and a delta stream. Returns the target
+// length, or -1 if the delta is corrupt or does not fit out_size.
+long block_delta_apply(const uint8_t *basis, size_t basis_len, uint16_t block_size,
+                       const uint8_t *delta, size_t delta_len, uint8_t *out, size_t out_size);
+
+#endif // BLOCK_DELTA_H
@@ -0,0 +1,174 @@
+// block_fec.c - XOR / Cauchy Reed-Solomon erasure coding for chunk groups
+
+#include "block_fec.h"
+#include <string.h>
+
+// GF(2^8) with the 0x11D polynomial. exp[] is doubled so products can
+// index exp[log a + log b] without a modulo.
+static uint8_t gf_exp[512];
+static uint8_t gf_log[256];
+static bool gf_ready = false;
+
+static void gf_init(void) {
+    uint16_t x = 1;
+    for (int i = 0; i < 255; i++) {
+        gf_exp[i] = (uint8_t)x;
+        gf_log[x] = (uint8_t)i;
+        x <<= 1;
+        if (x & 0x100) x ^= 0x11D;
+    }
+    for (int i = 255; i < 512; i++) {
+        gf_exp[i] = gf_exp[i - 255];
+    }
+    gf_log[0] = 0;  // Unused - callers skip zero operands
+    gf_ready = true;
+}
+
+static uint8_t gf_mul(uint8_t a, uint8_t b) {
+    if (a == 0 || b == 0) return 0;
+    return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+static uint8_t gf_inv(uint8_t a) {
+    return gf_exp[255 - gf_log[a]];
+}
+
+// dst ^= c * src
+static void gf_mul_add(uint8_t *dst, uint8_t c, const uint8_t *src, size_t len) {
+    if (c == 0) return;
+    if (c == 1) {
+        for (size_t i = 0; i < len; i++) dst[i] ^= src[i];
+        return;
+    }
+    unsigned lc = gf_log[c];
+    for (size_t i = 0; i < len; i++) {
+        if (src[i] != 0) dst[i] ^= gf_exp[lc + gf_log[src[i]]];
+    }
+}
+
+// Coefficient of data chunk i in parity row j. M = 1 is XOR parity;
+// otherwise a Cauchy matrix 1 / (x_j + y_i) with x_j = 255 - j and y_i = i,
+// whose square submatrices are all invertible (MDS).
+static uint8_t fec_coef(uint8_t m, uint8_t j, uint8_t i) {
+    if (m == 1) return 1;
+    return gf_inv((uint8_t)((255 - j) ^ i));
+}
+
+bool block_fec_valid(uint8_t k, uint8_t m) {
+    return k >= 1 && k <= BLOCK_FEC_MAX_K && m >= 1 && m <= BLOCK_FEC_MAX_M;
+}
+
+void block_fec_encode_chunk(uint8_t m, uint8_t index, const uint8_t *data,
+                            uint16_t data_len, uint8_t *const parity[], size_t chunk_size) {
+    if (!gf_ready) gf_init();
+    if (data_len > chunk_size) data_len = chunk_size;
+
+    uint8_t len_bytes[BLOCK_FEC_LEN_SIZE] = { data_len & 0xFF, data_len >> 8 };
+    for (uint8_t j = 0; j < m; j++) {
+        uint8_t c = fec_coef(m, j, index);
+        gf_mul_add(parity[j], c, len_bytes, BLOCK_FEC_LEN_SIZE);
+        gf_mul_add(parity[j] + BLOCK_FEC_LEN_SIZE, c, data, data_len);
+    }
+}
+
+// Invert an n x n matrix in place (Gauss-Jordan). Returns -1 if singular.
+static int gf_invert_matrix(uint8_t a[BLOCK_FEC_MAX_M][BLOCK_FEC_MAX_M],
+                            uint8_t inv[BLOCK_FEC_MAX_M][BLOCK_FEC_MAX_M], int n) {
+    if (n < 1 || n > BLOCK_FEC_MAX_M) return -1;
+
+    for (int r = 0; r < n; r++) {
+        for (int c = 0; c < n; c++) inv[r][c] = (r == c);
+    }
+
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        while (pivot < n && a[pivot][col] == 0) pivot++;
+        if (pivot == n) return -1;
+
+        if (pivot != col) {
+            for (int c = 0; c < n; c++) {
+                uint8_t t = a[col][c]; a[col][c] = a[pivot][c]; a[pivot][c] = t;
+                t = inv[col][c]; inv[col][c] = inv[pivot][c]; inv[pivot][c] = t;
+            }
+        }
+
+        uint8_t scale = gf_inv(a[col][col]);
+        for (int c = 0; c < n; c++) {
+            a[col][c] = gf_mul(a[col][c], scale);
+            inv[col][c] = gf_mul(inv[col][c], scale);
+        }
+
+        for (int r = 0; r < n; r++) {
+            if (r == col || a[r][col] == 0) continue;
+            uint8_t f = a[r][col];
+            for (int c = 0; c < n; c++) {
+                a[r][c] ^= gf_mul(f, a[col][c]);
+                inv[r][c] ^= gf_mul(f, inv[col][c]);
+            }
+        }
+    }
+    return 0;
+}
+
+int block_fec_decode(uint8_t group_k, uint8_t m, uint8_t *const data[], uint16_t lens[],
+                     const bool present[], uint8_t *const parity[],
+                     const bool parity_present[], size_t chunk_size) {
+    if (!gf_ready) gf_init();
+
+    uint8_t lost[BLOCK_FEC_MAX_M];
+    uint8_t rows[BLOCK_FEC_MAX_M];
+    int n_lost = 0;
+    int n_rows = 0;
+
+    for (uint8_t i = 0; i < group_k; i++) {
+        if (!present[i]) {
+            if (n_lost == m) return -1;  // More erasures than the code can fix
+            lost[n_lost++] = i;
+        }
+    }
+    if (n_lost == 0) return 0;
+
+    for (uint8_t j = 0; j < m && n_rows < n_lost; j++) {
+        if (parity_present[j]) rows[n_rows++] = j;
+    }
+    if (n_rows < n_lost) return -1;
+
+    // Remove the received chunks from each parity row, leaving only the
+    // contribution of the lost ones (the syndrome).
+    for (int r = 0; r < n_rows; r++) {
+        uint8_t *p = parity[rows[r]];
+        for (uint8_t i = 0; i < group_k; i++) {
+            if (!present[i]) continue;
+            uint16_t len = lens[i] > chunk_size ? chunk_size : lens[i];
+            uint8_t len_bytes[BLOCK_FEC_LEN_SIZE] = { len & 0xFF, len >> 8 };
+            uint8_t c = fec_coef(m, rows[r], i);
+            gf_mul_add(p, c, len_bytes, BLOCK_FEC_LEN_SIZE);
+            gf_mul_add(p + BLOCK_FEC_LEN_SIZE, c, data[i], len);
+        }
+    }
+
+    uint8_t a[BLOCK_FEC_MAX_M][BLOCK_FEC_MAX_M];
+    uint8_t inv[BLOCK_FEC_MAX_M][BLOCK_FEC_MAX_M];
+    for (int r = 0; r < n_lost; r++) {
+        for (int c = 0; c < n_lost; c++) {
+            a[r][c] = fec_coef(m, rows[r], lost[c]);
+        }
+    }
+    if (gf_invert_matrix(a, inv, n_lost) != 0) return -1;
+
+    // lost[c] = sum over r of inv[c][r] * syndrome[r]
+    for (int c = 0; c < n_lost; c++) {
+        uint8_t len_bytes[BLOCK_FEC_LEN_SIZE] = { 0, 0 };
+        uint8_t *out = data[lost[c]];
+        memset(out, 0, chunk_size);
+        for (int r = 0; r < n_lost; r++) {
+            const uint8_t *p = parity[rows[r]];
+            gf_mul_add(len_bytes, inv[c][r], p, BLOCK_FEC_LEN_SIZE);
+            gf_mul_add(out, inv[c][r], p + BLOCK_FEC_LEN_SIZE, chunk_size);
+        }
+        uint16_t len = len_bytes[0] | (len_bytes[1] << 8);
+        lens[lost[c]] = len > chunk_size ? chunk_size : len;
+    }
+
+    return n_lost;
+}
@@ -0,0 +1,46 @@
+// block_fec.h - Forward error correction for block transfer chunk groups
+//
+// Data chunks are grouped K at a time and M parity chunks are sent after
+// each group. M = 1 is plain XOR parity; M > 1 uses a Cauchy Reed-Solomon
+// code over GF(2^8), so any K of the K + M chunks rebuild the group.
+//
+// Each chunk is coded as a symbol of [data_len (2 bytes, LE)][data padded
+// with zeros to chunk_size], so a rebuilt chunk also recovers its length.
+
+#ifndef BLOCK_FEC_H
+#define BLOCK_FEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define BLOCK_FEC_MAX_K 64   // Data chunks per group
+#define BLOCK_FEC_MAX_M 4    // Parity chunks per group
+#define BLOCK_FEC_LEN_SIZE 2 // Length prefix of a coded symbol
+
+// Size of a coded parity symbol for a given chunk data size
+#define BLOCK_FEC_SYMBOL_SIZE(chunk_size) ((chunk_size) + BLOCK_FEC_LEN_SIZE)
+
+// Validate a K/M pair. Returns true if the code can be used.
+bool block_fec_valid(uint8_t k, uint8_t m);
+
+// Add data chunk `index` (0-based within its group) into the M parity
+// accumulators. Parity buffers must start zeroed and hold
+// BLOCK_FEC_SYMBOL_SIZE(chunk_size) bytes each.
+void block_fec_encode_chunk(uint8_t m, uint8_t index, const uint8_t *data,
+                            uint16_t data_len, uint8_t *const parity[], size_t chunk_size);
+
+// Rebuild missing data chunks of one group in place.
+//   group_k         chunks in this group (the last group may be short)
+//   m               parity chunks per group
+//   data[i]         chunk_size bytes of storage for chunk i (present or not)
+//   lens[i]         data length of chunk i; filled in for rebuilt chunks
+//   present[i]      chunk i was received
+//   parity[j]       parity symbol j (modified during decoding)
+//   parity_present  parity j was received
+// Returns the number of chunks rebuilt, or -1 if there is not enough parity.
+int block_fec_decode(uint8_t group_k, uint8_t m, uint8_t *const data[], uint16_t lens[],
+                     const bool present[], uint8_t *const parity[],
+                     const bool parity_present[], size_t chunk_size);
+
+#endif // BLOCK_FEC_H
@@ -0,0 +1,165 @@
+// block_fountain.c - GF(2) fountain coding over chunk generations
+
+#include "block_fountain.h"
+#include <string.h>
+
+#define COEF_SIZE 8
+
+static uint64_t get_coef(const block_fountain_decoder_t *dec, uint16_t index) {
+    uint64_t c;
+    memcpy(&c, dec->coefs + (size_t)index * COEF_SIZE, COEF_SIZE);
+    return c;
+}
+
+static void put_coef(block_fountain_decoder_t *dec, uint16_t index, uint64_t c) {
+    memcpy(dec->coefs + (size_t)index * COEF_SIZE, &c, COEF_SIZE);
+}
+
+// Word access to byte buffers (the reassembly buffer is uint8_t)
+typedef uint32_t __attribute__((may_alias)) xor_word_t;
+
+// dst ^= src, a word at a time when both buffers allow it
+static void xor_into(uint8_t *dst, const uint8_t *src, size_t len) {
+    size_t i = 0;
+    if ((((uintptr_t)dst | (uintptr_t)src) & 3) == 0) {
+        for (; i + 4 <= len; i += 4) {
+            *(xor_word_t *)(dst + i) ^= *(const xor_word_t *)(src + i);
+        }
+    }
+    for (; i < len; i++) {
+        dst[i] ^= src[i];
+    }
+}
+
+static uint64_t gen_mask(uint8_t k) {
+    return k >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << k) - 1);
+}
+
+// Weyl sequence through the murmur3 finaliser
+static uint32_t coef_rand(uint32_t *state) {
+    uint32_t z = (*state += 0x9E3779B9u);
+    z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+    z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+    return z ^ (z >> 16);
+}
+
+uint64_t block_fountain_random_coef(uint32_t *state, uint8_t k) {
+    uint64_t coef;
+    do {
+        coef = (((uint64_t)coef_rand(state) << 32) | coef_rand(state)) & gen_mask(k);
+    } while (coef == 0);
+    return coef;
+}
+
+uint16_t block_fountain_generations(uint16_t total_parts) {
+    return (total_parts + BLOCK_FOUNTAIN_GEN_SIZE - 1) / BLOCK_FOUNTAIN_GEN_SIZE;
+}
+
+uint8_t block_fountain_gen_size(uint16_t total_parts, uint16_t gen) {
+    uint32_t first = (uint32_t)gen * BLOCK_FOUNTAIN_GEN_SIZE;
+    if (first >= total_parts) return 0;
+    uint32_t left = total_parts - first;
+    return left > BLOCK_FOUNTAIN_GEN_SIZE ? BLOCK_FOUNTAIN_GEN_SIZE : (uint8_t)left;
+}
+
+size_t block_fountain_workspace_size(uint16_t total_parts, size_t chunk_size) {
+    return (size_t)total_parts * (chunk_size + COEF_SIZE);
+}
+
+void block_fountain_encode(const uint8_t *data, size_t data_len, uint16_t gen,
+                           uint64_t coef, uint8_t *out, size_t chunk_size) {
+    memset(out, 0, chunk_size);
+    size_t first = (size_t)gen * BLOCK_FOUNTAIN_GEN_SIZE;
+
+    for (int i = 0; i < BLOCK_FOUNTAIN_GEN_SIZE; i++) {
+        if (!((coef >> i) & 1)) continue;
+        size_t offset = (first + i) * chunk_size;
+        if (offset >= data_len) break;
+        size_t len = data_len - offset < chunk_size ? data_len - offset : chunk_size;
+        xor_into(out, data + offset, len);
+    }
+}
+
+int block_fountain_decoder_init(block_fountain_decoder_t *dec, uint8_t *workspace,
+                                size_t workspace_size, bool *present,
+                                uint16_t total_parts, size_t chunk_size) {
+    size_t needed = block_fountain_workspace_size(total_parts, chunk_size);
+    if (total_parts == 0 || needed > workspace_size) {
+        return -1;
+    }
+
+    // Chunks at the start (where the block ends up), masks at the end
+    dec->chunks = workspace;
+    dec->coefs = workspace + workspace_size - (size_t)total_parts * COEF_SIZE;
+    dec->present = present;
+    dec->total_parts = total_parts;
+    dec->rank = 0;
+    dec->chunk_size = chunk_size;
+    memset(present, 0, total_parts * sizeof(bool));
+    return 0;
+}
+
+// Generation at full rank: rows are in echelon form (row i has its lowest
+// bit at i), so resolving from the top down leaves each slot holding chunk i.
+static void back_substitute(block_fountain_decoder_t *dec, uint16_t first, uint8_t k) {
+    for (int i = k - 1; i >= 0; i--) {
+        uint8_t *row = dec->chunks + (size_t)(first + i) * dec->chunk_size;
+        uint64_t c = get_coef(dec, first + i) & ~((uint64_t)1 << i);
+        for (int j = i + 1; j < k && c != 0; j++) {
+            if ((c >> j) & 1) {
+                xor_into(row, dec->chunks + (size_t)(first + j) * dec->chunk_size, dec->chunk_size);
+                c &= ~((uint64_t)1 << j);
+            }
+        }
+        put_coef(dec, first + i, (uint64_t)1 << i);
+    }
+}
+
+int block_fountain_decoder_add(block_fountain_decoder_t *dec, uint16_t gen,
+                               uint64_t coef, const uint8_t *symbol) {
+    uint8_t k = block_fountain_gen_size(dec->total_parts, gen);
+    if (k == 0 || coef == 0 || (coef & ~gen_mask(k)) != 0) {
+        return -1;
+    }
+    uint16_t first = gen * BLOCK_FOUNTAIN_GEN_SIZE;
+
+    // Reduce the mask against the stored rows first; the payload only needs
+    // the same XORs, which are applied once the pivot slot is known.
+    uint64_t c = coef;
+    uint64_t used = 0;
+    int pivot = -1;
+    for (int i = 0; i < k; i++) {
+        if (!((c >> i) & 1)) continue;
+        if (dec->present[first + i]) {
+            c ^= get_coef(dec, first + i);
+            used |= (uint64_t)1 << i;
+        } else {
+            pivot = i;
+            break;
+        }
+    }
+    if (pivot < 0) {
+        return 0;  // Linear combination of rows already held
+    }
+
+    uint8_t *row = dec->chunks + (size_t)(first + pivot) * dec->chunk_size;
+    memcpy(row, symbol, dec->chunk_size);
+    for (int i = 0; used != 0; i++) {
+        if ((used >> i) & 1) {
+            xor_into(row, dec->chunks + (size_t)(first + i) * dec->chunk_size, dec->chunk_size);
+            used &= ~((uint64_t)1 << i);
+        }
+    }
+    put_coef(dec, first + pivot, c);
+    dec->present[first + pivot] = true;
+    dec->rank++;
+
+    uint8_t gen_rank = 0;
+    for (int i = 0; i < k; i++) {
+        if (dec->present[first + i]) gen_rank++;
+    }
+    if (gen_rank == k) {
+        back_substitute(dec, first, k);
+    }
+    return 1;
+}
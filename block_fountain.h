@@ -0,0 +1,71 @@
+// block_fountain.h - Rateless (fountain) coding for one-to-many block transfers
+//
+// The block is split into generations of up to 64 chunks. Every encoded
+// symbol is the XOR of a subset of one generation's chunks, described by a
+// 64-bit coefficient mask (bit i = chunk i of the generation). The first
+// pass is systematic (one chunk per symbol); after that the publisher sends
+// random combinations for as long as it likes. A subscriber can rebuild a
+// generation from any set of symbols whose masks span it - with random
+// masks that is K plus one or two extra symbols, whichever ones were lost.
+//
+// Decoding is incremental Gaussian elimination over GF(2). The reassembly
+// buffer is the workspace: row i of a generation is kept in the slot of
+// chunk i, and the coefficient masks sit in a table at the end of the
+// buffer. Once a generation reaches full rank it is back-substituted in
+// place, leaving the plain chunks where a normal transfer would put them.
+
+#ifndef BLOCK_FOUNTAIN_H
+#define BLOCK_FOUNTAIN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define BLOCK_FOUNTAIN_GEN_SIZE 64   // Chunks per generation (bits in a mask)
+
+typedef struct {
+    uint8_t *chunks;        // Row storage, chunk_size bytes per chunk
+    uint8_t *coefs;         // Coefficient masks, 8 bytes per chunk
+    bool *present;          // present[i]: a row with pivot i is stored
+    uint16_t total_parts;   // Source chunks in the block
+    uint16_t rank;          // Rows stored so far (== total_parts when decoded)
+    size_t chunk_size;
+} block_fountain_decoder_t;
+
+// Number of generations for a block of total_parts chunks
+uint16_t block_fountain_generations(uint16_t total_parts);
+
+// Chunks in generation gen (the last one may be short)
+uint8_t block_fountain_gen_size(uint16_t total_parts, uint16_t gen);
+
+// Draw a random non-zero coefficient mask for a generation of k chunks.
+// The generator is deliberately non-linear over GF(2) (a linear one such as
+// xorshift would confine the masks to a subspace the decoder cannot complete).
+uint64_t block_fountain_random_coef(uint32_t *state, uint8_t k);
+
+// Workspace bytes needed to decode total_parts chunks
+size_t block_fountain_workspace_size(uint16_t total_parts, size_t chunk_size);
+
+// Build the symbol for (gen, coef) from the source block into out
+// (chunk_size bytes; chunks shorter than chunk_size are zero padded).
+void block_fountain_encode(const uint8_t *data, size_t data_len, uint16_t gen,
+                           uint64_t coef, uint8_t *out, size_t chunk_size);
+
+// Prepare a decoder over a caller-provided workspace. present[] must hold
+// total_parts entries. Returns -1 if the workspace is too small.
+int block_fountain_decoder_init(block_fountain_decoder_t *dec, uint8_t *workspace,
+                                size_t workspace_size, bool *present,
+                                uint16_t total_parts, size_t chunk_size);
+
+// Add one received symbol. Returns 1 if it raised the rank, 0 if it was
+// redundant, -1 if gen/coef are out of range. When a generation reaches
+// full rank its chunks are decoded in place.
+int block_fountain_decoder_add(block_fountain_decoder_t *dec, uint16_t gen,
+                               uint64_t coef, const uint8_t *symbol);
+
+// True once every generation has been decoded
+static inline bool block_fountain_decoder_done(const block_fountain_decoder_t *dec) {
+    return dec->rank == dec->total_parts;
+}
+
+#endif // BLOCK_FOUNTAIN_H
@@ -0,0 +1,189 @@
+// block_lz.c - Greedy LZ4 block compressor and restartable decompressor
+
+#include "block_lz.h"
+#include <string.h>
+
+#define MIN_MATCH      4
+#define MAX_OFFSET     65535
+#define LAST_LITERALS  5     // LZ4 format: the block ends with >= 5 literals
+#define MF_LIMIT       12    // ... and no match starts in the last 12 bytes
+#define HASH_SIZE      (1u << BLOCK_LZ_HASH_BITS)
+#define NO_POSITION    0xFFFFFFFFu
+
+static uint32_t hash_table[HASH_SIZE];
+
+typedef struct {
+    block_lz_sink_t sink;
+    void *ctx;
+    size_t count;
+    bool failed;
+} lz_writer_t;
+
+static void lz_put(lz_writer_t *w, const uint8_t *data, size_t len) {
+    if (w->sink && !w->failed && w->sink(w->ctx, data, len) != 0) {
+        w->failed = true;
+    }
+    w->count += len;
+}
+
+static void lz_put_byte(lz_writer_t *w, uint8_t b) {
+    lz_put(w, &b, 1);
+}
+
+// Length continuation bytes for lengths >= 15
+static void lz_put_length(lz_writer_t *w, size_t len) {
+    while (len >= 255) {
+        lz_put_byte(w, 255);
+        len -= 255;
+    }
+    lz_put_byte(w, (uint8_t)len);
+}
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash32(uint32_t v) {
+    return (v * 2654435761u) >> (32 - BLOCK_LZ_HASH_BITS);
+}
+
+// One sequence: literals src[anchor..ip), then a match (match_len 0 = none)
+static void lz_emit(lz_writer_t *w, const uint8_t *literals, size_t lit_len,
+                    uint16_t offset, size_t match_len) {
+    size_t ml = match_len ? match_len - MIN_MATCH : 0;
+    uint8_t token = (uint8_t)(((lit_len >= 15 ? 15 : lit_len) << 4) | (ml >= 15 ? 15 : ml));
+
+    lz_put_byte(w, token);
+    if (lit_len >= 15) lz_put_length(w, lit_len - 15);
+    lz_put(w, literals, lit_len);
+
+    if (match_len) {
+        lz_put_byte(w, offset & 0xFF);
+        lz_put_byte(w, offset >> 8);
+        if (ml >= 15) lz_put_length(w, ml - 15);
+    }
+}
+
+long block_lz_compress(const uint8_t *src, size_t len, block_lz_sink_t sink, void *ctx,
+                       size_t *head_room) {
+    lz_writer_t w = { sink, ctx, 0, false };
+    size_t anchor = 0;
+    size_t ip = 0;
+    size_t lead = 0;
+
+    for (size_t i = 0; i < HASH_SIZE; i++) {
+        hash_table[i] = NO_POSITION;
+    }
+
+    if (len > MF_LIMIT) {
+        size_t match_start_limit = len - MF_LIMIT;
+        size_t match_end_limit = len - LAST_LITERALS;
+
+        while (ip < match_start_limit) {
+            uint32_t seq = read32(src + ip);
+            uint32_t h = hash32(seq);
+            uint32_t ref = hash_table[h];
+            hash_table[h] = (uint32_t)ip;
+
+            if (ref == NO_POSITION || ip - ref > MAX_OFFSET || read32(src + ref) != seq) {
+                ip++;
+                continue;
+            }
+
+            size_t match_len = MIN_MATCH;
+            while (ip + match_len < match_end_limit && src[ref + match_len] == src[ip + match_len]) {
+                match_len++;
+            }
+
+            lz_emit(&w, src + anchor, ip - anchor, (uint16_t)(ip - ref), match_len);
+            ip += match_len;
+            anchor = ip;
+
+            // Output runs ahead of input by this much after the sequence
+            if (ip > w.count && ip - w.count > lead) lead = ip - w.count;
+
+            if (ip >= 2 && ip < match_start_limit) {
+                hash_table[hash32(read32(src + ip - 2))] = (uint32_t)(ip - 2);
+            }
+        }
+    }
+
+    // Final literals-only sequence
+    lz_emit(&w, src + anchor, len - anchor, 0, 0);
+    if (len > w.count && len - w.count > lead) lead = len - w.count;
+
+    if (head_room) *head_room = lead;
+    return w.failed ? -1 : (long)w.count;
+}
+
+// Parse a length continuation starting at *pos. Returns false if the
+// input ends before the length does.
+static bool read_length(const uint8_t *in, size_t in_avail, size_t *pos, size_t *len) {
+    uint8_t b;
+    do {
+        if (*pos >= in_avail) return false;
+        b = in[(*pos)++];
+        *len += b;
+    } while (b == 255);
+    return true;
+}
+
+int block_lz_decompress(block_lz_stream_t *s, const uint8_t *in, size_t in_avail,
+                        uint8_t *out, size_t out_len) {
+    // In-place decoding: the input lives later in the output buffer, so a
+    // write must never pass the input still to be read
+    size_t guard = (size_t)-1;
+    if ((uintptr_t)in > (uintptr_t)out && (uintptr_t)in < (uintptr_t)out + out_len) {
+        guard = (uintptr_t)in - (uintptr_t)out;
+    }
+
+    while (s->out_pos < out_len) {
+        size_t pos = s->in_pos;
+        if (pos >= in_avail) return 0;
+
+        uint8_t token = in[pos++];
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !read_length(in, in_avail, &pos, &lit_len)) return 0;
+        if (pos + lit_len > in_avail) return 0;
+        if (s->out_pos + lit_len > out_len) return -1;
+
+        size_t lit_pos = pos;
+        pos += lit_len;
+        bool last = (s->out_pos + lit_len == out_len);
+
+        size_t offset = 0;
+        size_t match_len = 0;
+        if (!last) {
+            if (pos + 2 > in_avail) return 0;
+            offset = in[pos] | (in[pos + 1] << 8);
+            pos += 2;
+            match_len = token & 0x0F;
+            if (match_len == 15 && !read_length(in, in_avail, &pos, &match_len)) return 0;
+            match_len += MIN_MATCH;
+            if (offset == 0 || offset > s->out_pos + lit_len ||
+                s->out_pos + lit_len + match_len > out_len) {
+                return -1;
+            }
+        }
+
+        // Whole sequence available - check it cannot overwrite unread input
+        if (guard != (size_t)-1 && s->out_pos + lit_len + match_len > guard + pos) {
+            return -1;
+        }
+
+        memmove(out + s->out_pos, in + lit_pos, lit_len);
+        s->out_pos += lit_len;
+
+        // Byte copy: matches may overlap their own output
+        uint8_t *dst = out + s->out_pos;
+        const uint8_t *ref = dst - offset;
+        for (size_t i = 0; i < match_len; i++) {
+            dst[i] = ref[i];
+        }
+        s->out_pos += match_len;
+        s->in_pos = pos;
+    }
+    return 1;
+}
@@ -0,0 +1,43 @@
+// block_lz.h - LZ4 block-format compression for block transfers
+//
+// The encoder is a greedy single-pass LZ4 compressor with a small static
+// hash table (no malloc). Output is handed to a sink callback as it is
+// produced, so the publisher can chunk it without a second full-size
+// buffer; a NULL sink just measures. Matches reach back at most 64KB.
+//
+// The decoder is restartable: it decodes whole sequences from whatever
+// prefix of the compressed stream is available and resumes from there when
+// more arrives. The input may sit at the end of the output buffer (in-place
+// decoding) as long as writes stay behind the unread input, which the
+// encoder reports as the required head room.
+
+#ifndef BLOCK_LZ_H
+#define BLOCK_LZ_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define BLOCK_LZ_HASH_BITS 11   // 2048-entry match table (8KB)
+
+// Receives compressed bytes in order
+typedef int (*block_lz_sink_t)(void *ctx, const uint8_t *data, size_t len);
+
+// Compress src into the sink. Returns the compressed size, or -1 if the
+// sink failed. If head_room is set it receives the minimum distance the
+// compressed stream must start after the output buffer for in-place
+// decoding (the largest amount the output ever runs ahead of the input).
+long block_lz_compress(const uint8_t *src, size_t len, block_lz_sink_t sink, void *ctx,
+                       size_t *head_room);
+
+typedef struct {
+    size_t in_pos;          // Start of the next undecoded sequence
+    size_t out_pos;         // Bytes produced so far
+} block_lz_stream_t;
+
+// Decode complete sequences from in[0..in_avail). Returns 1 once out_len
+// bytes have been produced, 0 if more input is needed, -1 on corrupt input.
+int block_lz_decompress(block_lz_stream_t *s, const uint8_t *in, size_t in_avail,
+                        uint8_t *out, size_t out_len);
+
+#endif // BLOCK_LZ_H
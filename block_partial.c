@@ -0,0 +1,325 @@
+// block_partial.c - Checkpoints of the block being received
+
+#include "block_partial.h"
+#include "sd_write_queue.h"
+#include "sd_card.h"
+#include "crc32c.h"
+#include "ff.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PARTIAL_MAGIC       0x4C4A5250u     // "PRJL"
+#define PARTIAL_SLOT_SIZE   512
+#define PARTIAL_TAG_PREPARE 0x2             // Record job clearing the journal before a new block
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;               // The valid slot with the highest seq is current
+    uint16_t block_id;          // 0 = no partial block
+    uint16_t total_parts;
+    uint16_t received_parts;
+    uint8_t has_digest;
+    uint8_t reserved;
+    uint32_t total_length;      // 0 until the final chunk is on the card
+    uint32_t block_crc;
+    uint8_t mask[(BLOCK_MAX_CHUNKS + 7) / 8];   // Chunks whose data is in PARTIAL.DAT
+    uint32_t crc;               // CRC-32C of the fields above
+} partial_record_t;
+
+_Static_assert(sizeof(partial_record_t) <= PARTIAL_SLOT_SIZE, "journal record must fit a slot");
+
+static partial_record_t rec;        // Newest record on the card
+static partial_record_t pending;    // Checkpoint in flight
+static uint8_t slot_buf[2][PARTIAL_SLOT_SIZE];
+static uint32_t pending_bytes;
+static bool in_flight;
+static bool prepare_failed;
+static uint16_t clear_after;        // Clear asked for while a checkpoint was in flight
+static block_partial_stats_t stats;
+
+static uint32_t record_crc(const partial_record_t *r) {
+    return crc32c((const uint8_t *)r, offsetof(partial_record_t, crc));
+}
+
+static bool mask_get(const partial_record_t *r, uint16_t i) {
+    return r->mask[i >> 3] & (1u << (i & 7));
+}
+
+static void record_written(void *ctx, int result);
+
+// Queue r as record seq, in slot seq & 1
+static int record_submit(const partial_record_t *r, uint32_t seq, uintptr_t tag) {
+    partial_record_t out = *r;
+    out.magic = PARTIAL_MAGIC;
+    out.seq = seq;
+    out.crc = record_crc(&out);
+
+    uint8_t *buf = slot_buf[seq & 1];
+    memset(buf, 0, PARTIAL_SLOT_SIZE);
+    memcpy(buf, &out, sizeof(out));
+    return sd_write_queue_submit(BLOCK_PARTIAL_JOURNAL, (seq & 1) * PARTIAL_SLOT_SIZE, buf,
+                                 PARTIAL_SLOT_SIZE, 0, record_written, (void *)(tag | (seq & 1)));
+}
+
+static void record_written(void *ctx, int result) {
+    uintptr_t tag = (uintptr_t)ctx;
+    if (result == 0) {
+        memcpy(&rec, slot_buf[tag & 1], sizeof(rec));
+    }
+    if (tag & PARTIAL_TAG_PREPARE) {
+        prepare_failed = (result != 0);
+        return;
+    }
+
+    in_flight = false;
+    if (result == 0) {
+        stats.checkpoints++;
+    } else {
+        stats.failed++;
+        printf("[PARTIAL] ❌ Journal write failed\n");
+    }
+    if (clear_after != 0) {
+        uint16_t block_id = clear_after;
+        clear_after = 0;
+        block_partial_clear(block_id);
+    }
+}
+
+// The chunk data is on the card: commit the record that claims it
+static void data_written(void *ctx, int result) {
+    (void)ctx;
+    if (result != 0 || prepare_failed) {
+        in_flight = false;
+        stats.failed++;
+        printf("[PARTIAL] ❌ Checkpoint of block %d failed\n", pending.block_id);
+        return;
+    }
+    stats.bytes += pending_bytes;
+    // The data job just left the queue, so there is room
+    if (record_submit(&pending, rec.seq + 1, 0) != 0) {
+        in_flight = false;
+        stats.failed++;
+    }
+}
+
+int block_partial_open(void) {
+    if (in_flight) {
+        sd_write_queue_flush();
+    }
+    memset(&rec, 0, sizeof(rec));
+    in_flight = false;
+    clear_after = 0;
+    if (!sd_card_is_mounted()) {
+        return -1;
+    }
+
+    FRESULT res = f_mkdir("received");
+    if (res != FR_OK && res != FR_EXIST) {
+        return -1;
+    }
+    FIL f;
+    if (f_open(&f, BLOCK_PARTIAL_JOURNAL, FA_READ | FA_WRITE | FA_OPEN_ALWAYS) != FR_OK) {
+        return -1;
+    }
+
+    UINT n = 0;
+    if (f_size(&f) < 2 * PARTIAL_SLOT_SIZE) {
+        // New journal: both slots empty
+        memset(slot_buf, 0, sizeof(slot_buf));
+        res = f_write(&f, slot_buf, sizeof(slot_buf), &n);
+        f_close(&f);
+        return (res == FR_OK && n == sizeof(slot_buf)) ? 0 : -1;
+    }
+
+    bool found = false;
+    for (int slot = 0; slot < 2; slot++) {
+        partial_record_t r;
+        if (f_lseek(&f, slot * PARTIAL_SLOT_SIZE) != FR_OK ||
+            f_read(&f, &r, sizeof(r), &n) != FR_OK || n != sizeof(r)) {
+            continue;
+        }
+        if (r.magic == PARTIAL_MAGIC && r.crc == record_crc(&r) && r.total_parts <= BLOCK_MAX_CHUNKS &&
+            (!found || r.seq > rec.seq)) {
+            rec = r;
+            found = true;
+        }
+    }
+    f_close(&f);
+
+    if (rec.block_id != 0) {
+        printf("[PARTIAL] Block %d journaled with %d/%d chunks\n", rec.block_id, rec.received_parts,
+               rec.total_parts);
+    }
+    return rec.block_id != 0 ? 1 : 0;
+}
+
+bool block_partial_find(uint16_t *block_id, uint16_t *total_parts) {
+    if (rec.block_id == 0) {
+        return false;
+    }
+    *block_id = rec.block_id;
+    *total_parts = rec.total_parts;
+    return true;
+}
+
+int block_partial_checkpoint(const block_assembly_t *block, bool force) {
+    if (!sd_card_is_mounted()) {
+        return -1;
+    }
+    if (block->block_id == 0 || block->compressed || block->fountain) {
+        return 1;
+    }
+
+    bool same = (rec.block_id == block->block_id && rec.total_parts == block->total_parts);
+    uint16_t journaled = same ? rec.received_parts : 0;
+    if (block->received_parts <= journaled ||
+        (!force && block->received_parts < journaled + BLOCK_PARTIAL_CHUNKS)) {
+        return 1;
+    }
+    // A new block takes a prepare record, its data and its record
+    int jobs = (same || rec.block_id == 0) ? 2 : 3;
+    if (in_flight || SD_WRITE_QUEUE_DEPTH - sd_write_queue_depth() < jobs) {
+        stats.skipped++;
+        return 1;
+    }
+
+    // Chunks received that the card does not hold yet
+    if (!same) {
+        memset(&pending, 0, sizeof(pending));
+    } else {
+        pending = rec;
+    }
+    uint16_t lo = block->total_parts;
+    uint16_t hi = 0;
+    for (uint16_t i = 0; i < block->total_parts; i++) {
+        if (block->received_mask[i] && !mask_get(&pending, i)) {
+            pending.mask[i >> 3] |= 1u << (i & 7);
+            if (i < lo) lo = i;
+            hi = i + 1;
+        }
+    }
+    pending.block_id = block->block_id;
+    pending.total_parts = block->total_parts;
+    pending.received_parts = block->received_parts;
+    pending.has_digest = block->has_digest;
+    pending.block_crc = block->block_crc;
+    pending.total_length = block->total_length;
+
+    // Whole sectors around them; the bytes of chunks not in the record
+    // are don't-cares
+    uint32_t start = (uint32_t)lo * BLOCK_CHUNK_DATA_SIZE & ~(uint32_t)511;
+    uint32_t end = ((uint32_t)hi * BLOCK_CHUNK_DATA_SIZE + 511) & ~(uint32_t)511;
+    if (end > BLOCK_BUFFER_SIZE) end = BLOCK_BUFFER_SIZE;
+    uint8_t flags = 0;
+    prepare_failed = false;
+
+    if (!same) {
+        // The old block's record must be gone before its data is
+        // overwritten; the new block's file starts at offset 0
+        if (rec.block_id != 0) {
+            partial_record_t empty;
+            memset(&empty, 0, sizeof(empty));
+            if (record_submit(&empty, rec.seq + 1, PARTIAL_TAG_PREPARE) != 0) {
+                return -1;
+            }
+        }
+        flags = SD_WQ_CREATE;
+        start = 0;
+    }
+
+    pending_bytes = end - start;
+    in_flight = true;
+    if (sd_write_queue_submit(BLOCK_PARTIAL_DATA, start, block->data_buffer + start, end - start,
+                              flags, data_written, NULL) != 0) {
+        // Only reachable if the queue filled in between; a queued prepare
+        // record still clears the journal, which is consistent
+        in_flight = false;
+        return -1;
+    }
+    return 0;
+}
+
+int block_partial_checkpoint_sync(const block_assembly_t *block) {
+    uint32_t failed = stats.failed;
+    if (in_flight) {
+        sd_write_queue_flush();
+    }
+    int rc = block_partial_checkpoint(block, true);
+    if (rc == 0 || in_flight) {
+        sd_write_queue_flush();
+    }
+    return (rc < 0 || stats.failed != failed) ? -1 : 0;
+}
+
+int block_partial_load(block_assembly_t *block) {
+    if (rec.block_id == 0 || rec.block_id != block->block_id || rec.total_parts != block->total_parts ||
+        block->chunk_base != block->data_buffer) {
+        return -1;
+    }
+
+    FIL f;
+    if (f_open(&f, BLOCK_PARTIAL_DATA, FA_READ) != FR_OK) {
+        return -1;
+    }
+    uint32_t len = f_size(&f);
+    uint32_t stream_len = (uint32_t)block->total_parts * BLOCK_CHUNK_DATA_SIZE;
+    if (len > stream_len) len = stream_len;
+    if (len > BLOCK_BUFFER_SIZE) len = BLOCK_BUFFER_SIZE;
+    UINT n = 0;
+    FRESULT res = f_read(&f, block->data_buffer, len, &n);
+    f_close(&f);
+    if (res != FR_OK) {
+        return -1;
+    }
+
+    // Chunks the record claims and the file holds in full
+    uint16_t restored = 0;
+    for (uint16_t i = 0; i < block->total_parts; i++) {
+        uint32_t chunk_end = (uint32_t)(i + 1) * BLOCK_CHUNK_DATA_SIZE;
+        if (i == block->total_parts - 1 && rec.total_length != 0) {
+            chunk_end = rec.total_length;
+        }
+        if (mask_get(&rec, i) && chunk_end <= n && !block->received_mask[i]) {
+            block->received_mask[i] = true;
+            restored++;
+        }
+    }
+    block->received_parts += restored;
+    if (block->received_mask[block->total_parts - 1] && rec.total_length != 0) {
+        block->total_length = rec.total_length;
+    }
+    if (rec.has_digest) {
+        block->has_digest = true;
+        block->block_crc = rec.block_crc;
+    }
+
+    stats.reloads++;
+    stats.chunks_reloaded += restored;
+    printf("[PARTIAL] ✓ Reloaded block %d: %d/%d chunks from the card\n", block->block_id, restored,
+           block->total_parts);
+    return restored;
+}
+
+void block_partial_clear(uint16_t block_id) {
+    if (in_flight) {
+        if (pending.block_id == block_id || rec.block_id == block_id) {
+            clear_after = block_id;
+        }
+        return;
+    }
+    if (rec.block_id == 0 || rec.block_id != block_id || !sd_card_is_mounted()) {
+        return;
+    }
+    memset(&pending, 0, sizeof(pending));
+    in_flight = true;
+    if (record_submit(&pending, rec.seq + 1, 0) != 0) {
+        in_flight = false;
+    }
+}
+
+void block_partial_get_stats(block_partial_stats_t *out) {
+    *out = stats;
+}
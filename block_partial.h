@@ -0,0 +1,65 @@
+// block_partial.h - Subscriber journal of a partially received block
+//
+// The chunks of the block being assembled are checkpointed to the card so
+// they survive a reboot, a reconnect or the assembly timeout. A checkpoint
+// writes the chunks received since the previous one to PARTIAL.DAT (at
+// their offsets in the block) and then a record to PARTIAL.JNL: block id,
+// chunk count, digest and the bitmap of chunks on the card. Both go
+// through the write-behind queue, the record only after its data write
+// succeeded, so a record never claims a chunk whose data is not on the
+// card. The record alternates between two CRC-checked 512-byte slots; a
+// write torn by a power cut leaves the previous checkpoint.
+//
+// When chunks of the journaled block arrive again (the publisher resending
+// or resuming it), the assembly is reloaded from the card and only the
+// chunks still missing are NACKed. One block is journaled at a time.
+// Compressed and fountain blocks are not: their chunks move in the
+// reassembly buffer as they are decoded.
+
+#ifndef BLOCK_PARTIAL_H
+#define BLOCK_PARTIAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "block_transfer.h"
+
+#define BLOCK_PARTIAL_DATA      "received/PARTIAL.DAT"
+#define BLOCK_PARTIAL_JOURNAL   "received/PARTIAL.JNL"
+#define BLOCK_PARTIAL_CHUNKS    64      // New chunks between checkpoints
+#define BLOCK_PARTIAL_IDLE_MS   2000    // Checkpoint a block that stopped arriving
+
+typedef struct {
+    uint32_t checkpoints;       // Records written
+    uint32_t skipped;           // Checkpoints refused: one in flight or the queue full
+    uint32_t failed;
+    uint32_t bytes;             // Chunk data written
+    uint32_t reloads;           // Assemblies restored from the card
+    uint32_t chunks_reloaded;
+} block_partial_stats_t;
+
+// Read the journal record. Returns 1 if it holds a partial block, 0 if
+// not, -1 if the card is not mounted.
+int block_partial_open(void);
+
+// The journaled partial block, if any
+bool block_partial_find(uint16_t *block_id, uint16_t *total_parts);
+
+// Queue a checkpoint of the block. Unless forced, waits for
+// BLOCK_PARTIAL_CHUNKS new chunks. Returns 0 if queued, 1 if there was
+// nothing to do (or a checkpoint is still in flight), -1 on error.
+int block_partial_checkpoint(const block_assembly_t *block, bool force);
+
+// Checkpoint the block and wait until it is on the card. For an assembly
+// about to be dropped: the queued writes read from the reassembly buffer.
+int block_partial_checkpoint_sync(const block_assembly_t *block);
+
+// Restore the journaled chunks into an assembly just initialised for the
+// journaled block. Returns the chunks restored, or -1.
+int block_partial_load(block_assembly_t *block);
+
+// Forget the block once it has been saved or discarded
+void block_partial_clear(uint16_t block_id);
+
+void block_partial_get_stats(block_partial_stats_t *stats);
+
+#endif // BLOCK_PARTIAL_H
@@ -0,0 +1,174 @@
+// block_pipeline.c - SPSC packet ring between a producer core and core0
+
+#include "block_pipeline.h"
+#include <stdatomic.h>
+
+#ifdef BLOCK_PIPELINE_HOST
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#else
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#endif
+
+#define SLOT_MASK (BLOCK_PIPELINE_SLOTS - 1)
+
+_Static_assert((BLOCK_PIPELINE_SLOTS & SLOT_MASK) == 0, "BLOCK_PIPELINE_SLOTS must be a power of two");
+
+static block_pipeline_slot_t ring[BLOCK_PIPELINE_SLOTS];
+static atomic_uint ring_head;           // Next slot the producer fills (written by producer)
+static atomic_uint ring_tail;           // Next slot the consumer sends (written by consumer)
+static atomic_bool producer_done;
+static atomic_bool consumer_abort;
+static atomic_uint producer_waits;
+static volatile int producer_status;
+
+static block_pipeline_producer_t run_producer;
+static void *run_ctx;
+
+static void producer_entry(void) {
+    producer_status = run_producer(run_ctx);
+    atomic_store_explicit(&producer_done, true, memory_order_release);
+}
+
+#ifdef BLOCK_PIPELINE_HOST
+
+static pthread_t producer_thread;
+
+static void *producer_thread_main(void *arg) {
+    (void)arg;
+    producer_entry();
+    return NULL;
+}
+
+static int start_producer(void) {
+    return pthread_create(&producer_thread, NULL, producer_thread_main, NULL) == 0 ? 0 : -1;
+}
+
+static void join_producer(void) {
+    pthread_join(producer_thread, NULL);
+}
+
+static void producer_yield(void) {
+    sched_yield();
+}
+
+uint64_t block_pipeline_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+#else
+
+static int start_producer(void) {
+    // Core1 may still be parked from an earlier transfer
+    multicore_reset_core1();
+    multicore_launch_core1(producer_entry);
+    return 0;
+}
+
+static void join_producer(void) {
+    while (!atomic_load_explicit(&producer_done, memory_order_acquire)) {
+        tight_loop_contents();
+    }
+}
+
+static void producer_yield(void) {
+    tight_loop_contents();
+}
+
+uint64_t block_pipeline_now_us(void) {
+    return time_us_64();
+}
+
+#endif
+
+block_pipeline_slot_t *block_pipeline_acquire(void) {
+    unsigned head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    bool waited = false;
+
+    while (head - atomic_load_explicit(&ring_tail, memory_order_acquire) >= BLOCK_PIPELINE_SLOTS) {
+        if (atomic_load_explicit(&consumer_abort, memory_order_acquire)) {
+            return NULL;
+        }
+        if (!waited) {
+            atomic_fetch_add_explicit(&producer_waits, 1, memory_order_relaxed);
+            waited = true;
+        }
+        producer_yield();
+    }
+    if (atomic_load_explicit(&consumer_abort, memory_order_acquire)) {
+        return NULL;
+    }
+    return &ring[head & SLOT_MASK];
+}
+
+void block_pipeline_commit(void) {
+    unsigned head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    atomic_store_explicit(&ring_head, head + 1, memory_order_release);
+}
+
+int block_pipeline_run(block_pipeline_producer_t producer, block_pipeline_consumer_t consumer,
+                       block_pipeline_idle_t idle, void *ctx, block_pipeline_stats_t *stats) {
+    block_pipeline_stats_t s = {0};
+    int result = 0;
+
+    atomic_store(&ring_head, 0);
+    atomic_store(&ring_tail, 0);
+    atomic_store(&producer_done, false);
+    atomic_store(&consumer_abort, false);
+    atomic_store(&producer_waits, 0);
+    producer_status = 0;
+    run_producer = producer;
+    run_ctx = ctx;
+
+    uint64_t start = block_pipeline_now_us();
+    if (start_producer() != 0) {
+        return -1;
+    }
+
+    unsigned tail = 0;
+    bool waited = false;
+    for (;;) {
+        unsigned head = atomic_load_explicit(&ring_head, memory_order_acquire);
+        if (tail == head) {
+            // Check done before re-reading head so the last commit is not missed
+            if (atomic_load_explicit(&producer_done, memory_order_acquire) &&
+                atomic_load_explicit(&ring_head, memory_order_acquire) == tail) {
+                break;
+            }
+            if (!waited) {
+                s.consumer_waits++;
+                waited = true;
+            }
+            if (idle) idle(ctx);
+            continue;
+        }
+        waited = false;
+
+        const block_pipeline_slot_t *slot = &ring[tail & SLOT_MASK];
+        if (s.packets == 0) {
+            s.first_packet_us = block_pipeline_now_us() - start;
+        }
+        if (consumer(ctx, slot) != 0) {
+            result = -1;
+            atomic_store_explicit(&consumer_abort, true, memory_order_release);
+            break;
+        }
+        s.packets++;
+        s.bytes += slot->len;
+        atomic_store_explicit(&ring_tail, ++tail, memory_order_release);
+    }
+
+    join_producer();
+    if (producer_status != 0) {
+        result = -1;
+    }
+
+    s.elapsed_us = block_pipeline_now_us() - start;
+    s.producer_waits = atomic_load(&producer_waits);
+    if (stats) *stats = s;
+    return result;
+}
@@ -0,0 +1,65 @@
+// block_pipeline.h - Two-core packet pipeline for block transfers
+//
+// A producer (core1 on the Pico, a pthread on the host) reads the payload
+// and builds finished chunk packets into a single-producer/single-consumer
+// ring; the consumer (core0) only transmits them and handles the QoS
+// handshakes. Neither side ever blocks the other: the ring indices are
+// C11 atomics with acquire/release ordering, and a side that finds the ring
+// full (producer) or empty (consumer) spins on a yield/idle hook.
+//
+// The producer runs as a plain function that calls block_pipeline_acquire()
+// and block_pipeline_commit() for every packet and returns when it is done.
+// Host builds define BLOCK_PIPELINE_HOST to use pthreads instead of the
+// RP2040's second core.
+
+#ifndef BLOCK_PIPELINE_H
+#define BLOCK_PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define BLOCK_PIPELINE_SLOTS     16     // Packets in flight between the cores (power of two)
+#ifndef BLOCK_PIPELINE_SLOT_SIZE
+#define BLOCK_PIPELINE_SLOT_SIZE 192    // Largest packet a slot holds
+#endif
+
+typedef struct {
+    uint16_t len;           // Packet bytes
+    uint16_t part;          // Part number (for logging and retries)
+    uint8_t qos;            // QoS to publish with
+    uint8_t data[BLOCK_PIPELINE_SLOT_SIZE];
+} block_pipeline_slot_t;
+
+typedef struct {
+    uint64_t first_packet_us;   // Start to first packet handed to the consumer
+    uint64_t elapsed_us;        // Start to last packet consumed
+    uint32_t packets;
+    uint32_t bytes;
+    uint32_t producer_waits;    // Times the producer found the ring full
+    uint32_t consumer_waits;    // Times the consumer found the ring empty
+} block_pipeline_stats_t;
+
+// Producer: returns 0 on success, -1 on error (the transfer is abandoned)
+typedef int (*block_pipeline_producer_t)(void *ctx);
+// Consumer: send one packet. Returns 0, or -1 to abort the transfer.
+typedef int (*block_pipeline_consumer_t)(void *ctx, const block_pipeline_slot_t *slot);
+// Called by the consumer while it waits for packets (e.g. to poll the radio)
+typedef void (*block_pipeline_idle_t)(void *ctx);
+
+// Run a transfer: start the producer on the other core and consume on this
+// one until the producer has finished and the ring is drained. Returns 0 if
+// both sides succeeded, -1 otherwise. stats may be NULL.
+int block_pipeline_run(block_pipeline_producer_t producer, block_pipeline_consumer_t consumer,
+                       block_pipeline_idle_t idle, void *ctx, block_pipeline_stats_t *stats);
+
+// Producer side: wait for a free slot. Returns NULL if the consumer aborted.
+block_pipeline_slot_t *block_pipeline_acquire(void);
+
+// Producer side: publish the slot returned by block_pipeline_acquire()
+void block_pipeline_commit(void);
+
+// Microsecond clock used for the statistics
+uint64_t block_pipeline_now_us(void);
+
+#endif // BLOCK_PIPELINE_H
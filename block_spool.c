@@ -0,0 +1,238 @@
+// block_spool.c - Back-to-back sends of the unsent images, with a journal
+
+#include "block_spool.h"
+#include "image_index.h"
+#include "sd_card.h"
+#include "crc32c.h"
+#include "ff.h"
+#include "diskio.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#define SPOOL_MAGIC     0x4C4A5053u     // "SPJL"
+#define SPOOL_SLOT_SIZE 512
+#define SPOOL_IDLE      0
+#define SPOOL_SENDING   1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;               // The valid slot with the highest seq is current
+    uint8_t state;              // SPOOL_IDLE or SPOOL_SENDING
+    uint8_t reserved;
+    uint16_t block_id;          // 0 until the send has picked one
+    uint16_t total_parts;
+    uint16_t acked;             // Chunks 1..acked are delivered
+    uint32_t size;              // File size, to notice a replaced file
+    char name[IMAGE_INDEX_NAME_MAX];
+    uint32_t crc;               // CRC-32C of the fields above
+} spool_record_t;
+
+_Static_assert(sizeof(spool_record_t) <= SPOOL_SLOT_SIZE, "journal record must fit a slot");
+
+static FIL journal;
+static LBA_t journal_lba;       // First sector when the file is contiguous, else 0
+static spool_record_t rec;
+static uint8_t slot_buf[SPOOL_SLOT_SIZE];
+static block_spool_stats_t run_stats;
+
+static uint32_t record_crc(const spool_record_t *r) {
+    return crc32c((const uint8_t *)r, offsetof(spool_record_t, crc));
+}
+
+// Open the journal and load its newest valid slot, creating it (as one
+// contiguous extent when the card has room) if it is missing or damaged
+static int journal_open(void) {
+    memset(&rec, 0, sizeof(rec));
+    if (f_open(&journal, BLOCK_SPOOL_JOURNAL, FA_READ | FA_WRITE | FA_OPEN_ALWAYS) != FR_OK) {
+        return -1;
+    }
+    FATFS *fs = journal.obj.fs;
+
+    if (f_size(&journal) == 2 * SPOOL_SLOT_SIZE) {
+        bool found = false;
+        for (int slot = 0; slot < 2; slot++) {
+            spool_record_t r;
+            UINT n = 0;
+            if (f_lseek(&journal, slot * SPOOL_SLOT_SIZE) != FR_OK ||
+                f_read(&journal, &r, sizeof(r), &n) != FR_OK || n != sizeof(r)) {
+                continue;
+            }
+            if (r.magic == SPOOL_MAGIC && r.crc == record_crc(&r) && (!found || r.seq > rec.seq)) {
+                rec = r;
+                found = true;
+            }
+        }
+        // Both slots lie in one cluster, so they are contiguous
+        journal_lba = (fs->csize >= 2) ?
+                      fs->database + (LBA_t)(journal.obj.sclust - 2) * fs->csize : 0;
+        return 0;
+    }
+
+    f_close(&journal);
+    if (f_open(&journal, BLOCK_SPOOL_JOURNAL, FA_READ | FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+        return -1;
+    }
+    int rc = sd_card_expand_file(&journal, 2 * SPOOL_SLOT_SIZE);
+    if (rc == 0) {
+        journal_lba = fs->database + (LBA_t)(journal.obj.sclust - 2) * fs->csize;
+    } else {
+        UINT n = 0;
+        memset(slot_buf, 0, sizeof(slot_buf));
+        journal_lba = 0;
+        for (int slot = 0; slot < 2 && rc >= 0; slot++) {
+            if (f_write(&journal, slot_buf, sizeof(slot_buf), &n) != FR_OK || n != sizeof(slot_buf)) {
+                rc = -1;
+            }
+        }
+    }
+    if (rc < 0 || f_sync(&journal) != FR_OK) {
+        f_close(&journal);
+        return -1;
+    }
+    return 0;
+}
+
+// Write rec to the slot not holding the previous record. Runs on core1
+// during a pipelined send, so it must not print or touch the radio.
+static int journal_write(void) {
+    uint64_t start = time_us_64();
+    rec.magic = SPOOL_MAGIC;
+    rec.seq++;
+    rec.crc = record_crc(&rec);
+    memset(slot_buf, 0, sizeof(slot_buf));
+    memcpy(slot_buf, &rec, sizeof(rec));
+
+    uint32_t slot = rec.seq & 1;
+    int rc = 0;
+    if (journal_lba != 0) {
+        // One sector, pushed past the diskio write-back cache
+        BYTE pdrv = journal.obj.fs->pdrv;
+        if (disk_write(pdrv, slot_buf, journal_lba + slot, 1) != RES_OK ||
+            disk_ioctl(pdrv, CTRL_SYNC, NULL) != RES_OK) {
+            rc = -1;
+        }
+    } else {
+        UINT n = 0;
+        if (f_lseek(&journal, slot * SPOOL_SLOT_SIZE) != FR_OK ||
+            f_write(&journal, slot_buf, sizeof(slot_buf), &n) != FR_OK || n != sizeof(slot_buf) ||
+            f_sync(&journal) != FR_OK) {
+            rc = -1;
+        }
+    }
+
+    run_stats.journal_writes++;
+    run_stats.journal_us += time_us_64() - start;
+    return rc;
+}
+
+// block_progress_t: journal the block id once, then every
+// BLOCK_SPOOL_JOURNAL_CHUNKS acknowledged chunks and at the last one
+static void spool_progress(void *ctx, uint16_t block_id, uint16_t total_parts, uint16_t acked) {
+    (void)ctx;
+    if (block_id == rec.block_id && total_parts == rec.total_parts &&
+        (acked == rec.acked || (acked < rec.acked + BLOCK_SPOOL_JOURNAL_CHUNKS && acked < total_parts))) {
+        return;
+    }
+    rec.block_id = block_id;
+    rec.total_parts = total_parts;
+    rec.acked = acked;
+    journal_write();
+}
+
+int block_spool_run(block_spool_send_t send, void *ctx, block_spool_stats_t *stats) {
+    memset(&run_stats, 0, sizeof(run_stats));
+    uint64_t start = time_us_64();
+
+    // The journal first: creating it changes the free cluster count the
+    // index uses to notice a changed card
+    if (journal_open() != 0) {
+        printf("[SPOOL] ❌ Cannot open %s\n", BLOCK_SPOOL_JOURNAL);
+        return -1;
+    }
+    int count = image_index_open();
+    if (count < 0) {
+        f_close(&journal);
+        printf("[SPOOL] ❌ Cannot open the image index\n");
+        return -1;
+    }
+
+    image_index_entry_t entry;
+    int id;
+    int result = 0;
+    while ((id = image_index_next(&entry)) >= 0) {
+        uint16_t block_id = 0;
+        uint16_t resume_after = 0;
+
+        if (rec.state == SPOOL_SENDING && strcmp(rec.name, entry.name) == 0 &&
+            rec.size == entry.size && rec.block_id != 0) {
+            block_id = rec.block_id;
+            resume_after = rec.acked;
+            run_stats.resumed++;
+            run_stats.chunks_skipped += resume_after;
+            printf("[SPOOL] Resuming '%s' as block %d after chunk %d/%d\n", entry.name, block_id,
+                   resume_after, rec.total_parts);
+        } else {
+            rec.state = SPOOL_SENDING;
+            strcpy(rec.name, entry.name);
+            rec.size = entry.size;
+            rec.block_id = 0;
+            rec.total_parts = 0;
+            rec.acked = 0;
+            if (journal_write() != 0) {
+                printf("[SPOOL] ❌ Cannot write %s\n", BLOCK_SPOOL_JOURNAL);
+                result = -1;
+                break;
+            }
+        }
+
+        // Every chunk was out before the power went: nothing left to send
+        bool delivered = (block_id != 0 && rec.total_parts != 0 && resume_after >= rec.total_parts);
+        if (!delivered) {
+            printf("[SPOOL] Sending '%s' (%lu bytes, image %d of %d)\n", entry.name,
+                   (unsigned long)entry.size, id + 1, count);
+            if (send(ctx, entry.name, block_id, resume_after, spool_progress, NULL) != 0) {
+                printf("[SPOOL] ❌ Sending '%s' failed after chunk %d - the next run resumes there\n",
+                       entry.name, rec.acked);
+                result = -1;
+                break;
+            }
+        }
+
+        if (image_index_mark_sent((uint32_t)id) != 0) {
+            result = -1;
+            break;
+        }
+        run_stats.files++;
+        run_stats.bytes += entry.size;
+    }
+
+    if (result == 0) {
+        rec.state = SPOOL_IDLE;
+        journal_write();
+    }
+    f_close(&journal);
+
+    run_stats.elapsed_us = time_us_64() - start;
+    float seconds = run_stats.elapsed_us / 1e6f;
+    printf("[SPOOL] %lu file(s), %llu bytes in %.1f s (%.1f files/min, %.0f B/s), "
+           "%lu journal writes (%.1f ms)\n",
+           (unsigned long)run_stats.files, (unsigned long long)run_stats.bytes, seconds,
+           seconds > 0 ? run_stats.files * 60.0f / seconds : 0.0f,
+           seconds > 0 ? run_stats.bytes / seconds : 0.0f,
+           (unsigned long)run_stats.journal_writes, run_stats.journal_us / 1000.0f);
+    if (stats) {
+        *stats = run_stats;
+    }
+    return result == 0 ? (int)run_stats.files : -1;
+}
+
+bool block_spool_interrupted(void) {
+    if (journal_open() != 0) {
+        return false;
+    }
+    bool interrupted = (rec.state == SPOOL_SENDING);
+    f_close(&journal);
+    return interrupted;
+}
@@ -0,0 +1,49 @@
+// block_spool.h - Send every unsent image on the card, resumably
+//
+// The spool takes the unsent images from the image index (image_index.h)
+// and sends them one after another without waiting between blocks. Each
+// file is marked sent in the index once all its chunks went out.
+//
+// Progress is kept in a journal on the card, SPOOL.JNL: the file being
+// sent, its block id and the last acknowledged chunk. After a power loss
+// or a failed send, the next run continues that file as the same block,
+// starting after the journaled chunk. The journal has two 512-byte slots,
+// written alternately and CRC-checked, so a write torn by a power cut
+// leaves the previous one intact. With a contiguous journal file each
+// update is a single raw sector write.
+
+#ifndef BLOCK_SPOOL_H
+#define BLOCK_SPOOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "block_transfer.h"
+
+#define BLOCK_SPOOL_JOURNAL         "SPOOL.JNL"
+#define BLOCK_SPOOL_JOURNAL_CHUNKS  32      // Acknowledged chunks between journal writes
+
+typedef struct {
+    uint32_t files;             // Files sent completely
+    uint32_t resumed;           // Files continued from the journal
+    uint32_t chunks_skipped;    // Chunks not sent again thanks to the journal
+    uint64_t bytes;             // Size of the files sent
+    uint32_t journal_writes;
+    uint64_t journal_us;        // Time spent writing the journal
+    uint64_t elapsed_us;
+} block_spool_stats_t;
+
+// Send one file (see send_image_file_resume()). Returns 0 once every chunk
+// is out.
+typedef int (*block_spool_send_t)(void *ctx, const char *filename, uint16_t block_id,
+                                  uint16_t resume_after, block_progress_t progress,
+                                  void *progress_ctx);
+
+// Send every unsent image. Returns the number of files sent, or -1 if the
+// index or journal cannot be opened or a send failed (the journal then
+// holds the point to resume from). stats may be NULL.
+int block_spool_run(block_spool_send_t send, void *ctx, block_spool_stats_t *stats);
+
+// The journal holds a file whose send was interrupted
+bool block_spool_interrupted(void);
+
+#endif // BLOCK_SPOOL_H
@@ -1,8 +1,18 @@
 #include "block_transfer.h"
 #include "mqttsn_client.h"
 #include "sd_card.h"
+#include "crc32c.h"
+#include "block_pipeline.h"
+#include "sd_write_queue.h"
+#include "block_partial.h"
+#include "binlog.h"
+#include "metrics.h"
+#include "trace.h"
+#include "pico/rand.h"
+#include "pico/cyw43_arch.h"
 #include "ff.h"  // FatFs library for directory operations
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -10,13 +20,98 @@
 
 // Global variables for block transfer
 static block_assembly_t current_block = {0};
-static uint16_t next_block_id = 1;
+static uint16_t next_block_id = 1;     // Starts from a random boot nonce (block_transfer_init())
 
 // Static buffers to avoid malloc failures on constrained devices
 static uint8_t static_data_buffer[BLOCK_BUFFER_SIZE];
 static bool static_received_mask[BLOCK_MAX_CHUNKS];
 static int duplicate_count = 0;
 static int total_packets_received = 0;
+static int crc_error_count = 0;
+static int fec_recovered_count = 0;
+static uint16_t last_completed_block_id = 0;
+static uint32_t last_completed_block_crc = 0;
+
+// Metric ids (see metrics.h), registered by block_transfer_init()
+static struct {
+    int chunks_sent;        // Publisher: chunk packets published, resends included
+    int chunk_bytes_sent;
+    int chunk_retries;
+    int chunk_send_failures;
+    int chunks_resent;
+    int chunk_ack_ms;       // QoS 1/2 publish round trip
+    int blocks_sent;
+    int chunks_received;    // Subscriber: chunk packets, duplicates and bad ones included
+    int chunk_duplicates;
+    int chunk_crc_errors;
+    int chunks_fec_rebuilt;
+    int chunks_nacked;
+    int blocks_received;
+    int blocks_corrupt;
+    int blocks_timed_out;
+} metric = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+
+static const uint32_t chunk_ack_ms_bounds[] = { 5, 10, 20, 50, 100, 200, 500, 1000 };
+
+// FEC configuration for outgoing QoS 0 transfers
+static uint8_t fec_k = BLOCK_FEC_DEFAULT_K;
+static uint8_t fec_m = BLOCK_FEC_DEFAULT_M;
+
+// Publisher: parity accumulators for the group being sent
+static uint8_t fec_tx_parity[BLOCK_FEC_MAX_M][BLOCK_FEC_SYMBOL_SIZE(BLOCK_CHUNK_DATA_SIZE)];
+
+// Subscriber: parity chunks held until their group can be rebuilt
+typedef struct {
+    bool used;
+    uint16_t group;
+    uint8_t row;
+    uint8_t symbol[BLOCK_FEC_SYMBOL_SIZE(BLOCK_CHUNK_DATA_SIZE)];
+} fec_parity_slot_t;
+static fec_parity_slot_t fec_rx_slots[BLOCK_FEC_PARITY_SLOTS];
+
+// Fountain mode: extra symbols the publisher sends (percent of chunk count)
+static uint8_t fountain_repair = BLOCK_FOUNTAIN_DEFAULT_REPAIR;
+static uint32_t fountain_rng = 0;
+
+// Subscriber: decoder working in the reassembly buffer
+static block_fountain_decoder_t fountain_dec;
+
+// Compress outgoing payloads that are not already compressed images
+static bool compression_enabled = BLOCK_COMPRESS_DEFAULT;
+
+// Send deltas against a subscriber's copy when it has sent signatures
+static bool delta_enabled = BLOCK_DELTA_DEFAULT;
+static uint16_t ignored_delta_block_id = 0;
+
+// Publisher: the last file sent, in case a subscriber refuses it or finds it corrupt
+static const char *sending_filename = NULL;    // File being sent by send_image_file_resume()
+static struct {
+    uint16_t block_id;
+    char filename[64];
+    bool resend;                        // Refused: send it again in full
+    uint8_t corrupt_resends;            // Full resends of this file after CORRUPT
+} last_tx;
+
+// Stream plain file sends through the core1 -> core0 packet pipeline
+static bool pipeline_enabled = BLOCK_PIPELINE_DEFAULT;
+
+// Subscriber: the completed block being written from the reassembly
+// buffer by the write-behind queue. The buffer is not reused until it is done.
+static struct {
+    bool pending;
+    uint16_t block_id;
+    char filename[64];
+    uint32_t length;
+    uint64_t start_us;
+} block_save;
+
+// Delay between chunks to prevent subscriber buffer overflow; deferred
+// log records are written out meanwhile
+static void pace_chunk(void) {
+    TRACE_BEGIN(TRACE_PACE, 50);
+    binlog_wait_ms(50);
+    TRACE_END(TRACE_PACE, 50);
+}
 
 // map current calls of mqttsn_publish() to new mqttsn publish call method (mqttsn_demo_publish_name)
 // This function respects the QoS parameter by temporarily setting current_qos
@@ -34,13 +129,275 @@ static int mqttsn_publish(const char *topic, const uint8_t *data, size_t len, ui
     return result;
 }
 
+// Block ids are 16 bits and never 0
+static uint16_t take_block_id(void) {
+    uint16_t block_id = next_block_id;
+    next_block_id = (next_block_id == UINT16_MAX) ? 1 : next_block_id + 1;
+    return block_id;
+}
+
 int block_transfer_init(void) {
+    // A reconnect re-initialises: keep what arrived of an unfinished block
+    if (current_block.block_id != 0) {
+        block_partial_checkpoint_sync(&current_block);
+    }
     memset(&current_block, 0, sizeof(current_block));
-    next_block_id = 1;
+    // Ids continue from a random boot nonce, so a block sent after a reboot
+    // is not mistaken for one a subscriber journaled before it
+    next_block_id = 1 + get_rand_32() % UINT16_MAX;
+    block_delta_reset();
+    
+    metric.chunks_sent = metrics_counter("chunks_sent");
+    metric.chunk_bytes_sent = metrics_counter("chunk_bytes_sent");
+    metric.chunk_retries = metrics_counter("chunk_retries");
+    metric.chunk_send_failures = metrics_counter("chunk_send_failures");
+    metric.chunks_resent = metrics_counter("chunks_resent");
+    metric.chunk_ack_ms = metrics_histogram("chunk_ack_ms", chunk_ack_ms_bounds,
+                                            sizeof(chunk_ack_ms_bounds) / sizeof(chunk_ack_ms_bounds[0]));
+    metric.blocks_sent = metrics_counter("blocks_sent");
+    metric.chunks_received = metrics_counter("chunks_received");
+    metric.chunk_duplicates = metrics_counter("chunk_duplicates");
+    metric.chunk_crc_errors = metrics_counter("chunk_crc_errors");
+    metric.chunks_fec_rebuilt = metrics_counter("chunks_fec_rebuilt");
+    metric.chunks_nacked = metrics_counter("chunks_nacked");
+    metric.blocks_received = metrics_counter("blocks_received");
+    metric.blocks_corrupt = metrics_counter("blocks_corrupt");
+    metric.blocks_timed_out = metrics_counter("blocks_timed_out");
     printf("Block transfer system initialized\n");
     return 0;
 }
 
+// Configure FEC for subsequent QoS 0 transfers: M parity chunks after every
+// K data chunks. m = 0 disables FEC.
+int block_transfer_set_fec(uint8_t k, uint8_t m) {
+    if (m == 0) {
+        fec_m = 0;
+        printf("[FEC] Disabled\n");
+        return 0;
+    }
+    if (!block_fec_valid(k, m)) {
+        printf("[FEC] Invalid configuration K=%d M=%d (max K=%d, M=%d)\n",
+               k, m, BLOCK_FEC_MAX_K, BLOCK_FEC_MAX_M);
+        return -1;
+    }
+    fec_k = k;
+    fec_m = m;
+    printf("[FEC] Enabled: %d parity chunk(s) per %d data chunks (%s)\n",
+           m, k, m == 1 ? "XOR" : "Reed-Solomon");
+    return 0;
+}
+
+// Configure fountain mode for subsequent QoS 0 transfers. Every chunk is
+// sent once, followed by repair_percent% extra coded symbols so each
+// subscriber can make up its own losses. 0 disables fountain mode.
+int block_transfer_set_fountain(uint8_t repair_percent) {
+    if (repair_percent > BLOCK_FOUNTAIN_MAX_REPAIR) {
+        printf("[FOUNTAIN] Invalid repair overhead %d%% (max %d%%)\n",
+               repair_percent, BLOCK_FOUNTAIN_MAX_REPAIR);
+        return -1;
+    }
+    fountain_repair = repair_percent;
+    if (repair_percent == 0) {
+        printf("[FOUNTAIN] Disabled\n");
+    } else {
+        printf("[FOUNTAIN] Enabled: %d%% repair symbols per block\n", repair_percent);
+    }
+    return 0;
+}
+
+// Enable or disable compression of outgoing transfers
+void block_transfer_set_compression(bool enabled) {
+    compression_enabled = enabled;
+    printf("[LZ] Compression %s\n", enabled ? "enabled" : "disabled");
+}
+
+// Enable or disable delta transfers against subscriber signatures
+void block_transfer_set_delta(bool enabled) {
+    delta_enabled = enabled;
+    printf("[DELTA] Delta transfers %s\n", enabled ? "enabled" : "disabled");
+}
+
+const char *block_transfer_take_full_resend(void) {
+    if (!last_tx.resend) {
+        return NULL;
+    }
+    last_tx.resend = false;
+    return last_tx.filename;
+}
+
+// Remember the file behind a block just started (a full resend keeps its count)
+static void record_last_tx(uint16_t block_id, const char *filename) {
+    if (filename == NULL) {
+        filename = "";
+    }
+    if (strcmp(last_tx.filename, filename) != 0) {
+        snprintf(last_tx.filename, sizeof(last_tx.filename), "%s", filename);
+        last_tx.corrupt_resends = 0;
+    }
+    last_tx.block_id = block_id;
+    last_tx.resend = false;
+}
+
+// Enable or disable the dual-core pipeline for file sends
+void block_transfer_set_pipeline(bool enabled) {
+    pipeline_enabled = enabled;
+    printf("[PIPE] Dual-core pipeline %s\n", enabled ? "enabled" : "disabled");
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le64(uint8_t *p, uint64_t v) {
+    put_le32(p, (uint32_t)v);
+    put_le32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint64_t get_le64(const uint8_t *p) {
+    return get_le32(p) | ((uint64_t)get_le32(p + 4) << 32);
+}
+
+// Build a v2 chunk packet (header + data + trailer). Returns the packet size.
+static size_t build_chunk_packet(uint8_t *packet, uint16_t block_id, uint16_t part,
+                                 uint16_t total_parts, const uint8_t *chunk,
+                                 size_t chunk_len, const block_trailer_t *trailer) {
+    TRACE_BEGIN(TRACE_CHUNK_BUILD, part);
+    block_header_t *header = (block_header_t*)packet;
+
+    header->block_id = block_id;
+    header->part_num = part;
+    header->total_parts = total_parts;
+    header->data_len = chunk_len;
+
+    // Copy chunk data after header
+    memcpy(packet + sizeof(block_header_t), chunk, chunk_len);
+
+    size_t pos = sizeof(block_header_t) + chunk_len;
+
+    packet[pos++] = BLOCK_WIRE_VERSION;
+    packet[pos++] = trailer->flags;
+    if (trailer->flags & BLOCK_FLAG_DIGEST) {
+        put_le32(packet + pos, trailer->block_crc);
+        pos += BLOCK_DIGEST_SIZE;
+    }
+    if (trailer->flags & BLOCK_FLAG_FEC) {
+        packet[pos++] = trailer->fec_k;
+        packet[pos++] = trailer->fec_m;
+    }
+    if (trailer->flags & BLOCK_FLAG_FOUNTAIN) {
+        packet[pos] = trailer->fountain_gen & 0xFF;
+        packet[pos + 1] = trailer->fountain_gen >> 8;
+        put_le64(packet + pos + 2, trailer->fountain_coef);
+        put_le32(packet + pos + 10, trailer->block_len);
+        pos += BLOCK_FOUNTAIN_FIELDS_SIZE;
+    }
+    if (trailer->flags & BLOCK_FLAG_COMPRESSED) {
+        put_le32(packet + pos, trailer->raw_len);
+        pos += BLOCK_COMPRESSED_FIELDS_SIZE;
+    }
+    if (trailer->flags & BLOCK_FLAG_DELTA) {
+        put_le32(packet + pos, trailer->basis_crc);
+        packet[pos + 4] = trailer->basis_block_size & 0xFF;
+        packet[pos + 5] = trailer->basis_block_size >> 8;
+        pos += BLOCK_DELTA_FIELDS_SIZE;
+    }
+
+    put_le32(packet + pos, crc32c(packet, pos));
+    TRACE_END(TRACE_CHUNK_BUILD, part);
+    return pos + 4;
+}
+
+// Parse and verify the v2 trailer of a received chunk. Chunks without a
+// trailer are reported as version 1. Returns 0 if the chunk is usable,
+// -1 if the trailer is malformed or the CRC does not match.
+static int parse_chunk_trailer(const uint8_t *data, size_t len, uint16_t data_len,
+                               block_trailer_t *trailer) {
+    size_t pos = sizeof(block_header_t) + data_len;
+
+    trailer->version = 1;
+    trailer->flags = 0;
+    trailer->block_crc = 0;
+    trailer->fec_k = 0;
+    trailer->fec_m = 0;
+    trailer->fountain_gen = 0;
+    trailer->fountain_coef = 0;
+    trailer->block_len = 0;
+    trailer->raw_len = 0;
+    trailer->basis_crc = 0;
+    trailer->basis_block_size = 0;
+
+    if (len == pos) {
+        return 0;  // v1 chunk
+    }
+
+    if (len < pos + BLOCK_TRAILER_SIZE || data[pos] != BLOCK_WIRE_VERSION) {
+        // Truncated trailer or a corrupted version byte: the CRC cannot be
+        // checked, so drop the chunk rather than take it as v1
+        return -1;
+    }
+
+    trailer->version = data[pos++];
+    trailer->flags = data[pos++];
+    if (trailer->flags & BLOCK_FLAG_DIGEST) {
+        if (len < pos + BLOCK_DIGEST_SIZE + 4) return -1;
+        trailer->block_crc = get_le32(data + pos);
+        pos += BLOCK_DIGEST_SIZE;
+    }
+    if (trailer->flags & BLOCK_FLAG_FEC) {
+        if (len < pos + BLOCK_FEC_FIELDS_SIZE + 4) return -1;
+        trailer->fec_k = data[pos++];
+        trailer->fec_m = data[pos++];
+        if (!block_fec_valid(trailer->fec_k, trailer->fec_m)) return -1;
+    }
+    if (trailer->flags & BLOCK_FLAG_FOUNTAIN) {
+        if (len < pos + BLOCK_FOUNTAIN_FIELDS_SIZE + 4) return -1;
+        trailer->fountain_gen = data[pos] | (data[pos + 1] << 8);
+        trailer->fountain_coef = get_le64(data + pos + 2);
+        trailer->block_len = get_le32(data + pos + 10);
+        pos += BLOCK_FOUNTAIN_FIELDS_SIZE;
+    }
+    if (trailer->flags & BLOCK_FLAG_COMPRESSED) {
+        if (len < pos + BLOCK_COMPRESSED_FIELDS_SIZE + 4) return -1;
+        trailer->raw_len = get_le32(data + pos);
+        pos += BLOCK_COMPRESSED_FIELDS_SIZE;
+    }
+    if (trailer->flags & BLOCK_FLAG_DELTA) {
+        if (len < pos + BLOCK_DELTA_FIELDS_SIZE + 4) return -1;
+        trailer->basis_crc = get_le32(data + pos);
+        trailer->basis_block_size = data[pos + 4] | (data[pos + 5] << 8);
+        pos += BLOCK_DELTA_FIELDS_SIZE;
+    }
+
+    if (len != pos + 4) return -1;
+    return (crc32c(data, pos) == get_le32(data + pos)) ? 0 : -1;
+}
+
+// Guess the file type from its signature. Returns ".bin" when unknown.
+static const char *detect_file_ext(const uint8_t *data, size_t len) {
+    if (len >= 2) {
+        // JPEG: FF D8
+        if (data[0] == 0xFF && data[1] == 0xD8) {
+            return ".jpg";
+        }
+        // PNG: 89 50 4E 47
+        if (len >= 4 && data[0] == 0x89 && data[1] == 0x50 && data[2] == 0x4E && data[3] == 0x47) {
+            return ".png";
+        }
+        // GIF: 47 49 46 38
+        if (len >= 4 && data[0] == 0x47 && data[1] == 0x49 && data[2] == 0x46 && data[3] == 0x38) {
+            return ".gif";
+        }
+    }
+    return ".bin";
+}
+
 // Generate sample 10KB text data
 void generate_large_message(char *buffer, size_t size) {
     snprintf(buffer, size, "=== LARGE MESSAGE BLOCK TRANSFER TEST ===\n");
@@ -76,7 +433,8 @@ int send_block_transfer(const char *topic, const uint8_t *data, size_t data_len)
         return -1;
     }
     
-    uint16_t block_id = next_block_id++;
+    uint16_t block_id = take_block_id();
+    uint32_t block_crc = crc32c(data, data_len);
     printf("\n=== Starting block transfer ===\n");
     printf("Block ID: %d, Data size: %zu bytes, Chunks: %d\n", block_id, data_len, total_parts);
     
@@ -86,21 +444,16 @@ int send_block_transfer(const char *topic, const uint8_t *data, size_t data_len)
         size_t chunk_len = (offset + chunk_data_size > data_len) ? 
                           (data_len - offset) : chunk_data_size;
         
-        // Create packet with header + data
-        uint8_t packet[BLOCK_CHUNK_SIZE];
-        block_header_t *header = (block_header_t*)packet;
-        
-        header->block_id = block_id;
-        header->part_num = part;
-        header->total_parts = total_parts;
-        header->data_len = chunk_len;
-        
-        // Copy chunk data after header
-        memcpy(packet + sizeof(block_header_t), data + offset, chunk_len);
+        // Create packet with header + data + v2 trailer
+        block_trailer_t trailer = {0};
+        trailer.flags = (part == total_parts) ? BLOCK_FLAG_DIGEST : 0;
+        trailer.block_crc = block_crc;
         
-        size_t packet_size = sizeof(block_header_t) + chunk_len;
+        uint8_t packet[BLOCK_PACKET_MAX];
+        size_t packet_size = build_chunk_packet(packet, block_id, part, total_parts,
+                                                data + offset, chunk_len, &trailer);
         
-        printf("Sending chunk %d/%d (%zu bytes)\n", part, total_parts, packet_size);
+        BLOG_DEBUG("Sending chunk %d/%d (%zu bytes)\n", part, total_parts, packet_size);
         
         // Send with QoS 1 - will wait for PUBACK, retry if timeout
         int max_retries = 3;
@@ -112,37 +465,380 @@ int send_block_transfer(const char *topic, const uint8_t *data, size_t data_len)
             if (ret == MQTTSN_OK) {
                 break; // Success - PUBACK received
             } else if (attempt < max_retries) {
-                printf("  Retry %d/%d for chunk %d (no PUBACK)\n", attempt, max_retries, part);
+                BLOG_WARN("  Retry %d/%d for chunk %d (no PUBACK)\n", attempt, max_retries, part);
                 sleep_ms(100); // Small delay before retry
             }
         }
         
         if (ret != MQTTSN_OK) {
-            printf("Failed to send chunk %d/%d after %d attempts\n", part, total_parts, max_retries);
+            BLOG_ERROR("Failed to send chunk %d/%d after %d attempts\n", part, total_parts, max_retries);
             return -1;
         }
         
         // Print progress every 10 chunks
         if (part % 10 == 0 || part == total_parts) {
-            printf("  Progress: %d/%d chunks sent (%.1f%%)\n", 
-                   part, total_parts, (float)part * 100.0 / total_parts);
+            int permille = part * 1000 / total_parts;
+            BLOG_INFO("  Progress: %d/%d chunks sent (%d.%d%%)\n", part, total_parts, permille / 10, permille % 10);
         }
         
         // Delay between chunks to prevent subscriber buffer overflow
-        sleep_ms(50);
+        pace_chunk();
     }
     
+    binlog_flush();
+    metrics_inc(metric.blocks_sent);
     printf("Block transfer completed: %d chunks sent\n", total_parts);
     return 0;
 }
 
+// Publish one chunk packet with the requested QoS (retrying QoS 1/2 handshakes)
+static int send_chunk_packet(const char *topic, const uint8_t *packet, size_t packet_size,
+                             uint8_t qos, uint16_t part, uint16_t total_parts) {
+    int ret;
+    uint64_t start_us = time_us_64();
+    TRACE_BEGIN(TRACE_CHUNK_SEND, part);
+    if (qos == 1) {
+        // QoS 1 - will wait for PUBACK, retry if timeout
+        int max_retries = 3;
+        ret = MQTTSN_ERROR;
+        
+        for (int attempt = 1; attempt <= max_retries; attempt++) {
+            ret = mqttsn_publish(topic, packet, packet_size, 1);
+            
+            if (ret == MQTTSN_OK) {
+                break; // Success - PUBACK received
+            } else if (attempt < max_retries) {
+                metrics_inc(metric.chunk_retries);
+                BLOG_WARN("  Retry %d/%d for chunk %d (no PUBACK)\n", attempt, max_retries, part);
+                sleep_ms(100); // Small delay before retry
+            }
+        }
+        
+        if (ret != MQTTSN_OK) {
+            metrics_inc(metric.chunk_send_failures);
+            BLOG_ERROR("Failed to send chunk %d/%d after %d attempts\n", part, total_parts, max_retries);
+            TRACE_END(TRACE_CHUNK_SEND, part);
+            return -1;
+        }
+    } else if (qos == 2) {
+        // QoS 2 - will wait for PUBREC/PUBREL/PUBCOMP handshake, retry if timeout
+        int max_retries = 3;
+        ret = MQTTSN_ERROR;
+        
+        for (int attempt = 1; attempt <= max_retries; attempt++) {
+            ret = mqttsn_publish(topic, packet, packet_size, 2);
+            
+            if (ret == MQTTSN_OK) {
+                break; // Success - PUBREC/PUBREL/PUBCOMP completed
+            } else if (attempt < max_retries) {
+                metrics_inc(metric.chunk_retries);
+                BLOG_WARN("  Retry %d/%d for chunk %d (QoS 2 handshake failed)\n", attempt, max_retries, part);
+                sleep_ms(100); // Small delay before retry
+            }
+        }
+        
+        if (ret != MQTTSN_OK) {
+            metrics_inc(metric.chunk_send_failures);
+            BLOG_ERROR("Failed to send chunk %d/%d after %d attempts (QoS 2)\n", part, total_parts, max_retries);
+            TRACE_END(TRACE_CHUNK_SEND, part);
+            return -1;
+        }
+    } else {
+        // QoS 0 - fire and forget (no acknowledgment, may lose packets)
+        ret = mqttsn_publish(topic, packet, packet_size, 0);
+        if (ret != MQTTSN_OK) {
+            metrics_inc(metric.chunk_send_failures);
+            BLOG_ERROR("Failed to send chunk %d/%d (QoS 0)\n", part, total_parts);
+            TRACE_END(TRACE_CHUNK_SEND, part);
+            return -1;
+        }
+        // Note: QoS 0 returns success immediately after UDP send
+        // This does NOT guarantee the packet was received by the gateway
+    }
+    if (qos > 0) {
+        metrics_observe(metric.chunk_ack_ms, (uint32_t)((time_us_64() - start_us) / 1000));
+    }
+    metrics_inc(metric.chunks_sent);
+    metrics_add(metric.chunk_bytes_sent, packet_size);
+    TRACE_END(TRACE_CHUNK_SEND, part);
+    return 0;
+}
+
+// Continuing an interrupted file send (see block_spool.h)
+typedef struct {
+    uint16_t block_id;              // 0 = next id
+    uint16_t resume_after;          // Chunks the subscriber already has
+    block_progress_t progress;
+    void *ctx;
+} tx_resume_t;
+
+// Outgoing transfer state shared by the plain, compressed and pipelined paths
+typedef struct {
+    const char *topic;
+    uint8_t qos;
+    uint16_t block_id;
+    uint16_t total_parts;
+    uint16_t part;                  // Last part sent
+    bool use_fec;
+    bool pipelined;                 // Packets are queued for core0 instead of sent
+    uint8_t base_flags;             // Trailer flags on every chunk
+    block_trailer_t trailer;
+    uint8_t pending[BLOCK_CHUNK_DATA_SIZE];  // Encoded bytes waiting for a full chunk
+    size_t pending_len;
+    uint16_t resume_after;          // Chunks not sent again after a restart
+    volatile uint16_t acked;        // Last data chunk acknowledged (sent, at QoS 0)
+    block_progress_t progress;
+    void *progress_ctx;
+} block_tx_t;
+
+_Static_assert(BLOCK_PACKET_MAX <= BLOCK_PIPELINE_SLOT_SIZE, "pipeline slots too small for a chunk packet");
+
+static void tx_report(block_tx_t *tx) {
+    if (tx->progress) {
+        tx->progress(tx->progress_ctx, tx->block_id, tx->total_parts, tx->acked);
+    }
+}
+
+// Send a finished packet, or hand it to core0 when running as the pipeline producer
+static int tx_emit(block_tx_t *tx, const uint8_t *packet, size_t packet_size,
+                   uint8_t qos, uint16_t part) {
+    if (tx->pipelined) {
+        block_pipeline_slot_t *slot = block_pipeline_acquire();
+        if (slot == NULL) {
+            return -1;  // Core0 gave up on the transfer
+        }
+        memcpy(slot->data, packet, packet_size);
+        slot->len = packet_size;
+        slot->part = part;
+        slot->qos = qos;
+        block_pipeline_commit();
+        return 0;
+    }
+    
+    if (send_chunk_packet(tx->topic, packet, packet_size, qos, part, tx->total_parts) != 0) {
+        return -1;
+    }
+    if (part <= tx->total_parts) {
+        tx->acked = part;
+        tx_report(tx);
+    }
+    
+    // Delay between chunks to prevent subscriber buffer overflow
+    pace_chunk();
+    return 0;
+}
+
+// Send the M parity chunks of a completed FEC group and reset the accumulators
+static int send_fec_parity(block_tx_t *tx, uint16_t group) {
+    const size_t symbol_size = BLOCK_FEC_SYMBOL_SIZE(BLOCK_CHUNK_DATA_SIZE);
+    
+    for (uint8_t row = 0; row < tx->trailer.fec_m; row++) {
+        uint16_t part = tx->total_parts + group * tx->trailer.fec_m + row + 1;
+        uint8_t packet[BLOCK_PACKET_MAX];
+        size_t packet_size = build_chunk_packet(packet, tx->block_id, part, tx->total_parts,
+                                                fec_tx_parity[row], symbol_size, &tx->trailer);
+        
+        if (tx_emit(tx, packet, packet_size, 0, part) != 0) {
+            return -1;
+        }
+        memset(fec_tx_parity[row], 0, symbol_size);
+    }
+    return 0;
+}
+
+// Stream a block as fountain symbols: one systematic pass (each chunk on its
+// own), then random combinations cycling through the generations. Every
+// subscriber finishes as soon as it holds enough independent symbols.
+static int send_block_fountain(const char *topic, const uint8_t *data, size_t data_len,
+                               uint16_t total_parts) {
+    const size_t chunk_data_size = BLOCK_CHUNK_DATA_SIZE;
+    uint16_t generations = block_fountain_generations(total_parts);
+    uint32_t total_symbols = total_parts + (uint32_t)total_parts * fountain_repair / 100;
+    if (total_symbols > UINT16_MAX) {
+        total_symbols = UINT16_MAX;
+    }
+    
+    uint16_t block_id = take_block_id();
+    printf("\n=== Starting fountain block transfer (QoS 0) ===\n");
+    printf("Block ID: %d, Data size: %zu bytes, Chunks: %d in %d generations\n",
+           block_id, data_len, total_parts, generations);
+    printf("Symbols: %lu (%d%% repair)\n", (unsigned long)total_symbols, fountain_repair);
+    
+    block_trailer_t trailer = {0};
+    trailer.flags = BLOCK_FLAG_DIGEST | BLOCK_FLAG_FOUNTAIN;
+    trailer.block_crc = crc32c(data, data_len);
+    trailer.block_len = data_len;
+    
+    fountain_rng = ((uint32_t)block_id << 16) ^ to_ms_since_boot(get_absolute_time());
+    
+    uint8_t symbol[BLOCK_CHUNK_DATA_SIZE];
+    for (uint32_t seq = 1; seq <= total_symbols; seq++) {
+        if (seq <= total_parts) {
+            // Systematic pass
+            uint16_t index = seq - 1;
+            trailer.fountain_gen = index / BLOCK_FOUNTAIN_GEN_SIZE;
+            trailer.fountain_coef = (uint64_t)1 << (index % BLOCK_FOUNTAIN_GEN_SIZE);
+        } else {
+            // Repair: a random half of one generation's chunks
+            uint16_t gen = (seq - total_parts - 1) % generations;
+            trailer.fountain_gen = gen;
+            trailer.fountain_coef = block_fountain_random_coef(&fountain_rng,
+                                        block_fountain_gen_size(total_parts, gen));
+        }
+        
+        block_fountain_encode(data, data_len, trailer.fountain_gen, trailer.fountain_coef,
+                              symbol, chunk_data_size);
+        
+        uint8_t packet[BLOCK_PACKET_MAX];
+        size_t packet_size = build_chunk_packet(packet, block_id, seq, total_parts,
+                                                symbol, chunk_data_size, &trailer);
+        
+        if (send_chunk_packet(topic, packet, packet_size, 0, seq, total_parts) != 0) {
+            return -1;
+        }
+        
+        if (seq % 50 == 0 || seq == total_symbols) {
+            BLOG_INFO("  Progress: %lu/%lu symbols sent\n", seq, total_symbols);
+        }
+        
+        // Same pacing as regular chunks
+        pace_chunk();
+    }
+    
+    binlog_flush();
+    metrics_inc(metric.blocks_sent);
+    printf("Fountain transfer completed: %lu symbols sent\n", (unsigned long)total_symbols);
+    return 0;
+}
+
+// Send the next data chunk of a transfer (plus its group's parity with FEC)
+static int send_transfer_chunk(block_tx_t *tx, const uint8_t *chunk, size_t chunk_len) {
+    uint16_t part = ++tx->part;
+    uint16_t total_parts = tx->total_parts;
+    
+    // Chunks delivered before an interrupted send still feed the FEC parity
+    bool skip = (part <= tx->resume_after);
+    
+    if (!skip) {
+        // Create packet with header + data + v2 trailer
+        tx->trailer.flags = tx->base_flags | (part == total_parts ? BLOCK_FLAG_DIGEST : 0);
+        
+        uint8_t packet[BLOCK_PACKET_MAX];
+        size_t packet_size = build_chunk_packet(packet, tx->block_id, part, total_parts,
+                                                chunk, chunk_len, &tx->trailer);
+        
+        // Only print every 50th chunk to reduce spam (core0 reports pipelined sends)
+        if (!tx->pipelined && (part % 50 == 1 || part == total_parts)) {
+            BLOG_INFO("Sending chunk %d/%d (%zu bytes)\n", part, total_parts, packet_size);
+        }
+        
+        if (tx_emit(tx, packet, packet_size, tx->qos, part) != 0) {
+            return -1;
+        }
+        
+        // Print progress every 10 chunks
+        if (!tx->pipelined && (part % 10 == 0 || part == total_parts)) {
+            int permille = part * 1000 / total_parts;
+            BLOG_INFO("  Progress: %d/%d chunks sent (%d.%d%%)\n", part, total_parts, permille / 10, permille % 10);
+        }
+    }
+    
+    if (tx->use_fec) {
+        uint8_t *parity[BLOCK_FEC_MAX_M];
+        for (int row = 0; row < fec_m; row++) parity[row] = fec_tx_parity[row];
+        TRACE_BEGIN(TRACE_FEC_ENCODE, part);
+        block_fec_encode_chunk(fec_m, (part - 1) % fec_k, chunk, chunk_len,
+                               parity, BLOCK_CHUNK_DATA_SIZE);
+        TRACE_END(TRACE_FEC_ENCODE, part);
+        
+        // Group complete - send its parity. The last group's parity also
+        // carries the digest in case the final data chunk is lost.
+        if (part % fec_k == 0 || part == total_parts) {
+            uint16_t group = (part - 1) / fec_k;
+            if (skip) {
+                memset(fec_tx_parity, 0, sizeof(fec_tx_parity));
+            } else if (send_fec_parity(tx, group) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// block_lz / block_delta sink: cut the encoded stream into chunks as it is produced
+static int tx_stream_sink(void *ctx, const uint8_t *data, size_t len) {
+    block_tx_t *tx = (block_tx_t *)ctx;
+    
+    while (len > 0) {
+        size_t n = sizeof(tx->pending) - tx->pending_len;
+        if (n > len) n = len;
+        memcpy(tx->pending + tx->pending_len, data, n);
+        tx->pending_len += n;
+        data += n;
+        len -= n;
+        
+        if (tx->pending_len == sizeof(tx->pending)) {
+            if (send_transfer_chunk(tx, tx->pending, tx->pending_len) != 0) {
+                return -1;
+            }
+            tx->pending_len = 0;
+        }
+    }
+    return 0;
+}
+
+// Common setup of a chunked transfer. Returns the number of FEC groups.
+static uint16_t tx_begin(block_tx_t *tx, const char *topic, uint8_t qos,
+                         uint16_t total_parts, size_t data_len, const tx_resume_t *resume) {
+    memset(tx, 0, sizeof(*tx));
+    tx->topic = topic;
+    tx->qos = qos;
+    tx->total_parts = total_parts;
+    tx->block_id = (resume && resume->block_id) ? resume->block_id : take_block_id();
+    
+    // FEC only pays off without per-chunk acknowledgements
+    tx->use_fec = (qos == 0 && fec_m > 0);
+    uint16_t fec_groups = tx->use_fec ? (total_parts + fec_k - 1) / fec_k : 0;
+    
+    printf("\n=== Starting block transfer (QoS %d) ===\n", qos);
+    printf("Block ID: %d, Data size: %zu bytes, Chunks: %d\n", tx->block_id, data_len, total_parts);
+    if (tx->use_fec) {
+        printf("FEC: K=%d M=%d, %d parity chunks in %d groups\n",
+               fec_k, fec_m, fec_groups * fec_m, fec_groups);
+        memset(fec_tx_parity, 0, sizeof(fec_tx_parity));
+    }
+    
+    tx->trailer.fec_k = fec_k;
+    tx->trailer.fec_m = fec_m;
+    
+    if (resume) {
+        // More chunks than the file has means the file changed: start over
+        tx->resume_after = (resume->resume_after < total_parts) ? resume->resume_after : 0;
+        tx->acked = tx->resume_after;
+        tx->progress = resume->progress;
+        tx->progress_ctx = resume->ctx;
+        if (tx->resume_after > 0) {
+            printf("Resuming after chunk %d\n", tx->resume_after);
+        }
+        tx_report(tx);
+    }
+    return fec_groups;
+}
+
 // Send a large message using block transfer with configurable QoS
-int send_block_transfer_qos(const char *topic, const uint8_t *data, size_t data_len, uint8_t qos) {
+static int send_block_transfer_resume(const char *topic, const uint8_t *data, size_t data_len,
+                                      uint8_t qos, const tx_resume_t *resume) {
     if (data_len > BLOCK_BUFFER_SIZE) {
         printf("Error: Message too large (%zu bytes, max %d)\n", data_len, BLOCK_BUFFER_SIZE);
         return -1;
     }
     
+    if (qos > 2) {
+        // Invalid QoS level
+        printf("Error: Invalid QoS level %d (must be 0, 1, or 2)\n", qos);
+        return -1;
+    }
+    
     // Calculate number of chunks needed
     size_t chunk_data_size = BLOCK_CHUNK_SIZE - sizeof(block_header_t);
     uint16_t total_parts = (data_len + chunk_data_size - 1) / chunk_data_size;
@@ -152,102 +848,322 @@ int send_block_transfer_qos(const char *topic, const uint8_t *data, size_t data_
         return -1;
     }
     
-    uint16_t block_id = next_block_id++;
-    printf("\n=== Starting block transfer (QoS %d) ===\n", qos);
-    printf("Block ID: %d, Data size: %zu bytes, Chunks: %d\n", block_id, data_len, total_parts);
+    // Fountain mode needs room for the decoder's coefficient table on the
+    // subscriber, which shrinks the largest block it can take
+    if (qos == 0 && fountain_repair > 0) {
+        if (block_fountain_workspace_size(total_parts, chunk_data_size) <= BLOCK_BUFFER_SIZE) {
+            return send_block_fountain(topic, data, data_len, total_parts);
+        }
+        printf("[FOUNTAIN] Block too large for fountain decoding (%zu bytes) - sending normally\n",
+               data_len);
+    }
     
-    // Send each chunk
-    for (uint16_t part = 1; part <= total_parts; part++) {
-        size_t offset = (part - 1) * chunk_data_size;
-        size_t chunk_len = (offset + chunk_data_size > data_len) ? 
-                          (data_len - offset) : chunk_data_size;
-        
-        // Create packet with header + data
-        uint8_t packet[BLOCK_CHUNK_SIZE];
-        block_header_t *header = (block_header_t*)packet;
-        
-        header->block_id = block_id;
-        header->part_num = part;
-        header->total_parts = total_parts;
-        header->data_len = chunk_len;
-        
-        // Copy chunk data after header
-        memcpy(packet + sizeof(block_header_t), data + offset, chunk_len);
+    // A delta against the subscriber's copy beats everything else when the
+    // file has only changed in places
+    bool delta = false;
+    uint32_t basis_crc = 0;
+    uint16_t basis_block_size = 0;
+    uint16_t delta_parts = 0;
+    if (delta_enabled && block_delta_ready(&basis_crc, &basis_block_size)) {
+        long delta_len = block_delta_encode(data, data_len, NULL, NULL);
+        delta_parts = (delta_len + chunk_data_size - 1) / chunk_data_size;
         
-        size_t packet_size = sizeof(block_header_t) + chunk_len;
-        
-        // Only print every 50th chunk to reduce spam
-        if (part % 50 == 1 || part == total_parts) {
-            printf("Sending chunk %d/%d (%zu bytes)\n", part, total_parts, packet_size);
+        if (delta_len < 0 || delta_parts * 100 > total_parts * (100 - BLOCK_COMPRESS_MIN_GAIN)) {
+            printf("[DELTA] Not sending a delta: %zu -> %ld bytes is not worth it\n",
+                   data_len, delta_len);
+        } else {
+            printf("[DELTA] Delta against basis %08lx: %zu -> %ld bytes\n",
+                   (unsigned long)basis_crc, data_len, delta_len);
+            delta = true;
         }
+    }
+    
+    // Compress unless the payload is already a compressed image. The
+    // subscriber decompresses in place, with the compressed chunks stored at
+    // the end of its reassembly buffer, so the output must never catch up
+    // with compressed bytes it has not read yet.
+    bool compress = false;
+    if (compression_enabled && strcmp(detect_file_ext(data, data_len), ".bin") == 0) {
+        size_t head_room = 0;
+        long compressed_len = block_lz_compress(data, data_len, NULL, NULL, &head_room);
+        uint16_t compressed_parts = (compressed_len + chunk_data_size - 1) / chunk_data_size;
         
-        int ret;
-        if (qos == 1) {
-            // QoS 1 - will wait for PUBACK, retry if timeout
-            int max_retries = 3;
-            ret = MQTTSN_ERROR;
-            
-            for (int attempt = 1; attempt <= max_retries; attempt++) {
-                ret = mqttsn_publish(topic, packet, packet_size, 1);
-                
-                if (ret == MQTTSN_OK) {
-                    break; // Success - PUBACK received
-                } else if (attempt < max_retries) {
-                    printf("  Retry %d/%d for chunk %d (no PUBACK)\n", attempt, max_retries, part);
-                    sleep_ms(100); // Small delay before retry
-                }
-            }
-            
-            if (ret != MQTTSN_OK) {
-                printf("Failed to send chunk %d/%d after %d attempts\n", part, total_parts, max_retries);
-                return -1;
-            }
-        } else if (qos == 2) {
-            // QoS 2 - will wait for PUBREC/PUBREL/PUBCOMP handshake, retry if timeout
-            int max_retries = 3;
-            ret = MQTTSN_ERROR;
-            
-            for (int attempt = 1; attempt <= max_retries; attempt++) {
-                ret = mqttsn_publish(topic, packet, packet_size, 2);
-                
-                if (ret == MQTTSN_OK) {
-                    break; // Success - PUBREC/PUBREL/PUBCOMP completed
-                } else if (attempt < max_retries) {
-                    printf("  Retry %d/%d for chunk %d (QoS 2 handshake failed)\n", attempt, max_retries, part);
-                    sleep_ms(100); // Small delay before retry
-                }
-            }
-            
-            if (ret != MQTTSN_OK) {
-                printf("Failed to send chunk %d/%d after %d attempts (QoS 2)\n", part, total_parts, max_retries);
+        if (compressed_parts * 100 > total_parts * (100 - BLOCK_COMPRESS_MIN_GAIN)) {
+            printf("[LZ] Not compressing: %zu -> %ld bytes is not worth it\n", data_len, compressed_len);
+        } else if (head_room + compressed_parts * chunk_data_size > BLOCK_BUFFER_SIZE) {
+            printf("[LZ] Not compressing: no room for in-place decompression\n");
+        } else if (delta && delta_parts <= compressed_parts) {
+            printf("[LZ] Not compressing: the delta is smaller (%ld bytes compressed)\n",
+                   compressed_len);
+        } else {
+            printf("[LZ] Compressed %zu -> %ld bytes (%.1fx)\n",
+                   data_len, compressed_len, (float)data_len / compressed_len);
+            compress = true;
+            delta = false;
+            total_parts = compressed_parts;
+        }
+    }
+    if (delta) {
+        total_parts = delta_parts;
+    }
+    
+    block_tx_t tx;
+    uint16_t fec_groups = tx_begin(&tx, topic, qos, total_parts, data_len, resume);
+    
+    tx.trailer.block_crc = crc32c(data, data_len);
+    tx.trailer.raw_len = data_len;
+    tx.trailer.basis_crc = basis_crc;
+    tx.trailer.basis_block_size = basis_block_size;
+    tx.base_flags = (tx.use_fec ? BLOCK_FLAG_FEC : 0) | (compress ? BLOCK_FLAG_COMPRESSED : 0) |
+                    (delta ? BLOCK_FLAG_DELTA : 0);
+    if (sending_filename != NULL) {
+        record_last_tx(tx.block_id, sending_filename);
+    }
+    
+    if (compress || delta) {
+        // Second pass streams the encoded bytes straight into chunks
+        long rc = compress ? block_lz_compress(data, data_len, tx_stream_sink, &tx, NULL)
+                           : block_delta_encode(data, data_len, tx_stream_sink, &tx);
+        if (rc < 0 ||
+            (tx.pending_len > 0 && send_transfer_chunk(&tx, tx.pending, tx.pending_len) != 0)) {
+            return -1;
+        }
+        if (tx.part != total_parts) {
+            printf("Error: Encoded stream produced %d chunks, expected %d\n", tx.part, total_parts);
+            return -1;
+        }
+    } else {
+        for (uint16_t part = 1; part <= total_parts; part++) {
+            size_t offset = (part - 1) * chunk_data_size;
+            size_t chunk_len = (offset + chunk_data_size > data_len) ? 
+                              (data_len - offset) : chunk_data_size;
+            if (send_transfer_chunk(&tx, data + offset, chunk_len) != 0) {
                 return -1;
             }
-        } else if (qos == 0) {
-            // QoS 0 - fire and forget (no acknowledgment, may lose packets)
-            ret = mqttsn_publish(topic, packet, packet_size, 0);
-            if (ret != MQTTSN_OK) {
-                printf("Failed to send chunk %d/%d (QoS 0)\n", part, total_parts);
+        }
+    }
+    
+    binlog_flush();
+    metrics_inc(metric.blocks_sent);
+    printf("Block transfer completed: %d chunks sent\n", total_parts + fec_groups * fec_m);
+    return 0;
+}
+
+int send_block_transfer_qos(const char *topic, const uint8_t *data, size_t data_len, uint8_t qos) {
+    return send_block_transfer_resume(topic, data, data_len, qos, NULL);
+}
+
+// Pipelined file send: core1 reads the file and builds every packet
+// (header, trailer CRC, FEC parity) while core0 only transmits them
+typedef struct {
+    block_tx_t tx;
+    FIL file;
+    size_t file_size;
+    uint8_t read_buf[BLOCK_PIPELINE_READ_CHUNKS * BLOCK_CHUNK_DATA_SIZE];
+    DWORD clmt[BLOCK_RETX_CLMT_SIZE];   // Fast-seek cluster map of the file
+    bool open;                          // File kept open for retransmission
+    bool running;                       // Core1 owns the file
+    uint16_t pending[BLOCK_RETX_MAX_PENDING];  // Missing chunks reported meanwhile
+    uint16_t pending_count;
+} pipeline_tx_t;
+
+static pipeline_tx_t pipeline_tx;
+
+// The pipeline sends the file as it is, so it is only used when no
+// whole-file encoding (fountain, delta, compression) would apply
+static bool pipeline_suitable(const uint8_t *magic, size_t magic_len, uint8_t qos) {
+    if (qos == 0 && fountain_repair > 0) return false;
+    if (delta_enabled && block_delta_ready(NULL, NULL)) return false;
+    if (compression_enabled && strcmp(detect_file_ext(magic, magic_len), ".bin") == 0) return false;
+    return true;
+}
+
+// Core1: read the file and queue its packets
+static int pipeline_produce(void *ctx) {
+    pipeline_tx_t *p = (pipeline_tx_t *)ctx;
+    size_t offset = 0;
+    uint32_t crc = 0;
+    
+    while (offset < p->file_size) {
+        size_t want = p->file_size - offset;
+        if (want > sizeof(p->read_buf)) want = sizeof(p->read_buf);
+        
+        UINT got = 0;
+        if (f_read(&p->file, p->read_buf, want, &got) != FR_OK || got != want) {
+            return -1;
+        }
+        
+        // The digest is complete by the time the final chunk is built
+        crc = crc32c_update(crc, p->read_buf, got);
+        p->tx.trailer.block_crc = crc;
+        
+        for (size_t pos = 0; pos < got; pos += BLOCK_CHUNK_DATA_SIZE) {
+            size_t len = (got - pos < BLOCK_CHUNK_DATA_SIZE) ? got - pos : BLOCK_CHUNK_DATA_SIZE;
+            if (send_transfer_chunk(&p->tx, p->read_buf + pos, len) != 0) {
                 return -1;
             }
-            // Note: QoS 0 returns success immediately after UDP send
-            // This does NOT guarantee the packet was received by the gateway
-        } else {
-            // Invalid QoS level
-            printf("Error: Invalid QoS level %d (must be 0, 1, or 2)\n", qos);
-            return -1;
+        }
+        offset += got;
+        
+        // Core0 only sends; progress is recorded here, where the card is owned
+        tx_report(&p->tx);
+    }
+    return 0;
+}
+
+// Core0: transmit one queued packet
+static int pipeline_consume(void *ctx, const block_pipeline_slot_t *slot) {
+    pipeline_tx_t *p = (pipeline_tx_t *)ctx;
+    uint16_t total_parts = p->tx.total_parts;
+    
+    if (slot->part % 50 == 1 || slot->part == total_parts) {
+        BLOG_INFO("Sending chunk %d/%d (%d bytes)\n", slot->part, total_parts, slot->len);
+    }
+    
+    if (send_chunk_packet(p->tx.topic, slot->data, slot->len, slot->qos, slot->part, total_parts) != 0) {
+        return -1;
+    }
+    if (slot->part <= total_parts) {
+        p->tx.acked = slot->part;
+    }
+    
+    if (slot->part % 10 == 0 || slot->part == total_parts) {
+        int permille = slot->part * 1000 / total_parts;
+        BLOG_INFO("  Progress: %d/%d chunks sent (%d.%d%%)\n", slot->part, total_parts, permille / 10, permille % 10);
+    }
+    
+    // Delay between chunks to prevent subscriber buffer overflow; core1
+    // keeps filling the ring meanwhile
+    pace_chunk();
+    return 0;
+}
+
+static void pipeline_idle(void *ctx) {
+    (void)ctx;
+    cyw43_arch_poll();
+}
+
+// Map the file's cluster chain for fast seeks. A file with more fragments
+// than the map holds still works, but every seek walks the FAT again.
+static void pipeline_map_file(pipeline_tx_t *p) {
+    p->clmt[0] = BLOCK_RETX_CLMT_SIZE;
+    p->file.cltbl = p->clmt;
+    
+    FRESULT res = f_lseek(&p->file, CREATE_LINKMAP);
+    if (res == FR_OK) {
+        printf("[RETX] Cluster map: %lu fragments\n", (unsigned long)(p->clmt[0] - 1) / 2);
+    } else {
+        p->file.cltbl = NULL;
+        printf("[RETX] ⚠️  Cluster map needs %lu entries (have %d) - seeks will walk the FAT\n",
+               (unsigned long)p->clmt[0], BLOCK_RETX_CLMT_SIZE);
+    }
+}
+
+static void pipeline_release(pipeline_tx_t *p) {
+    if (p->open) {
+        f_close(&p->file);
+        p->open = false;
+    }
+    p->pending_count = 0;
+}
+
+// Re-read chunks of the last pipelined file and send them again, with the
+// trailer they had the first time
+static int pipeline_retransmit(pipeline_tx_t *p, const uint16_t *parts, uint16_t count) {
+    block_tx_t *tx = &p->tx;
+    uint8_t chunk[BLOCK_CHUNK_DATA_SIZE];
+    uint8_t packet[BLOCK_PACKET_MAX];
+    uint64_t read_us = 0;
+    uint16_t sent = 0;
+    
+    // A COMPLETE status arriving while sending closes the file
+    for (uint16_t i = 0; i < count && p->open; i++) {
+        uint16_t part = parts[i];
+        if (part < 1 || part > tx->total_parts) {
+            continue;
         }
         
-        // Print progress every 10 chunks
-        if (part % 10 == 0 || part == total_parts) {
-            printf("  Progress: %d/%d chunks sent (%.1f%%)\n", 
-                   part, total_parts, (float)part * 100.0 / total_parts);
+        FSIZE_t offset = (FSIZE_t)(part - 1) * BLOCK_CHUNK_DATA_SIZE;
+        size_t len = p->file_size - offset;
+        if (len > BLOCK_CHUNK_DATA_SIZE) len = BLOCK_CHUNK_DATA_SIZE;
+        
+        uint64_t start = time_us_64();
+        UINT got = 0;
+        if (f_lseek(&p->file, offset) != FR_OK ||
+            f_read(&p->file, chunk, len, &got) != FR_OK || got != len) {
+            printf("[RETX] ❌ Failed to re-read chunk %d\n", part);
+            return -1;
         }
+        read_us += time_us_64() - start;
         
-        // Delay between chunks to prevent subscriber buffer overflow
-        sleep_ms(50);
+        tx->trailer.flags = tx->base_flags | (part == tx->total_parts ? BLOCK_FLAG_DIGEST : 0);
+        size_t packet_size = build_chunk_packet(packet, tx->block_id, part, tx->total_parts,
+                                                chunk, len, &tx->trailer);
+        if (send_chunk_packet(tx->topic, packet, packet_size, tx->qos, part, tx->total_parts) != 0) {
+            return -1;
+        }
+        sent++;
+        metrics_inc(metric.chunks_resent);
+        pace_chunk();
     }
+    binlog_flush();
     
-    printf("Block transfer completed: %d chunks sent\n", total_parts);
+    printf("[RETX] Resent %d chunks of block %d (%.2f ms per seek+read%s)\n", sent, tx->block_id,
+           sent ? read_us / 1000.0f / sent : 0.0f, p->file.cltbl ? ", fast seek" : "");
+    return 0;
+}
+
+static int send_image_file_pipelined(const char *topic, const char *filename,
+                                     size_t file_size, uint8_t qos, const tx_resume_t *resume) {
+    pipeline_tx_t *p = &pipeline_tx;
+    
+    // Only the latest transfer can be retransmitted
+    pipeline_release(p);
+    
+    FRESULT res = f_open(&p->file, filename, FA_READ);
+    if (res != FR_OK) {
+        printf("❌ Error: Failed to open file '%s' (error %d)\n", filename, res);
+        return -1;
+    }
+    p->open = true;
+    pipeline_map_file(p);
+    
+    uint16_t total_parts = (file_size + BLOCK_CHUNK_DATA_SIZE - 1) / BLOCK_CHUNK_DATA_SIZE;
+    p->file_size = file_size;
+    tx_begin(&p->tx, topic, qos, total_parts, file_size, resume);
+    p->tx.pipelined = true;
+    record_last_tx(p->tx.block_id, filename);
+    p->tx.base_flags = p->tx.use_fec ? BLOCK_FLAG_FEC : 0;
+    
+    printf("[PIPE] core1 reads and packetizes, core0 transmits\n");
+    block_pipeline_stats_t stats;
+    p->running = true;
+    int ret = block_pipeline_run(pipeline_produce, pipeline_consume, pipeline_idle, p, &stats);
+    p->running = false;
+    binlog_flush();
+    
+    if (ret != 0) {
+        pipeline_release(p);
+        printf("❌ Image transfer failed\n");
+        return -1;
+    }
+    
+    tx_report(&p->tx);
+    
+    float seconds = stats.elapsed_us / 1e6f;
+    metrics_inc(metric.blocks_sent);
+    printf("Block transfer completed: %lu chunks sent\n", (unsigned long)stats.packets);
+    printf("[PIPE] First chunk after %.1f ms, %.2f KB/s, producer waits %lu, consumer waits %lu\n",
+           stats.first_packet_us / 1000.0f, seconds > 0 ? file_size / 1024.0f / seconds : 0.0f,
+           (unsigned long)stats.producer_waits, (unsigned long)stats.consumer_waits);
+    printf("✅ Image transfer completed successfully\n");
+    
+    // Chunks reported corrupt while core1 still owned the file
+    if (p->pending_count > 0) {
+        uint16_t count = p->pending_count;
+        p->pending_count = 0;
+        pipeline_retransmit(p, p->pending, count);
+    }
     return 0;
 }
 
@@ -259,6 +1175,13 @@ int send_image_file(const char *topic, const char *filename) {
 // Send an image file from SD card using block transfer with configurable QoS
 // This sends images from SD card to GitHub repo via MQTT-SN
 int send_image_file_qos(const char *topic, const char *filename, uint8_t qos) {
+    return send_image_file_resume(topic, filename, qos, 0, 0, NULL, NULL);
+}
+
+int send_image_file_resume(const char *topic, const char *filename, uint8_t qos, uint16_t block_id,
+                           uint16_t resume_after, block_progress_t progress, void *ctx) {
+    tx_resume_t resume = { block_id, resume_after, progress, ctx };
+    
     printf("\n=== Sending image from SD card to GitHub repo (QoS %d) ===\n", qos);
     printf("📁 Reading from SD card: %s\n", filename);
     
@@ -276,8 +1199,11 @@ int send_image_file_qos(const char *topic, const char *filename, uint8_t qos) {
         return -1;
     }
     
-    // Get file size
+    // Get file size, and the signature bytes that decide how it is sent
     FSIZE_t file_size_fs = f_size(&file);
+    uint8_t magic[4];
+    UINT magic_len = 0;
+    f_read(&file, magic, sizeof(magic), &magic_len);
     f_close(&file);
     
     // Convert FSIZE_t to size_t (handle both 32-bit and 64-bit)
@@ -309,6 +1235,13 @@ int send_image_file_qos(const char *topic, const char *filename, uint8_t qos) {
         printf("   File will be truncated to %d bytes\n", BLOCK_BUFFER_SIZE);
     }
     
+    // Plain sends stream straight from the card: the first chunk goes out
+    // without waiting for the whole file, and no file-sized buffer is needed
+    if (pipeline_enabled && file_size <= BLOCK_BUFFER_SIZE &&
+        pipeline_suitable(magic, magic_len, qos)) {
+        return send_image_file_pipelined(topic, filename, file_size, qos, &resume);
+    }
+    
     // Allocate buffer (use file size or buffer size, whichever is smaller)
     size_t buffer_size = (file_size > BLOCK_BUFFER_SIZE) ? BLOCK_BUFFER_SIZE : file_size;
     
@@ -339,9 +1272,12 @@ int send_image_file_qos(const char *topic, const char *filename, uint8_t qos) {
     printf("📤 Sending to topic '%s' (will be saved to repo/received/)\n", topic);
     
     // Send via block transfer with specified QoS
-    ret = send_block_transfer_qos(topic, image_buffer, image_size, qos);
+    sending_filename = filename;
+    ret = send_block_transfer_resume(topic, image_buffer, image_size, qos, &resume);
+    sending_filename = NULL;
     
     free(image_buffer);
+    binlog_flush();
     
     if (ret == 0) {
         printf("✅ Image transfer completed successfully\n");
@@ -368,22 +1304,478 @@ static int init_block_assembly(uint16_t block_id, uint16_t total_parts) {
     current_block.received_parts = 0;
     current_block.total_length = 0;
     current_block.last_update = to_ms_since_boot(get_absolute_time());
+    current_block.has_digest = false;
+    current_block.block_crc = 0;
+    current_block.fec_k = 0;
+    current_block.fec_m = 0;
+    current_block.stream_end = total_parts;
+    current_block.fountain = false;
+    current_block.compressed = false;
+    current_block.raw_length = 0;
+    current_block.lz.in_pos = 0;
+    current_block.lz.out_pos = 0;
+    current_block.lz_chunks = 0;
+    current_block.nack_last = 0;
     
     // Use static buffers instead of malloc
     current_block.received_mask = static_received_mask;
     current_block.data_buffer = static_data_buffer;
+    current_block.chunk_base = static_data_buffer;
     
     // Clear the buffers
     memset(static_received_mask, 0, sizeof(static_received_mask));
     memset(static_data_buffer, 0, BLOCK_BUFFER_SIZE);
+    memset(fec_rx_slots, 0, sizeof(fec_rx_slots));
     
     printf("Initialized block assembly: ID=%d, parts=%d (using static buffers)\n", block_id, total_parts);
     return 0;
 }
 
+static void finish_block(void);
+
+// Bytes available for chunk storage from chunk_base to the end of the buffer
+static size_t chunk_space(void) {
+    return BLOCK_BUFFER_SIZE - (current_block.chunk_base - current_block.data_buffer);
+}
+
+// Switch a new block to compressed layout: chunks go to the end of the
+// buffer and are decompressed towards the front as they arrive
+static int setup_compressed_block(uint32_t raw_len) {
+    size_t stream_space = (size_t)current_block.total_parts * BLOCK_CHUNK_DATA_SIZE;
+    if (raw_len > BLOCK_BUFFER_SIZE || stream_space > BLOCK_BUFFER_SIZE) {
+        printf("Error: Compressed block too large (%lu bytes)\n", (unsigned long)raw_len);
+        return -1;
+    }
+    current_block.compressed = true;
+    current_block.raw_length = raw_len;
+    current_block.chunk_base = current_block.data_buffer + BLOCK_BUFFER_SIZE - stream_space;
+    printf("[LZ] Compressed block: %lu bytes in %d chunks\n",
+           (unsigned long)raw_len, current_block.total_parts);
+    return 0;
+}
+
+// Decompress as far as the chunks received without gaps allow. With FEC the
+// stream stops short of a group that is still incomplete: decompressing
+// overwrites consumed chunks, which that group may still need for a rebuild.
+// Returns 1 once the whole block is decompressed, 0 if more data is needed,
+// -1 if the stream is corrupt.
+static int lz_stream_advance(void) {
+    while (current_block.lz_chunks < current_block.total_parts &&
+           current_block.received_mask[current_block.lz_chunks]) {
+        current_block.lz_chunks++;
+    }
+    
+    size_t avail;
+    if (current_block.lz_chunks == current_block.total_parts) {
+        avail = current_block.total_length;
+    } else {
+        uint16_t usable = current_block.lz_chunks;
+        if (current_block.fec_m > 0) {
+            usable -= usable % current_block.fec_k;
+        }
+        avail = (size_t)usable * BLOCK_CHUNK_DATA_SIZE;
+    }
+    
+    return block_lz_decompress(&current_block.lz, current_block.chunk_base, avail,
+                               current_block.data_buffer, current_block.raw_length);
+}
+
+// Final packet of the stream seen - request any chunks still missing
+static void request_missing_chunks(void) {
+    if (current_block.received_parts >= current_block.total_parts) {
+        return;
+    }
+    binlog_flush();
+    
+    // Missing chunks - send status request for retransmission
+    uint16_t missing_list[50];
+    uint16_t missing_count = 0;
+    
+    printf("[WARNING] Missing %d chunks! Showing first 20:\n", 
+           current_block.total_parts - current_block.received_parts);
+    
+    for (int i = 0; i < current_block.total_parts && missing_count < 50; i++) {
+        if (!current_block.received_mask[i]) {
+            missing_list[missing_count++] = i + 1;
+            if (missing_count <= 20) {
+                printf("  Missing: chunk %d\n", i + 1);
+            }
+        }
+    }
+    
+    // The last chunk listed arriving prompts the next request
+    current_block.nack_last = missing_list[missing_count - 1];
+    
+    // Send status message requesting missing chunks
+    send_block_status(current_block.block_id, BLOCK_STATUS_MISSING, missing_list, missing_count);
+}
+
+// Number of data chunks still missing in an FEC group
+static int fec_group_missing(uint16_t group) {
+    uint16_t first = group * current_block.fec_k;
+    int missing = 0;
+    for (uint16_t i = first; i < first + current_block.fec_k && i < current_block.total_parts; i++) {
+        if (!current_block.received_mask[i]) missing++;
+    }
+    return missing;
+}
+
+// Keep a parity chunk until its group can be rebuilt. When the pool is full
+// the parity of the oldest group is dropped (its chunks get NACKed instead).
+static void fec_store_parity(uint16_t group, uint8_t row, const uint8_t *symbol) {
+    int free_slot = -1;
+    int oldest = -1;
+    
+    for (int i = 0; i < BLOCK_FEC_PARITY_SLOTS; i++) {
+        fec_parity_slot_t *slot = &fec_rx_slots[i];
+        if (slot->used && slot->group == group && slot->row == row) {
+            return;  // Duplicate parity
+        }
+        if (!slot->used) {
+            if (free_slot < 0) free_slot = i;
+        } else if (oldest < 0 || slot->group < fec_rx_slots[oldest].group) {
+            oldest = i;
+        }
+    }
+    
+    fec_parity_slot_t *slot = &fec_rx_slots[free_slot >= 0 ? free_slot : oldest];
+    slot->used = true;
+    slot->group = group;
+    slot->row = row;
+    memcpy(slot->symbol, symbol, sizeof(slot->symbol));
+}
+
+// Try to rebuild the missing chunks of a group from the parity held for it
+static void fec_try_decode(uint16_t group) {
+    const size_t chunk_data_size = BLOCK_CHUNK_DATA_SIZE;
+    uint16_t first = group * current_block.fec_k;
+    uint16_t last_part = current_block.total_parts - 1;
+    uint8_t group_k = current_block.fec_k;
+    if (first + group_k > current_block.total_parts) {
+        group_k = current_block.total_parts - first;  // Short final group
+    }
+    if ((size_t)(first + group_k) * chunk_data_size > chunk_space()) {
+        return;
+    }
+    
+    uint8_t *chunks[BLOCK_FEC_MAX_K];
+    uint16_t lens[BLOCK_FEC_MAX_K];
+    bool present[BLOCK_FEC_MAX_K];
+    uint8_t *parity[BLOCK_FEC_MAX_M] = {0};
+    bool parity_present[BLOCK_FEC_MAX_M] = {0};
+    
+    for (uint8_t i = 0; i < group_k; i++) {
+        uint16_t index = first + i;
+        chunks[i] = current_block.chunk_base + index * chunk_data_size;
+        present[i] = current_block.received_mask[index];
+        lens[i] = chunk_data_size;
+        if (index == last_part) {
+            lens[i] = present[i] ? current_block.total_length - index * chunk_data_size : 0;
+        }
+    }
+    
+    for (int i = 0; i < BLOCK_FEC_PARITY_SLOTS; i++) {
+        if (fec_rx_slots[i].used && fec_rx_slots[i].group == group) {
+            parity[fec_rx_slots[i].row] = fec_rx_slots[i].symbol;
+            parity_present[fec_rx_slots[i].row] = true;
+        }
+    }
+    
+    TRACE_BEGIN(TRACE_FEC_DECODE, group);
+    int rebuilt = block_fec_decode(group_k, current_block.fec_m, chunks, lens, present,
+                                   parity, parity_present, chunk_data_size);
+    TRACE_END(TRACE_FEC_DECODE, group);
+    if (rebuilt <= 0) {
+        return;
+    }
+    
+    for (uint8_t i = 0; i < group_k; i++) {
+        if (present[i]) continue;
+        uint16_t index = first + i;
+        current_block.received_mask[index] = true;
+        current_block.received_parts++;
+        if (index == last_part) {
+            current_block.total_length = index * chunk_data_size + lens[i];
+        }
+    }
+    
+    for (int i = 0; i < BLOCK_FEC_PARITY_SLOTS; i++) {
+        if (fec_rx_slots[i].group == group) fec_rx_slots[i].used = false;
+    }
+    
+    fec_recovered_count += rebuilt;
+    metrics_add(metric.chunks_fec_rebuilt, rebuilt);
+    if (current_block.compressed) {
+        lz_stream_advance();
+    }
+    printf("[FEC] ✓ Rebuilt %d chunk(s) in group %d (total rebuilt=%d)\n",
+           rebuilt, group, fec_recovered_count);
+}
+
+// Handle an FEC parity chunk (part numbers after the data chunks)
+static void process_parity_chunk(uint16_t part_num, const uint8_t *symbol, uint16_t symbol_len) {
+    uint16_t index = part_num - current_block.total_parts - 1;
+    uint16_t group = index / current_block.fec_m;
+    uint8_t row = index % current_block.fec_m;
+    
+    if (part_num > current_block.stream_end ||
+        symbol_len != BLOCK_FEC_SYMBOL_SIZE(BLOCK_CHUNK_DATA_SIZE)) {
+        printf("Error: Invalid parity chunk %d (len=%d)\n", part_num, symbol_len);
+        return;
+    }
+    
+    current_block.last_update = to_ms_since_boot(get_absolute_time());
+    
+    if (fec_group_missing(group) > 0) {
+        fec_store_parity(group, row, symbol);
+        fec_try_decode(group);
+    }
+    
+    if (part_num == current_block.stream_end) {
+        request_missing_chunks();
+    }
+    
+    if (current_block.received_parts == current_block.total_parts) {
+        finish_block();
+    }
+}
+
+// Handle a fountain symbol: feed it to the decoder, which rebuilds each
+// generation in the reassembly buffer once it has enough of them
+static void process_fountain_symbol(uint16_t part_num, const block_trailer_t *trailer,
+                                    const uint8_t *symbol, uint16_t symbol_len) {
+    if (!current_block.fountain) {
+        // First fountain symbol of this block - switch the buffer over to the decoder
+        if (trailer->block_len == 0 ||
+            (trailer->block_len + BLOCK_CHUNK_DATA_SIZE - 1) / BLOCK_CHUNK_DATA_SIZE != current_block.total_parts ||
+            block_fountain_decoder_init(&fountain_dec, current_block.data_buffer, BLOCK_BUFFER_SIZE,
+                                        current_block.received_mask, current_block.total_parts,
+                                        BLOCK_CHUNK_DATA_SIZE) != 0) {
+            printf("Error: Cannot decode fountain block (%lu bytes)\n", (unsigned long)trailer->block_len);
+            current_block.block_id = 0;
+            return;
+        }
+        current_block.fountain = true;
+        current_block.total_length = trailer->block_len;
+        printf("[FOUNTAIN] Decoding %d chunks in %d generations\n",
+               current_block.total_parts, block_fountain_generations(current_block.total_parts));
+    }
+    
+    if (symbol_len != BLOCK_CHUNK_DATA_SIZE) {
+        printf("Error: Invalid fountain symbol %d (len=%d)\n", part_num, symbol_len);
+        return;
+    }
+    
+    int ret = block_fountain_decoder_add(&fountain_dec, trailer->fountain_gen,
+                                         trailer->fountain_coef, symbol);
+    if (ret < 0) {
+        printf("Error: Invalid fountain symbol %d (gen=%d)\n", part_num, trailer->fountain_gen);
+        return;
+    }
+    if (ret == 0) {
+        duplicate_count++;  // Nothing new - already implied by the symbols held
+        metrics_inc(metric.chunk_duplicates);
+    }
+    
+    current_block.received_parts = fountain_dec.rank;
+    current_block.last_update = to_ms_since_boot(get_absolute_time());
+    
+    if (ret > 0 && (current_block.received_parts % 50 == 0 ||
+                    block_fountain_decoder_done(&fountain_dec))) {
+        printf("  Progress: rank %d/%d after %d symbols (%d redundant)\n",
+               current_block.received_parts, current_block.total_parts,
+               part_num, duplicate_count);
+    }
+    
+    if (block_fountain_decoder_done(&fountain_dec)) {
+        finish_block();
+    }
+}
+
+// Write-behind queue callback for a block save
+static void block_save_done(void *ctx, int result) {
+    (void)ctx;
+    block_save.pending = false;
+    uint32_t elapsed_ms = (time_us_64() - block_save.start_us) / 1000;
+    if (result == 0) {
+        printf("✅ Block saved to SD card: %s (%lu bytes, %lu ms)\n", block_save.filename,
+               (unsigned long)block_save.length, (unsigned long)elapsed_ms);
+        block_partial_clear(block_save.block_id);
+    } else {
+        printf("❌ Failed to save block to SD card: %s\n", block_save.filename);
+    }
+}
+
+// A completed block is still being written from the reassembly buffer
+bool block_transfer_save_pending(void) {
+    return block_save.pending;
+}
+
+// Save the completed block to SD card and publish the completion notice
+static void finish_block(void) {
+    uint16_t finished_id = current_block.block_id;
+    TRACE_BEGIN(TRACE_BLOCK_FINISH, finished_id);
+    binlog_flush();
+    printf("\n");
+    printf("╔════════════════════════════════════════╗\n");
+    printf("║   BLOCK TRANSFER COMPLETE!             ║\n");
+    printf("╚════════════════════════════════════════╝\n");
+    printf("Block ID: %d\n", current_block.block_id);
+    printf("Total size: %d bytes\n", current_block.total_length);
+    printf("Total chunks: %d\n", current_block.total_parts);
+    printf("Transfer completed successfully!\n");
+    printf("\n");
+    
+    // Flush the rest of the compressed stream
+    if (current_block.compressed) {
+        if (lz_stream_advance() != 1) {
+            printf("[LZ] ✗ Block %d failed to decompress - discarding\n", current_block.block_id);
+            send_block_status(current_block.block_id, BLOCK_STATUS_CORRUPT, NULL, 0);
+            block_partial_clear(current_block.block_id);
+            current_block.block_id = 0;
+            TRACE_END(TRACE_BLOCK_FINISH, finished_id);
+            return;
+        }
+        printf("[LZ] ✓ Decompressed %d -> %lu bytes\n",
+               current_block.total_length, (unsigned long)current_block.raw_length);
+        current_block.total_length = current_block.raw_length;
+    }
+    
+    // Verify whole-block digest (v2 publishers) before touching the SD card
+    if (current_block.has_digest) {
+        uint32_t actual_crc = crc32c(current_block.data_buffer, current_block.total_length);
+        if (actual_crc != current_block.block_crc) {
+            printf("[CRC] ✗ Block %d digest mismatch (expected %08lx, got %08lx) - discarding\n",
+                   current_block.block_id, (unsigned long)current_block.block_crc,
+                   (unsigned long)actual_crc);
+            send_block_status(current_block.block_id, BLOCK_STATUS_CORRUPT, NULL, 0);
+            block_partial_clear(current_block.block_id);
+            current_block.block_id = 0;
+            TRACE_END(TRACE_BLOCK_FINISH, finished_id);
+            return;
+        }
+        printf("[CRC] ✓ Block digest verified (%08lx)\n", (unsigned long)actual_crc);
+    }
+    send_block_status(current_block.block_id, BLOCK_STATUS_COMPLETE, NULL, 0);
+    
+    // Detect file type from data signature
+    const char *file_ext = detect_file_ext(current_block.data_buffer, current_block.total_length);
+    
+    // Save received block to SD card
+    printf("\n[SD SAVE] Starting SD card save operation...\n");
+    if (sd_card_is_mounted()) {
+        printf("[SD] Block complete - preparing to save...\n");
+        
+        // Poll WiFi stack before long SD operation
+        cyw43_arch_poll();
+        
+        // Create received directory if it doesn't exist
+        DIR dir;
+        FRESULT dir_res = f_opendir(&dir, "received");
+        if (dir_res == FR_NO_PATH || dir_res == FR_NO_FILE) {
+            // Directory doesn't exist, create it
+            printf("[SD] Creating 'received' directory...\n");
+            dir_res = f_mkdir("received");
+            if (dir_res == FR_OK) {
+                printf("📁 Created 'received' directory\n");
+            } else if (dir_res == FR_EXIST) {
+                printf("📁 Directory 'received' already exists\n");
+            } else {
+                printf("⚠️  Failed to create 'received' directory (error %d)\n", dir_res);
+            }
+        } else if (dir_res == FR_OK) {
+            // Directory exists, close the handle
+            f_closedir(&dir);
+            printf("📁 Using existing 'received' directory\n");
+        }
+        
+        // Poll WiFi again
+        cyw43_arch_poll();
+        
+        // Generate filename with timestamp
+        char received_filename[64];
+        uint32_t timestamp_sec = to_ms_since_boot(get_absolute_time()) / 1000;
+        snprintf(received_filename, sizeof(received_filename), 
+                "received/block_%d_%lu%s", 
+                current_block.block_id, 
+                timestamp_sec,
+                file_ext);
+        
+        printf("💾 Saving received block to SD card: %s (%d bytes)\n", 
+               received_filename, current_block.total_length);
+        
+        // Poll WiFi before write
+        cyw43_arch_poll();
+        
+        // Written step by step from the main loop (sd_write_queue_poll())
+        strcpy(block_save.filename, received_filename);
+        block_save.block_id = current_block.block_id;
+        block_save.length = current_block.total_length;
+        block_save.start_us = time_us_64();
+        if (sd_write_queue_submit(received_filename, 0, current_block.data_buffer,
+                                  current_block.total_length, SD_WQ_CREATE,
+                                  block_save_done, NULL) == 0) {
+            block_save.pending = true;
+            printf("[WQ] Save queued - written in the background\n");
+        } else {
+            printf("[WQ] ⚠️  Write queue full - saving now\n");
+            int save_result = sd_card_save_block(received_filename, 
+                                                 current_block.data_buffer, 
+                                                 current_block.total_length);
+            
+            // Poll WiFi after write
+            cyw43_arch_poll();
+            
+            block_save_done(NULL, save_result == 0 ? 0 : -1);
+        }
+    } else {
+        printf("⚠️  SD card not mounted, skipping save\n");
+    }
+    
+    // Final completion summary
+    printf("\n");
+    printf("════════════════════════════════════════\n");
+    printf("   TRANSFER SUMMARY\n");
+    printf("════════════════════════════════════════\n");
+    printf("✓ Block ID: %d\n", current_block.block_id);
+    printf("✓ Size: %d bytes (%.2f KB)\n", current_block.total_length, current_block.total_length / 1024.0);
+    printf("✓ Chunks: %d/%d (100%%)\n", current_block.received_parts, current_block.total_parts);
+    printf("✓ Status: COMPLETE\n");
+    if (block_save.pending) {
+        printf("✓ Saving to SD card in the background\n");
+    } else if (sd_card_is_mounted()) {
+        printf("✓ Saved to SD card\n");
+    } else {
+        printf("⚠ SD save skipped (not mounted)\n");
+    }
+    printf("════════════════════════════════════════\n");
+    printf("\n");
+    
+    // Publish completion notification
+    char complete_msg[150];
+    uint32_t timestamp_sec = to_ms_since_boot(get_absolute_time()) / 1000;
+    snprintf(complete_msg, sizeof(complete_msg), 
+            "BLOCK_RECEIVED: ID=%d, SIZE=%d, PARTS=%d, TYPE=%s, TIME=%lu", 
+            current_block.block_id, 
+            current_block.total_length, 
+            current_block.total_parts,
+            file_ext,
+            timestamp_sec);
+    
+    mqttsn_publish("pico/block", (uint8_t*)complete_msg, strlen(complete_msg), 0);
+    printf("📬 Published metadata to 'pico/block'\n");
+    
+    // Reset for next block
+    last_completed_block_id = current_block.block_id;
+    last_completed_block_crc = current_block.block_crc;
+    current_block.block_id = 0;
+    TRACE_END(TRACE_BLOCK_FINISH, finished_id);
+}
+
 // Process received block chunk
-void process_block_chunk(const uint8_t *data, size_t len) {
+static void handle_block_chunk(const uint8_t *data, size_t len) {
     total_packets_received++;
+    metrics_inc(metric.chunks_received);
     
     // printf("[DEBUG] Entered process_block_chunk (len=%zu)\n", len);
     
@@ -420,8 +1812,64 @@ void process_block_chunk(const uint8_t *data, size_t len) {
     const uint8_t *chunk_data = data + sizeof(block_header_t);
     size_t chunk_data_len = data_len;
     
+    if (len < sizeof(block_header_t) + chunk_data_len) {
+        printf("Error: Truncated chunk (data_len=%d, got %zu bytes)\n", data_len, len);
+        return;
+    }
+    
+    // Verify the v2 trailer before trusting any header field. A corrupted
+    // chunk that still belongs to the current block is NACKed straight away
+    // instead of waiting for the final-chunk scan.
+    block_trailer_t trailer;
+    if (parse_chunk_trailer(data, len, data_len, &trailer) != 0) {
+        crc_error_count++;
+        metrics_inc(metric.chunk_crc_errors);
+        BLOG_WARN("[CRC] ✗ Chunk %d/%d failed CRC-32C check - dropped (total CRC errors=%d)\n",
+               part_num, total_parts, crc_error_count);
+        if (block_id == current_block.block_id && total_parts == current_block.total_parts &&
+            part_num >= 1 && part_num <= total_parts &&
+            !current_block.received_mask[part_num - 1]) {
+            send_block_status(block_id, BLOCK_STATUS_MISSING, &part_num, 1);
+        }
+        return;
+    }
+    
+    // Parity or fountain symbols that trail a block already rebuilt and
+    // saved are not a new block
+    if (((trailer.flags & BLOCK_FLAG_FEC) && part_num > total_parts) ||
+        (trailer.flags & BLOCK_FLAG_FOUNTAIN)) {
+        if (current_block.block_id != block_id && block_id == last_completed_block_id &&
+            (!(trailer.flags & BLOCK_FLAG_DIGEST) || trailer.block_crc == last_completed_block_crc)) {
+            return;
+        }
+    }
+    
+    // Rebuilding a delta needs the basis file, which only the subscriber
+    // that published signatures for it holds: ask for the file in full
+    if (trailer.flags & BLOCK_FLAG_DELTA) {
+        if (block_id != ignored_delta_block_id) {
+            printf("[DELTA] Block %d is a delta against basis %08lx - not for this subscriber\n",
+                   block_id, (unsigned long)trailer.basis_crc);
+            ignored_delta_block_id = block_id;
+            send_block_status(block_id, BLOCK_STATUS_NO_DELTA, NULL, 0);
+        }
+        return;
+    }
+    
     // Initialize block assembly if this is a new block
     if (current_block.block_id != block_id) {
+        // The buffer still holds the previous block until its save ends.
+        // Callers that can push back check block_transfer_save_pending() first.
+        if (block_save.pending) {
+            printf("[WQ] Block %d arrived while %s is being saved - waiting for the write\n",
+                   block_id, block_save.filename);
+            sd_write_queue_flush();
+        }
+        // An unfinished block is put on the card before the buffer is reused
+        if (current_block.block_id != 0) {
+            block_partial_checkpoint_sync(&current_block);
+        }
+        binlog_flush();
         printf("\n========================================\n");
         printf("  NEW BLOCK TRANSFER STARTING\n");
         printf("========================================\n");
@@ -429,6 +1877,12 @@ void process_block_chunk(const uint8_t *data, size_t len) {
             printf("[ERROR] init_block_assembly failed!\n");
             return;
         }
+        // Resent or resumed after a reboot or timeout: start from the journal
+        uint16_t journaled_id, journaled_parts;
+        if (block_partial_find(&journaled_id, &journaled_parts) && journaled_id == block_id &&
+            journaled_parts == total_parts) {
+            block_partial_load(&current_block);
+        }
         // Calculate expected size
         size_t chunk_data_size = BLOCK_CHUNK_SIZE - sizeof(block_header_t);
         size_t expected_size = (total_parts - 1) * chunk_data_size + data_len;
@@ -436,6 +1890,37 @@ void process_block_chunk(const uint8_t *data, size_t len) {
         printf("========================================\n\n");
     }
     
+    // Trailer fields that describe the whole block
+    if (trailer.flags & BLOCK_FLAG_DIGEST) {
+        current_block.has_digest = true;
+        current_block.block_crc = trailer.block_crc;
+    }
+    if ((trailer.flags & BLOCK_FLAG_FEC) && current_block.fec_m == 0) {
+        uint16_t groups = (total_parts + trailer.fec_k - 1) / trailer.fec_k;
+        current_block.fec_k = trailer.fec_k;
+        current_block.fec_m = trailer.fec_m;
+        current_block.stream_end = total_parts + groups * trailer.fec_m;
+    }
+    
+    if ((trailer.flags & BLOCK_FLAG_COMPRESSED) && !current_block.compressed &&
+        !(trailer.flags & BLOCK_FLAG_FOUNTAIN)) {
+        if (setup_compressed_block(trailer.raw_len) != 0) {
+            current_block.block_id = 0;
+            return;
+        }
+    }
+    
+    if (trailer.flags & BLOCK_FLAG_FOUNTAIN) {
+        process_fountain_symbol(part_num, &trailer, chunk_data, data_len);
+        return;
+    }
+    
+    // FEC parity chunks are numbered after the data chunks
+    if ((trailer.flags & BLOCK_FLAG_FEC) && part_num > total_parts) {
+        process_parity_chunk(part_num, chunk_data, data_len);
+        return;
+    }
+    
     // Validate part number
     if (part_num < 1 || part_num > total_parts) {
         printf("Error: Invalid part number %d (total %d)\n", part_num, total_parts);
@@ -446,7 +1931,8 @@ void process_block_chunk(const uint8_t *data, size_t len) {
     uint16_t part_index = part_num - 1;
     if (current_block.received_mask[part_index]) {
         duplicate_count++;
-        printf("[DUPLICATE] Chunk %d (total duplicates=%d)\n", part_num, duplicate_count);
+        metrics_inc(metric.chunk_duplicates);
+        BLOG_INFO("[DUPLICATE] Chunk %d (total duplicates=%d)\n", part_num, duplicate_count);
         return;
     }
     
@@ -455,15 +1941,15 @@ void process_block_chunk(const uint8_t *data, size_t len) {
     size_t buffer_offset = part_index * chunk_data_size;
     
     // Store chunk data
-    if (buffer_offset + chunk_data_len <= BLOCK_BUFFER_SIZE) {
-        memcpy(current_block.data_buffer + buffer_offset, chunk_data, chunk_data_len);
+    if (buffer_offset + chunk_data_len <= chunk_space()) {
+        memcpy(current_block.chunk_base + buffer_offset, chunk_data, chunk_data_len);
         current_block.received_mask[part_index] = true;
         current_block.received_parts++;
         current_block.last_update = to_ms_since_boot(get_absolute_time());
         
         // Debug: Show counter increment for last 10 chunks
         if (part_num > total_parts - 10) {
-            printf("[STORE] Chunk %d stored, counter now=%d/%d\n", 
+            BLOG_DEBUG("[STORE] Chunk %d stored, counter now=%d/%d\n", 
                    part_num, current_block.received_parts, current_block.total_parts);
         }
         
@@ -472,184 +1958,44 @@ void process_block_chunk(const uint8_t *data, size_t len) {
             current_block.total_length = buffer_offset + chunk_data_len;
             
             // Final chunk received - check for missing chunks and send status
-            printf("\n[FINAL CHUNK] Received chunk %d/%d, counter=%d\n", 
+            BLOG_INFO("\n[FINAL CHUNK] Received chunk %d/%d, counter=%d\n", 
                    part_num, total_parts, current_block.received_parts);
-            printf("[STATS] Total packets received=%d, Duplicates=%d, Unique=%d\n",
+            BLOG_INFO("[STATS] Total packets received=%d, Duplicates=%d, Unique=%d\n",
                    total_packets_received, duplicate_count, current_block.received_parts);
-            
-            if (current_block.received_parts < current_block.total_parts) {
-                // Missing chunks - send status request for retransmission
-                uint16_t missing_list[50];
-                uint16_t missing_count = 0;
-                
-                printf("[WARNING] Missing %d chunks! Showing first 20:\n", 
-                       current_block.total_parts - current_block.received_parts);
-                
-                for (int i = 0; i < total_parts && missing_count < 50; i++) {
-                    if (!current_block.received_mask[i]) {
-                        missing_list[missing_count++] = i + 1;
-                        if (missing_count <= 20) {
-                            printf("  Missing: chunk %d\n", i + 1);
-                        }
-                    }
-                }
-                
-                // Send status message requesting missing chunks
-                send_block_status(current_block.block_id, BLOCK_STATUS_MISSING, missing_list, missing_count);
-            } else {
-                // All chunks received - send completion status
-                send_block_status(current_block.block_id, BLOCK_STATUS_COMPLETE, NULL, 0);
-            }
+        }
+        
+        // With FEC the stream ends with the last group's parity, which may
+        // still rebuild chunks - only NACK once the whole stream has passed.
+        // Completion status is sent once the block digest has been verified.
+        if (part_num == current_block.stream_end || part_num == current_block.nack_last) {
+            request_missing_chunks();
+        }
+        
+        // Decompress whatever is now contiguous; errors surface when the
+        // block completes
+        if (current_block.compressed) {
+            lz_stream_advance();
         }
         
         // Display progress every 10 chunks or at completion
         if (current_block.received_parts % 10 == 0 || 
             current_block.received_parts == current_block.total_parts) {
-            printf("  Progress: %d/%d chunks received\n",
+            BLOG_INFO("  Progress: %d/%d chunks received\n",
                    current_block.received_parts, current_block.total_parts);
         }
         
         // Debug: Show state before completion check
         if (current_block.received_parts >= current_block.total_parts - 3) {
-            printf("[DEBUG-COMPLETE] received=%d, total=%d, equal=%d\n",
+            BLOG_DEBUG("[DEBUG-COMPLETE] received=%d, total=%d, equal=%d\n",
                    current_block.received_parts, current_block.total_parts,
                    current_block.received_parts == current_block.total_parts);
         }
         
         // Check if block is complete
         if (current_block.received_parts == current_block.total_parts) {
-            printf("\n");
-            printf("╔════════════════════════════════════════╗\n");
-            printf("║   BLOCK TRANSFER COMPLETE!             ║\n");
-            printf("╚════════════════════════════════════════╝\n");
-            printf("Block ID: %d\n", current_block.block_id);
-            printf("Total size: %d bytes\n", current_block.total_length);
-            printf("Total chunks: %d\n", current_block.total_parts);
-            printf("Transfer completed successfully!\n");
-            printf("\n");
-            
-            // Detect file type from data signature
-            const char *file_ext = ".bin";  // Default extension
-            if (current_block.total_length >= 2) {
-                uint8_t byte0 = current_block.data_buffer[0];
-                uint8_t byte1 = current_block.data_buffer[1];
-                
-                // JPEG: FF D8
-                if (byte0 == 0xFF && byte1 == 0xD8) {
-                    file_ext = ".jpg";
-                }
-                // PNG: 89 50 4E 47
-                else if (byte0 == 0x89 && byte1 == 0x50 && 
-                         current_block.total_length >= 4 &&
-                         current_block.data_buffer[2] == 0x4E && 
-                         current_block.data_buffer[3] == 0x47) {
-                    file_ext = ".png";
-                }
-                // GIF: 47 49 46 38
-                else if (byte0 == 0x47 && byte1 == 0x49 &&
-                         current_block.total_length >= 4 &&
-                         current_block.data_buffer[2] == 0x46 &&
-                         current_block.data_buffer[3] == 0x38) {
-                    file_ext = ".gif";
-                }
-            }
-            
-            // Save received block to SD card
-            printf("\n[SD SAVE] Starting SD card save operation...\n");
-            if (sd_card_is_mounted()) {
-                printf("[SD] Block complete - preparing to save...\n");
-                
-                // Poll WiFi stack before long SD operation
-                cyw43_arch_poll();
-                
-                // Create received directory if it doesn't exist
-                DIR dir;
-                FRESULT dir_res = f_opendir(&dir, "received");
-                if (dir_res == FR_NO_PATH || dir_res == FR_NO_FILE) {
-                    // Directory doesn't exist, create it
-                    printf("[SD] Creating 'received' directory...\n");
-                    dir_res = f_mkdir("received");
-                    if (dir_res == FR_OK) {
-                        printf("📁 Created 'received' directory\n");
-                    } else if (dir_res == FR_EXIST) {
-                        printf("📁 Directory 'received' already exists\n");
-                    } else {
-                        printf("⚠️  Failed to create 'received' directory (error %d)\n", dir_res);
-                    }
-                } else if (dir_res == FR_OK) {
-                    // Directory exists, close the handle
-                    f_closedir(&dir);
-                    printf("📁 Using existing 'received' directory\n");
-                }
-                
-                // Poll WiFi again
-                cyw43_arch_poll();
-                
-                // Generate filename with timestamp
-                char received_filename[64];
-                uint32_t timestamp_sec = to_ms_since_boot(get_absolute_time()) / 1000;
-                snprintf(received_filename, sizeof(received_filename), 
-                        "received/block_%d_%lu%s", 
-                        current_block.block_id, 
-                        timestamp_sec,
-                        file_ext);
-                
-                printf("💾 Saving received block to SD card: %s (%d bytes)\n", 
-                       received_filename, current_block.total_length);
-                
-                // Poll WiFi before write
-                cyw43_arch_poll();
-                
-                int save_result = sd_card_save_block(received_filename, 
-                                                     current_block.data_buffer, 
-                                                     current_block.total_length);
-                
-                // Poll WiFi after write
-                cyw43_arch_poll();
-                
-                if (save_result == 0) {
-                    printf("✅ Block saved to SD card: %s (%d bytes)\n", 
-                           received_filename, current_block.total_length);
-                } else {
-                    printf("❌ Failed to save block to SD card (error %d)\n", save_result);
-                }
-            } else {
-                printf("⚠️  SD card not mounted, skipping save\n");
-            }
-            
-            // Final completion summary
-            printf("\n");
-            printf("════════════════════════════════════════\n");
-            printf("   TRANSFER SUMMARY\n");
-            printf("════════════════════════════════════════\n");
-            printf("✓ Block ID: %d\n", current_block.block_id);
-            printf("✓ Size: %d bytes (%.2f KB)\n", current_block.total_length, current_block.total_length / 1024.0);
-            printf("✓ Chunks: %d/%d (100%%)\n", current_block.received_parts, current_block.total_parts);
-            printf("✓ Status: COMPLETE\n");
-            if (sd_card_is_mounted()) {
-                printf("✓ Saved to SD card\n");
-            } else {
-                printf("⚠ SD save skipped (not mounted)\n");
-            }
-            printf("════════════════════════════════════════\n");
-            printf("\n");
-            
-            // Publish completion notification
-            char complete_msg[150];
-            uint32_t timestamp_sec = to_ms_since_boot(get_absolute_time()) / 1000;
-            snprintf(complete_msg, sizeof(complete_msg), 
-                    "BLOCK_RECEIVED: ID=%d, SIZE=%d, PARTS=%d, TYPE=%s, TIME=%lu", 
-                    current_block.block_id, 
-                    current_block.total_length, 
-                    current_block.total_parts,
-                    file_ext,
-                    timestamp_sec);
-            
-            mqttsn_publish("pico/block", (uint8_t*)complete_msg, strlen(complete_msg), 0);
-            printf("📬 Published metadata to 'pico/block'\n");
-            
-            // Reset for next block
-            current_block.block_id = 0;
+            finish_block();
+        } else {
+            block_partial_checkpoint(&current_block, false);
         }
     } else {
         printf("Error: Chunk data would overflow buffer\n");
@@ -658,6 +2004,36 @@ void process_block_chunk(const uint8_t *data, size_t len) {
     // printf("[DEBUG] process_block_chunk completed\n");
 }
 
+void process_block_chunk(const uint8_t *data, size_t len) {
+    TRACE_BEGIN(TRACE_CHUNK_RECEIVE, len);
+    handle_block_chunk(data, len);
+    TRACE_END(TRACE_CHUNK_RECEIVE, len);
+}
+
+// Subscriber: after (re)subscribing, restore a block journaled before a
+// reboot or reconnect and request the chunks it is missing. Returns 1 if
+// a block was restored.
+int block_transfer_resume_partial(void) {
+    uint16_t block_id, total_parts;
+    if (block_partial_open() != 1 || !block_partial_find(&block_id, &total_parts)) {
+        return 0;
+    }
+    if (current_block.block_id == block_id) {
+        return 1;
+    }
+    if (init_block_assembly(block_id, total_parts) != 0 || block_partial_load(&current_block) < 0) {
+        current_block.block_id = 0;
+        return -1;
+    }
+    // All there: the power went before the save finished
+    if (current_block.received_parts == current_block.total_parts) {
+        finish_block();
+    } else {
+        request_missing_chunks();
+    }
+    return 1;
+}
+
 bool block_transfer_is_active(void) {
     return current_block.block_id != 0;
 }
@@ -666,10 +2042,19 @@ void block_transfer_check_timeout(void) {
     // Check for block assembly timeout (120 seconds)
     if (current_block.block_id != 0) {
         uint32_t now = to_ms_since_boot(get_absolute_time());
-        if ((now - current_block.last_update) > 120000) {
+        uint32_t idle = now - current_block.last_update;
+        if (idle > 120000) {
+            metrics_inc(metric.blocks_timed_out);
             printf("Block assembly timeout for block %d (received %d/%d parts)\n",
                    current_block.block_id, current_block.received_parts, current_block.total_parts);
+            // Chunks of this block arriving later reload it from the card
+            if (block_partial_checkpoint_sync(&current_block) == 0) {
+                printf("[PARTIAL] Block %d kept on the SD card\n", current_block.block_id);
+            }
             current_block.block_id = 0; // Reset
+        } else if (idle > BLOCK_PARTIAL_IDLE_MS) {
+            // Stalled: checkpoint what arrived in case it never resumes
+            block_partial_checkpoint(&current_block, true);
         }
     }
 }
@@ -691,8 +2076,15 @@ void send_block_status(uint16_t block_id, uint8_t status, uint16_t *missing_chun
                    1); // QoS 1
     
     if (status == BLOCK_STATUS_COMPLETE) {
+        metrics_inc(metric.blocks_received);
         printf("[STATUS] ✅ Block %d COMPLETE - sent confirmation\n", block_id);
+    } else if (status == BLOCK_STATUS_CORRUPT) {
+        metrics_inc(metric.blocks_corrupt);
+        printf("[STATUS] ✗ Block %d CORRUPT - requesting full resend\n", block_id);
+    } else if (status == BLOCK_STATUS_NO_DELTA) {
+        printf("[STATUS] ✗ Block %d is a delta - requesting full send\n", block_id);
     } else {
+        metrics_add(metric.chunks_nacked, msg.missing_count);
         printf("[STATUS] ⚠️  Block %d MISSING %d chunks - requesting retransmission\n", 
                block_id, msg.missing_count);
     }
@@ -711,7 +2103,10 @@ void process_block_status(const uint8_t *data, size_t len) {
     
     if (msg->status == BLOCK_STATUS_COMPLETE) {
         printf("✅ COMPLETE\n");
-        // Block successfully received - can proceed with next operation
+        // Block successfully received - its file is no longer needed
+        if (pipeline_tx.open && msg->block_id == pipeline_tx.tx.block_id && !pipeline_tx.running) {
+            pipeline_release(&pipeline_tx);
+        }
     } else if (msg->status == BLOCK_STATUS_MISSING) {
         printf("⚠️  MISSING %d chunks\n", msg->missing_count);
         printf("[STATUS] Missing chunks: ");
@@ -723,7 +2118,60 @@ void process_block_status(const uint8_t *data, size_t len) {
         }
         printf("\n");
         
-        // TODO: Implement retransmission of missing chunks
-        printf("[STATUS] ⚠️  Retransmission not yet implemented\n");
+        // Only the last pipelined file is still open to re-read from
+        pipeline_tx_t *p = &pipeline_tx;
+        uint16_t count = msg->missing_count;
+        size_t listed = (len - offsetof(block_status_msg_t, missing_chunks)) / sizeof(uint16_t);
+        if (count > listed) count = listed;
+        
+        if (!p->open || msg->block_id != p->tx.block_id) {
+            printf("[STATUS] ⚠️  Block %d is no longer open - cannot retransmit\n", msg->block_id);
+        } else if (p->running) {
+            for (uint16_t i = 0; i < count && p->pending_count < BLOCK_RETX_MAX_PENDING; i++) {
+                p->pending[p->pending_count++] = msg->missing_chunks[i];
+            }
+        } else {
+            pipeline_retransmit(p, msg->missing_chunks, count);
+        }
+    } else if (msg->status == BLOCK_STATUS_CORRUPT) {
+        printf("✗ CORRUPT (whole-block digest mismatch)\n");
+        if (msg->block_id != last_tx.block_id || last_tx.filename[0] == '\0') {
+            printf("[STATUS] ⚠️  Block %d is not the last file sent - cannot resend\n", msg->block_id);
+        } else if (last_tx.corrupt_resends >= BLOCK_CORRUPT_RESEND_MAX) {
+            printf("[STATUS] ✗ '%s' was corrupt %d times - giving up\n", last_tx.filename,
+                   last_tx.corrupt_resends + 1);
+            last_tx.block_id = 0;
+        } else {
+            printf("[STATUS] '%s' will be sent again in full\n", last_tx.filename);
+            last_tx.corrupt_resends++;
+            last_tx.resend = true;
+            last_tx.block_id = 0;
+        }
+    } else if (msg->status == BLOCK_STATUS_NO_DELTA) {
+        printf("✗ NO DELTA (subscriber cannot rebuild deltas)\n");
+        // Not every subscriber can take deltas: stop sending them
+        if (delta_enabled) {
+            block_transfer_set_delta(false);
+        }
+        if (msg->block_id == last_tx.block_id && last_tx.filename[0] != '\0') {
+            printf("[DELTA] '%s' will be sent again in full\n", last_tx.filename);
+            last_tx.resend = true;
+            last_tx.block_id = 0;
+        }
+    }
+}
+
+// Process a signature message from a subscriber (on publisher side)
+void process_block_signatures(const uint8_t *data, size_t len) {
+    int rc = block_delta_add_signatures(data, len);
+    
+    if (rc < 0) {
+        printf("[DELTA] Invalid signature message (%zu bytes)\n", len);
+    } else if (rc == 1) {
+        uint32_t basis_crc;
+        uint16_t block_size;
+        block_delta_ready(&basis_crc, &block_size);
+        printf("[DELTA] ✅ Signatures complete for basis %08lx (%u-byte blocks) - delta transfers available\n",
+               (unsigned long)basis_crc, block_size);
     }
 }
\ No newline at end of file
@@ -2,12 +2,60 @@
 #define BLOCK_TRANSFER_H
 
 #include "pico/stdlib.h"
+#include "block_fec.h"
+#include "block_fountain.h"
+#include "block_lz.h"
+#include "block_delta.h"
 
 // Block transfer constants
+#ifndef BLOCK_CHUNK_SIZE
 #define BLOCK_CHUNK_SIZE 128        // Size of each chunk (adjust based on MQTT-SN packet limits)
+#endif
 #define BLOCK_MAX_CHUNKS 3000       // Maximum number of chunks per block (supports up to ~375KB images)
 #define BLOCK_BUFFER_SIZE 150000    // 150KB buffer - fits in Pico W's ~264KB RAM with room for stack/WiFi
 #define MAX_SUPPORTED_FILE_SIZE 150000  // Maximum file size we can handle (150KB) - safe for Pico W RAM
+#define BLOCK_CHUNK_DATA_SIZE (BLOCK_CHUNK_SIZE - sizeof(block_header_t))  // Data bytes per chunk
+
+// Forward error correction for QoS 0 transfers (see block_fec.h). After every
+// K data chunks the publisher sends M parity chunks; M = 0 disables FEC.
+#define BLOCK_FEC_DEFAULT_K 8
+#define BLOCK_FEC_DEFAULT_M 0
+#define BLOCK_FEC_PARITY_SLOTS 16   // Parity chunks the subscriber can hold for incomplete groups
+
+// Fountain (rateless) mode for one-to-many QoS 0 transfers (see block_fountain.h).
+// The publisher sends every chunk once, then this many extra coded symbols
+// (as a percentage of the chunk count); 0 disables fountain mode.
+#define BLOCK_FOUNTAIN_DEFAULT_REPAIR 0
+#define BLOCK_FOUNTAIN_MAX_REPAIR     200
+
+// Compression (see block_lz.h). Payloads that are not already compressed
+// images are LZ4-compressed before chunking when it saves at least
+// BLOCK_COMPRESS_MIN_GAIN percent of the chunks.
+#define BLOCK_COMPRESS_DEFAULT  true
+#define BLOCK_COMPRESS_MIN_GAIN 10
+
+// Delta mode (see block_delta.h). Once a subscriber has published
+// signatures of its copy on "pico/block_sig", the next file is sent as a
+// delta against that copy when it is smaller than the file (and than its
+// compressed form) by at least BLOCK_COMPRESS_MIN_GAIN percent. Every
+// subscriber on the chunk topic gets the delta, and only receive_blocks.py
+// can rebuild one, so it is off unless block_transfer_set_delta() turns it
+// on. A Pico subscriber that gets a delta anyway replies
+// BLOCK_STATUS_NO_DELTA; the publisher then turns delta mode off and
+// sends the file again in full.
+#define BLOCK_DELTA_DEFAULT     false
+
+// Dual-core file sends (see block_pipeline.h): core1 reads the file and
+// builds packets while core0 transmits. Used for sends that need no
+// whole-file encoding (images, or any file with compression off).
+#define BLOCK_PIPELINE_DEFAULT      true
+#define BLOCK_PIPELINE_READ_CHUNKS  8    // Chunks per SD read on core1
+
+// Retransmission from the card: a pipelined file stays open after the send
+// with a FatFs fast-seek cluster map, so each chunk a subscriber reports
+// missing is re-read without walking the FAT chain.
+#define BLOCK_RETX_CLMT_SIZE    64   // Map entries (DWORDs): up to 31 fragments
+#define BLOCK_RETX_MAX_PENDING  50   // Requests queued while the pipeline runs
 
 // Block transfer header structure
 typedef struct {
@@ -17,9 +65,72 @@ typedef struct {
     uint16_t data_len;      // Length of data in this chunk
 } block_header_t;
 
+// Wire format v2: a trailer follows the chunk data. v1 receivers only read
+// data_len bytes after the header, so they ignore it; v2 receivers treat a
+// chunk without a trailer as v1 and skip the integrity checks.
+//
+//   [block_header_t][data (data_len)][version][flags][optional fields][crc32c]
+//
+// The CRC-32C covers every byte before it (header, data, trailer fields).
+// Optional fields appear in flag order; all multi-byte values are little-endian.
+#define BLOCK_WIRE_VERSION   2
+#define BLOCK_FLAG_DIGEST    0x01   // + uint32 CRC-32C of the whole block (final chunk)
+#define BLOCK_FLAG_FEC       0x02   // + uint8 fec_k, uint8 fec_m (chunk is part of an FEC stream)
+#define BLOCK_FLAG_FOUNTAIN  0x04   // + uint16 generation, uint64 coefficient mask, uint32 block length
+#define BLOCK_FLAG_COMPRESSED 0x08  // + uint32 uncompressed length (chunks carry an LZ4 stream)
+#define BLOCK_FLAG_DELTA     0x10   // + uint32 basis CRC-32C, uint16 basis block size (chunks carry a delta)
+#define BLOCK_TRAILER_SIZE   6      // version + flags + crc32c
+#define BLOCK_DIGEST_SIZE    4
+#define BLOCK_FEC_FIELDS_SIZE 2
+#define BLOCK_FOUNTAIN_FIELDS_SIZE 14
+#define BLOCK_COMPRESSED_FIELDS_SIZE 4
+#define BLOCK_DELTA_FIELDS_SIZE 6
+#define BLOCK_TRAILER_MAX    (BLOCK_TRAILER_SIZE + BLOCK_DIGEST_SIZE + BLOCK_FEC_FIELDS_SIZE + \
+                              BLOCK_FOUNTAIN_FIELDS_SIZE + BLOCK_COMPRESSED_FIELDS_SIZE + \
+                              BLOCK_DELTA_FIELDS_SIZE)
+#define BLOCK_PACKET_MAX     (BLOCK_CHUNK_SIZE + BLOCK_FEC_LEN_SIZE + BLOCK_TRAILER_MAX)
+
+// FEC parity chunks follow the data chunks of their group and are numbered
+// after the data: part_num = total_parts + group * M + row + 1. Their data is
+// a coded symbol of BLOCK_FEC_SYMBOL_SIZE(BLOCK_CHUNK_DATA_SIZE) bytes. v1
+// receivers reject them as out-of-range part numbers.
+//
+// Fountain symbols number part_num as a running sequence (1-based, past
+// total_parts once the systematic pass is done). Their data is always
+// BLOCK_CHUNK_DATA_SIZE bytes, the XOR of the chunks selected by the mask,
+// and every symbol carries the block digest.
+//
+// Compressed blocks chunk the LZ4 stream instead of the data; every chunk
+// (and parity chunk) carries the uncompressed length. The block digest is
+// always over the uncompressed data.
+//
+// Delta blocks chunk a block_delta stream instead of the data. The basis it
+// applies to is named by its CRC-32C, so only a subscriber holding that file
+// can rebuild the block. The block digest is over the rebuilt file. Delta
+// and compression are not combined.
+
+// Parsed v2 trailer
+typedef struct {
+    uint8_t version;        // 1 = no trailer present, otherwise BLOCK_WIRE_VERSION
+    uint8_t flags;          // BLOCK_FLAG_* bits
+    uint32_t block_crc;     // Whole-block digest (valid with BLOCK_FLAG_DIGEST)
+    uint8_t fec_k;          // Data chunks per FEC group (valid with BLOCK_FLAG_FEC)
+    uint8_t fec_m;          // Parity chunks per FEC group (valid with BLOCK_FLAG_FEC)
+    uint16_t fountain_gen;  // Generation of a fountain symbol (valid with BLOCK_FLAG_FOUNTAIN)
+    uint64_t fountain_coef; // Chunks of the generation XORed into the symbol
+    uint32_t block_len;     // Length of the whole block in bytes
+    uint32_t raw_len;       // Uncompressed length (valid with BLOCK_FLAG_COMPRESSED)
+    uint32_t basis_crc;     // Basis the delta applies to (valid with BLOCK_FLAG_DELTA)
+    uint16_t basis_block_size;
+} block_trailer_t;
+
 // Block status message (for requesting retransmission)
 #define BLOCK_STATUS_COMPLETE 0
 #define BLOCK_STATUS_MISSING  1
+#define BLOCK_STATUS_CORRUPT  2   // Whole-block digest mismatch - resend the block
+#define BLOCK_STATUS_NO_DELTA 3   // Block is a delta this subscriber cannot rebuild - resend in full
+
+#define BLOCK_CORRUPT_RESEND_MAX 3  // Full resends of one file after CORRUPT replies
 typedef struct {
     uint16_t block_id;
     uint8_t status;           // COMPLETE or MISSING
@@ -36,19 +147,52 @@ typedef struct {
     uint8_t *data_buffer;   // Buffer to store reassembled data
     uint32_t total_length;  // Total length of complete message
     uint32_t last_update;   // Timestamp of last received part
+    bool has_digest;        // Final chunk carried a whole-block digest
+    uint32_t block_crc;     // Expected CRC-32C of the reassembled block
+    uint8_t fec_k;          // FEC group size (0 = no FEC)
+    uint8_t fec_m;          // Parity chunks per group
+    uint16_t stream_end;    // Part number of the last packet in the stream
+    bool fountain;          // Block arrives as fountain symbols
+    bool compressed;        // Chunks carry an LZ4 stream
+    uint32_t raw_length;    // Uncompressed block length
+    uint8_t *chunk_base;    // Where chunk 1 is stored (end of the buffer when compressed)
+    block_lz_stream_t lz;   // Streaming decompression progress
+    uint16_t lz_chunks;     // Chunks received without gaps from the start
+    uint16_t nack_last;     // Last chunk of the latest MISSING request (0 = none)
 } block_assembly_t;
 
+// File send progress, for block_spool.h: called before the first chunk
+// (acked = chunks skipped on resume), then as data chunks are acknowledged
+// (sent, at QoS 0). Always called from the core that owns the SD card.
+typedef void (*block_progress_t)(void *ctx, uint16_t block_id, uint16_t total_parts, uint16_t acked);
+
 // Block transfer functions
 int block_transfer_init(void);
+int block_transfer_set_fec(uint8_t k, uint8_t m);
+int block_transfer_set_fountain(uint8_t repair_percent);
+void block_transfer_set_compression(bool enabled);
+void block_transfer_set_delta(bool enabled);
+void block_transfer_set_pipeline(bool enabled);
 int send_block_transfer(const char *topic, const uint8_t *data, size_t data_len);
 int send_block_transfer_qos(const char *topic, const uint8_t *data, size_t data_len, uint8_t qos);
 int send_image_file(const char *topic, const char *filename);
 int send_image_file_qos(const char *topic, const char *filename, uint8_t qos);
+// Send a file as block block_id (0 = a new id) without resending chunks
+// 1..resume_after. Fountain sends always start from the beginning.
+int send_image_file_resume(const char *topic, const char *filename, uint8_t qos, uint16_t block_id,
+                           uint16_t resume_after, block_progress_t progress, void *ctx);
+// File a subscriber refused as a delta (BLOCK_STATUS_NO_DELTA) or found
+// corrupt (BLOCK_STATUS_CORRUPT), to send again in full; NULL if none.
+// Returns each file once per refusal.
+const char *block_transfer_take_full_resend(void);
 void process_block_chunk(const uint8_t *data, size_t len);
 void generate_large_message(char *buffer, size_t size);
 bool block_transfer_is_active(void);
+bool block_transfer_save_pending(void);  // Last block still queued for the SD card
 void block_transfer_check_timeout(void);
+int block_transfer_resume_partial(void);  // Subscriber: restore a block journaled on the card
 void send_block_status(uint16_t block_id, uint8_t status, uint16_t *missing_chunks, uint16_t missing_count);
 void process_block_status(const uint8_t *data, size_t len);
+void process_block_signatures(const uint8_t *data, size_t len);
 
 #endif // BLOCK_TRANSFER_H
\ No newline at end of file
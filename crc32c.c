@@ -0,0 +1,70 @@
+// crc32c.c - Table-driven slice-by-4 CRC-32C
+//
+// Cortex-M0+ has no CRC instruction, so this processes 4 bytes per step
+// with four 256-entry lookup tables (4 KB). The tables are generated into
+// RAM on first use: flash (XIP) lookups miss the cache too often to keep up.
+
+#include "crc32c.h"
+#include <stdbool.h>
+
+#define CRC32C_POLY 0x82F63B78u  // Reflected Castagnoli polynomial
+
+static uint32_t crc_table[4][256];
+static bool crc_table_ready = false;
+
+static void crc32c_init_tables(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : (c >> 1);
+        }
+        crc_table[0][i] = c;
+    }
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = crc_table[0][i];
+        for (int t = 1; t < 4; t++) {
+            c = crc_table[0][c & 0xFF] ^ (c >> 8);
+            crc_table[t][i] = c;
+        }
+    }
+
+    crc_table_ready = true;
+}
+
+uint32_t crc32c_update(uint32_t crc, const uint8_t *data, size_t len) {
+    if (!crc_table_ready) {
+        crc32c_init_tables();
+    }
+
+    uint32_t c = ~crc;
+
+    // Byte-at-a-time until the pointer is word aligned
+    while (len > 0 && ((uintptr_t)data & 3) != 0) {
+        c = crc_table[0][(c ^ *data++) & 0xFF] ^ (c >> 8);
+        len--;
+    }
+
+    // Slice-by-4 main loop (little-endian word loads)
+    while (len >= 4) {
+        c ^= *(const uint32_t *)data;
+        c = crc_table[3][c & 0xFF] ^
+            crc_table[2][(c >> 8) & 0xFF] ^
+            crc_table[1][(c >> 16) & 0xFF] ^
+            crc_table[0][c >> 24];
+        data += 4;
+        len -= 4;
+    }
+
+    // Tail
+    while (len > 0) {
+        c = crc_table[0][(c ^ *data++) & 0xFF] ^ (c >> 8);
+        len--;
+    }
+
+    return ~c;
+}
+
+uint32_t crc32c(const uint8_t *data, size_t len) {
+    return crc32c_update(0, data, len);
+}
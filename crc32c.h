@@ -0,0 +1,16 @@
+// crc32c.h - CRC-32C (Castagnoli) used for block transfer integrity checks
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Compute CRC-32C over a buffer (initial value 0, final XOR applied).
+uint32_t crc32c(const uint8_t *data, size_t len);
+
+// Incremental form: start with crc = 0 and feed the buffer in pieces.
+// crc32c_update(crc32c_update(0, a, n), b, m) == crc32c(a || b).
+uint32_t crc32c_update(uint32_t crc, const uint8_t *data, size_t len);
+
+#endif // CRC32C_H
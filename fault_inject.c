@@ -0,0 +1,455 @@
+// fault_inject.c - Drop, delay, duplicate and corrupt MQTT-SN datagrams (see fault_inject.h)
+
+#include "fault_inject.h"
+
+#if FAULT_INJECT_ENABLED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+#include "pico/rand.h"
+#include "network_errors.h"
+#include "mqttsn_client.h"
+#include "metrics.h"
+
+#define SPEC_MAX            128
+#define CONSOLE_TIMEOUT_US  30000000    // Per key, before a spec being typed is abandoned
+#define PPM                 1000000u
+
+typedef struct {
+    uint32_t loss_ppm;
+    bool ge;
+    bool bad;                       // Gilbert-Elliott state
+    uint32_t ge_p_ppm;              // good -> bad, per packet
+    uint32_t ge_r_ppm;              // bad -> good
+    uint32_t ge_good_ppm;           // Loss in each state
+    uint32_t ge_bad_ppm;
+    uint32_t dup_ppm;
+    uint32_t corrupt_ppm;
+    uint32_t delay_ms;
+    uint32_t jitter_ms;
+    char pattern[FAULT_INJECT_PATTERN + 1];
+    uint8_t pattern_pos;
+} fault_dir_t;
+
+// A delayed or duplicate packet. dest_ip is kept as a pointer: the client
+// always passes MQTTSN_GATEWAY_IP.
+typedef struct {
+    bool used;
+    bool outgoing;
+    uint64_t due_us;
+    const char *dest_ip;
+    uint16_t dest_port;
+    uint16_t len;
+    uint8_t data[FAULT_INJECT_MTU];
+} held_t;
+
+typedef enum {
+    FAULT_PASS,
+    FAULT_DROP,
+    FAULT_DUP,
+    FAULT_CORRUPT
+} fault_t;
+
+static fault_dir_t dir_out;
+static fault_dir_t dir_in;
+static bool active;                 // Any fault set
+static held_t held[FAULT_INJECT_HELD];
+static int held_count;
+static uint16_t control_topicid;
+static uint32_t rng_state;
+static uint8_t scratch[FAULT_INJECT_MTU];
+
+static struct {
+    int dropped;
+    int duplicated;
+    int corrupted;
+    int delayed;
+} metric = { -1, -1, -1, -1 };
+
+// PRNG: xorshift32, seeded from the hardware on first use or by seed=N
+
+static uint32_t next_rand(void) {
+    if (rng_state == 0) {
+        rng_state = get_rand_32() | 1;
+    }
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static bool chance(uint32_t ppm) {
+    return ppm > 0 && next_rand() % PPM < ppm;
+}
+
+// Per-packet decision: the pattern first, then the random faults
+static fault_t decide(fault_dir_t *d) {
+    fault_t f = FAULT_PASS;
+    if (d->pattern[0] != '\0') {
+        char c = d->pattern[d->pattern_pos++];
+        if (d->pattern[d->pattern_pos] == '\0') {
+            d->pattern_pos = 0;
+        }
+        if (c == 'X') return FAULT_DROP;
+        if (c == 'D') f = FAULT_DUP;
+        if (c == 'C') f = FAULT_CORRUPT;
+    }
+    if (d->ge) {
+        // The state moves once per packet, then its loss rate applies
+        if (chance(d->bad ? d->ge_r_ppm : d->ge_p_ppm)) {
+            d->bad = !d->bad;
+        }
+        if (chance(d->bad ? d->ge_bad_ppm : d->ge_good_ppm)) return FAULT_DROP;
+    }
+    if (chance(d->loss_ppm)) return FAULT_DROP;
+    if (f == FAULT_PASS && chance(d->corrupt_ppm)) f = FAULT_CORRUPT;
+    if (f == FAULT_PASS && chance(d->dup_ppm)) f = FAULT_DUP;
+    return f;
+}
+
+static uint64_t delay_us(const fault_dir_t *d) {
+    uint64_t us = (uint64_t)d->delay_ms * 1000u;
+    if (d->jitter_ms > 0) {
+        us += next_rand() % (d->jitter_ms * 1000u + 1);
+    }
+    return us;
+}
+
+static void flip_bit(uint8_t *data, size_t len) {
+    uint32_t bit = next_rand() % (uint32_t)(len * 8);
+    data[bit / 8] ^= (uint8_t)(1u << (bit % 8));
+    metrics_inc(metric.corrupted);
+}
+
+// Packets held back
+
+static bool hold(bool outgoing, uint64_t due_us, const char *dest_ip, uint16_t dest_port,
+                 const uint8_t *data, size_t len) {
+    if (len > FAULT_INJECT_MTU) {
+        return false;
+    }
+    for (int i = 0; i < FAULT_INJECT_HELD; i++) {
+        held_t *h = &held[i];
+        if (!h->used) {
+            h->used = true;
+            h->outgoing = outgoing;
+            h->due_us = due_us;
+            h->dest_ip = dest_ip;
+            h->dest_port = dest_port;
+            h->len = (uint16_t)len;
+            memcpy(h->data, data, len);
+            held_count++;
+            return true;
+        }
+    }
+    return false;       // All slots taken: the packet goes now
+}
+
+static void release(held_t *h) {
+    h->used = false;
+    held_count--;
+}
+
+static void send_due(const mqttsn_transport_ops_t *ops) {
+    uint64_t now = time_us_64();
+    for (int i = 0; i < FAULT_INJECT_HELD && held_count > 0; i++) {
+        held_t *h = &held[i];
+        if (h->used && h->outgoing && h->due_us <= now) {
+            ops->send(h->dest_ip, h->dest_port, h->data, h->len);
+            release(h);
+        }
+    }
+}
+
+// The earliest incoming packet that is due, copied out; 0 if none
+static int take_due(uint8_t *buffer, size_t max_len) {
+    held_t *first = NULL;
+    uint64_t now = time_us_64();
+    for (int i = 0; i < FAULT_INJECT_HELD && held_count > 0; i++) {
+        held_t *h = &held[i];
+        if (h->used && !h->outgoing && h->due_us <= now && (first == NULL || h->due_us < first->due_us)) {
+            first = h;
+        }
+    }
+    if (first == NULL) {
+        return 0;
+    }
+    size_t len = first->len < max_len ? first->len : max_len;
+    memcpy(buffer, first->data, len);
+    release(first);
+    return (int)len;
+}
+
+static uint64_t next_due_us(void) {
+    uint64_t next = UINT64_MAX;
+    for (int i = 0; i < FAULT_INJECT_HELD && held_count > 0; i++) {
+        if (held[i].used && held[i].due_us < next) {
+            next = held[i].due_us;
+        }
+    }
+    return next;
+}
+
+// Configuration
+
+static int parse_percent(const char *text, uint32_t *ppm) {
+    char *end;
+    double v = strtod(text, &end);
+    if (end == text || v < 0 || v > 100) {
+        return -1;
+    }
+    *ppm = (uint32_t)(v * 10000.0 + 0.5);
+    return 0;
+}
+
+static int parse_ge(const char *text, fault_dir_t *d) {
+    double p, r, k = 0, h = 100;
+    int n = sscanf(text, "%lf:%lf:%lf:%lf", &p, &r, &k, &h);
+    if (n < 2 || p < 0 || p > 100 || r < 0 || r > 100 || k < 0 || k > 100 || h < 0 || h > 100) {
+        return -1;
+    }
+    d->ge = true;
+    d->bad = false;
+    d->ge_p_ppm = (uint32_t)(p * 10000.0 + 0.5);
+    d->ge_r_ppm = (uint32_t)(r * 10000.0 + 0.5);
+    d->ge_good_ppm = (uint32_t)(k * 10000.0 + 0.5);
+    d->ge_bad_ppm = (uint32_t)(h * 10000.0 + 0.5);
+    return 0;
+}
+
+// "loss=2,delay=20,..." on top of a direction's settings; 0 on success
+static int parse_dir(const char *text, fault_dir_t *d) {
+    char buf[SPEC_MAX];
+    char *save;
+    snprintf(buf, sizeof(buf), "%s", text);
+    for (char *item = strtok_r(buf, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+        while (*item == ' ') item++;
+        if (strcmp(item, "off") == 0) {
+            memset(d, 0, sizeof(*d));
+            continue;
+        }
+        char *eq = strchr(item, '=');
+        if (eq == NULL) return -1;
+        *eq = '\0';
+        const char *value = eq + 1;
+        if (strcmp(item, "loss") == 0) {
+            if (parse_percent(value, &d->loss_ppm) != 0) return -1;
+        } else if (strcmp(item, "ge") == 0) {
+            if (parse_ge(value, d) != 0) return -1;
+        } else if (strcmp(item, "dup") == 0) {
+            if (parse_percent(value, &d->dup_ppm) != 0) return -1;
+        } else if (strcmp(item, "corrupt") == 0) {
+            if (parse_percent(value, &d->corrupt_ppm) != 0) return -1;
+        } else if (strcmp(item, "delay") == 0) {
+            d->delay_ms = (uint32_t)strtoul(value, NULL, 0);
+        } else if (strcmp(item, "jitter") == 0) {
+            d->jitter_ms = (uint32_t)strtoul(value, NULL, 0);
+        } else if (strcmp(item, "pattern") == 0) {
+            if (strlen(value) > FAULT_INJECT_PATTERN || strspn(value, ".XDC") != strlen(value)) return -1;
+            strcpy(d->pattern, value);
+            d->pattern_pos = 0;
+        } else if (strcmp(item, "seed") == 0) {
+            rng_state = (uint32_t)strtoul(value, NULL, 0) | 1;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static bool dir_active(const fault_dir_t *d) {
+    return d->loss_ppm || d->ge || d->dup_ppm || d->corrupt_ppm || d->delay_ms || d->jitter_ms ||
+           d->pattern[0] != '\0';
+}
+
+static void print_dir(const char *name, const fault_dir_t *d) {
+    printf("[FAULT] %-3s loss=%.2f%% dup=%.2f%% corrupt=%.2f%% delay=%lu+%lums", name,
+           d->loss_ppm / 10000.0, d->dup_ppm / 10000.0, d->corrupt_ppm / 10000.0,
+           (unsigned long)d->delay_ms, (unsigned long)d->jitter_ms);
+    if (d->ge) {
+        printf(" ge=%.2f:%.2f:%.2f:%.2f", d->ge_p_ppm / 10000.0, d->ge_r_ppm / 10000.0,
+               d->ge_good_ppm / 10000.0, d->ge_bad_ppm / 10000.0);
+    }
+    if (d->pattern[0] != '\0') {
+        printf(" pattern=%s", d->pattern);
+    }
+    printf("\n");
+}
+
+int fault_inject_configure(const char *spec) {
+    char buf[SPEC_MAX];
+    char *save;
+    fault_dir_t out = dir_out;
+    fault_dir_t in = dir_in;
+
+    snprintf(buf, sizeof(buf), "%s", spec);
+    buf[strcspn(buf, "\r\n")] = '\0';
+    for (char *part = strtok_r(buf, ";", &save); part != NULL; part = strtok_r(NULL, ";", &save)) {
+        while (*part == ' ') part++;
+        bool to_out = true, to_in = true;
+        if (strncmp(part, "out:", 4) == 0) {
+            to_in = false;
+            part += 4;
+        } else if (strncmp(part, "in:", 3) == 0) {
+            to_out = false;
+            part += 3;
+        }
+        if ((to_out && parse_dir(part, &out) != 0) || (to_in && parse_dir(part, &in) != 0)) {
+            printf("[FAULT] ✗ Bad spec '%s'\n", spec);
+            return -1;
+        }
+    }
+
+    metric.dropped = metrics_counter("fault_dropped");
+    metric.duplicated = metrics_counter("fault_duplicated");
+    metric.corrupted = metrics_counter("fault_corrupted");
+    metric.delayed = metrics_counter("fault_delayed");
+
+    dir_out = out;
+    dir_in = in;
+    active = dir_active(&dir_out) || dir_active(&dir_in);
+    print_dir("out", &dir_out);
+    print_dir("in", &dir_in);
+    return 0;
+}
+
+void fault_inject_console(void) {
+    char line[SPEC_MAX];
+    size_t n = 0;
+    printf("[FAULT] Spec (Enter to apply): ");
+    for (;;) {
+        int c = getchar_timeout_us(CONSOLE_TIMEOUT_US);
+        if (c == PICO_ERROR_TIMEOUT) {
+            printf("\n[FAULT] No spec entered\n");
+            return;
+        }
+        if (c == '\r' || c == '\n') {
+            break;
+        }
+        if ((c == '\b' || c == 0x7F) && n > 0) {
+            n--;
+            printf("\b \b");
+        } else if (c >= ' ' && n < sizeof(line) - 1) {
+            line[n++] = (char)c;
+            putchar(c);
+        }
+    }
+    line[n] = '\0';
+    printf("\n");
+    if (n > 0) {
+        fault_inject_configure(line);
+    }
+}
+
+void fault_inject_set_control_topic(uint16_t topicid) {
+    control_topicid = topicid;
+}
+
+void fault_inject_control(const uint8_t *payload, size_t len) {
+    char spec[SPEC_MAX];
+    if (len > sizeof(spec) - 1) len = sizeof(spec) - 1;
+    memcpy(spec, payload, len);
+    spec[len] = '\0';
+    printf("[FAULT] Control message: %s\n", spec);
+    fault_inject_configure(spec);
+}
+
+// A PUBLISH on the control topic, passed up without faults
+static bool is_control(const uint8_t *buf, int len) {
+    mqttsn_publish_t pub;
+    return control_topicid != 0 && mqttsn_parse_publish(buf, len, &pub) == 0 && pub.topicid == control_topicid;
+}
+
+// Transport calls
+
+int fault_inject_send(const mqttsn_transport_ops_t *ops, const char *dest_ip, uint16_t dest_port,
+                      const uint8_t *data, size_t len) {
+    if (held_count > 0) {
+        send_due(ops);
+    }
+    if (!active) {
+        return ops->send(dest_ip, dest_port, data, len);
+    }
+
+    fault_t f = decide(&dir_out);
+    if (f == FAULT_DROP) {
+        metrics_inc(metric.dropped);
+        return WIFI_OK;     // Lost on the way: the sender cannot tell
+    }
+    if (f == FAULT_CORRUPT && len > 0 && len <= sizeof(scratch)) {
+        memcpy(scratch, data, len);
+        flip_bit(scratch, len);
+        data = scratch;
+    }
+    int copies = 1;
+    if (f == FAULT_DUP) {
+        metrics_inc(metric.duplicated);
+        copies = 2;
+    }
+    int rc = WIFI_OK;
+    for (int i = 0; i < copies; i++) {
+        uint64_t delay = delay_us(&dir_out);
+        if (delay > 0 && hold(true, time_us_64() + delay, dest_ip, dest_port, data, len)) {
+            metrics_inc(metric.delayed);
+            continue;
+        }
+        rc = ops->send(dest_ip, dest_port, data, len);
+    }
+    return rc;
+}
+
+int fault_inject_receive(const mqttsn_transport_ops_t *ops, uint8_t *buffer, size_t max_len,
+                         uint32_t timeout_ms) {
+    uint64_t deadline = time_us_64() + (uint64_t)timeout_ms * 1000u;
+    for (;;) {
+        if (held_count > 0) {
+            send_due(ops);
+            int n = take_due(buffer, max_len);
+            if (n > 0) {
+                return n;
+            }
+        }
+
+        // Wait no longer than the deadline or the next held packet
+        uint64_t now = time_us_64();
+        uint64_t until = deadline;
+        uint64_t next = next_due_us();
+        if (next < until) until = next;
+        uint32_t wait_ms = until > now ? (uint32_t)((until - now + 999) / 1000) : 0;
+
+        int n = ops->receive(buffer, max_len, wait_ms);
+        if (n > 0) {
+            if (!active || is_control(buffer, n)) {
+                return n;
+            }
+            fault_t f = decide(&dir_in);
+            if (f == FAULT_DROP) {
+                metrics_inc(metric.dropped);
+                continue;
+            }
+            if (f == FAULT_CORRUPT) {
+                flip_bit(buffer, (size_t)n);
+            }
+            if (f == FAULT_DUP && hold(false, time_us_64() + delay_us(&dir_in), NULL, 0, buffer, (size_t)n)) {
+                metrics_inc(metric.duplicated);
+            }
+            uint64_t delay = delay_us(&dir_in);
+            if (delay > 0 && hold(false, time_us_64() + delay, NULL, 0, buffer, (size_t)n)) {
+                metrics_inc(metric.delayed);
+                continue;
+            }
+            return n;
+        }
+        if (n < 0 && n != WIFI_ETIMEDOUT) {
+            return n;
+        }
+        if (time_us_64() >= deadline) {
+            return timeout_ms == 0 ? 0 : WIFI_ETIMEDOUT;
+        }
+    }
+}
+
+#endif // FAULT_INJECT_ENABLED
@@ -0,0 +1,71 @@
+// fault_inject.h - Packet faults inside the MQTT-SN transport
+//
+// Built with FAULT_INJECT_ENABLED=1 (cmake -DFAULT_INJECT=ON; off by
+// default), mqttsn_transport_send() and mqttsn_transport_receive() pass
+// every datagram through this layer, which can drop, delay, duplicate or
+// corrupt it, on the device itself, whatever the backend. The same code
+// runs in the firmware and in the host build, so a loss pattern measured
+// in the field can be replayed against retransmission and FEC on both.
+//
+// Faults are set per direction with a spec, "out:" for what the device
+// sends, "in:" for what it receives, neither for both, directions
+// separated by ';':
+//
+//   loss=P          Independent loss, percent
+//   ge=P:R[:K:H]    Gilbert-Elliott burst loss: P% chance per packet of
+//                   going from the good state to the bad one, R% of coming
+//                   back, loss K% in good (default 0) and H% in bad (100)
+//   dup=P           Send or receive a second copy, percent
+//   corrupt=P       Flip one random bit, percent
+//   delay=MS        Hold each packet this long...
+//   jitter=MS       ...plus up to this much more
+//   pattern=..X.D   Repeating per-packet script, before the random faults:
+//                   '.' pass, 'X' drop, 'D' duplicate, 'C' corrupt
+//   seed=N          Restart the fault PRNG (the same seed, the same faults)
+//   off             Clear the direction
+//
+// e.g. "in:ge=2:25;out:loss=1,delay=40,jitter=10". The spec can come
+//   - from the console: 'f', then the spec and Enter (picow_*_host: -F spec)
+//   - as the payload of a PUBLISH on FAULT_INJECT_TOPIC, which both Picos
+//     subscribe to and hand to fault_inject_control(); such packets are
+//     never faulted, so "off" always gets through
+// Counters go out with the metrics (fault_dropped, fault_duplicated,
+// fault_corrupted, fault_delayed).
+
+#ifndef FAULT_INJECT_H
+#define FAULT_INJECT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "mqttsn_adapter.h"
+
+#ifndef FAULT_INJECT_ENABLED
+#define FAULT_INJECT_ENABLED    0
+#endif
+
+#define FAULT_INJECT_TOPIC      "pico/fault"
+#define FAULT_INJECT_HELD       8       // Delayed or duplicate packets in hand
+#define FAULT_INJECT_PATTERN    32      // Longest pattern
+#define FAULT_INJECT_MTU        512
+
+#if FAULT_INJECT_ENABLED
+// Apply a spec (above); 0 on success, -1 if it does not parse (nothing changes)
+int fault_inject_configure(const char *spec);
+
+// Read a spec line from the console (after the 'f' key) and apply it
+void fault_inject_console(void);
+
+// Topic id of the control topic, once subscribed (0: none); its packets pass unfaulted
+void fault_inject_set_control_topic(uint16_t topicid);
+
+// Apply the payload of a PUBLISH on the control topic
+void fault_inject_control(const uint8_t *payload, size_t len);
+
+// The transport calls, through ops, with faults applied
+int fault_inject_send(const mqttsn_transport_ops_t *ops, const char *dest_ip, uint16_t dest_port,
+                      const uint8_t *data, size_t len);
+int fault_inject_receive(const mqttsn_transport_ops_t *ops, uint8_t *buffer, size_t max_len,
+                         uint32_t timeout_ms);
+#endif
+
+#endif // FAULT_INJECT_H
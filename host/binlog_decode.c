@@ -0,0 +1,130 @@
+// binlog_decode.c - Turn a binary-mode log capture back into text
+//
+// Reads a console capture (stdin or a file): #BLF lines define format
+// strings, #BL lines are records, formatted with binlog.c's own
+// formatter. Everything else (printf output) passes through unchanged.
+//
+// Usage: binlog_decode [-t] [capture.txt]
+//   -t  prefix records with their timestamp in seconds
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "binlog.h"
+
+// binlog.c's pacing wait is linked in but never called here
+uint64_t time_us_64(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000u;
+}
+
+void sleep_us(uint64_t us) {
+    (void)us;
+}
+
+void sleep_ms(uint32_t ms) {
+    (void)ms;
+}
+
+static char *formats[0x10000];
+
+// #BLF <id> <level> <format>
+static void define_format(const char *line) {
+    unsigned id, level;
+    int pos = 0;
+    if (sscanf(line, BINLOG_FORMAT_TAG " %u %u %n", &id, &level, &pos) != 2 || pos == 0 || id > 0xFFFF) {
+        return;
+    }
+    const char *src = line + pos;
+    char *fmt = malloc(strlen(src) + 1);
+    if (fmt == NULL) {
+        return;
+    }
+    char *dst = fmt;
+    for (; *src && *src != '\n' && *src != '\r'; src++) {
+        if (*src == '\\' && src[1] == 'n') {
+            *dst++ = '\n';
+            src++;
+        } else if (*src == '\\' && src[1] == '\\') {
+            *dst++ = '\\';
+            src++;
+        } else {
+            *dst++ = *src;
+        }
+    }
+    *dst = '\0';
+    free(formats[id]);
+    formats[id] = fmt;
+}
+
+// #BL <header> <timestamp> <args...>. Returns false if the line is not a record.
+static bool print_record(const char *line, bool timestamps) {
+    const char *p = line + strlen(BINLOG_RECORD_TAG);
+    uint32_t words[2 + BINLOG_MAX_ARGS];
+    int count = 0;
+    while (count < 2 + BINLOG_MAX_ARGS) {
+        char *end;
+        unsigned long w = strtoul(p, &end, 16);
+        if (end == p) {
+            break;
+        }
+        words[count++] = (uint32_t)w;
+        p = end;
+    }
+    uint8_t nargs = BINLOG_HDR_NARGS(words[0]);
+    if (count < 2 || count != 2 + nargs) {
+        return false;
+    }
+
+    uint16_t id = BINLOG_HDR_ID(words[0]);
+    if (timestamps) {
+        printf("[%10.6f] ", words[1] / 1e6);
+    }
+    if (formats[id] == NULL) {
+        printf("<format %u not in the capture>\n", id);
+        return true;
+    }
+    char text[512];
+    binlog_format(text, sizeof(text), formats[id], words + 2, nargs);
+    fputs(text, stdout);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool timestamps = false;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0) {
+            timestamps = true;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    FILE *in = path ? fopen(path, "r") : stdin;
+    if (in == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return 1;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), in)) {
+        if (strncmp(line, BINLOG_FORMAT_TAG " ", strlen(BINLOG_FORMAT_TAG) + 1) == 0) {
+            define_format(line);
+        } else if (strncmp(line, BINLOG_RECORD_TAG " ", strlen(BINLOG_RECORD_TAG) + 1) == 0 &&
+                   print_record(line, timestamps)) {
+            continue;
+        } else {
+            fputs(line, stdout);
+        }
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+    return 0;
+}
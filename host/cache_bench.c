@@ -0,0 +1,198 @@
+// cache_bench.c - diskio sector cache on the repo's own FatFs access pattern
+//
+// Runs sd_card.c, diskio_sdcard.c (with its sector cache) and FatFs against
+// the emulated card from sd_emu.c, replaying what the firmware does:
+//
+//   mount+scan   sd_card_mount_fat32() (f_mount + f_getfree) and the
+//                publisher's scan_and_select_image()
+//   receive      the subscriber's end-of-block path, ten times: f_opendir /
+//                f_closedir of "received", then sd_card_save_block()
+//   stream read  the publisher's pipelined send: f_read of 960 bytes
+//                (8 chunks) at a time through a whole image
+//
+// Each run starts from the same freshly formatted card holding a dozen
+// files in the root and a few earlier blocks in received/. The cached run
+// is then remounted from a cold cache and every file it wrote is compared.
+// The card runs at 12.5MHz; times are the emulator's virtual clock.
+//
+// Usage: cache_bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sd_card.h"
+#include "sd_emu.h"
+#include "diskio_sdcard.h"
+#include "ff.h"
+
+#define CARD_SECTORS  (256u * 2048u)     // 256MB
+#define CARD_CLOCK    12500000
+#define BLOCK_SIZE    20000
+#define BLOCKS        10
+#define IMAGE_SIZE    60000
+#define READ_PIECE    960                // BLOCK_PIPELINE_READ_CHUNKS * 120
+
+typedef struct {
+    const char *name;
+    uint64_t us;
+    sd_emu_stats_t card;
+} phase_t;
+
+typedef struct {
+    phase_t phases[3];
+    disk_cache_stats_t cache;
+    bool ok;
+} run_t;
+
+static uint8_t data[IMAGE_SIZE];
+static uint8_t readback[IMAGE_SIZE];
+
+static void fill(uint8_t *buf, size_t len, uint32_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)((i + seed) * 2654435761u >> 24);
+    }
+}
+
+static int card_up(void) {
+    if (sd_card_init() != 0) return -1;
+    int mounted = sd_card_mount_fat32();
+    if (mounted == -2) mounted = sd_card_format_fat32();
+    return mounted;
+}
+
+// Root holds images and other files; received/ a few earlier blocks
+static int populate(void) {
+    char name[64];
+    for (int i = 0; i < 12; i++) {
+        snprintf(name, sizeof(name), i % 2 ? "photo_%02d.jpg" : "log_%02d.txt", i);
+        fill(data, IMAGE_SIZE, i);
+        if (sd_card_write_file(name, data, i % 2 ? IMAGE_SIZE : 3000) != 0) return -1;
+    }
+    if (f_mkdir("received") != FR_OK) return -1;
+    for (int i = 0; i < 6; i++) {
+        snprintf(name, sizeof(name), "received/block_%d_%d.jpg", 100 + i, 10 * i);
+        fill(data, BLOCK_SIZE, 100 + i);
+        if (sd_card_write_file(name, data, BLOCK_SIZE) != 0) return -1;
+    }
+    return 0;
+}
+
+static void phase_begin(void) {
+    sd_emu_reset_stats();
+}
+
+static void phase_end(phase_t *p, const char *name, uint64_t start) {
+    p->name = name;
+    p->us = sd_emu_now_us() - start;
+    sd_emu_get_stats(&p->card);
+}
+
+static bool verify_blocks(void) {
+    char name[64];
+    for (int i = 0; i < BLOCKS; i++) {
+        size_t got = 0;
+        snprintf(name, sizeof(name), "received/block_%d_%d.jpg", i + 1, 1000 + i);
+        fill(data, BLOCK_SIZE, i + 1);
+        if (sd_card_read_file(name, readback, sizeof(readback), &got) != 0 || got != BLOCK_SIZE ||
+            memcmp(readback, data, BLOCK_SIZE) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool run(bool cached, run_t *r) {
+    memset(r, 0, sizeof(*r));
+    if (sd_emu_init(CARD_SECTORS, NULL) != 0) return false;
+    sd_card_set_max_clock(CARD_CLOCK);
+    disk_cache_set_enabled(true);
+    if (card_up() != 0 || populate() != 0) return false;
+
+    // Cold start, as after boot
+    f_unmount("");
+    sd_card_deinit();
+    disk_cache_set_enabled(cached);
+    if (sd_card_init() != 0) return false;
+    disk_cache_reset_stats();
+
+    phase_begin();
+    uint64_t start = sd_emu_now_us();
+    if (sd_card_mount_fat32() != 0 || !scan_and_select_image()) return false;
+    phase_end(&r->phases[0], "mount+scan", start);
+
+    phase_begin();
+    start = sd_emu_now_us();
+    for (int i = 0; i < BLOCKS; i++) {
+        char name[64];
+        DIR dir;
+        if (f_opendir(&dir, "received") != FR_OK) return false;
+        f_closedir(&dir);
+        snprintf(name, sizeof(name), "received/block_%d_%d.jpg", i + 1, 1000 + i);
+        fill(data, BLOCK_SIZE, i + 1);
+        if (sd_card_save_block(name, data, BLOCK_SIZE) != 0) return false;
+    }
+    phase_end(&r->phases[1], "receive x10", start);
+
+    phase_begin();
+    start = sd_emu_now_us();
+    FIL file;
+    UINT n;
+    size_t total = 0;
+    if (f_open(&file, sd_card_get_first_image(), FA_READ) != FR_OK) return false;
+    do {
+        if (f_read(&file, readback + total, READ_PIECE, &n) != FR_OK) return false;
+        total += n;
+    } while (n == READ_PIECE);
+    f_close(&file);
+    phase_end(&r->phases[2], "stream read", start);
+    fill(data, IMAGE_SIZE, 1);      // photo_01.jpg is the first image
+    if (total != IMAGE_SIZE || memcmp(readback, data, IMAGE_SIZE) != 0) return false;
+
+    disk_cache_get_stats(&r->cache);
+
+    // Everything written must be on the card, not just in the cache
+    f_unmount("");
+    sd_card_deinit();
+    if (card_up() != 0) return false;
+    return verify_blocks();
+}
+
+int main(void) {
+    run_t runs[2];
+    for (int cached = 0; cached <= 1; cached++) {
+        runs[cached].ok = run(cached, &runs[cached]);
+    }
+
+    printf("\nSD at %.1fMHz, cache %d sectors, read-ahead %d\n\n", CARD_CLOCK / 1e6,
+           DISK_CACHE_SECTORS, DISK_READAHEAD);
+    printf("%-12s %-7s %9s %9s %10s %10s\n", "phase", "cache", "ms", "commands", "blocks rd",
+           "blocks wr");
+    for (int p = 0; p < 3; p++) {
+        for (int cached = 0; cached <= 1; cached++) {
+            const phase_t *ph = &runs[cached].phases[p];
+            printf("%-12s %-7s %9.1f %9u %10u %10u\n", cached ? "" : ph->name, cached ? "on" : "off",
+                   ph->us / 1000.0, ph->card.commands, ph->card.blocks_read, ph->card.blocks_written);
+        }
+        const phase_t *off = &runs[0].phases[p];
+        const phase_t *on = &runs[1].phases[p];
+        printf("%-12s %-7s %8.2fx\n", "", "", on->us ? (double)off->us / on->us : 0.0);
+    }
+
+    const disk_cache_stats_t *c = &runs[1].cache;
+    printf("\nCache: %u hits, %u misses (%.0f%% hit rate), read-ahead %u sectors (%u used),\n"
+           "       %u write hits, %u write-backs, %u/%u multi-sector reads/writes bypassed\n",
+           c->hits, c->misses, 100.0 * c->hits / (c->hits + c->misses ? c->hits + c->misses : 1),
+           c->readahead, c->readahead_hits, c->write_hits, c->writebacks, c->bypass_reads,
+           c->bypass_writes);
+
+    if (!runs[0].ok || !runs[1].ok) {
+        printf("\n❌ Run failed (uncached %s, cached %s)\n", runs[0].ok ? "ok" : "failed",
+               runs[1].ok ? "ok" : "failed");
+        return 1;
+    }
+    printf("\n✅ Both runs completed; every block read back intact after a cold remount\n");
+    return 0;
+}
@@ -0,0 +1,211 @@
+// delta_bench.c - Full re-send vs. LZ4 vs. delta for edited files
+//
+// A base file (config/log style text) is edited in a few typical ways and
+// each new version is sent to a subscriber that already holds the base.
+// The subscriber's signatures go through the real signature messages, the
+// publisher runs block_delta.c against them, and the delta is applied back
+// and compared with the new version. Chunk counts use the publisher's 120
+// data bytes per chunk; time uses its 50 ms chunk pacing, plus the
+// signature messages for the delta column.
+//
+// Usage: delta_bench [base_bytes]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "block_delta.h"
+#include "block_lz.h"
+
+#define CHUNK_DATA_SIZE   120
+#define CHUNK_PACING_MS   50
+#define MAX_FILE          150000
+
+typedef void (*edit_fn_t)(const uint8_t *base, size_t base_len, uint8_t *out, size_t *out_len);
+
+static uint8_t base[MAX_FILE];
+static uint8_t target[MAX_FILE];
+static uint8_t delta[MAX_FILE + MAX_FILE / 100 + 64];
+static uint8_t rebuilt[MAX_FILE];
+static size_t delta_len;
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng_next(void) {
+    uint32_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng_state = x;
+    return x;
+}
+
+// Sensor-log style lines: compressible but not trivially repetitive
+static size_t make_log(uint8_t *out, size_t len, uint32_t seed) {
+    size_t pos = 0;
+    rng_state = seed;
+    for (unsigned line = 0; pos < len; line++) {
+        char text[96];
+        int n = snprintf(text, sizeof(text), "%06u,temp=%u.%u,hum=%u,rssi=-%u,state=%s\n",
+                         line, 18 + rng_next() % 10, rng_next() % 10, 30 + rng_next() % 40,
+                         40 + rng_next() % 50, (rng_next() & 3) ? "ok" : "retry");
+        if (pos + n > len) n = len - pos;
+        memcpy(out + pos, text, n);
+        pos += n;
+    }
+    return pos;
+}
+
+static void edit_none(const uint8_t *b, size_t n, uint8_t *out, size_t *out_len) {
+    memcpy(out, b, n);
+    *out_len = n;
+}
+
+static void edit_scattered(const uint8_t *b, size_t n, uint8_t *out, size_t *out_len) {
+    memcpy(out, b, n);
+    for (int i = 0; i < 10; i++) {
+        out[rng_next() % n] ^= 0x20;
+    }
+    *out_len = n;
+}
+
+static void edit_insert(const uint8_t *b, size_t n, uint8_t *out, size_t *out_len) {
+    size_t at = n / 2;
+    size_t extra = make_log(out + at, 1000, 777);
+    memcpy(out, b, at);
+    memcpy(out + at + extra, b + at, n - at);
+    *out_len = n + extra;
+}
+
+static void edit_delete(const uint8_t *b, size_t n, uint8_t *out, size_t *out_len) {
+    size_t at = n / 3;
+    size_t cut = 2000;
+    memcpy(out, b, at);
+    memcpy(out + at, b + at + cut, n - at - cut);
+    *out_len = n - cut;
+}
+
+static void edit_append(const uint8_t *b, size_t n, uint8_t *out, size_t *out_len) {
+    memcpy(out, b, n);
+    *out_len = n + make_log(out + n, 4000, 999);
+}
+
+static void edit_rewrite_lines(const uint8_t *b, size_t n, uint8_t *out, size_t *out_len) {
+    // Change one value on roughly every fifth line
+    memcpy(out, b, n);
+    rng_state = 4242;
+    for (size_t i = 0; i < n; i++) {
+        if (out[i] == '\n' && i + 8 < n && rng_next() % 5 == 0) {
+            out[i + 8] = '0' + rng_next() % 10;
+        }
+    }
+    *out_len = n;
+}
+
+static void edit_unrelated(const uint8_t *b, size_t n, uint8_t *out, size_t *out_len) {
+    (void)b;
+    *out_len = make_log(out, n, 31337);
+}
+
+static const struct {
+    const char *name;
+    edit_fn_t fn;
+} edits[] = {
+    { "unchanged",      edit_none },
+    { "10 byte edits",  edit_scattered },
+    { "1KB inserted",   edit_insert },
+    { "2KB deleted",    edit_delete },
+    { "4KB appended",   edit_append },
+    { "20% lines",      edit_rewrite_lines },
+    { "unrelated",      edit_unrelated },
+};
+
+static int delta_sink(void *ctx, const uint8_t *data, size_t len) {
+    (void)ctx;
+    if (delta_len + len > sizeof(delta)) return -1;
+    memcpy(delta + delta_len, data, len);
+    delta_len += len;
+    return 0;
+}
+
+// Subscriber -> publisher: feed every signature message of the basis
+static int send_signatures(const uint8_t *basis, size_t len, uint16_t block_size,
+                           size_t *bytes) {
+    uint8_t msg[BLOCK_DELTA_SIG_HEADER + BLOCK_DELTA_SIGS_PER_MSG * BLOCK_DELTA_SIG_SIZE];
+    int messages = 0;
+    *bytes = 0;
+    block_delta_reset();
+    for (uint16_t first = 0;; first += BLOCK_DELTA_SIGS_PER_MSG) {
+        size_t n = block_delta_signature_msg(basis, len, block_size, first, msg, sizeof(msg));
+        if (n == 0) break;
+        if (block_delta_add_signatures(msg, n) < 0) return -1;
+        messages++;
+        *bytes += n;
+    }
+    return messages;
+}
+
+static unsigned long chunks(size_t bytes) {
+    return (bytes + CHUNK_DATA_SIZE - 1) / CHUNK_DATA_SIZE;
+}
+
+int main(int argc, char **argv) {
+    size_t base_len = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+    if (base_len < 10000 || base_len > MAX_FILE - 5000) {
+        fprintf(stderr, "Usage: %s [base_bytes 10000..%d]\n", argv[0], MAX_FILE - 5000);
+        return 1;
+    }
+
+    make_log(base, base_len, 1);
+    uint16_t block_size = block_delta_block_size(base_len);
+    size_t sig_bytes = 0;
+    int sig_messages = send_signatures(base, base_len, block_size, &sig_bytes);
+    if (sig_messages < 0 || !block_delta_ready(NULL, NULL)) {
+        fprintf(stderr, "Signature set rejected\n");
+        return 1;
+    }
+
+    printf("Base: %zu bytes, block size %u, signatures: %d messages (%zu bytes)\n\n",
+           base_len, block_size, sig_messages, sig_bytes);
+    printf("%-14s %8s %8s %8s %8s %8s %8s %9s\n", "edit", "bytes", "full", "lz4",
+           "delta B", "delta", "saving", "time s");
+
+    int failures = 0;
+    for (size_t e = 0; e < sizeof(edits) / sizeof(edits[0]); e++) {
+        size_t target_len;
+        rng_state = 2024 + e;
+        edits[e].fn(base, base_len, target, &target_len);
+
+        long lz_len = block_lz_compress(target, target_len, NULL, NULL, NULL);
+        delta_len = 0;
+        if (block_delta_encode(target, target_len, delta_sink, NULL) < 0) {
+            printf("%-14s encode failed\n", edits[e].name);
+            failures++;
+            continue;
+        }
+
+        long out_len = block_delta_apply(base, base_len, block_size, delta, delta_len,
+                                         rebuilt, sizeof(rebuilt));
+        if (out_len != (long)target_len || memcmp(rebuilt, target, target_len) != 0) {
+            failures++;
+        }
+
+        unsigned long full = chunks(target_len);
+        unsigned long delta_chunks = chunks(delta_len);
+        double full_s = full * CHUNK_PACING_MS / 1000.0;
+        double delta_s = (delta_chunks + sig_messages) * CHUNK_PACING_MS / 1000.0;
+        printf("%-14s %8zu %8lu %8lu %8zu %8lu %7.1f%% %4.1f/%4.1f\n", edits[e].name,
+               target_len, full, chunks(lz_len), delta_len, delta_chunks,
+               100.0 - 100.0 * delta_chunks / full, full_s, delta_s);
+    }
+
+    printf("\n(full/lz4/delta in chunks; time is full vs. delta incl. signatures)\n");
+    if (failures) {
+        printf("❌ %d deltas did not rebuild the target\n", failures);
+        return 1;
+    }
+    printf("✅ All deltas rebuilt the target\n");
+    return 0;
+}
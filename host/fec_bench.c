@@ -0,0 +1,266 @@
+// fec_bench.c - Goodput of QoS 0 block transfers with and without FEC
+//
+// Simulates the publisher/subscriber exchange of block_transfer.c over a
+// lossy link: the data chunks (plus parity when FEC is on) are streamed
+// once and the subscriber rebuilds what it can with block_fec.c. That is
+// what a QoS 0 block gets from the firmware: the publisher re-reads
+// missing chunks only for the last file of a pipelined run, the one it
+// still has open, so in general a block with a gap FEC cannot fill is
+// lost. Goodput counts only the blocks that arrive complete.
+//
+// -r assumes a publisher that answers every BLOCK_STATUS_MISSING (up to
+// 50 missing chunks per round, repeated until the block is complete),
+// which the firmware does not do; it shows what FEC saves in repair
+// rounds when repair is available.
+//
+// Wire sizes match the v2 chunk format (header + data + trailer).
+// Transfer time uses the publisher's 50 ms chunk pacing, plus one status
+// round trip per NACK round with -r.
+//
+// Usage: fec_bench [-r] [block_bytes] [trials]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "block_fec.h"
+
+#define CHUNK_DATA_SIZE   120    // BLOCK_CHUNK_DATA_SIZE
+#define HEADER_SIZE       8      // block_header_t
+#define TRAILER_SIZE      6      // version + flags + crc32c
+#define DIGEST_SIZE       4
+#define FEC_FIELDS_SIZE   2
+#define NACK_MAX          50     // Missing chunks per BLOCK_STATUS_MISSING
+#define STATUS_OVERHEAD   7      // block_id + status + count + terminator
+#define MAX_CHUNKS        3000
+#define SYMBOL_SIZE       BLOCK_FEC_SYMBOL_SIZE(CHUNK_DATA_SIZE)
+#define CHUNK_PACING_MS   50     // sleep_ms() between chunks in the publisher
+#define ROUND_TRIP_MS     250    // NACK to first retransmitted chunk
+
+typedef struct {
+    const char *name;
+    uint8_t k;
+    uint8_t m;
+} fec_config_t;
+
+typedef struct {
+    unsigned long packets;
+    unsigned long bytes;
+    unsigned long rounds;
+    unsigned long rebuilt;
+    uint16_t delivered;         // Chunks the subscriber holds at the end
+    bool complete;
+    bool ok;                    // Everything delivered matches the source
+} transfer_result_t;
+
+static const fec_config_t configs[] = {
+    { "none",  0, 0 },
+    { "K8M1",  8, 1 },
+    { "K8M2",  8, 2 },
+    { "K16M4", 16, 4 },
+};
+
+static const double loss_rates[] = { 0.0, 0.01, 0.02, 0.05, 0.10, 0.20 };
+
+static uint8_t source[MAX_CHUNKS * CHUNK_DATA_SIZE];
+static uint8_t received[MAX_CHUNKS * CHUNK_DATA_SIZE];
+static bool received_mask[MAX_CHUNKS];
+
+// xorshift32 - deterministic across platforms
+static uint32_t rng_state = 1;
+
+static uint32_t rng_next(void) {
+    uint32_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng_state = x;
+    return x;
+}
+
+static bool link_drops(double loss) {
+    return (rng_next() / 4294967296.0) < loss;
+}
+
+static uint16_t chunk_len(uint16_t index, size_t block_len) {
+    size_t offset = (size_t)index * CHUNK_DATA_SIZE;
+    return (block_len - offset) < CHUNK_DATA_SIZE ? (uint16_t)(block_len - offset) : CHUNK_DATA_SIZE;
+}
+
+static unsigned long data_packet_size(uint16_t index, uint16_t total, size_t block_len, bool fec) {
+    unsigned long size = HEADER_SIZE + chunk_len(index, block_len) + TRAILER_SIZE;
+    if (index == total - 1) size += DIGEST_SIZE;
+    if (fec) size += FEC_FIELDS_SIZE;
+    return size;
+}
+
+// Stream one block (and with repair, NACK until it is complete) and return the cost
+static transfer_result_t run_transfer(const fec_config_t *cfg, size_t block_len, double loss, bool repair) {
+    transfer_result_t r = {0};
+    uint16_t total = (block_len + CHUNK_DATA_SIZE - 1) / CHUNK_DATA_SIZE;
+    bool fec = cfg->m > 0;
+    uint16_t received_count = 0;
+
+    memset(received, 0, sizeof(received));
+    memset(received_mask, 0, sizeof(received_mask));
+
+    // Initial stream: data chunks with parity after every group
+    uint16_t groups = fec ? (total + cfg->k - 1) / cfg->k : 0;
+    for (uint16_t g = 0; g < (fec ? groups : 1); g++) {
+        uint16_t first = fec ? g * cfg->k : 0;
+        uint16_t group_k = fec ? cfg->k : total;
+        if (first + group_k > total) group_k = total - first;
+
+        uint8_t parity_buf[BLOCK_FEC_MAX_M][SYMBOL_SIZE];
+        uint8_t *parity[BLOCK_FEC_MAX_M];
+        bool parity_present[BLOCK_FEC_MAX_M] = {0};
+        memset(parity_buf, 0, sizeof(parity_buf));
+        for (int j = 0; j < BLOCK_FEC_MAX_M; j++) parity[j] = parity_buf[j];
+
+        for (uint16_t i = 0; i < group_k; i++) {
+            uint16_t index = first + i;
+            const uint8_t *chunk = source + (size_t)index * CHUNK_DATA_SIZE;
+            r.packets++;
+            r.bytes += data_packet_size(index, total, block_len, fec);
+            if (fec) {
+                block_fec_encode_chunk(cfg->m, i, chunk, chunk_len(index, block_len),
+                                       parity, CHUNK_DATA_SIZE);
+            }
+            if (!link_drops(loss)) {
+                memcpy(received + (size_t)index * CHUNK_DATA_SIZE, chunk, chunk_len(index, block_len));
+                received_mask[index] = true;
+                received_count++;
+            }
+        }
+
+        if (!fec) break;
+
+        for (uint8_t j = 0; j < cfg->m; j++) {
+            r.packets++;
+            r.bytes += HEADER_SIZE + SYMBOL_SIZE + TRAILER_SIZE + FEC_FIELDS_SIZE;
+            parity_present[j] = !link_drops(loss);
+        }
+
+        uint8_t *chunks[BLOCK_FEC_MAX_K];
+        uint16_t lens[BLOCK_FEC_MAX_K];
+        bool present[BLOCK_FEC_MAX_K];
+        for (uint16_t i = 0; i < group_k; i++) {
+            uint16_t index = first + i;
+            chunks[i] = received + (size_t)index * CHUNK_DATA_SIZE;
+            present[i] = received_mask[index];
+            lens[i] = present[i] ? chunk_len(index, block_len) : 0;
+        }
+        int rebuilt = block_fec_decode(group_k, cfg->m, chunks, lens, present,
+                                       parity, parity_present, CHUNK_DATA_SIZE);
+        if (rebuilt > 0) {
+            for (uint16_t i = 0; i < group_k; i++) {
+                if (!present[i]) {
+                    received_mask[first + i] = true;
+                    received_count++;
+                }
+            }
+            r.rebuilt += rebuilt;
+        }
+    }
+    r.rounds = 1;
+
+    // NACK rounds: the status message and the retransmissions can both be lost
+    while (repair && received_count < total) {
+        uint16_t missing[NACK_MAX];
+        uint16_t missing_count = 0;
+        for (uint16_t i = 0; i < total && missing_count < NACK_MAX; i++) {
+            if (!received_mask[i]) missing[missing_count++] = i;
+        }
+
+        r.rounds++;
+        r.packets++;
+        r.bytes += STATUS_OVERHEAD + missing_count * 2;
+        if (link_drops(loss)) continue;
+
+        for (uint16_t n = 0; n < missing_count; n++) {
+            uint16_t index = missing[n];
+            r.packets++;
+            r.bytes += data_packet_size(index, total, block_len, false);
+            if (!link_drops(loss) && !received_mask[index]) {
+                memcpy(received + (size_t)index * CHUNK_DATA_SIZE,
+                       source + (size_t)index * CHUNK_DATA_SIZE, chunk_len(index, block_len));
+                received_mask[index] = true;
+                received_count++;
+            }
+        }
+    }
+
+    r.delivered = received_count;
+    r.complete = received_count == total;
+    r.ok = true;
+    for (uint16_t i = 0; i < total; i++) {
+        size_t offset = (size_t)i * CHUNK_DATA_SIZE;
+        if (received_mask[i] && memcmp(received + offset, source + offset, chunk_len(i, block_len)) != 0) {
+            r.ok = false;
+        }
+    }
+    return r;
+}
+
+int main(int argc, char **argv) {
+    bool repair = argc > 1 && strcmp(argv[1], "-r") == 0;
+    int first = repair ? 2 : 1;
+    size_t block_len = argc > first ? strtoul(argv[first], NULL, 0) : 60000;
+    int trials = argc > first + 1 ? atoi(argv[first + 1]) : 20;
+
+    if (block_len == 0 || block_len > sizeof(source) || trials < 1) {
+        fprintf(stderr, "Usage: %s [-r] [block_bytes <= %zu] [trials]\n", argv[0], sizeof(source));
+        return 1;
+    }
+
+    for (size_t i = 0; i < block_len; i++) {
+        source[i] = (uint8_t)rng_next();
+    }
+
+    printf("Block: %zu bytes (%zu chunks), %d trials per point, %s\n\n",
+           block_len, (block_len + CHUNK_DATA_SIZE - 1) / CHUNK_DATA_SIZE, trials,
+           repair ? "NACK repair rounds (-r, assumed publisher)" : "QoS 0 stream, no NACK repair (firmware)");
+    printf("%-6s %-6s %8s %11s %7s %8s %10s %9s %10s %8s %9s\n",
+           "loss", "fec", "packets", "wire bytes", "rounds", "rebuilt", "delivered",
+           "complete", "efficiency", "time s", "goodput");
+
+    int failures = 0;
+    for (size_t l = 0; l < sizeof(loss_rates) / sizeof(loss_rates[0]); l++) {
+        for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+            double packets = 0, bytes = 0, rounds = 0, rebuilt = 0, delivered = 0, complete = 0;
+            rng_state = 0x9E3779B9u + (uint32_t)l;  // Same loss pattern for every config
+
+            for (int t = 0; t < trials; t++) {
+                transfer_result_t r = run_transfer(&configs[c], block_len, loss_rates[l], repair);
+                if (!r.ok) failures++;
+                packets += r.packets;
+                bytes += r.bytes;
+                rounds += r.rounds;
+                rebuilt += r.rebuilt;
+                delivered += r.delivered;
+                complete += r.complete;
+            }
+
+            // Efficiency: fraction of wire bytes that were payload of complete
+            // blocks; goodput counts complete blocks only
+            double total_chunks = (double)((block_len + CHUNK_DATA_SIZE - 1) / CHUNK_DATA_SIZE) * trials;
+            double seconds = (packets * CHUNK_PACING_MS + (rounds - trials) * ROUND_TRIP_MS)
+                             / 1000.0 / trials;
+            printf("%5.0f%% %-6s %8.0f %11.0f %7.2f %8.1f %9.1f%% %8.0f%% %9.1f%% %8.1f %6.0f B/s\n",
+                   loss_rates[l] * 100, configs[c].name, packets / trials, bytes / trials,
+                   rounds / trials, rebuilt / trials, 100.0 * delivered / total_chunks,
+                   100.0 * complete / trials, 100.0 * block_len * complete / bytes,
+                   seconds, block_len * complete / trials / seconds);
+        }
+        printf("\n");
+    }
+
+    if (failures) {
+        printf("❌ %d transfers delivered corrupted data\n", failures);
+        return 1;
+    }
+    printf("✅ All transfers verified\n");
+    return 0;
+}
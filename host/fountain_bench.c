@@ -0,0 +1,217 @@
+// fountain_bench.c - NACK repair vs. fountain coding on a lossy multicast
+//
+// One publisher streams a block on "pico/chunks" to several subscribers,
+// each losing packets independently. Two schemes are compared:
+//
+//   nack      every chunk once, then each incomplete subscriber NACKs up to
+//             50 missing chunks per round and the publisher resends them
+//             (resends are seen by every subscriber, as on the real topic)
+//   fountain  systematic pass, then random combinations cycling through the
+//             generations until the last subscriber has decoded the block
+//
+// The fountain side runs the real block_fountain.c decoder for every
+// subscriber and checks the decoded bytes. Time uses the publisher's 50 ms
+// chunk pacing plus one status round trip per NACK round.
+//
+// Usage: fountain_bench [block_bytes] [trials]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "block_fountain.h"
+
+#define CHUNK_DATA_SIZE   120
+#define NACK_MAX          50
+#define MAX_SUBSCRIBERS   16
+#define MAX_CHUNKS        1000
+#define CHUNK_PACING_MS   50
+#define ROUND_TRIP_MS     250
+
+typedef struct {
+    double packets;         // Published chunk/symbol packets
+    double statuses;        // Status messages sent by subscribers
+    double seconds;
+    double received;        // Symbols received per subscriber until done
+} scheme_result_t;
+
+static const int subscriber_counts[] = { 1, 4, 16 };
+static const double loss_rates[] = { 0.01, 0.05, 0.10, 0.20 };
+
+static uint8_t source[MAX_CHUNKS * CHUNK_DATA_SIZE];
+static uint8_t workspace[MAX_SUBSCRIBERS][MAX_CHUNKS * (CHUNK_DATA_SIZE + 8)];
+static bool have[MAX_SUBSCRIBERS][MAX_CHUNKS];
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng_next(void) {
+    uint32_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng_state = x;
+    return x;
+}
+
+static bool link_drops(double loss) {
+    return (rng_next() / 4294967296.0) < loss;
+}
+
+static void run_nack(int subscribers, uint16_t total, double loss, scheme_result_t *r) {
+    uint16_t missing_count[MAX_SUBSCRIBERS];
+    unsigned long packets = 0, statuses = 0, rounds = 1;
+
+    for (int s = 0; s < subscribers; s++) {
+        memset(have[s], 0, total * sizeof(bool));
+        missing_count[s] = total;
+    }
+
+    for (uint16_t i = 0; i < total; i++) {
+        packets++;
+        for (int s = 0; s < subscribers; s++) {
+            if (!link_drops(loss)) {
+                have[s][i] = true;
+                missing_count[s]--;
+            }
+        }
+    }
+
+    for (;;) {
+        bool all_done = true;
+        for (int s = 0; s < subscribers; s++) {
+            if (missing_count[s] > 0) all_done = false;
+        }
+        if (all_done) break;
+        rounds++;
+
+        // Each status is handled on its own: the requested chunks go out
+        // on the shared topic, so other subscribers may pick them up too
+        for (int s = 0; s < subscribers; s++) {
+            if (missing_count[s] == 0) continue;
+            uint16_t list[NACK_MAX];
+            uint16_t n = 0;
+            for (uint16_t i = 0; i < total && n < NACK_MAX; i++) {
+                if (!have[s][i]) list[n++] = i;
+            }
+            statuses++;
+            if (link_drops(loss)) continue;
+
+            for (uint16_t k = 0; k < n; k++) {
+                packets++;
+                for (int t = 0; t < subscribers; t++) {
+                    if (!have[t][list[k]] && !link_drops(loss)) {
+                        have[t][list[k]] = true;
+                        missing_count[t]--;
+                    }
+                }
+            }
+        }
+    }
+
+    r->packets += packets;
+    r->statuses += statuses;
+    r->seconds += (packets * CHUNK_PACING_MS + (rounds - 1) * ROUND_TRIP_MS) / 1000.0;
+}
+
+// Returns false if any subscriber decoded the wrong bytes
+static bool run_fountain(int subscribers, uint16_t total, size_t block_len, double loss,
+                         scheme_result_t *r) {
+    block_fountain_decoder_t dec[MAX_SUBSCRIBERS];
+    unsigned long received[MAX_SUBSCRIBERS] = {0};
+    uint16_t generations = block_fountain_generations(total);
+    uint8_t symbol[CHUNK_DATA_SIZE];
+    int done = 0;
+    unsigned long seq = 0;
+    uint32_t coef_state = rng_next();
+
+    for (int s = 0; s < subscribers; s++) {
+        block_fountain_decoder_init(&dec[s], workspace[s], sizeof(workspace[s]), have[s],
+                                    total, CHUNK_DATA_SIZE);
+    }
+
+    while (done < subscribers) {
+        uint16_t gen;
+        uint64_t coef;
+        if (seq < total) {
+            gen = seq / BLOCK_FOUNTAIN_GEN_SIZE;
+            coef = (uint64_t)1 << (seq % BLOCK_FOUNTAIN_GEN_SIZE);
+        } else {
+            gen = (seq - total) % generations;
+            coef = block_fountain_random_coef(&coef_state, block_fountain_gen_size(total, gen));
+        }
+        seq++;
+        block_fountain_encode(source, block_len, gen, coef, symbol, CHUNK_DATA_SIZE);
+
+        for (int s = 0; s < subscribers; s++) {
+            if (block_fountain_decoder_done(&dec[s]) || link_drops(loss)) continue;
+            received[s]++;
+            block_fountain_decoder_add(&dec[s], gen, coef, symbol);
+            if (block_fountain_decoder_done(&dec[s])) done++;
+        }
+    }
+
+    bool ok = true;
+    double avg_received = 0;
+    for (int s = 0; s < subscribers; s++) {
+        if (memcmp(workspace[s], source, block_len) != 0) ok = false;
+        avg_received += received[s];
+    }
+
+    // One COMPLETE status per subscriber lets the publisher stop
+    r->packets += seq;
+    r->statuses += subscribers;
+    r->seconds += (seq * CHUNK_PACING_MS + ROUND_TRIP_MS) / 1000.0;
+    r->received += avg_received / subscribers;
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    size_t block_len = argc > 1 ? strtoul(argv[1], NULL, 0) : 60000;
+    int trials = argc > 2 ? atoi(argv[2]) : 10;
+
+    if (block_len == 0 || block_len > sizeof(source) || trials < 1) {
+        fprintf(stderr, "Usage: %s [block_bytes <= %zu] [trials]\n", argv[0], sizeof(source));
+        return 1;
+    }
+
+    uint16_t total = (block_len + CHUNK_DATA_SIZE - 1) / CHUNK_DATA_SIZE;
+    for (size_t i = 0; i < block_len; i++) {
+        source[i] = (uint8_t)rng_next();
+    }
+
+    printf("Block: %zu bytes (%d chunks, %d generations), %d trials per point\n\n",
+           block_len, total, block_fountain_generations(total), trials);
+    printf("%-5s %-5s %-9s %9s %9s %8s %14s\n",
+           "subs", "loss", "scheme", "packets", "statuses", "time s", "rx per sub/K");
+
+    int failures = 0;
+    for (size_t n = 0; n < sizeof(subscriber_counts) / sizeof(subscriber_counts[0]); n++) {
+        for (size_t l = 0; l < sizeof(loss_rates) / sizeof(loss_rates[0]); l++) {
+            int subs = subscriber_counts[n];
+            double loss = loss_rates[l];
+            scheme_result_t nack = {0}, fountain = {0};
+
+            rng_state = 0x9E3779B9u + (uint32_t)(n * 16 + l);
+            for (int t = 0; t < trials; t++) {
+                run_nack(subs, total, loss, &nack);
+                if (!run_fountain(subs, total, block_len, loss, &fountain)) failures++;
+            }
+
+            printf("%-5d %4.0f%% %-9s %9.0f %9.1f %8.1f %14s\n", subs, loss * 100, "nack",
+                   nack.packets / trials, nack.statuses / trials, nack.seconds / trials, "-");
+            printf("%-5d %4.0f%% %-9s %9.0f %9.1f %8.1f %14.3f\n", subs, loss * 100, "fountain",
+                   fountain.packets / trials, fountain.statuses / trials,
+                   fountain.seconds / trials, fountain.received / trials / total);
+        }
+        printf("\n");
+    }
+
+    if (failures) {
+        printf("❌ %d fountain transfers decoded incorrectly\n", failures);
+        return 1;
+    }
+    printf("✅ All fountain transfers verified\n");
+    return 0;
+}
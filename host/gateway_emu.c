@@ -0,0 +1,844 @@
+// gateway_emu.c - Local MQTT-SN gateway stand-in with network impairments
+//
+// Replaces the Paho gateway + mosquitto pair for local runs: one UDP port
+// on which clients CONNECT, REGISTER and SUBSCRIBE, and PUBLISHes are
+// forwarded to every subscriber of the topic at min(publish, granted) QoS.
+// QoS 1/2 follow the MQTT-SN handshakes both ways (PUBACK, PUBREC/PUBREL/
+// PUBCOMP); deliveries not acknowledged are sent again with DUP set every
+// retry interval, up to the retry count, like a gateway's Tretry/Nretry.
+// Topic ids are gateway-wide, so a subscriber sees the id the publisher
+// registered. Wildcard subscriptions, wills and sleeping clients are not
+// supported.
+//
+// Each direction - uplink (client to gateway) and downlink (gateway to
+// client) - passes through an impairment stage, applied in netem's order:
+//
+//   loss=%      drop the packet
+//   dup=%       send it twice
+//   rate=kbit/s serialize it (28 bytes of IP/UDP header included) behind
+//               the packets before it; queue=ms is the drop-tail limit
+//   delay=ms    fixed latency, plus jitter=ms uniform either way
+//   reorder=%   send it without the delay, ahead of delayed packets
+//
+// All of it is driven by a seeded PRNG (-s), so a run can be repeated.
+// SIGINT/SIGTERM print the counters (#GW lines) and exit.
+//
+// Usage: gateway_emu [-p port] [-s seed] [-r retry_ms] [-n retries]
+//                    [-u spec] [-d spec] [-b spec] [-i stats_s] [-v]
+//   e.g. gateway_emu -b loss=2,delay=20,jitter=5 -d rate=250
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MAX_PACKET      1024
+#define MAX_EVENTS      8192    // Packets in flight through the impairment stages
+#define MAX_CLIENTS     16
+#define MAX_TOPICS      64
+#define MAX_TOPIC_NAME  64
+#define MAX_SUBS        16      // Per client
+#define MAX_INFLIGHT    64      // Unacknowledged QoS 1/2 deliveries per client
+#define MAX_QOS2_IN     16      // QoS 2 publishes per client waiting for PUBREL
+#define UDP_IP_OVERHEAD 28
+
+// MQTT-SN message types
+#define MSG_SEARCHGW    0x01
+#define MSG_GWINFO      0x02
+#define MSG_CONNECT     0x04
+#define MSG_CONNACK     0x05
+#define MSG_REGISTER    0x0A
+#define MSG_REGACK      0x0B
+#define MSG_PUBLISH     0x0C
+#define MSG_PUBACK      0x0D
+#define MSG_PUBCOMP     0x0E
+#define MSG_PUBREC      0x0F
+#define MSG_PUBREL      0x10
+#define MSG_SUBSCRIBE   0x12
+#define MSG_SUBACK      0x13
+#define MSG_PINGREQ     0x16
+#define MSG_PINGRESP    0x17
+#define MSG_DISCONNECT  0x18
+
+#define FLAG_DUP        0x80
+#define FLAG_QOS(f)     (((f) >> 5) & 3)
+#define TOPIC_TYPE(f)   ((f) & 3)
+#define TOPIC_NORMAL    0
+#define TOPIC_PREDEF    1
+#define TOPIC_SHORT     2
+
+#define RC_ACCEPTED         0
+#define RC_INVALID_TOPIC    2
+#define RC_NOT_SUPPORTED    3
+
+typedef enum { UPLINK, DOWNLINK } direction_t;
+
+typedef struct {
+    double loss;            // Percentages
+    double dup;
+    double reorder;
+    unsigned delay_ms;
+    unsigned jitter_ms;
+    unsigned rate_kbps;     // 0 = unlimited
+    unsigned queue_ms;
+    uint64_t busy_until;    // Rate limiter: when the last queued packet is out
+} link_t;
+
+typedef struct {
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t lost;
+    uint64_t duplicated;
+    uint64_t reordered;
+    uint64_t queue_drops;
+    uint64_t delivered;
+} link_stats_t;
+
+// A packet between its arrival at a stage and its release
+typedef struct {
+    uint64_t due;
+    uint64_t seq;           // Ties keep arrival order
+    direction_t dir;
+    struct sockaddr_in addr;
+    uint16_t len;
+    uint8_t data[MAX_PACKET];
+} event_t;
+
+typedef struct {
+    bool used;
+    uint16_t msgid;
+    uint16_t topic;
+    uint8_t qos;
+    bool released;          // QoS 2: PUBREC seen, PUBREL sent, waiting for PUBCOMP
+    uint8_t tries;
+    uint64_t next_retry;
+    uint16_t len;
+    uint8_t packet[MAX_PACKET];
+} inflight_t;
+
+typedef struct {
+    bool used;
+    uint16_t msgid;
+    uint16_t topic;
+    uint8_t qos;
+    uint16_t payload_len;
+    uint8_t payload[MAX_PACKET];
+} qos2_in_t;
+
+typedef struct {
+    bool used;
+    struct sockaddr_in addr;
+    char client_id[24];
+    uint16_t subs[MAX_SUBS];
+    uint8_t sub_qos[MAX_SUBS];
+    int sub_count;
+    uint16_t next_msgid;
+    inflight_t inflight[MAX_INFLIGHT];
+    qos2_in_t qos2_in[MAX_QOS2_IN];
+} client_t;
+
+static int sock = -1;
+static link_t links[2];
+static link_stats_t link_stats[2];
+static event_t events[MAX_EVENTS];
+static event_t *heap[MAX_EVENTS];
+static event_t *free_events[MAX_EVENTS];
+static int heap_len;
+static int free_len;
+static uint64_t event_seq;
+
+static client_t clients[MAX_CLIENTS];
+static char topics[MAX_TOPICS][MAX_TOPIC_NAME];
+static int topic_count;
+
+static unsigned retry_ms = 2000;
+static unsigned max_tries = 4;          // First send + 3 retries
+static bool verbose;
+static volatile sig_atomic_t stop;
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static struct {
+    uint64_t publishes_in;
+    uint64_t forwarded;
+    uint64_t retries;
+    uint64_t expired;       // Deliveries given up after max_tries
+    uint64_t dropped;       // No room in a client's in-flight window
+} gw_stats;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+// xorshift64*
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+static bool chance(double percent) {
+    return percent > 0 && (double)(rng_next() >> 11) * (100.0 / 9007199254740992.0) < percent;
+}
+
+static const char *addr_text(const struct sockaddr_in *addr) {
+    static char text[32];
+    snprintf(text, sizeof(text), "%s:%u", inet_ntoa(addr->sin_addr), ntohs(addr->sin_port));
+    return text;
+}
+
+// Event heap, ordered by due time then arrival
+
+static bool event_before(const event_t *a, const event_t *b) {
+    return a->due < b->due || (a->due == b->due && a->seq < b->seq);
+}
+
+static void heap_push(event_t *e) {
+    int i = heap_len++;
+    while (i > 0 && event_before(e, heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = e;
+}
+
+static event_t *heap_pop(void) {
+    event_t *top = heap[0];
+    event_t *last = heap[--heap_len];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= heap_len) break;
+        if (child + 1 < heap_len && event_before(heap[child + 1], heap[child])) child++;
+        if (!event_before(heap[child], last)) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (heap_len > 0) heap[i] = last;
+    return top;
+}
+
+// Impairments
+
+static void schedule(direction_t dir, const struct sockaddr_in *addr, const uint8_t *data, size_t len, uint64_t due) {
+    if (free_len == 0) {
+        link_stats[dir].queue_drops++;
+        return;
+    }
+    event_t *e = free_events[--free_len];
+    e->due = due;
+    e->seq = event_seq++;
+    e->dir = dir;
+    e->addr = *addr;
+    e->len = (uint16_t)len;
+    memcpy(e->data, data, len);
+    heap_push(e);
+}
+
+static void impair(direction_t dir, const struct sockaddr_in *addr, const uint8_t *data, size_t len) {
+    link_t *link = &links[dir];
+    link_stats_t *st = &link_stats[dir];
+    st->packets++;
+    st->bytes += len;
+
+    if (chance(link->loss)) {
+        st->lost++;
+        return;
+    }
+    int copies = 1;
+    if (chance(link->dup)) {
+        st->duplicated++;
+        copies = 2;
+    }
+
+    for (int c = 0; c < copies; c++) {
+        uint64_t now = now_us();
+        uint64_t t = now;
+        if (link->rate_kbps > 0) {
+            uint64_t tx_us = (uint64_t)(len + UDP_IP_OVERHEAD) * 8000u / link->rate_kbps;
+            uint64_t start = link->busy_until > now ? link->busy_until : now;
+            if (start - now > (uint64_t)link->queue_ms * 1000u) {
+                st->queue_drops++;
+                continue;
+            }
+            t = start + tx_us;
+            link->busy_until = t;
+        }
+        if (chance(link->reorder)) {
+            st->reordered++;
+        } else {
+            int64_t delay = (int64_t)link->delay_ms * 1000;
+            if (link->jitter_ms > 0) {
+                delay += (int64_t)(rng_next() % (2u * link->jitter_ms * 1000u + 1)) - (int64_t)link->jitter_ms * 1000;
+            }
+            if (delay > 0) t += (uint64_t)delay;
+        }
+        schedule(dir, addr, data, len, t);
+    }
+}
+
+// Downlink: everything the gateway sends goes through here
+static void send_packet(const struct sockaddr_in *addr, const uint8_t *data, size_t len) {
+    impair(DOWNLINK, addr, data, len);
+}
+
+// MQTT-SN framing
+
+static size_t put_header(uint8_t *buf, size_t body_len, uint8_t type) {
+    size_t total = body_len + 2;
+    if (total <= 255) {
+        buf[0] = (uint8_t)total;
+        buf[1] = type;
+        return 2;
+    }
+    total += 2;
+    buf[0] = 0x01;
+    buf[1] = (uint8_t)(total >> 8);
+    buf[2] = (uint8_t)total;
+    buf[3] = type;
+    return 4;
+}
+
+static void send_message(const struct sockaddr_in *addr, uint8_t type, const uint8_t *body, size_t body_len) {
+    uint8_t buf[MAX_PACKET];
+    if (body_len + 4 > sizeof(buf)) return;
+    size_t n = put_header(buf, body_len, type);
+    memcpy(buf + n, body, body_len);
+    send_packet(addr, buf, n + body_len);
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static size_t build_publish(uint8_t *buf, uint8_t flags, uint16_t topic, uint16_t msgid,
+                            const uint8_t *payload, size_t payload_len) {
+    size_t n = put_header(buf, 5 + payload_len, MSG_PUBLISH);
+    buf[n++] = flags;
+    put16(buf + n, topic);
+    put16(buf + n + 2, msgid);
+    memcpy(buf + n + 4, payload, payload_len);
+    return n + 4 + payload_len;
+}
+
+// Clients and topics
+
+static client_t *find_client(const struct sockaddr_in *addr, bool create) {
+    client_t *free_slot = NULL;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        client_t *c = &clients[i];
+        if (c->used && c->addr.sin_addr.s_addr == addr->sin_addr.s_addr && c->addr.sin_port == addr->sin_port) {
+            return c;
+        }
+        if (!c->used && free_slot == NULL) free_slot = c;
+    }
+    if (!create || free_slot == NULL) return NULL;
+    memset(free_slot, 0, sizeof(*free_slot));
+    free_slot->used = true;
+    free_slot->addr = *addr;
+    free_slot->next_msgid = 1;
+    snprintf(free_slot->client_id, sizeof(free_slot->client_id), "?");
+    return free_slot;
+}
+
+// Topic id for a name, registered on first use; 0 if the table is full
+static uint16_t topic_id(const char *name, size_t len) {
+    if (len == 0 || len >= MAX_TOPIC_NAME) return 0;
+    for (int i = 0; i < topic_count; i++) {
+        if (strlen(topics[i]) == len && memcmp(topics[i], name, len) == 0) {
+            return (uint16_t)(i + 1);
+        }
+    }
+    if (topic_count == MAX_TOPICS) return 0;
+    memcpy(topics[topic_count], name, len);
+    topics[topic_count][len] = '\0';
+    return (uint16_t)++topic_count;
+}
+
+static const char *topic_name(uint16_t id) {
+    return id >= 1 && id <= topic_count ? topics[id - 1] : "?";
+}
+
+static void deliver(client_t *c, uint16_t topic, uint8_t qos, const uint8_t *payload, size_t payload_len) {
+    uint8_t buf[MAX_PACKET];
+    if (payload_len + 9 > sizeof(buf)) return;
+    if (qos == 0) {
+        size_t n = build_publish(buf, 0, topic, 0, payload, payload_len);
+        send_packet(&c->addr, buf, n);
+        gw_stats.forwarded++;
+        return;
+    }
+
+    inflight_t *slot = NULL;
+    for (int i = 0; i < MAX_INFLIGHT; i++) {
+        if (!c->inflight[i].used) {
+            slot = &c->inflight[i];
+            break;
+        }
+    }
+    if (slot == NULL) {
+        gw_stats.dropped++;
+        return;
+    }
+    uint16_t msgid = c->next_msgid++;
+    if (c->next_msgid == 0) c->next_msgid = 1;
+    slot->used = true;
+    slot->msgid = msgid;
+    slot->topic = topic;
+    slot->qos = qos;
+    slot->released = false;
+    slot->tries = 1;
+    slot->next_retry = now_us() + (uint64_t)retry_ms * 1000u;
+    slot->len = (uint16_t)build_publish(slot->packet, (uint8_t)(qos << 5), topic, msgid, payload, payload_len);
+    send_packet(&c->addr, slot->packet, slot->len);
+    gw_stats.forwarded++;
+}
+
+static void forward(uint16_t topic, uint8_t qos, const uint8_t *payload, size_t payload_len) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        client_t *c = &clients[i];
+        if (!c->used) continue;
+        for (int s = 0; s < c->sub_count; s++) {
+            if (c->subs[s] == topic) {
+                deliver(c, topic, qos < c->sub_qos[s] ? qos : c->sub_qos[s], payload, payload_len);
+                break;
+            }
+        }
+    }
+}
+
+static inflight_t *find_inflight(client_t *c, uint16_t msgid) {
+    for (int i = 0; i < MAX_INFLIGHT; i++) {
+        if (c->inflight[i].used && c->inflight[i].msgid == msgid) return &c->inflight[i];
+    }
+    return NULL;
+}
+
+static qos2_in_t *find_qos2_in(client_t *c, uint16_t msgid) {
+    for (int i = 0; i < MAX_QOS2_IN; i++) {
+        if (c->qos2_in[i].used && c->qos2_in[i].msgid == msgid) return &c->qos2_in[i];
+    }
+    return NULL;
+}
+
+// Protocol handling for one uplink packet that made it through
+
+static void handle_publish(client_t *c, const struct sockaddr_in *from, const uint8_t *b, size_t len) {
+    if (len < 5) return;
+    uint8_t flags = b[0];
+    uint16_t topic = get16(b + 1);
+    uint16_t msgid = get16(b + 3);
+    const uint8_t *payload = b + 5;
+    size_t payload_len = len - 5;
+    uint8_t qos = FLAG_QOS(flags);
+    gw_stats.publishes_in++;
+
+    if (TOPIC_TYPE(flags) == TOPIC_SHORT) {
+        topic = topic_id((const char *)b + 1, 2);
+    }
+    if (topic == 0 || topic > topic_count) {
+        uint8_t ack[5];
+        put16(ack, topic);
+        put16(ack + 2, msgid);
+        ack[4] = RC_INVALID_TOPIC;
+        if (qos == 1 || qos == 2) send_message(from, MSG_PUBACK, ack, sizeof(ack));
+        return;
+    }
+
+    if (qos == 3) {
+        qos = 0;    // QoS -1: no connection, no acknowledgement
+    }
+    if (qos == 0) {
+        forward(topic, 0, payload, payload_len);
+    } else if (qos == 1) {
+        uint8_t ack[5];
+        put16(ack, topic);
+        put16(ack + 2, msgid);
+        ack[4] = RC_ACCEPTED;
+        send_message(from, MSG_PUBACK, ack, sizeof(ack));
+        forward(topic, 1, payload, payload_len);
+    } else if (c != NULL) {
+        // QoS 2: hold it until PUBREL, once however often it is sent
+        uint8_t rec[2];
+        put16(rec, msgid);
+        if (find_qos2_in(c, msgid) == NULL) {
+            qos2_in_t *slot = NULL;
+            for (int i = 0; i < MAX_QOS2_IN && slot == NULL; i++) {
+                if (!c->qos2_in[i].used) slot = &c->qos2_in[i];
+            }
+            if (slot == NULL) {
+                gw_stats.dropped++;
+                return;     // No PUBREC: the client sends it again
+            }
+            slot->used = true;
+            slot->msgid = msgid;
+            slot->topic = topic;
+            slot->qos = 2;
+            slot->payload_len = (uint16_t)payload_len;
+            memcpy(slot->payload, payload, payload_len);
+        }
+        send_message(from, MSG_PUBREC, rec, sizeof(rec));
+    }
+}
+
+static void handle_packet(const struct sockaddr_in *from, const uint8_t *data, size_t len) {
+    if (len < 2) return;
+    size_t hdr = 2;
+    size_t total = data[0];
+    uint8_t type = data[1];
+    if (data[0] == 0x01) {
+        if (len < 4) return;
+        hdr = 4;
+        total = get16(data + 1);
+        type = data[3];
+    }
+    if (total > len || total < hdr) {
+        if (verbose) printf("[GW] Malformed packet from %s (%zu bytes)\n", addr_text(from), len);
+        return;
+    }
+    const uint8_t *b = data + hdr;
+    size_t blen = total - hdr;
+
+    client_t *c = find_client(from, type == MSG_CONNECT);
+    if (verbose) {
+        printf("[GW] <- %s type=0x%02X len=%zu\n", addr_text(from), type, total);
+    }
+
+    switch (type) {
+        case MSG_SEARCHGW: {
+            uint8_t gwid = 1;
+            send_message(from, MSG_GWINFO, &gwid, 1);
+            break;
+        }
+        case MSG_CONNECT: {
+            if (c == NULL) {
+                uint8_t rc = RC_NOT_SUPPORTED;     // Client table full
+                send_message(from, MSG_CONNACK, &rc, 1);
+                break;
+            }
+            if (blen >= 4) {
+                size_t id_len = blen - 4 < sizeof(c->client_id) - 1 ? blen - 4 : sizeof(c->client_id) - 1;
+                memcpy(c->client_id, b + 4, id_len);
+                c->client_id[id_len] = '\0';
+            }
+            if (blen >= 1 && (b[0] & 0x04)) {
+                // Clean session
+                c->sub_count = 0;
+                memset(c->inflight, 0, sizeof(c->inflight));
+                memset(c->qos2_in, 0, sizeof(c->qos2_in));
+            }
+            printf("[GW] CONNECT %s from %s\n", c->client_id, addr_text(from));
+            uint8_t rc = RC_ACCEPTED;
+            send_message(from, MSG_CONNACK, &rc, 1);
+            break;
+        }
+        case MSG_REGISTER: {
+            if (blen < 4) break;
+            uint16_t id = topic_id((const char *)b + 4, blen - 4);
+            uint8_t ack[5];
+            put16(ack, id);
+            memcpy(ack + 2, b + 2, 2);
+            ack[4] = id ? RC_ACCEPTED : RC_INVALID_TOPIC;
+            send_message(from, MSG_REGACK, ack, sizeof(ack));
+            break;
+        }
+        case MSG_SUBSCRIBE: {
+            if (blen < 3 || c == NULL) break;
+            uint8_t flags = b[0];
+            uint16_t id = 0;
+            uint8_t rc = RC_ACCEPTED;
+            if (TOPIC_TYPE(flags) == TOPIC_PREDEF && blen >= 5) {
+                id = get16(b + 3);
+                if (id == 0 || id > topic_count) rc = RC_INVALID_TOPIC;
+            } else if (memchr(b + 3, '#', blen - 3) || memchr(b + 3, '+', blen - 3)) {
+                rc = RC_NOT_SUPPORTED;
+            } else {
+                id = topic_id((const char *)b + 3, blen - 3);
+                if (id == 0) rc = RC_INVALID_TOPIC;
+            }
+            uint8_t granted = FLAG_QOS(flags) == 3 ? 0 : FLAG_QOS(flags);
+            if (rc == RC_ACCEPTED) {
+                int s;
+                for (s = 0; s < c->sub_count && c->subs[s] != id; s++) {
+                }
+                if (s == c->sub_count && c->sub_count < MAX_SUBS) c->sub_count++;
+                if (s < MAX_SUBS) {
+                    c->subs[s] = id;
+                    c->sub_qos[s] = granted;
+                }
+                printf("[GW] %s subscribed to %s (TopicID=%u, QoS %u)\n", c->client_id, topic_name(id), id, granted);
+            }
+            uint8_t ack[6];
+            ack[0] = (uint8_t)(granted << 5);
+            put16(ack + 1, rc == RC_ACCEPTED ? id : 0);
+            memcpy(ack + 3, b + 1, 2);
+            ack[5] = rc;
+            send_message(from, MSG_SUBACK, ack, sizeof(ack));
+            break;
+        }
+        case MSG_PUBLISH:
+            handle_publish(c, from, b, blen);
+            break;
+        case MSG_PUBREL: {
+            if (blen < 2) break;
+            uint16_t msgid = get16(b);
+            qos2_in_t *in = c ? find_qos2_in(c, msgid) : NULL;
+            if (in != NULL) {
+                in->used = false;
+                forward(in->topic, in->qos, in->payload, in->payload_len);
+            }
+            send_message(from, MSG_PUBCOMP, b, 2);
+            break;
+        }
+        case MSG_PUBACK:
+        case MSG_PUBCOMP: {
+            size_t off = type == MSG_PUBACK ? 2 : 0;
+            if (c == NULL || blen < off + 2) break;
+            inflight_t *f = find_inflight(c, get16(b + off));
+            if (f != NULL) f->used = false;
+            break;
+        }
+        case MSG_PUBREC: {
+            if (c == NULL || blen < 2) break;
+            inflight_t *f = find_inflight(c, get16(b));
+            if (f != NULL) {
+                // From here on the retransmission is the PUBREL
+                f->released = true;
+                f->tries = 1;
+                f->next_retry = now_us() + (uint64_t)retry_ms * 1000u;
+                f->len = (uint16_t)put_header(f->packet, 2, MSG_PUBREL);
+                memcpy(f->packet + f->len, b, 2);
+                f->len += 2;
+                send_packet(&c->addr, f->packet, f->len);
+            } else {
+                send_message(from, MSG_PUBREL, b, 2);
+            }
+            break;
+        }
+        case MSG_PINGREQ:
+            send_message(from, MSG_PINGRESP, NULL, 0);
+            break;
+        case MSG_DISCONNECT:
+            send_message(from, MSG_DISCONNECT, NULL, 0);
+            if (c != NULL) {
+                printf("[GW] DISCONNECT %s\n", c->client_id);
+                c->used = false;
+            }
+            break;
+        default:
+            if (verbose) printf("[GW] Unhandled type 0x%02X from %s\n", type, addr_text(from));
+            break;
+    }
+}
+
+// Resend QoS 1/2 deliveries (or their PUBREL) that were not acknowledged
+static void retry_inflight(uint64_t now) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        client_t *c = &clients[i];
+        if (!c->used) continue;
+        for (int j = 0; j < MAX_INFLIGHT; j++) {
+            inflight_t *f = &c->inflight[j];
+            if (!f->used || now < f->next_retry) continue;
+            if (f->tries >= max_tries) {
+                f->used = false;
+                gw_stats.expired++;
+                continue;
+            }
+            if (!f->released) {
+                size_t flags_at = f->packet[0] == 0x01 ? 4 : 2;
+                f->packet[flags_at] |= FLAG_DUP;
+            }
+            f->tries++;
+            f->next_retry = now + (uint64_t)retry_ms * 1000u;
+            gw_stats.retries++;
+            send_packet(&c->addr, f->packet, f->len);
+        }
+    }
+}
+
+// Earliest time something is due: a held packet or a retry
+static uint64_t next_due(void) {
+    uint64_t due = UINT64_MAX;
+    if (heap_len > 0) due = heap[0]->due;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (!clients[i].used) continue;
+        for (int j = 0; j < MAX_INFLIGHT; j++) {
+            const inflight_t *f = &clients[i].inflight[j];
+            if (f->used && f->next_retry < due) due = f->next_retry;
+        }
+    }
+    return due;
+}
+
+static void print_stats(void) {
+    static const char *names[2] = { "up", "down" };
+    for (int d = 0; d < 2; d++) {
+        const link_stats_t *s = &link_stats[d];
+        printf("#GW %s packets=%llu bytes=%llu lost=%llu duplicated=%llu reordered=%llu queue_drops=%llu delivered=%llu\n",
+               names[d], (unsigned long long)s->packets, (unsigned long long)s->bytes, (unsigned long long)s->lost,
+               (unsigned long long)s->duplicated, (unsigned long long)s->reordered,
+               (unsigned long long)s->queue_drops, (unsigned long long)s->delivered);
+    }
+    printf("#GW publish in=%llu forwarded=%llu retries=%llu expired=%llu dropped=%llu\n",
+           (unsigned long long)gw_stats.publishes_in, (unsigned long long)gw_stats.forwarded,
+           (unsigned long long)gw_stats.retries, (unsigned long long)gw_stats.expired,
+           (unsigned long long)gw_stats.dropped);
+}
+
+// "loss=2,delay=20,..." into a link; 0 on success
+static int parse_link(const char *spec, link_t *link) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", spec);
+    for (char *item = strtok(buf, ","); item != NULL; item = strtok(NULL, ",")) {
+        char *eq = strchr(item, '=');
+        if (eq == NULL) return -1;
+        *eq = '\0';
+        double v = strtod(eq + 1, NULL);
+        if (v < 0) return -1;
+        if (strcmp(item, "loss") == 0) link->loss = v;
+        else if (strcmp(item, "dup") == 0) link->dup = v;
+        else if (strcmp(item, "reorder") == 0) link->reorder = v;
+        else if (strcmp(item, "delay") == 0) link->delay_ms = (unsigned)v;
+        else if (strcmp(item, "jitter") == 0) link->jitter_ms = (unsigned)v;
+        else if (strcmp(item, "rate") == 0) link->rate_kbps = (unsigned)v;
+        else if (strcmp(item, "queue") == 0) link->queue_ms = (unsigned)v;
+        else return -1;
+    }
+    return 0;
+}
+
+static void print_link(const char *name, const link_t *l) {
+    printf("[GW] %-8s loss=%.2f%% dup=%.2f%% reorder=%.2f%% delay=%ums jitter=%ums rate=%s",
+           name, l->loss, l->dup, l->reorder, l->delay_ms, l->jitter_ms, l->rate_kbps ? "" : "unlimited");
+    if (l->rate_kbps) printf("%ukbit/s queue=%ums", l->rate_kbps, l->queue_ms);
+    printf("\n");
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-p port] [-s seed] [-r retry_ms] [-n retries] [-u spec] [-d spec] [-b spec] [-i stats_s] [-v]\n"
+            "  -u/-d/-b  uplink / downlink / both: loss=%%,dup=%%,reorder=%%,delay=ms,jitter=ms,rate=kbit/s,queue=ms\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    unsigned port = 1884;
+    unsigned stats_s = 0;
+    uint64_t seed = 1;
+    links[UPLINK].queue_ms = links[DOWNLINK].queue_ms = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-v") == 0) {
+            verbose = true;
+            continue;
+        }
+        const char *value = i + 1 < argc ? argv[++i] : NULL;
+        if (value == NULL || arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0') {
+            usage(argv[0]);
+            return 1;
+        }
+        int rc = 0;
+        switch (arg[1]) {
+            case 'p': port = (unsigned)atoi(value); break;
+            case 's': seed = strtoull(value, NULL, 0); break;
+            case 'r': retry_ms = (unsigned)atoi(value); break;
+            case 'n': max_tries = (unsigned)atoi(value) + 1; break;
+            case 'i': stats_s = (unsigned)atoi(value); break;
+            case 'u': rc = parse_link(value, &links[UPLINK]); break;
+            case 'd': rc = parse_link(value, &links[DOWNLINK]); break;
+            case 'b': rc = parse_link(value, &links[UPLINK]) | parse_link(value, &links[DOWNLINK]); break;
+            default: rc = -1; break;
+        }
+        if (rc != 0) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    rng_state ^= seed * 0xD1B54A32D192ED03ull;
+    if (rng_state == 0) rng_state = 1;
+
+    for (int i = 0; i < MAX_EVENTS; i++) {
+        free_events[i] = &events[MAX_EVENTS - 1 - i];
+    }
+    free_len = MAX_EVENTS;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in local = {0};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons((uint16_t)port);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&local, sizeof(local)) != 0) {
+        fprintf(stderr, "Cannot bind UDP port %u: %s\n", port, strerror(errno));
+        return 1;
+    }
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    printf("[GW] MQTT-SN gateway emulator on UDP %u (seed %llu, retry %ums x%u)\n",
+           port, (unsigned long long)seed, retry_ms, max_tries - 1);
+    print_link("uplink", &links[UPLINK]);
+    print_link("downlink", &links[DOWNLINK]);
+
+    uint64_t next_stats = stats_s ? now_us() + (uint64_t)stats_s * 1000000u : UINT64_MAX;
+    while (!stop) {
+        uint64_t now = now_us();
+        uint64_t due = next_due();
+        if (next_stats < due) due = next_stats;
+        int timeout = due == UINT64_MAX ? 1000 : due <= now ? 0 : (int)((due - now + 999) / 1000);
+
+        struct pollfd pfd = { .fd = sock, .events = POLLIN };
+        if (poll(&pfd, 1, timeout) > 0 && (pfd.revents & POLLIN)) {
+            uint8_t buf[MAX_PACKET];
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            ssize_t n = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+            if (n > 0) {
+                impair(UPLINK, &from, buf, (size_t)n);
+            }
+        }
+
+        now = now_us();
+        while (heap_len > 0 && heap[0]->due <= now) {
+            event_t *e = heap_pop();
+            link_stats[e->dir].delivered++;
+            if (e->dir == UPLINK) {
+                handle_packet(&e->addr, e->data, e->len);
+            } else {
+                sendto(sock, e->data, e->len, 0, (struct sockaddr *)&e->addr, sizeof(e->addr));
+            }
+            free_events[free_len++] = e;
+        }
+        retry_inflight(now);
+        if (now >= next_stats) {
+            print_stats();
+            next_stats = now + (uint64_t)stats_s * 1000000u;
+        }
+    }
+
+    print_stats();
+    close(sock);
+    return 0;
+}
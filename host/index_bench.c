@@ -0,0 +1,246 @@
+// index_bench.c - image selection: directory scan vs. the on-card index
+//
+// Runs sd_card.c, image_index.c, diskio_sdcard.c and FatFs against the
+// emulated card from sd_emu.c. The root directory holds N long-named
+// images (three directory entries each) and N/4 other files. For each N:
+//
+//   dir scan     what scan_and_select_image() did on every boot: f_readdir
+//                through the whole root directory
+//   build        image_index_open(): a full scan into a new IMAGES.IDX, or
+//                a merge into the one already there
+//   boot select  cold remount, image_index_open() + image_index_next().
+//                Opening IMAGES.IDX is a name search of the root directory,
+//                so this depends on where its entry is: after the images
+//                when they were copied before the first boot, first when
+//                the index was created on an empty card
+//   warm select  the same again with the index already open
+//   mark sent    image_index_mark_sent() + image_index_next()
+//   rescan       after adding 20 images and deleting 10: the merge keeps
+//                the sent flags of the files that did not change
+//
+// Every record's first cluster is checked against f_open(). Each
+// measurement starts from an empty diskio sector cache. The card runs at
+// 12.5MHz; times are the emulator's virtual clock.
+//
+// Usage: index_bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sd_card.h"
+#include "sd_emu.h"
+#include "diskio_sdcard.h"
+#include "image_index.h"
+#include "ff.h"
+
+#define CARD_SECTORS  (4096u * 2048u)    // 4GB: FAT32, as SDHC cards ship
+#define CARD_CLOCK    12500000
+#define FILE_SIZE     2000
+#define SENT          5                  // Images marked sent before the rescan
+#define ADDED         20
+#define DELETED       10
+#define PHASES        6
+
+typedef struct {
+    uint64_t us;
+    uint32_t blocks;
+} cost_t;
+
+typedef struct {
+    cost_t phases[PHASES];
+    uint32_t count;
+    uint32_t kept;                       // Sent flags that survived the rescan
+    bool ok;
+} result_t;
+
+static const char *phase_names[PHASES] = {
+    "dir scan", "build", "boot select", "warm select", "mark sent", "rescan"
+};
+
+static uint8_t data[FILE_SIZE];
+static uint64_t phase_start;
+
+static int card_up(void) {
+    if (sd_card_init() != 0) return -1;
+    int mounted = sd_card_mount_fat32();
+    if (mounted == -2) mounted = sd_card_format_fat32();
+    return mounted;
+}
+
+static void phase_begin(void) {
+    disk_cache_set_enabled(true);        // Drop cached sectors
+    sd_emu_reset_stats();
+    phase_start = sd_emu_now_us();
+}
+
+static void phase_end(cost_t *c) {
+    sd_emu_stats_t st;
+    sd_emu_get_stats(&st);
+    c->us = sd_emu_now_us() - phase_start;
+    c->blocks = st.blocks_read + st.blocks_written;
+}
+
+static void image_name(char *name, size_t len, int i) {
+    snprintf(name, len, "IMG_%05d_holiday_camera.jpg", i);
+}
+
+static int populate(int images) {
+    char name[64];
+    for (int i = 0; i < images; i++) {
+        image_name(name, sizeof(name), i);
+        data[0] = (uint8_t)i;
+        if (sd_card_write_file(name, data, FILE_SIZE) != 0) return -1;
+        if (i % 4 == 3) {
+            snprintf(name, sizeof(name), "notes_%05d.txt", i);
+            if (sd_card_write_file(name, data, 100) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+// The old per-boot scan: walk the root, counting images
+static uint32_t dir_scan(void) {
+    DIR dir;
+    FILINFO fno;
+    uint32_t images = 0;
+    if (f_opendir(&dir, "/") != FR_OK) return 0;
+    while (f_readdir(&dir, &fno) == FR_OK && fno.fname[0] != 0) {
+        size_t len = strlen(fno.fname);
+        if (!(fno.fattrib & AM_DIR) && len > 4 && strcasecmp(&fno.fname[len - 4], ".jpg") == 0) {
+            images++;
+        }
+    }
+    f_closedir(&dir);
+    return images;
+}
+
+static bool check_clusters(void) {
+    image_index_entry_t e;
+    for (uint32_t id = 0; id < image_index_count(); id++) {
+        FIL f;
+        if (image_index_get(id, &e) != 0 || f_open(&f, e.name, FA_READ) != FR_OK) return false;
+        bool match = f.obj.sclust == e.first_cluster && f_size(&f) == e.size;
+        f_close(&f);
+        if (!match) {
+            printf("❌ %s: index says cluster %lu, file starts at %lu\n", e.name,
+                   (unsigned long)e.first_cluster, (unsigned long)f.obj.sclust);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void run(int images, bool index_first, result_t *r) {
+    image_index_entry_t e;
+    char name[64];
+    memset(r, 0, sizeof(*r));
+    if (sd_emu_init(CARD_SECTORS, NULL) != 0) return;
+    sd_card_set_max_clock(CARD_CLOCK);
+    if (card_up() != 0) return;
+    if (index_first) {
+        if (image_index_open() != 0) return;
+        image_index_close();
+    }
+    if (populate(images) != 0) return;
+
+    f_unmount("");
+    sd_card_deinit();
+    if (card_up() != 0) return;
+
+    phase_begin();
+    uint32_t scanned = dir_scan();
+    phase_end(&r->phases[0]);
+
+    phase_begin();
+    int count = image_index_open();
+    phase_end(&r->phases[1]);
+    if (count != images || scanned != (uint32_t)images || !check_clusters()) return;
+
+    // Cold boot with the index on the card
+    image_index_close();
+    f_unmount("");
+    sd_card_deinit();
+    if (card_up() != 0) return;
+    phase_begin();
+    if (image_index_open() != images || image_index_next(&e) != 0) return;
+    phase_end(&r->phases[2]);
+
+    phase_begin();
+    if (image_index_open() != images || image_index_next(&e) != 0) return;
+    phase_end(&r->phases[3]);
+
+    for (int i = 0; i < SENT; i++) {
+        if (i == SENT - 1) phase_begin();
+        if (image_index_mark_sent((uint32_t)i) != 0 || image_index_next(&e) != i + 1) return;
+        if (i == SENT - 1) phase_end(&r->phases[4]);
+    }
+
+    // Change the card: new images and a few deleted near the front
+    for (int i = 0; i < ADDED; i++) {
+        image_name(name, sizeof(name), images + i);
+        if (sd_card_write_file(name, data, FILE_SIZE) != 0) return;
+    }
+    for (int i = 0; i < DELETED; i++) {
+        image_name(name, sizeof(name), SENT + 2 * i);
+        if (f_unlink(name) != FR_OK) return;
+    }
+    phase_begin();
+    count = image_index_open();
+    phase_end(&r->phases[5]);
+    r->count = (uint32_t)count;
+    if (count != images + ADDED - DELETED || !check_clusters()) return;
+
+    int next = image_index_next(&e);
+    for (int id = 0; id < count; id++) {
+        if (image_index_get((uint32_t)id, &e) != 0) return;
+        if (e.flags & IMAGE_INDEX_SENT) r->kept++;
+    }
+    r->ok = (r->kept == SENT && next == SENT);
+    image_index_close();
+}
+
+int main(void) {
+    static const int sizes[] = { 200, 2000 };
+    static const char *placements[] = { "index after the images", "index first" };
+    const int runs = sizeof(sizes) / sizeof(sizes[0]);
+    result_t results[2][2];                 // [index_first][size]
+
+    for (int first = 0; first <= 1; first++) {
+        for (int i = 0; i < runs; i++) {
+            run(sizes[i], first, &results[first][i]);
+        }
+    }
+
+    printf("\nSD at %.1fMHz: selecting the next image from N images in the root directory\n",
+           CARD_CLOCK / 1e6);
+    bool ok = true;
+    for (int first = 0; first <= 1; first++) {
+        printf("\n%-22s", placements[first]);
+        for (int i = 0; i < runs; i++) printf(" %8d imgs %8s", sizes[i], "sectors");
+        printf("\n");
+        for (int p = 0; p < PHASES; p++) {
+            printf("  %-20s", phase_names[p]);
+            for (int i = 0; i < runs; i++) {
+                const cost_t *c = &results[first][i].phases[p];
+                printf(" %10.2f ms %8u", c->us / 1000.0, c->blocks);
+            }
+            printf("\n");
+        }
+        for (int i = 0; i < runs; i++) {
+            const result_t *r = &results[first][i];
+            ok &= r->ok;
+            printf("  N=%d: %u images after the rescan, %u sent flags kept%s\n", sizes[i], r->count,
+                   r->kept, r->ok ? "" : "  FAILED");
+        }
+    }
+
+    if (!ok) {
+        printf("\n❌ A run failed\n");
+        return 1;
+    }
+    printf("\n✅ Index matched the directory and every first cluster\n");
+    return 0;
+}
@@ -0,0 +1,289 @@
+// log_bench.c - Console logging cost per chunk: printf vs. the binlog ring
+//
+// Replays the log calls a QoS 0 send makes per chunk (publisher: payload,
+// packet dump, UDP and publish lines, progress) and those the subscriber
+// makes per chunk received, once as the printf calls they used to be and
+// once through binlog.c. printf output goes to /dev/null, so its figure is
+// formatting and stdio only - on the Pico every byte also has to get
+// through stdio_usb before printf returns. The ring's output is drained
+// separately, as the pacing wait between chunks does.
+//
+// The formats are then checked: each record, formatted by the drain, must
+// read as printf would have printed it.
+//
+// Usage: log_bench
+//        log_bench --capture | binlog_decode   (binary-mode output to decode)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "binlog.h"
+
+#define CHUNKS      2000
+#define PACKET_LEN  142         // 8-byte header, 120 data bytes, trailer, MQTT-SN header
+#define PAYLOAD_LEN 134
+#define CHUNKS_TOPIC 2
+
+uint64_t time_us_64(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000u;
+}
+
+void sleep_us(uint64_t us) {
+    struct timespec ts = { (time_t)(us / 1000000u), (long)(us % 1000000u) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+void sleep_ms(uint32_t ms) {
+    sleep_us((uint64_t)ms * 1000);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint8_t packet[PACKET_LEN];
+static FILE *sink;
+static unsigned long sink_bytes;
+
+static void out(int n) {
+    if (n > 0) sink_bytes += (unsigned long)n;
+}
+
+static uint32_t dump_word(const uint8_t *buf, int len, int offset) {
+    uint32_t w = 0;
+    for (int i = offset; i < offset + 4; i++) {
+        w = (w << 8) | (i < len ? buf[i] : 0);
+    }
+    return w;
+}
+
+// The publisher's per-chunk prints before binlog
+static void printf_publisher_chunk(uint16_t part, uint16_t total_parts) {
+    const uint8_t *payload = packet + 8;
+    if (part % 50 == 1 || part == total_parts) {
+        out(fprintf(sink, "Sending chunk %d/%d (%d bytes)\n", part, total_parts, PAYLOAD_LEN));
+    }
+    out(fprintf(sink, "[PUBLISHER] Payload (%d bytes): %.*s\n", PAYLOAD_LEN, PAYLOAD_LEN, (const char *)payload));
+    out(fprintf(sink, "[DEBUG] PUBLISH packet (%d bytes, QoS=%d): ", PACKET_LEN, 0));
+    for (int i = 0; i < PACKET_LEN && i < 30; i++) {
+        out(fprintf(sink, "%02x ", packet[i]));
+    }
+    out(fprintf(sink, "...\n"));
+    out(fprintf(sink, "[UDP] Sent %d bytes to %s:%d\n", PACKET_LEN, "192.168.0.10", 10000));
+    out(fprintf(sink, "[MQTTSN] ✓ PUBLISH sent (QoS 0, no ACK) to '%s' (TopicID=%u, len=%d)\n",
+                "pico/chunks", CHUNKS_TOPIC, PAYLOAD_LEN));
+    if (part % 10 == 0 || part == total_parts) {
+        out(fprintf(sink, "  Progress: %d/%d chunks sent (%.1f%%)\n", part, total_parts,
+                    (float)part * 100.0 / total_parts));
+    }
+}
+
+// ... and through the ring, as the call sites now read
+static void binlog_publisher_chunk(uint16_t part, uint16_t total_parts) {
+    if (part % 50 == 1 || part == total_parts) {
+        BLOG_INFO("Sending chunk %d/%d (%d bytes)\n", part, total_parts, PAYLOAD_LEN);
+    }
+    BLOG_DEBUG("[PUBLISHER] Binary payload (%d bytes)\n", PAYLOAD_LEN);
+    BLOG_DEBUG("[DEBUG] PUBLISH packet (%d bytes, QoS=%d): %08x %08x %08x %08x ...\n", PACKET_LEN, 0,
+               dump_word(packet, PACKET_LEN, 0), dump_word(packet, PACKET_LEN, 4),
+               dump_word(packet, PACKET_LEN, 8), dump_word(packet, PACKET_LEN, 12));
+    BLOG_DEBUG("[UDP] Sent %zu bytes to port %d\n", (size_t)PACKET_LEN, 10000);
+    BLOG_INFO("[MQTTSN] ✓ PUBLISH sent (QoS 0, no ACK) (TopicID=%u, len=%d)\n", CHUNKS_TOPIC, PAYLOAD_LEN);
+    if (part % 10 == 0 || part == total_parts) {
+        int permille = part * 1000 / total_parts;
+        BLOG_INFO("  Progress: %d/%d chunks sent (%d.%d%%)\n", part, total_parts, permille / 10, permille % 10);
+    }
+}
+
+static void printf_subscriber_chunk(uint16_t part, uint16_t total_parts) {
+    out(fprintf(sink, "[DEBUG] Received PUBLISH: TopicID=%u, Expected chunks_topicid=%u\n", CHUNKS_TOPIC,
+                CHUNKS_TOPIC));
+    if (part > total_parts - 10) {
+        out(fprintf(sink, "[STORE] Chunk %d stored, counter now=%d/%d\n", part, part, total_parts));
+    }
+    if (part % 10 == 0 || part == total_parts) {
+        out(fprintf(sink, "  Progress: %d/%d chunks received\n", part, total_parts));
+    }
+    if (part >= total_parts - 3) {
+        out(fprintf(sink, "[DEBUG-COMPLETE] received=%d, total=%d, equal=%d\n", part, total_parts,
+                    part == total_parts));
+    }
+}
+
+static void binlog_subscriber_chunk(uint16_t part, uint16_t total_parts) {
+    BLOG_DEBUG("[DEBUG] Received PUBLISH: TopicID=%u, Expected chunks_topicid=%u\n", CHUNKS_TOPIC, CHUNKS_TOPIC);
+    if (part > total_parts - 10) {
+        BLOG_DEBUG("[STORE] Chunk %d stored, counter now=%d/%d\n", part, part, total_parts);
+    }
+    if (part % 10 == 0 || part == total_parts) {
+        BLOG_INFO("  Progress: %d/%d chunks received\n", part, total_parts);
+    }
+    if (part >= total_parts - 3) {
+        BLOG_DEBUG("[DEBUG-COMPLETE] received=%d, total=%d, equal=%d\n", part, total_parts, part == total_parts);
+    }
+}
+
+typedef struct {
+    double hot_ns;              // Per chunk, in the chunk loop
+    double drain_ns;            // Per chunk, in the pacing wait
+    double bytes;               // Console bytes per chunk
+    double records;
+} cost_t;
+
+// stdout into a temporary file while the ring drains, to count its bytes
+static int redirect_stdout(int *saved) {
+    fflush(stdout);
+    FILE *tmp = tmpfile();
+    if (tmp == NULL) return -1;
+    *saved = dup(STDOUT_FILENO);
+    dup2(fileno(tmp), STDOUT_FILENO);
+    return 0;
+}
+
+static long restore_stdout(int saved) {
+    fflush(stdout);
+    long bytes = lseek(STDOUT_FILENO, 0, SEEK_END);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    return bytes;
+}
+
+static void run_printf(void (*chunk)(uint16_t, uint16_t), cost_t *c) {
+    sink_bytes = 0;
+    uint64_t start = now_ns();
+    for (uint16_t part = 1; part <= CHUNKS; part++) {
+        chunk(part, CHUNKS);
+    }
+    fflush(sink);
+    c->hot_ns = (double)(now_ns() - start) / CHUNKS;
+    c->drain_ns = 0;
+    c->bytes = (double)sink_bytes / CHUNKS;
+    c->records = 0;
+}
+
+static int run_binlog(void (*chunk)(uint16_t, uint16_t), bool binary, cost_t *c) {
+    int saved;
+    if (redirect_stdout(&saved) != 0) return -1;
+    binlog_set_binary(binary);
+    binlog_reset_stats();
+    uint64_t hot = 0, drain = 0;
+    for (uint16_t part = 1; part <= CHUNKS; part++) {
+        uint64_t t0 = now_ns();
+        chunk(part, CHUNKS);
+        uint64_t t1 = now_ns();
+        binlog_flush();
+        drain += now_ns() - t1;
+        hot += t1 - t0;
+    }
+    binlog_set_binary(false);
+    long bytes = restore_stdout(saved);
+
+    binlog_stats_t st;
+    binlog_get_stats(&st);
+    c->hot_ns = (double)hot / CHUNKS;
+    c->drain_ns = (double)drain / CHUNKS;
+    c->bytes = (double)bytes / CHUNKS;
+    c->records = (double)st.records / CHUNKS;
+    return st.dropped == 0 ? 0 : -1;
+}
+
+// Every record formatted by binlog_format() as printf formats it
+static int check_formats(void) {
+    static const struct {
+        const char *fmt;
+        uint32_t args[BINLOG_MAX_ARGS];
+        uint8_t nargs;
+    } cases[] = {
+        { "  Progress: %d/%d chunks sent (%d.%d%%)\n", { 10, 1250, 0, 8 }, 4 },
+        { "[DEBUG] PUBLISH packet (%d bytes, QoS=%d): %08x %08x ...\n", { 142, 0, 0x8e0c2000, 0x0002 }, 4 },
+        { "[UDP] Sent %zu bytes to port %d\n", { 142, 10000 }, 2 },
+        { "  Progress: %lu/%lu symbols sent\n", { 4000000000u, 4000000001u }, 2 },
+        { "[CRC] ✗ Chunk %d/%d failed (total CRC errors=%d)\n", { 7, 12, (uint32_t)-3 }, 3 },
+        { "%-6u|%5d|%c|%X|%#x|%%\n", { 42, (uint32_t)-17, 'Z', 0xBEEF, 0x10 }, 5 },
+    };
+    char got[256], want[256];
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const uint32_t *a = cases[i].args;
+        binlog_format(got, sizeof(got), cases[i].fmt, a, cases[i].nargs);
+        switch (i) {
+        case 0: snprintf(want, sizeof(want), cases[i].fmt, 10, 1250, 0, 8); break;
+        case 1: snprintf(want, sizeof(want), cases[i].fmt, 142, 0, 0x8e0c2000u, 0x0002u); break;
+        case 2: snprintf(want, sizeof(want), cases[i].fmt, (size_t)142, 10000); break;
+        case 3: snprintf(want, sizeof(want), cases[i].fmt, 4000000000ul, 4000000001ul); break;
+        case 4: snprintf(want, sizeof(want), cases[i].fmt, 7, 12, -3); break;
+        default: snprintf(want, sizeof(want), cases[i].fmt, 42u, -17, 'Z', 0xBEEFu, 0x10u); break;
+        }
+        if (strcmp(got, want) != 0) {
+            printf("❌ Format %zu: got \"%s\", printf gives \"%s\"\n", i, got, want);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+static void print_row(const char *name, const cost_t *c) {
+    printf("  %-28s %10.0f %10.0f %10.1f %10.2f\n", name, c->hot_ns, c->drain_ns, c->bytes, c->records);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 0; i < PACKET_LEN; i++) {
+        packet[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--capture") == 0) {
+        // A publisher block and a subscriber block, as the console would carry them
+        printf("[APP] plain printf lines pass through the decoder\n");
+        binlog_set_binary(true);
+        for (uint16_t part = 1; part <= 100; part++) {
+            binlog_publisher_chunk(part, 100);
+            binlog_subscriber_chunk(part, 100);
+            binlog_drain(BINLOG_DRAIN_BATCH);
+        }
+        binlog_flush();
+        return 0;
+    }
+
+    sink = fopen("/dev/null", "w");
+    if (sink == NULL) {
+        return 1;
+    }
+    cost_t pub_printf, pub_text, pub_binary, sub_printf, sub_text, sub_binary;
+    run_printf(printf_publisher_chunk, &pub_printf);
+    run_printf(printf_subscriber_chunk, &sub_printf);
+    int dropped = run_binlog(binlog_publisher_chunk, false, &pub_text);
+    dropped |= run_binlog(binlog_publisher_chunk, true, &pub_binary);
+    dropped |= run_binlog(binlog_subscriber_chunk, false, &sub_text);
+    dropped |= run_binlog(binlog_subscriber_chunk, true, &sub_binary);
+    int failures = check_formats();
+
+    printf("\n%d chunks, BINLOG_LEVEL %d, per chunk:\n", CHUNKS, BINLOG_LEVEL);
+    printf("\n  %-28s %10s %10s %10s %10s\n", "", "loop ns", "drain ns", "bytes", "records");
+    printf("publisher\n");
+    print_row("printf", &pub_printf);
+    print_row("binlog, text drain", &pub_text);
+    print_row("binlog, binary drain", &pub_binary);
+    printf("subscriber\n");
+    print_row("printf", &sub_printf);
+    print_row("binlog, text drain", &sub_text);
+    print_row("binlog, binary drain", &sub_binary);
+    printf("\nIn the chunk loop: publisher %.1fx, subscriber %.1fx less CPU\n",
+           pub_printf.hot_ns / (pub_text.hot_ns > 0 ? pub_text.hot_ns : 1),
+           sub_printf.hot_ns / (sub_text.hot_ns > 0 ? sub_text.hot_ns : 1));
+
+    if (dropped || failures) {
+        printf("\n❌ %s\n", dropped ? "Records were dropped" : "Formatting differs from printf");
+        return 1;
+    }
+    printf("\n✅ No records dropped; deferred formatting matches printf\n");
+    return 0;
+}
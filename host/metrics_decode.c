@@ -0,0 +1,283 @@
+// metrics_decode.c - Turn pico/metrics payloads back into JSON
+//
+// Reads one payload per line as hex (stdin or a file), for example
+//   mosquitto_sub -t pico/metrics -F %x | metrics_decode
+// Schema payloads are remembered by their CRC; each values publish is
+// printed as one JSON line once its schema is known. Values whose schema
+// has not been seen yet are counted and skipped.
+//
+// Usage: metrics_decode [capture.txt]
+//        metrics_decode --demo    encode a sample registry and decode it
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#include "metrics.h"
+
+#define MAX_SCHEMAS 4
+
+typedef struct {
+    uint8_t type;
+    char name[METRICS_NAME_MAX];
+    uint8_t nbounds;
+    uint32_t bounds[METRICS_MAX_BOUNDS];
+} schema_entry_t;
+
+typedef struct {
+    uint32_t crc;
+    uint8_t count;
+    schema_entry_t entries[METRICS_MAX];
+} schema_t;
+
+static schema_t schemas[MAX_SCHEMAS];
+static int schema_count;
+static int schema_next;         // Oldest slot, replaced when all are in use
+static unsigned skipped;
+
+// The values publish being assembled, printed when seq changes
+static struct {
+    bool open;
+    uint16_t seq;
+    uint32_t uptime_s;
+    const schema_t *schema;
+    bool present[METRICS_MAX];
+    char text[METRICS_MAX][160];
+} pending;
+
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint32_t *v) {
+    uint32_t value = 0;
+    for (int shift = 0; *p < end && shift < 35; shift += 7) {
+        uint8_t b = *(*p)++;
+        value |= (uint32_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            *v = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static schema_t *find_schema(uint32_t crc) {
+    for (int i = 0; i < schema_count; i++) {
+        if (schemas[i].crc == crc) {
+            return &schemas[i];
+        }
+    }
+    return NULL;
+}
+
+static void flush_pending(void) {
+    if (!pending.open) {
+        return;
+    }
+    printf("{\"seq\":%u,\"uptime_s\":%u", pending.seq, pending.uptime_s);
+    for (int i = 0; i < pending.schema->count; i++) {
+        if (pending.present[i]) {
+            printf(",\"%s\":%s", pending.schema->entries[i].name, pending.text[i]);
+        }
+    }
+    printf("}\n");
+    fflush(stdout);
+    pending.open = false;
+}
+
+static void decode_schema(uint32_t crc, uint8_t first, uint8_t count, const uint8_t *p, const uint8_t *end) {
+    schema_t *s = find_schema(crc);
+    if (s == NULL) {
+        s = &schemas[schema_next];
+        schema_next = (schema_next + 1) % MAX_SCHEMAS;
+        if (schema_count < MAX_SCHEMAS) {
+            schema_count++;
+        }
+        memset(s, 0, sizeof(*s));
+        s->crc = crc;
+    }
+    for (uint8_t i = first; i < first + count && i < METRICS_MAX; i++) {
+        schema_entry_t *e = &s->entries[i];
+        if (end - p < 2 || p[1] >= METRICS_NAME_MAX || end - p < 2 + p[1]) {
+            return;
+        }
+        e->type = p[0];
+        memcpy(e->name, p + 2, p[1]);
+        e->name[p[1]] = '\0';
+        p += 2 + p[1];
+        e->nbounds = 0;
+        if (e->type == METRIC_HISTOGRAM) {
+            if (p == end || *p > METRICS_MAX_BOUNDS) {
+                return;
+            }
+            e->nbounds = *p++;
+            for (uint8_t b = 0; b < e->nbounds; b++) {
+                if (!get_varint(&p, end, &e->bounds[b])) {
+                    return;
+                }
+            }
+        }
+        if (i + 1 > s->count) {
+            s->count = i + 1;
+        }
+    }
+}
+
+static void decode_values(uint32_t crc, uint16_t seq, uint32_t uptime_s, uint8_t first, uint8_t count,
+                          const uint8_t *p, const uint8_t *end) {
+    const schema_t *s = find_schema(crc);
+    if (s == NULL) {
+        skipped++;
+        return;
+    }
+    if (pending.open && (pending.seq != seq || pending.schema != s)) {
+        flush_pending();
+    }
+    if (!pending.open) {
+        memset(&pending, 0, sizeof(pending));
+        pending.open = true;
+        pending.seq = seq;
+        pending.uptime_s = uptime_s;
+        pending.schema = s;
+    }
+    for (uint8_t i = first; i < first + count && i < s->count; i++) {
+        const schema_entry_t *e = &s->entries[i];
+        char *out = pending.text[i];
+        size_t size = sizeof(pending.text[i]);
+        uint32_t v;
+        if (e->type == METRIC_COUNTER) {
+            if (!get_varint(&p, end, &v)) {
+                return;
+            }
+            snprintf(out, size, "%u", v);
+        } else if (e->type == METRIC_GAUGE) {
+            if (!get_varint(&p, end, &v)) {
+                return;
+            }
+            snprintf(out, size, "%d", (int32_t)((v >> 1) ^ (0u - (v & 1))));
+        } else {
+            // {"le":[bounds],"buckets":[counts],"sum":n}
+            int n = snprintf(out, size, "{\"le\":[");
+            for (uint8_t b = 0; b < e->nbounds; b++) {
+                n += snprintf(out + n, size - n, "%s%u", b ? "," : "", e->bounds[b]);
+            }
+            n += snprintf(out + n, size - n, "],\"buckets\":[");
+            for (uint8_t b = 0; b <= e->nbounds; b++) {
+                if (!get_varint(&p, end, &v)) {
+                    return;
+                }
+                n += snprintf(out + n, size - n, "%s%u", b ? "," : "", v);
+            }
+            if (!get_varint(&p, end, &v)) {
+                return;
+            }
+            snprintf(out + n, size - n, "],\"sum\":%u}", v);
+        }
+        pending.present[i] = true;
+    }
+}
+
+static void decode_payload(const uint8_t *buf, size_t len) {
+    if (len < METRICS_HEADER_SIZE || buf[0] != METRICS_VERSION) {
+        fprintf(stderr, "Skipping a payload of %zu bytes (not metrics v%d)\n", len, METRICS_VERSION);
+        return;
+    }
+    uint32_t crc = get_u32(buf + 2);
+    uint16_t seq = buf[6] | (buf[7] << 8);
+    uint32_t uptime_s = get_u32(buf + 8);
+    const uint8_t *p = buf + METRICS_HEADER_SIZE;
+    if (buf[1] == METRICS_KIND_SCHEMA) {
+        decode_schema(crc, buf[12], buf[13], p, buf + len);
+    } else if (buf[1] == METRICS_KIND_VALUES) {
+        decode_values(crc, seq, uptime_s, buf[12], buf[13], p, buf + len);
+    }
+}
+
+// Hex digits only; spaces and anything after a non-hex character are ignored
+static size_t parse_hex(const char *line, uint8_t *out, size_t size) {
+    size_t n = 0;
+    int high = -1;
+    for (; *line && n < size; line++) {
+        if (isspace((unsigned char)*line)) {
+            continue;
+        }
+        if (!isxdigit((unsigned char)*line)) {
+            break;
+        }
+        int d = isdigit((unsigned char)*line) ? *line - '0' : tolower((unsigned char)*line) - 'a' + 10;
+        if (high < 0) {
+            high = d;
+        } else {
+            out[n++] = (uint8_t)(high << 4 | d);
+            high = -1;
+        }
+    }
+    return n;
+}
+
+// Register a registry like the publisher's, encode it the way
+// metrics_publish() does and feed the payloads back through the decoder
+static int demo(void) {
+    static const uint32_t ack_bounds[] = {5, 10, 20, 50, 100, 200, 500, 1000};
+    int sent = metrics_counter("chunks_sent");
+    int bytes = metrics_counter("chunk_bytes_sent");
+    int retries = metrics_counter("chunk_retries");
+    int connected = metrics_gauge("mqtt_connected");
+    int rssi = metrics_gauge("rssi_dbm");
+    int ack = metrics_histogram("chunk_ack_ms", ack_bounds, 8);
+    for (int i = 0; i < 1000; i++) {
+        metrics_inc(sent);
+        metrics_add(bytes, 247);
+        metrics_observe(ack, 3 + (uint32_t)(i * 7919) % 400);
+    }
+    metrics_add(retries, 12);
+    metrics_set(connected, 1);
+    metrics_set(rssi, -61);
+
+    uint8_t payload[METRICS_PAYLOAD_MAX];
+    size_t total[2] = {0, 0};
+    for (uint8_t kind = METRICS_KIND_SCHEMA; kind <= METRICS_KIND_VALUES; kind++) {
+        uint8_t first = 0, next;
+        int len;
+        while ((len = metrics_encode(kind, first, 7, 1234, payload, sizeof(payload), &next)) > 0) {
+            total[kind - 1] += len;
+            decode_payload(payload, len);
+            first = next;
+        }
+    }
+    flush_pending();
+    fprintf(stderr, "Schema %zu bytes, values %zu bytes\n", total[0], total[1]);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--demo") == 0) {
+        return demo();
+    }
+    FILE *in = argc > 1 ? fopen(argv[1], "r") : stdin;
+    if (in == NULL) {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    char line[2 * METRICS_PAYLOAD_MAX + 64];
+    uint8_t payload[METRICS_PAYLOAD_MAX];
+    while (fgets(line, sizeof(line), in)) {
+        size_t len = parse_hex(line, payload, sizeof(payload));
+        if (len > 0) {
+            decode_payload(payload, len);
+        }
+    }
+    flush_pending();
+    if (skipped) {
+        fprintf(stderr, "%u values payloads arrived before their schema\n", skipped);
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+    return 0;
+}
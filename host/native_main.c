@@ -0,0 +1,177 @@
+// native_main.c - Runs the publisher or subscriber firmware as a Linux process
+//
+// picow_network_host / picow_subscriber_host link main.c or
+// subscriber_main.c (renamed picow_main) with the real transfer stack,
+// MQTT-SN client and Wi-Fi driver. Underneath, udp_posix.c sends through
+// a UDP socket, pico_host.c stands in for the SDK, sim_clock.c keeps real
+// time, and sd_emu.c is the SD card on the SPI bus, backed by a disk
+// image file.
+//
+//   picow_network_host [-g ip:port] [-c card.img] [-s MB] [-f file]... [-k keys] [-F spec]
+//
+//   -g  MQTT-SN gateway (default 127.0.0.1:1884)
+//   -c  Card image (default <program>.img); a new one is formatted FAT
+//   -s  Size of a new card image in MB (default 128)
+//   -f  Copy a file onto the card before starting (repeatable)
+//   -k  Keys pressed at startup, e.g. -k b to send the images once connected
+//   -F  Fault injection spec (fault_inject.h; needs -DFAULT_INJECT=ON)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "network_config.h"
+#include "sd_card.h"
+#include "sd_emu.h"
+#include "pico_host.h"
+#include "sim_clock.h"
+#include "fault_inject.h"
+
+#define MAX_COPY_FILES 32
+
+const char *picow_host_gateway_ip = "127.0.0.1";
+unsigned short picow_host_gateway_port = 1884;
+
+int picow_main(void);
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-g ip:port] [-c card.img] [-s MB] [-f file]... [-k keys] [-F spec]\n", prog);
+}
+
+static const char *base_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// Put a host file in the card's root directory, under its own name
+static int copy_to_card(const char *path) {
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        perror(path);
+        return -1;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    rewind(in);
+    uint8_t *data = malloc(size > 0 ? (size_t)size : 1);
+    if (data == NULL || fread(data, 1, (size_t)size, in) != (size_t)size) {
+        fprintf(stderr, "Cannot read %s\n", path);
+        free(data);
+        fclose(in);
+        return -1;
+    }
+    fclose(in);
+
+    int rc = sd_card_write_file(base_name(path), data, (size_t)size);
+    free(data);
+    if (rc != 0) {
+        fprintf(stderr, "Cannot copy %s onto the card\n", path);
+        return -1;
+    }
+    printf("[HOST] Copied %s (%ld bytes) onto the card\n", base_name(path), size);
+    return 0;
+}
+
+// Identify the card once and give it a filesystem if it has none
+static int prepare_card(const char **files, int file_count) {
+    if (sd_card_init() != 0) {
+        return -1;
+    }
+    int rc = sd_card_mount_fat32();
+    if (rc == -2) {
+        printf("[HOST] New card image - formatting\n");
+        rc = sd_card_format_fat32();
+    }
+    if (rc != 0) {
+        return -1;
+    }
+    for (int i = 0; i < file_count; i++) {
+        if (copy_to_card(files[i]) != 0) {
+            return -1;
+        }
+    }
+    // The firmware identifies and mounts the card again itself
+    sd_card_deinit();
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static char default_image[256];
+    static char gateway[64];
+    const char *image = NULL;
+    const char *files[MAX_COPY_FILES];
+    int file_count = 0;
+    uint32_t size_mb = 128;
+
+    sim_clock_use_real_time();
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL || arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0') {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+        switch (arg[1]) {
+            case 'g': {
+                snprintf(gateway, sizeof(gateway), "%s", value);
+                char *colon = strrchr(gateway, ':');
+                if (colon != NULL) {
+                    *colon = '\0';
+                    picow_host_gateway_port = (unsigned short)atoi(colon + 1);
+                }
+                picow_host_gateway_ip = gateway;
+                break;
+            }
+            case 'c':
+                image = value;
+                break;
+            case 's':
+                size_mb = (uint32_t)strtoul(value, NULL, 0);
+                break;
+            case 'f':
+                if (file_count == MAX_COPY_FILES) {
+                    fprintf(stderr, "At most %d files\n", MAX_COPY_FILES);
+                    return 1;
+                }
+                files[file_count++] = value;
+                break;
+            case 'k':
+                pico_host_press(value);
+                break;
+            case 'F':
+#if FAULT_INJECT_ENABLED
+                if (fault_inject_configure(value) != 0) {
+                    return 1;
+                }
+                break;
+#else
+                fprintf(stderr, "Built without fault injection (cmake -DFAULT_INJECT=ON)\n");
+                return 1;
+#endif
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (image == NULL) {
+        snprintf(default_image, sizeof(default_image), "%s.img", base_name(argv[0]));
+        image = default_image;
+    }
+    if (size_mb < 1 || size_mb > 32768) {
+        fprintf(stderr, "Card size must be 1..32768 MB\n");
+        return 1;
+    }
+
+    stdio_init_all();
+    if (sd_emu_init_image(image, size_mb * 2048, NULL) != 0) {
+        return 1;
+    }
+    if (prepare_card(files, file_count) != 0) {
+        fprintf(stderr, "Card image %s is not usable\n", image);
+        return 1;
+    }
+    printf("[HOST] Card %s, gateway %s:%u\n", image, picow_host_gateway_ip, picow_host_gateway_port);
+    return picow_main();
+}
@@ -0,0 +1,228 @@
+// partial_bench.c - partial-receive journal across power cuts
+//
+// Runs block_partial.c, sd_write_queue.c, sd_card.c, diskio_sdcard.c and
+// FatFs against the emulated card from sd_emu.c. A 150KB block arrives as
+// 1250 chunks, one every 2 ms with every 50th lost, into an assembly laid
+// out like the subscriber's. After each chunk the journal may queue a
+// checkpoint and the main loop does one write queue step, as
+// subscriber_main.c does.
+//
+// The card's power is then cut at pseudo-random times during the block,
+// mid-write included. Whatever was queued dies with the RAM; the card is
+// remounted and the assembly rebuilt from the journal. Every chunk the
+// journal claims must hold the right data, and the chunks still missing
+// are what the publisher has to send again. Without the journal that is
+// every chunk.
+//
+// A last run receives the whole block, has the lost chunks resent, clears
+// the journal after the "save" and checks it is empty on the next boot.
+//
+// Usage: partial_bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pico/stdlib.h"
+#include "sd_card.h"
+#include "sd_emu.h"
+#include "sd_write_queue.h"
+#include "block_partial.h"
+#include "crc32c.h"
+
+#define CARD_SECTORS  (256u * 2048u)
+#define CARD_CLOCK    12500000
+#define BLOCK_BYTES   150000
+#define PARTS         ((BLOCK_BYTES + BLOCK_CHUNK_DATA_SIZE - 1) / BLOCK_CHUNK_DATA_SIZE)
+#define BLOCK_ID      0x5A17
+#define CHUNK_US      2000
+#define LOSS_EVERY    50
+#define CUTS          40
+
+static bool mask[BLOCK_MAX_CHUNKS];
+static uint8_t buffer[BLOCK_BUFFER_SIZE];
+static uint8_t image[BLOCK_BYTES];
+static block_assembly_t blk;
+
+typedef struct {
+    uint32_t received;                   // Chunks in RAM when the power went
+    uint32_t restored;                   // ... found in the journal after reboot
+    bool ok;
+} cut_result_t;
+
+static int card_up(void) {
+    if (sd_card_init() != 0) return -1;
+    int mounted = sd_card_mount_fat32();
+    if (mounted == -2) mounted = sd_card_format_fat32();
+    return mounted;
+}
+
+static void assembly_init(void) {
+    memset(&blk, 0, sizeof(blk));
+    memset(mask, 0, sizeof(mask));
+    memset(buffer, 0, sizeof(buffer));
+    blk.block_id = BLOCK_ID;
+    blk.total_parts = PARTS;
+    blk.stream_end = PARTS;
+    blk.received_mask = mask;
+    blk.data_buffer = buffer;
+    blk.chunk_base = buffer;
+}
+
+static void store(uint16_t part) {
+    uint32_t offset = (uint32_t)(part - 1) * BLOCK_CHUNK_DATA_SIZE;
+    uint32_t len = BLOCK_BYTES - offset < BLOCK_CHUNK_DATA_SIZE ? BLOCK_BYTES - offset : BLOCK_CHUNK_DATA_SIZE;
+    if (mask[part - 1]) return;
+    memcpy(buffer + offset, image + offset, len);
+    mask[part - 1] = true;
+    blk.received_parts++;
+    if (part == PARTS) {
+        blk.total_length = offset + len;
+        blk.has_digest = true;
+        blk.block_crc = crc32c(image, BLOCK_BYTES);
+    }
+}
+
+// One main loop iteration per chunk. Returns false once the power is gone.
+static bool receive(uint16_t part, bool journal, uint64_t cut_us) {
+    sleep_us(CHUNK_US);
+    if (cut_us != 0 && sd_emu_now_us() >= cut_us) return false;
+    if (part % LOSS_EVERY != 0) {
+        store(part);
+        if (journal) block_partial_checkpoint(&blk, false);
+    }
+    sd_write_queue_poll();
+    return cut_us == 0 || sd_emu_powered();
+}
+
+static int fresh_card(void) {
+    if (sd_emu_init(CARD_SECTORS, NULL) != 0) return -1;
+    sd_card_set_max_clock(CARD_CLOCK);
+    if (card_up() != 0) return -1;
+    return block_partial_open() < 0 ? -1 : 0;
+}
+
+// Power back on, remount and rebuild the assembly from the journal.
+// Returns the chunks restored, or -1 if any of them is wrong.
+static int reboot_and_load(void) {
+    sd_emu_power_on();
+    sd_card_deinit();
+    if (card_up() != 0) return -1;
+    assembly_init();
+    uint16_t block_id, total_parts;
+    if (block_partial_open() != 1 || !block_partial_find(&block_id, &total_parts)) return 0;
+    if (block_id != BLOCK_ID || total_parts != PARTS) return -1;
+    int restored = block_partial_load(&blk);
+    if (restored < 0) return -1;
+    for (uint16_t i = 0; i < PARTS; i++) {
+        if (!mask[i]) continue;
+        uint32_t offset = (uint32_t)i * BLOCK_CHUNK_DATA_SIZE;
+        uint32_t len = BLOCK_BYTES - offset < BLOCK_CHUNK_DATA_SIZE ? BLOCK_BYTES - offset : BLOCK_CHUNK_DATA_SIZE;
+        if (memcmp(buffer + offset, image + offset, len) != 0) {
+            printf("❌ Chunk %d restored with the wrong data\n", i + 1);
+            return -1;
+        }
+    }
+    return restored;
+}
+
+static void run_cut(uint64_t cut_after_us, cut_result_t *r) {
+    memset(r, 0, sizeof(*r));
+    if (fresh_card() != 0) return;
+    assembly_init();
+    uint64_t cut_us = sd_emu_now_us() + cut_after_us;
+    sd_emu_power_cut_at(cut_us);
+    for (uint16_t part = 1; part <= PARTS; part++) {
+        if (!receive(part, true, cut_us)) break;
+    }
+    r->received = blk.received_parts;
+
+    // The RAM is gone with the power: queued jobs fail against the dead card
+    sd_emu_power_cut_at(1);
+    sd_write_queue_flush();
+    int restored = reboot_and_load();
+    r->restored = restored < 0 ? 0 : (uint32_t)restored;
+    r->ok = restored >= 0 && r->restored <= r->received;
+}
+
+// No cut: journal cost, then resend the lost chunks, save and clear
+static bool run_full(bool journal, sd_write_queue_stats_t *wq, block_partial_stats_t *ps,
+                     uint64_t *elapsed_us) {
+    if (fresh_card() != 0) return false;
+    assembly_init();
+    sd_write_queue_reset_stats();
+    uint64_t start = sd_emu_now_us();
+    for (uint16_t part = 1; part <= PARTS; part++) {
+        receive(part, journal, 0);
+    }
+    while (sd_write_queue_poll()) {
+    }
+    *elapsed_us = sd_emu_now_us() - start;
+    sd_write_queue_get_stats(wq);
+    block_partial_get_stats(ps);
+    if (!journal) return true;
+
+    for (uint16_t part = LOSS_EVERY; part <= PARTS; part += LOSS_EVERY) {
+        store(part);
+    }
+    if (blk.received_parts != PARTS || crc32c(buffer, blk.total_length) != blk.block_crc) return false;
+    block_partial_clear(BLOCK_ID);
+    sd_write_queue_flush();
+    f_unmount("");
+    sd_card_deinit();
+    return card_up() == 0 && block_partial_open() == 0;
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(image); i++) {
+        image[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+
+    sd_write_queue_stats_t wq_off, wq_on;
+    block_partial_stats_t ps_off, ps_on;
+    uint64_t us_off, us_on;
+    bool ok = run_full(false, &wq_off, &ps_off, &us_off);
+    bool full_ok = run_full(true, &wq_on, &ps_on, &us_on);
+    ok &= full_ok;
+
+    uint64_t span_us = (uint64_t)PARTS * CHUNK_US;
+    uint32_t seed = 12345;
+    uint64_t received = 0, restored = 0;
+    uint32_t worst = 0, failures = 0;
+    for (int i = 0; i < CUTS; i++) {
+        seed = seed * 1103515245u + 12345u;
+        uint64_t cut_after = span_us / 20 + (seed >> 8) % (span_us * 9 / 10);
+        cut_result_t r;
+        run_cut(cut_after, &r);
+        if (!r.ok) failures++;
+        received += r.received;
+        restored += r.restored;
+        if (r.received - r.restored > worst) worst = r.received - r.restored;
+    }
+    ok &= failures == 0;
+
+    printf("\nSD at %.1fMHz: %d-byte block in %d chunks, one every %d ms, every %dth lost\n",
+           CARD_CLOCK / 1e6, BLOCK_BYTES, (int)PARTS, CHUNK_US / 1000, LOSS_EVERY);
+    printf("\n%-22s %10s %12s %10s %12s %12s\n", "", "s", "records", "KB", "SD busy ms", "max step ms");
+    printf("  %-20s %10.2f %12s %10.1f %12.1f %12.2f\n", "no journal", us_off / 1e6, "-",
+           wq_off.bytes / 1024.0, wq_off.write_us / 1000.0, wq_off.max_step_us / 1000.0);
+    printf("  %-20s %10.2f %12u %10.1f %12.1f %12.2f%s\n", "journal", us_on / 1e6, ps_on.checkpoints,
+           wq_on.bytes / 1024.0, wq_on.write_us / 1000.0, wq_on.max_step_us / 1000.0,
+           full_ok ? "" : "  FAILED");
+    printf("\n%d power cuts at random times (mid-write included), per cut:\n", CUTS);
+    printf("  chunks received before the cut    %8.1f\n", (double)received / CUTS);
+    printf("  restored from the journal         %8.1f\n", (double)restored / CUTS);
+    printf("  received but not yet journaled    %8.1f (worst %u)\n", (double)(received - restored) / CUTS,
+           worst);
+    printf("  to resend: with journal %8.1f, without %d\n", PARTS - (double)restored / CUTS, (int)PARTS);
+    printf("  reloads with a wrong chunk        %8u\n", failures);
+
+    if (!ok) {
+        printf("\n❌ A run failed\n");
+        return 1;
+    }
+    printf("\n✅ Every journaled chunk survived its power cut intact\n");
+    return 0;
+}
@@ -0,0 +1,253 @@
+// pico_host.c - Pico SDK and CYW43 shims for the native publisher/subscriber
+//
+// The console on stdin/stdout and the station link reported up by the
+// first connect; the clock is sim_clock.c on real time. Buttons are
+// console keys:
+//
+//   b   GP21 (publisher: block transfer) reads pressed until polled once
+//   q   GP22 (publisher: QoS toggle) raises its falling-edge interrupt
+//   x   exit
+//
+// Any other key is handed to getchar_timeout_us(), so 't' still dumps the
+// trace rings and 'c'/'w' drive the wire capture. Keys queued with pico_host_press() count as typed. Keys
+// are taken KEY_INTERVAL_MS apart, past the buttons' debounce, so "qqb"
+// selects QoS 2 and then starts a transfer.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <signal.h>
+#include <arpa/inet.h>
+
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "pico/rand.h"
+#include "hardware/gpio.h"
+#include "lwip/netif.h"
+#include "pico_host.h"
+
+#define KEY_BLOCK_PIN   21
+#define KEY_QOS_PIN     22
+#define MAX_PINS        30
+#define QUEUE_SIZE      64
+#define KEY_INTERVAL_MS 400
+
+static bool console_raw;
+static struct termios saved_termios;
+
+// Typed or queued keys not yet seen, and keys left for getchar_timeout_us()
+static char pending[QUEUE_SIZE];
+static size_t pending_len;
+static char unclaimed[QUEUE_SIZE];
+static size_t unclaimed_len;
+static uint64_t last_key_us;
+
+static bool pin_pressed[MAX_PINS];      // Latched until gpio_get() reads it
+static gpio_irq_callback_t irq_callback;
+static uint32_t irq_mask[MAX_PINS];
+
+cyw43_t cyw43_state;
+
+static struct netif loopback;
+struct netif *netif_default;
+
+// Console
+
+static void restore_console(void) {
+    if (console_raw) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+        console_raw = false;
+    }
+}
+
+// Ctrl-C: put the terminal back before going
+static void on_interrupt(int sig) {
+    if (console_raw) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+    }
+    _exit(128 + sig);
+}
+
+bool stdio_init_all(void) {
+    setvbuf(stdout, NULL, _IONBF, 0);
+    // Keys take effect without Enter when run from a terminal
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved_termios) == 0) {
+        struct termios raw = saved_termios;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0) {
+            console_raw = true;
+            atexit(restore_console);
+            signal(SIGINT, on_interrupt);
+            signal(SIGTERM, on_interrupt);
+        }
+    }
+    return true;
+}
+
+static void queue_keys(const char *keys, size_t n) {
+    for (size_t i = 0; i < n && pending_len < QUEUE_SIZE; i++) {
+        pending[pending_len++] = keys[i];
+    }
+}
+
+void pico_host_press(const char *keys) {
+    queue_keys(keys, strlen(keys));
+}
+
+static void press_pin(uint pin) {
+    pin_pressed[pin] = true;
+    if (irq_callback && (irq_mask[pin] & GPIO_IRQ_EDGE_FALL)) {
+        irq_callback(pin, GPIO_IRQ_EDGE_FALL);
+    }
+}
+
+static void handle_key(char key) {
+    switch (key) {
+        case 'b':
+            press_pin(KEY_BLOCK_PIN);
+            break;
+        case 'q':
+            press_pin(KEY_QOS_PIN);
+            break;
+        case 'x':
+            printf("\n[HOST] Exit requested\n");
+            exit(0);
+        default:
+            if (unclaimed_len < QUEUE_SIZE) {
+                unclaimed[unclaimed_len++] = key;
+            }
+            break;
+    }
+}
+
+// Take whatever keys are waiting, without blocking
+static void poll_console(void) {
+    char buf[16];
+    struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+    while (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+        ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+        if (n <= 0) {
+            break;      // EOF (stdin redirected from /dev/null or a finished pipe)
+        }
+        queue_keys(buf, (size_t)n);
+    }
+    uint64_t now = time_us_64();
+    if (pending_len > 0 && (last_key_us == 0 || now - last_key_us >= KEY_INTERVAL_MS * 1000u)) {
+        char key = pending[0];
+        memmove(pending, pending + 1, --pending_len);
+        last_key_us = now;
+        handle_key(key);
+    }
+}
+
+int getchar_timeout_us(uint32_t timeout_us) {
+    uint64_t deadline = time_us_64() + timeout_us;
+    for (;;) {
+        poll_console();
+        if (unclaimed_len > 0) {
+            int c = (unsigned char)unclaimed[0];
+            memmove(unclaimed, unclaimed + 1, --unclaimed_len);
+            return c;
+        }
+        if (time_us_64() >= deadline) {
+            return PICO_ERROR_TIMEOUT;
+        }
+        sleep_us(1000);
+    }
+}
+
+// GPIO inputs (sd_emu.c has the outputs, which it watches for chip select)
+
+void gpio_pull_up(uint gpio) {
+    (void)gpio;
+}
+
+bool gpio_get(uint gpio) {
+    poll_console();
+    if (gpio < MAX_PINS && pin_pressed[gpio]) {
+        pin_pressed[gpio] = false;
+        return false;       // Pulled up: pressed reads low
+    }
+    return true;
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled,
+                                        gpio_irq_callback_t callback) {
+    if (gpio < MAX_PINS) {
+        irq_mask[gpio] = enabled ? event_mask : 0;
+    }
+    irq_callback = callback;
+}
+
+// CYW43: no radio, the loopback interface is the station
+
+int cyw43_arch_init_with_country(uint32_t country) {
+    (void)country;
+    cyw43_state.link_status = CYW43_LINK_DOWN;
+    return 0;
+}
+
+void cyw43_arch_enable_sta_mode(void) {
+}
+
+int cyw43_arch_wifi_connect_timeout_ms(const char *ssid, const char *pw, uint32_t auth, uint32_t timeout_ms) {
+    (void)ssid;
+    (void)pw;
+    (void)auth;
+    (void)timeout_ms;
+    ip4addr_aton("127.0.0.1", &loopback.ip_addr);
+    ip4addr_aton("255.0.0.0", &loopback.netmask);
+    ip4addr_aton("127.0.0.1", &loopback.gw);
+    netif_default = &loopback;
+    cyw43_state.link_status = CYW43_LINK_UP;
+    return 0;
+}
+
+int cyw43_tcpip_link_status(cyw43_t *self, int itf) {
+    (void)itf;
+    return self->link_status;
+}
+
+int cyw43_wifi_get_rssi(cyw43_t *self, int32_t *rssi) {
+    if (self->link_status != CYW43_LINK_UP) {
+        return -1;
+    }
+    *rssi = -40;
+    return 0;
+}
+
+void cyw43_arch_poll(void) {
+    poll_console();
+}
+
+// lwIP address helpers
+
+char *ip4addr_ntoa(const ip4_addr_t *addr) {
+    static char text[16];
+    struct in_addr in = { .s_addr = addr->addr };
+    return (char *)inet_ntop(AF_INET, &in, text, sizeof(text));
+}
+
+int ip4addr_aton(const char *cp, ip4_addr_t *addr) {
+    struct in_addr in;
+    if (inet_pton(AF_INET, cp, &in) != 1) {
+        return 0;
+    }
+    addr->addr = in.s_addr;
+    return 1;
+}
+
+uint32_t get_rand_32(void) {
+    static bool seeded;
+    if (!seeded) {
+        srand((unsigned)(time(NULL) ^ getpid()));
+        seeded = true;
+    }
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
@@ -0,0 +1,9 @@
+// pico_host.h - Native publisher/subscriber runtime (see pico_host.c)
+
+#ifndef PICO_HOST_H
+#define PICO_HOST_H
+
+// Queue console keys as if typed (e.g. "b" to start a block transfer)
+void pico_host_press(const char *keys);
+
+#endif // PICO_HOST_H
@@ -0,0 +1,242 @@
+// pipeline_bench.c - Serial vs. dual-core publisher pipeline
+//
+// Models the publisher's file send with the real block_pipeline.c ring
+// (pthreads standing in for core1). The SD card is a read delay at a given
+// throughput; the network is a per-packet send delay (UDP send for QoS 0,
+// plus the PUBACK round trip for QoS 1). Packets are built for real: header,
+// data, CRC-32C trailer, and Reed-Solomon parity (K=8, M=2).
+//
+//   serial     read the whole file, then build and send chunk by chunk
+//              (the non-pipelined send_image_file_qos path)
+//   pipelined  the producer thread reads 8 chunks at a time and builds
+//              packets into the ring while the main thread sends
+//
+// Reported: time to first chunk on the wire, total time, goodput (file
+// bytes over the total time) and steady-state goodput (file bytes over the
+// time after the first chunk). The publisher's 50 ms inter-chunk pacing is
+// left out by default (it delays both paths by the same amount); pass it as
+// the second argument to include it.
+//
+// Usage: pipeline_bench [file_bytes] [pacing_ms]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "block_pipeline.h"
+#include "block_fec.h"
+#include "crc32c.h"
+
+#define CHUNK_DATA_SIZE   120
+#define HEADER_SIZE       8
+#define READ_CHUNKS       8      // BLOCK_PIPELINE_READ_CHUNKS
+#define FEC_K             8
+#define FEC_M             2
+#define MAX_FILE          150000
+#define SYMBOL_SIZE       BLOCK_FEC_SYMBOL_SIZE(CHUNK_DATA_SIZE)
+
+typedef struct {
+    const char *name;
+    double sd_kbps;         // SD read throughput, KB/s
+    unsigned send_us;       // Time to publish one packet
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "SD 400kHz, QoS 0",   45,    800 },
+    { "SD 12MHz, QoS 0",    1200,  800 },
+    { "SD 400kHz, QoS 1",   45,    3000 },
+};
+
+typedef struct {
+    const scenario_t *sc;
+    size_t file_len;
+    unsigned pacing_ms;
+    uint16_t total_parts;
+    uint16_t part;
+    uint32_t crc;
+    uint8_t parity[FEC_M][SYMBOL_SIZE];
+    uint64_t start_us;
+    uint64_t first_us;      // Serial path: first packet sent
+    unsigned packets;
+} bench_t;
+
+static uint8_t file[MAX_FILE];
+static uint8_t whole_file[MAX_FILE];   // Serial path reads everything first
+
+static void delay_us(uint64_t us) {
+    struct timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static void sd_read(const bench_t *b, uint8_t *out, size_t offset, size_t len) {
+    memcpy(out, file + offset, len);
+    delay_us((uint64_t)(len * 1000.0 / b->sc->sd_kbps / 1.024));
+}
+
+static void net_send(bench_t *b, const uint8_t *packet, size_t len) {
+    (void)packet;
+    (void)len;
+    if (b->packets++ == 0) b->first_us = block_pipeline_now_us() - b->start_us;
+    delay_us(b->sc->send_us + b->pacing_ms * 1000u);
+}
+
+static size_t build_packet(uint8_t *packet, uint16_t part, uint16_t total, const uint8_t *data,
+                           size_t len, bool last, uint32_t digest) {
+    memcpy(packet, &part, 2);
+    memcpy(packet + 2, &part, 2);
+    memcpy(packet + 4, &total, 2);
+    uint16_t l = (uint16_t)len;
+    memcpy(packet + 6, &l, 2);
+    memcpy(packet + HEADER_SIZE, data, len);
+    size_t pos = HEADER_SIZE + len;
+    packet[pos++] = 2;
+    packet[pos++] = 0x02 | (last ? 0x01 : 0);
+    if (last) {
+        memcpy(packet + pos, &digest, 4);
+        pos += 4;
+    }
+    packet[pos++] = FEC_K;
+    packet[pos++] = FEC_M;
+    uint32_t crc = crc32c(packet, pos);
+    memcpy(packet + pos, &crc, 4);
+    return pos + 4;
+}
+
+typedef int (*emit_fn_t)(bench_t *b, const uint8_t *packet, size_t len);
+
+// Build one data chunk (and its group's parity) - the work send_transfer_chunk does
+static int chunk_packets(bench_t *b, const uint8_t *data, size_t len, emit_fn_t emit) {
+    uint8_t packet[BLOCK_PIPELINE_SLOT_SIZE];
+    uint16_t part = ++b->part;
+    bool last = (part == b->total_parts);
+
+    if (emit(b, packet, build_packet(packet, part, b->total_parts, data, len, last, b->crc)) != 0) {
+        return -1;
+    }
+
+    uint8_t *parity[FEC_M] = { b->parity[0], b->parity[1] };
+    block_fec_encode_chunk(FEC_M, (part - 1) % FEC_K, data, len, parity, CHUNK_DATA_SIZE);
+    if (part % FEC_K == 0 || last) {
+        for (int row = 0; row < FEC_M; row++) {
+            uint16_t ppart = b->total_parts + ((part - 1) / FEC_K) * FEC_M + row + 1;
+            if (emit(b, packet, build_packet(packet, ppart, b->total_parts, b->parity[row],
+                                             SYMBOL_SIZE, last, b->crc)) != 0) {
+                return -1;
+            }
+            memset(b->parity[row], 0, SYMBOL_SIZE);
+        }
+    }
+    return 0;
+}
+
+static int emit_direct(bench_t *b, const uint8_t *packet, size_t len) {
+    net_send(b, packet, len);
+    return 0;
+}
+
+static int emit_ring(bench_t *b, const uint8_t *packet, size_t len) {
+    (void)b;
+    block_pipeline_slot_t *slot = block_pipeline_acquire();
+    if (slot == NULL) return -1;
+    memcpy(slot->data, packet, len);
+    slot->len = (uint16_t)len;
+    block_pipeline_commit();
+    return 0;
+}
+
+static void bench_reset(bench_t *b) {
+    b->part = 0;
+    b->crc = 0;
+    b->packets = 0;
+    memset(b->parity, 0, sizeof(b->parity));
+    b->start_us = block_pipeline_now_us();
+}
+
+static uint64_t run_serial(bench_t *b) {
+    bench_reset(b);
+    for (size_t off = 0; off < b->file_len; off += READ_CHUNKS * CHUNK_DATA_SIZE) {
+        size_t n = b->file_len - off;
+        if (n > READ_CHUNKS * CHUNK_DATA_SIZE) n = READ_CHUNKS * CHUNK_DATA_SIZE;
+        sd_read(b, whole_file + off, off, n);
+    }
+    b->crc = crc32c(whole_file, b->file_len);
+    for (size_t off = 0; off < b->file_len; off += CHUNK_DATA_SIZE) {
+        size_t n = b->file_len - off < CHUNK_DATA_SIZE ? b->file_len - off : CHUNK_DATA_SIZE;
+        chunk_packets(b, whole_file + off, n, emit_direct);
+    }
+    return block_pipeline_now_us() - b->start_us;
+}
+
+static int produce(void *ctx) {
+    bench_t *b = (bench_t *)ctx;
+    uint8_t buf[READ_CHUNKS * CHUNK_DATA_SIZE];
+    for (size_t off = 0; off < b->file_len; off += sizeof(buf)) {
+        size_t n = b->file_len - off < sizeof(buf) ? b->file_len - off : sizeof(buf);
+        sd_read(b, buf, off, n);
+        b->crc = crc32c_update(b->crc, buf, n);
+        for (size_t pos = 0; pos < n; pos += CHUNK_DATA_SIZE) {
+            size_t len = n - pos < CHUNK_DATA_SIZE ? n - pos : CHUNK_DATA_SIZE;
+            if (chunk_packets(b, buf + pos, len, emit_ring) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+static int consume(void *ctx, const block_pipeline_slot_t *slot) {
+    net_send((bench_t *)ctx, slot->data, slot->len);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    size_t file_len = argc > 1 ? strtoul(argv[1], NULL, 0) : 30000;
+    unsigned pacing_ms = argc > 2 ? (unsigned)atoi(argv[2]) : 0;
+    if (file_len == 0 || file_len > MAX_FILE) {
+        fprintf(stderr, "Usage: %s [file_bytes <= %d] [pacing_ms]\n", argv[0], MAX_FILE);
+        return 1;
+    }
+    for (size_t i = 0; i < file_len; i++) {
+        file[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+
+    bench_t b = {0};
+    b.file_len = file_len;
+    b.pacing_ms = pacing_ms;
+    b.total_parts = (file_len + CHUNK_DATA_SIZE - 1) / CHUNK_DATA_SIZE;
+
+    printf("File: %zu bytes, %d chunks + FEC K=%d M=%d, pacing %u ms\n\n",
+           file_len, b.total_parts, FEC_K, FEC_M, pacing_ms);
+    printf("%-18s %-10s %12s %8s %12s %12s\n", "scenario", "mode", "first chunk", "total s",
+           "goodput KB/s", "steady KB/s");
+
+    int failures = 0;
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        b.sc = &scenarios[s];
+
+        uint64_t serial_us = run_serial(&b);
+        uint32_t serial_crc = b.crc;
+        double steady = file_len / 1024.0 / ((serial_us - b.first_us) / 1e6);
+        printf("%-18s %-10s %9.1f ms %8.2f %12.1f %12.1f\n", b.sc->name, "serial",
+               b.first_us / 1000.0, serial_us / 1e6, file_len / 1024.0 / (serial_us / 1e6), steady);
+
+        block_pipeline_stats_t stats;
+        bench_reset(&b);
+        if (block_pipeline_run(produce, consume, NULL, &b, &stats) != 0 || b.crc != serial_crc) {
+            failures++;
+        }
+        steady = file_len / 1024.0 / ((stats.elapsed_us - stats.first_packet_us) / 1e6);
+        printf("%-18s %-10s %9.1f ms %8.2f %12.1f %12.1f   (waits: producer %u, consumer %u)\n",
+               "", "pipelined", stats.first_packet_us / 1000.0, stats.elapsed_us / 1e6,
+               file_len / 1024.0 / (stats.elapsed_us / 1e6), steady,
+               stats.producer_waits, stats.consumer_waits);
+    }
+
+    if (failures) {
+        printf("\n❌ %d pipelined runs failed\n", failures);
+        return 1;
+    }
+    printf("\n✅ Pipelined runs sent every packet with the same digest\n");
+    return 0;
+}
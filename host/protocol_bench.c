@@ -0,0 +1,356 @@
+// protocol_bench.c - CPU cost of the MQTT-SN and block layers per chunk
+//
+// The real client (mqttsn_client.c, with Paho's serializers) publishes a
+// block with send_block_transfer_qos() over the in-memory loopback
+// transport and its inline gateway (transport_loopback.h); each PUBLISH
+// the gateway forwards is deserialized as subscriber_main.c does and
+// handed to process_block_chunk(), which saves the block to an emulated
+// card. No sockets, no kernel, and on sim_clock.c's virtual clock the
+// chunk pacing takes no time, so what is left is the protocol work:
+// header building, CRCs, serialization, the QoS handshakes, parsing,
+// reassembly and the save. Logging goes to /dev/null but is still
+// formatted, as it would be on the UART.
+//
+// Each configuration runs -N times and reports the run with the least
+// process CPU time, split between the subscriber side (the gateway's
+// deliver callback and the queued card writes) and the publisher side
+// (everything else).
+//
+//   protocol_bench_128 [-q 0,1,2] [-s 10000,50000,100000] [-N runs] [-j] [-n] [-F spec]
+//
+// -F applies a fault injection spec to the client's transport (built
+// with -DFAULT_INJECT=ON; see fault_inject.h). The inline gateway only
+// forwards at QoS 0 and RAM blocks have no NACK repair, so chunk loss
+// leaves a block incomplete; ack loss shows up as retries.
+//
+// Columns: chunks is the chunk packets delivered; packets and wire_bytes
+// count the client's datagrams both ways; cpu_ms is the whole transfer;
+// the ns_per_ figures divide it by chunks delivered and file bytes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "pico/stdlib.h"
+#include "block_transfer.h"
+#include "mqttsn_client.h"
+#include "mqttsn_adapter.h"
+#include "transport_loopback.h"
+#include "fault_inject.h"
+#include "sd_card.h"
+#include "sd_emu.h"
+#include "sd_write_queue.h"
+#include "sim_clock.h"
+#include "ff.h"
+#include "MQTTSNPacket.h"
+
+#define CARD_SECTORS    (64u * 2048u)       // 64MB
+#define MAX_LIST        8
+#define MAX_FILE_SIZE   BLOCK_BUFFER_SIZE
+#define LOCAL_PORT      10000
+#define SETTLE_MS       121000              // Past the subscriber's 120 s block timeout
+
+#define TOPIC_CHUNKS    "pico/chunks"
+
+extern unsigned short mqttsn_chunks_topicid;
+
+typedef struct {
+    uint32_t chunk_size;
+    int qos;
+    uint32_t file_bytes;
+    bool complete;
+    uint32_t chunks;
+    uint32_t packets;
+    uint32_t wire_bytes;
+    double cpu_ms;
+    double pub_ns_per_chunk;
+    double sub_ns_per_chunk;
+    double ns_per_chunk;
+    double ns_per_byte;
+} result_t;
+
+static uint8_t file_data[MAX_FILE_SIZE];
+static uint8_t readback[MAX_FILE_SIZE];
+static uint32_t chunks_delivered;
+static double subscriber_ns;
+static FILE *out;
+
+void cyw43_arch_poll(void) {
+}
+
+// No console
+int getchar_timeout_us(uint32_t timeout_us) {
+    (void)timeout_us;
+    return PICO_ERROR_TIMEOUT;
+}
+
+// Block ids the same every run
+uint32_t get_rand_32(void) {
+    static uint32_t state = 0x2545F491u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static double cpu_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Subscriber side: a forwarded PUBLISH, handled as subscriber_main.c does
+static void deliver(const uint8_t *packet, size_t len, void *ctx) {
+    (void)ctx;
+    double start = cpu_ns(CLOCK_THREAD_CPUTIME_ID);
+    unsigned char dup, retained;
+    int qos, payloadlen;
+    unsigned short msgid;
+    MQTTSN_topicid topic;
+    unsigned char *payload;
+    if (MQTTSNDeserialize_publish(&dup, &qos, &retained, &msgid, &topic, &payload, &payloadlen,
+                                  (unsigned char *)packet, (int)len) == 1 &&
+        topic.type == MQTTSN_TOPIC_TYPE_NORMAL && topic.data.id == mqttsn_chunks_topicid) {
+        chunks_delivered++;
+        process_block_chunk(payload, (size_t)payloadlen);
+    }
+    subscriber_ns += cpu_ns(CLOCK_THREAD_CPUTIME_ID) - start;
+}
+
+// Card
+
+static int fresh_card(void) {
+    if (sd_emu_init(CARD_SECTORS, NULL) != 0 || sd_card_init() != 0) {
+        return -1;
+    }
+    if (sd_card_format_fat32() != 0) {
+        return -1;
+    }
+    return f_mkdir("received") == FR_OK ? 0 : -1;
+}
+
+// Whatever the subscriber saved must be the file that was sent
+static bool received_intact(uint32_t size) {
+    DIR dir;
+    FILINFO info;
+    bool intact = false;
+    if (f_opendir(&dir, "received") != FR_OK) {
+        return false;
+    }
+    while (f_readdir(&dir, &info) == FR_OK && info.fname[0] != '\0') {
+        char path[300];
+        FIL file;
+        UINT got = 0;
+        snprintf(path, sizeof(path), "received/%s", info.fname);
+        if (info.fsize != size || f_open(&file, path, FA_READ) != FR_OK) {
+            continue;
+        }
+        if (f_read(&file, readback, size, &got) == FR_OK && got == size &&
+            memcmp(readback, file_data, size) == 0) {
+            intact = true;
+        }
+        f_close(&file);
+    }
+    f_closedir(&dir);
+    return intact;
+}
+
+// One run
+
+static int run(int qos, uint32_t size, result_t *r) {
+    if (fresh_card() != 0) {
+        fprintf(stderr, "emulated card not usable\n");
+        return -1;
+    }
+    // A JPEG by its magic, so no compression; the body is incompressible
+    for (uint32_t i = 0; i < size; i++) {
+        file_data[i] = (uint8_t)((i + size) * 2654435761u >> 24);
+    }
+    file_data[0] = 0xFF;
+    file_data[1] = 0xD8;
+    file_data[2] = 0xFF;
+
+    block_transfer_init();
+    loopback_stats_t before = *loopback_get_stats();
+    chunks_delivered = 0;
+    subscriber_ns = 0;
+
+    double start = cpu_ns(CLOCK_PROCESS_CPUTIME_ID);
+    int ret = send_block_transfer_qos(TOPIC_CHUNKS, file_data, size, (uint8_t)qos);
+    sim_clock_run();
+    double save_start = cpu_ns(CLOCK_THREAD_CPUTIME_ID);
+    while (sd_write_queue_poll()) {
+    }
+    subscriber_ns += cpu_ns(CLOCK_THREAD_CPUTIME_ID) - save_start;
+    double cpu = cpu_ns(CLOCK_PROCESS_CPUTIME_ID) - start;
+    const loopback_stats_t *after = loopback_get_stats();
+
+    memset(r, 0, sizeof(*r));
+    r->chunk_size = BLOCK_CHUNK_SIZE;
+    r->qos = qos;
+    r->file_bytes = size;
+    r->complete = ret == 0 && received_intact(size);
+    r->chunks = chunks_delivered;
+    r->packets = (after->tx_packets - before.tx_packets) + (after->rx_packets - before.rx_packets);
+    r->wire_bytes = (after->tx_bytes - before.tx_bytes) + (after->rx_bytes - before.rx_bytes);
+    r->cpu_ms = cpu / 1e6;
+    if (r->chunks > 0) {
+        r->pub_ns_per_chunk = (cpu - subscriber_ns) / r->chunks;
+        r->sub_ns_per_chunk = subscriber_ns / r->chunks;
+        r->ns_per_chunk = cpu / r->chunks;
+    }
+    r->ns_per_byte = cpu / size;
+
+    // Let a stalled block run into the subscriber's timeout so the next run starts clean
+    if (!r->complete) {
+        sleep_ms(SETTLE_MS);
+        block_transfer_check_timeout();
+        while (sd_write_queue_poll()) {
+        }
+    }
+    return 0;
+}
+
+// Output
+
+static const char *csv_header =
+    "chunk_size,qos,file_bytes,complete,chunks,packets,wire_bytes,cpu_ms,"
+    "pub_ns_per_chunk,sub_ns_per_chunk,ns_per_chunk,ns_per_byte";
+
+static void print_csv(const result_t *r) {
+    fprintf(out, "%u,%d,%u,%d,%u,%u,%u,%.3f,%.0f,%.0f,%.0f,%.1f\n",
+            r->chunk_size, r->qos, r->file_bytes, r->complete, r->chunks, r->packets,
+            r->wire_bytes, r->cpu_ms, r->pub_ns_per_chunk, r->sub_ns_per_chunk,
+            r->ns_per_chunk, r->ns_per_byte);
+}
+
+static void print_json(const result_t *r) {
+    fprintf(out, "{\"chunk_size\":%u,\"qos\":%d,\"file_bytes\":%u,\"complete\":%s,\"chunks\":%u,"
+            "\"packets\":%u,\"wire_bytes\":%u,\"cpu_ms\":%.3f,\"pub_ns_per_chunk\":%.0f,"
+            "\"sub_ns_per_chunk\":%.0f,\"ns_per_chunk\":%.0f,\"ns_per_byte\":%.1f}\n",
+            r->chunk_size, r->qos, r->file_bytes, r->complete ? "true" : "false", r->chunks,
+            r->packets, r->wire_bytes, r->cpu_ms, r->pub_ns_per_chunk, r->sub_ns_per_chunk,
+            r->ns_per_chunk, r->ns_per_byte);
+}
+
+static int parse_list(const char *text, double *values) {
+    int n = 0;
+    char *end;
+    while (*text != '\0' && n < MAX_LIST) {
+        values[n++] = strtod(text, &end);
+        if (end == text) {
+            return -1;
+        }
+        text = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-q 0,1,2] [-s 10000,50000,100000] [-N runs] [-j] [-n] [-F spec]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    double qos_list[MAX_LIST] = { 0, 1, 2 };
+    double size_list[MAX_LIST] = { 10000, 50000, 100000 };
+    int qos_count = 3, size_count = 3;
+    uint32_t runs = 5;
+    bool json = false, header = true;
+    const char *fault_spec = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "q:s:N:jnF:")) != -1) {
+        switch (opt) {
+            case 'q': qos_count = parse_list(optarg, qos_list); break;
+            case 's': size_count = parse_list(optarg, size_list); break;
+            case 'N': runs = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'j': json = true; break;
+            case 'n': header = false; break;
+            case 'F': fault_spec = optarg; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (qos_count <= 0 || size_count <= 0 || runs == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    for (int i = 0; i < size_count; i++) {
+        if (size_list[i] < 1 || size_list[i] > MAX_FILE_SIZE) {
+            fprintf(stderr, "File sizes must be 1..%d bytes\n", MAX_FILE_SIZE);
+            return 1;
+        }
+    }
+    for (int i = 0; i < qos_count; i++) {
+        if (qos_list[i] < 0 || qos_list[i] > 2) {
+            fprintf(stderr, "QoS must be 0, 1 or 2\n");
+            return 1;
+        }
+    }
+
+    // Results on stdout; the firmware's own logging goes nowhere
+    int results_fd = dup(STDOUT_FILENO);
+    out = fdopen(results_fd, "w");
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (out == NULL || null_fd < 0) {
+        perror("stdout");
+        return 1;
+    }
+    fflush(stdout);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+
+    if (fault_spec != NULL) {
+#if FAULT_INJECT_ENABLED
+        if (fault_inject_configure(fault_spec) != 0) {
+            fprintf(stderr, "Bad fault spec '%s'\n", fault_spec);
+            return 1;
+        }
+#else
+        fprintf(stderr, "Built without fault injection (cmake -DFAULT_INJECT=ON)\n");
+        return 1;
+#endif
+    }
+
+    block_transfer_set_compression(false);
+    block_transfer_set_delta(false);
+
+    mqttsn_transport_set(&transport_loopback);
+    loopback_gateway_attach(deliver, NULL);
+    if (mqttsn_demo_init(LOCAL_PORT, "protocol_bench") != 0 || mqttsn_chunks_topicid == 0) {
+        fprintf(stderr, "MQTT-SN client did not connect over the loopback\n");
+        return 1;
+    }
+
+    if (!json && header) {
+        fprintf(out, "%s\n", csv_header);
+    }
+    for (int s = 0; s < size_count; s++) {
+        for (int q = 0; q < qos_count; q++) {
+            result_t best;
+            for (uint32_t n = 0; n < runs; n++) {
+                result_t r;
+                if (run((int)qos_list[q], (uint32_t)size_list[s], &r) != 0) {
+                    return 1;
+                }
+                if (n == 0 || r.cpu_ms < best.cpu_ms) {
+                    best = r;
+                }
+            }
+            if (json) {
+                print_json(&best);
+            } else {
+                print_csv(&best);
+            }
+            fflush(out);
+        }
+    }
+    mqttsn_demo_close();
+    return 0;
+}
@@ -0,0 +1,530 @@
+// sd_emu.c - SPI-mode SD card emulator (see sd_emu.h)
+
+#include "sd_emu.h"
+#include "sim_clock.h"
+#include "hardware/spi.h"
+#include "hardware/gpio.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define SECTOR_SIZE 512
+#define CLK_PERI    125000000u  // RP2040 default peripheral clock
+
+typedef enum {
+    ST_IDLE,        // Waiting for a command
+    ST_READ,        // CMD9/17/18: data block pending or streaming
+    ST_WRITE_WAIT,  // CMD24/25: waiting for a data or stop token
+    ST_WRITE_DATA,  // Receiving a block and its CRC
+    ST_BUSY,        // Programming: MISO held low until busy_until_ns
+} emu_state_t;
+
+static const sd_emu_timing_t default_timing = {
+    .call_ns = 500,
+    .access_us = 250,
+    .stream_us = 40,
+    .program_single_us = 900,
+    .program_multi_us = 120,
+    .stop_us = 300,
+    .stop_no_erase_us = 1200,
+};
+
+static struct {
+    uint8_t *data;
+    uint32_t sectors;
+    bool mapped;                // data is an mmap()ed image file
+    uint8_t csd[16];
+    sd_emu_timing_t t;
+
+    uint32_t baud;
+    bool selected;
+    uint32_t stable_hz;     // Bus clean up to this clock, 0 = always
+    double error_rate;      // Per data byte at the current clock
+    uint32_t rng;
+    double cut_ns;          // Power cut at this time, 0 = never
+    bool off;               // Unpowered: the bus is ignored
+
+    emu_state_t state;
+    emu_state_t after_busy;
+    double busy_until_ns;
+
+    uint8_t cmd[6];
+    int cmd_len;
+    bool idle;              // In idle state until ACMD41 completes
+    bool crc_on;            // CMD59
+    bool app_cmd;           // Last command was CMD55
+    int acmd41_polls;
+
+    uint8_t out[SECTOR_SIZE + 8];   // Bytes queued for MISO
+    size_t out_head;
+    size_t out_len;
+
+    bool multi;             // CMD18/CMD25 rather than CMD17/CMD24
+    bool reg_read;          // CMD9: the block is the CSD
+    bool block_loaded;      // Current read block has been queued
+    uint32_t block;
+    double ready_ns;        // Read data available from
+
+    uint8_t wbuf[SECTOR_SIZE + 2];
+    size_t wlen;
+    uint32_t erase_count;   // ACMD23
+    bool pre_erased;
+
+    sd_emu_stats_t stats;
+} card;
+
+// CRC-16/XMODEM, the SD data block CRC
+static uint16_t crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// CRC7 of a command frame
+static uint8_t crc7(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t d = data[i];
+        for (int b = 0; b < 8; b++) {
+            crc <<= 1;
+            if ((d ^ crc) & 0x80) crc ^= 0x09;
+            d <<= 1;
+        }
+    }
+    return crc & 0x7F;
+}
+
+// Flip one bit of a data byte with the current error rate
+static uint8_t line_noise(uint8_t b) {
+    if (card.error_rate <= 0) return b;
+    card.rng ^= card.rng << 13;
+    card.rng ^= card.rng >> 17;
+    card.rng ^= card.rng << 5;
+    if (card.rng / 4294967296.0 < card.error_rate) {
+        card.stats.corrupted_bytes++;
+        b ^= 1u << (card.rng & 7);
+    }
+    return b;
+}
+
+static void update_error_rate(void) {
+    // Grows with the square of the overshoot: 20.8MHz on a 14MHz bus corrupts
+    // about one block in eight, 15.6MHz one in 150
+    double over = card.stable_hz ? (double)card.baud / card.stable_hz - 1.0 : 0.0;
+    card.error_rate = over > 0 ? over * over * 1e-3 : 0.0;
+}
+
+static void push(uint8_t b) {
+    if (card.out_head + card.out_len < sizeof(card.out)) {
+        card.out[card.out_head + card.out_len++] = b;
+    }
+}
+
+static void push_block(const uint8_t *data, size_t len) {
+    uint16_t crc = crc16(data, len);
+    push(0xFE);
+    for (size_t i = 0; i < len; i++) push(line_noise(data[i]));
+    push(crc >> 8);
+    push(crc & 0xFF);
+}
+
+static void enter_busy(unsigned us, emu_state_t next) {
+    card.busy_until_ns = sim_clock_ns() + us * 1000.0;
+    card.stats.busy_us += us;
+    card.after_busy = next;
+    card.state = ST_BUSY;
+}
+
+static void start_read(uint32_t block, bool multi, bool reg) {
+    card.state = ST_READ;
+    card.block = block;
+    card.multi = multi;
+    card.reg_read = reg;
+    card.block_loaded = false;
+    card.ready_ns = sim_clock_ns() + card.t.access_us * 1000.0;
+    card.stats.busy_us += card.t.access_us;
+}
+
+static void execute(void) {
+    uint8_t idx = card.cmd[0] & 0x3F;
+    uint32_t arg = ((uint32_t)card.cmd[1] << 24) | ((uint32_t)card.cmd[2] << 16) |
+                   ((uint32_t)card.cmd[3] << 8) | card.cmd[4];
+    bool app = card.app_cmd;
+    card.app_cmd = false;
+    card.stats.commands++;
+
+    // CMD0 and CMD8 always carry a checked CRC; everything else once CMD59 is on
+    bool bad_crc = (card.crc_on || idx == 0 || idx == 8) &&
+                   (card.cmd[5] >> 1) != crc7(card.cmd, 5);
+    if (bad_crc) {
+        card.stats.crc_errors++;
+        push(0xFF);
+        push((card.idle ? 0x01 : 0x00) | 0x08);     // Command CRC error
+        return;
+    }
+
+    if (idx == 12) {
+        // Stop transmission: one stuff byte (deliberately R1-shaped), R1, short busy
+        card.out_head = card.out_len = 0;
+        push(0x3F);
+        push(0x00);
+        enter_busy(20, ST_IDLE);
+        return;
+    }
+
+    uint8_t r1 = card.idle ? 0x01 : 0x00;
+    push(0xFF);     // N_CR: one byte before the response
+
+    switch (idx) {
+        case 0:
+            card.idle = true;
+            card.acmd41_polls = 0;
+            card.state = ST_IDLE;
+            push(0x01);
+            break;
+        case 8:
+            push(r1);
+            push(0x00);
+            push(0x00);
+            push(0x01);             // 2.7-3.6V accepted
+            push(arg & 0xFF);       // Check pattern echoed
+            break;
+        case 55:
+            card.app_cmd = true;
+            push(r1);
+            break;
+        case 41:
+            if (app && ++card.acmd41_polls >= 3) card.idle = false;
+            push(card.idle ? 0x01 : 0x00);
+            break;
+        case 23:
+            if (app) card.erase_count = arg & 0x7FFFFF;
+            push(app ? r1 : (r1 | 0x04));
+            break;
+        case 59:
+            card.crc_on = arg & 1;
+            push(r1);
+            break;
+        case 9:
+            push(r1);
+            start_read(0, false, true);
+            break;
+        case 17:
+        case 18:
+            if (arg >= card.sectors) {
+                push(r1 | 0x40);    // Parameter error
+                break;
+            }
+            push(r1);
+            start_read(arg, idx == 18, false);
+            break;
+        case 24:
+        case 25:
+            if (arg >= card.sectors) {
+                push(r1 | 0x40);
+                break;
+            }
+            push(r1);
+            card.state = ST_WRITE_WAIT;
+            card.block = arg;
+            card.multi = (idx == 25);
+            card.pre_erased = card.multi && card.erase_count > 0;
+            card.erase_count = 0;
+            break;
+        default:
+            push(r1 | 0x04);        // Illegal command
+            break;
+    }
+}
+
+static uint8_t pop(void) {
+    uint8_t b = card.out[card.out_head++];
+    if (--card.out_len == 0) card.out_head = 0;
+    return b;
+}
+
+// MISO for the next byte
+static uint8_t produce(void) {
+    if (card.out_len > 0) return pop();
+
+    switch (card.state) {
+        case ST_READ:
+            if (card.block_loaded) {
+                // Previous block fully clocked out
+                card.block_loaded = false;
+                if (!card.multi || ++card.block >= card.sectors) {
+                    card.state = ST_IDLE;
+                    return 0xFF;
+                }
+                card.ready_ns = sim_clock_ns() + card.t.stream_us * 1000.0;
+                card.stats.busy_us += card.t.stream_us;
+            }
+            if (sim_clock_ns() < card.ready_ns) return 0xFF;
+            if (card.reg_read) {
+                push_block(card.csd, sizeof(card.csd));
+            } else {
+                push_block(card.data + (size_t)card.block * SECTOR_SIZE, SECTOR_SIZE);
+                card.stats.blocks_read++;
+            }
+            card.block_loaded = true;
+            return pop();
+        case ST_BUSY:
+            if (sim_clock_ns() < card.busy_until_ns) return 0x00;
+            card.state = card.after_busy;
+            return 0xFF;
+        default:
+            return 0xFF;
+    }
+}
+
+// MOSI for the current byte
+static void consume(uint8_t in) {
+    switch (card.state) {
+        case ST_WRITE_WAIT:
+            if (in == (card.multi ? 0xFC : 0xFE)) {
+                card.state = ST_WRITE_DATA;
+                card.wlen = 0;
+            } else if (card.multi && in == 0xFD) {
+                enter_busy(card.pre_erased ? card.t.stop_us : card.t.stop_no_erase_us, ST_IDLE);
+            }
+            return;
+        case ST_WRITE_DATA:
+            card.wbuf[card.wlen] = card.wlen < SECTOR_SIZE ? line_noise(in) : in;
+            card.wlen++;
+            if (card.wlen == sizeof(card.wbuf) && card.crc_on &&
+                crc16(card.wbuf, SECTOR_SIZE) != ((card.wbuf[SECTOR_SIZE] << 8) | card.wbuf[SECTOR_SIZE + 1])) {
+                // Rejected: nothing is programmed
+                card.stats.crc_errors++;
+                push(0xEB);
+                enter_busy(5, card.multi ? ST_WRITE_WAIT : ST_IDLE);
+                return;
+            }
+            if (card.wlen == sizeof(card.wbuf)) {
+                memcpy(card.data + (size_t)card.block * SECTOR_SIZE, card.wbuf, SECTOR_SIZE);
+                card.stats.blocks_written++;
+                push(0xE5);         // Data accepted
+                if (card.multi) {
+                    enter_busy(card.t.program_multi_us, ST_WRITE_WAIT);
+                    if (++card.block >= card.sectors) card.state = ST_IDLE;
+                } else {
+                    enter_busy(card.t.program_single_us, ST_IDLE);
+                }
+            }
+            return;
+        case ST_BUSY:
+            return;
+        default:
+            break;
+    }
+
+    // Idle or streaming a read: look for a command frame
+    if (card.cmd_len == 0 && (in & 0xC0) != 0x40) return;
+    card.cmd[card.cmd_len++] = in;
+    if (card.cmd_len == 6) {
+        card.cmd_len = 0;
+        execute();
+    }
+}
+
+static uint8_t xfer(uint8_t in) {
+    sim_clock_charge_ns(8e9 / card.baud);
+    card.stats.spi_bytes++;
+    if (card.cut_ns > 0 && sim_clock_ns() >= card.cut_ns) card.off = true;
+    if (!card.selected || card.off) return 0xFF;
+    uint8_t out = produce();
+    consume(in);
+    return out;
+}
+
+static void release_data(void) {
+    if (card.mapped) {
+        munmap(card.data, (size_t)card.sectors * SECTOR_SIZE);
+    } else {
+        free(card.data);
+    }
+}
+
+static void setup_card(uint8_t *data, uint32_t sectors, bool mapped, const sd_emu_timing_t *timing) {
+    memset(&card, 0, sizeof(card));
+    card.data = data;
+    card.mapped = mapped;
+    card.sectors = sectors;
+    card.t = timing ? *timing : default_timing;
+    card.baud = 400000;
+    card.rng = 0x2545F491;
+
+    // CSD version 2.0: TRAN_SPEED 25MHz, READ_BL_LEN 9, C_SIZE in 512KB units
+    uint32_t c_size = sectors / 1024 - 1;
+    card.csd[0] = 0x40;
+    card.csd[3] = 0x32;
+    card.csd[5] = 0x59;
+    card.csd[7] = (c_size >> 16) & 0x3F;
+    card.csd[8] = (c_size >> 8) & 0xFF;
+    card.csd[9] = c_size & 0xFF;
+    card.csd[15] = 0x01;
+}
+
+int sd_emu_init(uint32_t sectors, const sd_emu_timing_t *timing) {
+    release_data();
+    uint8_t *data = calloc(sectors, SECTOR_SIZE);
+    setup_card(data, sectors, false, timing);
+    return data == NULL ? -1 : 0;
+}
+
+int sd_emu_init_image(const char *path, uint32_t sectors, const sd_emu_timing_t *timing) {
+    release_data();
+    card.data = NULL;
+    card.mapped = false;
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size >= SECTOR_SIZE * 1024) {
+        sectors = (uint32_t)(size / (SECTOR_SIZE * 1024)) * 1024;   // Whole 512KB C_SIZE units
+    } else if (ftruncate(fd, (off_t)sectors * SECTOR_SIZE) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    uint8_t *data = mmap(NULL, (size_t)sectors * SECTOR_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    setup_card(data, sectors, true, timing);
+    return 0;
+}
+
+void sd_emu_set_signal_limit(uint32_t stable_hz) {
+    card.stable_hz = stable_hz;
+    update_error_rate();
+}
+
+void sd_emu_power_cut_at(uint64_t us) {
+    card.cut_ns = us * 1e3;
+    if (card.cut_ns > 0 && sim_clock_ns() >= card.cut_ns) card.off = true;
+}
+
+bool sd_emu_powered(void) {
+    return !card.off;
+}
+
+void sd_emu_power_on(void) {
+    // Back from reset: only the contents, clock and configuration remain
+    card.cut_ns = 0;
+    card.off = false;
+    card.state = ST_IDLE;
+    card.cmd_len = 0;
+    card.idle = false;
+    card.crc_on = false;
+    card.app_cmd = false;
+    card.acmd41_polls = 0;
+    card.out_head = card.out_len = 0;
+    card.block_loaded = false;
+    card.wlen = 0;
+    card.erase_count = 0;
+    card.pre_erased = false;
+}
+
+uint64_t sd_emu_now_us(void) {
+    return (uint64_t)(sim_clock_ns() / 1000.0);
+}
+
+uint32_t sd_emu_baudrate(void) {
+    return card.baud;
+}
+
+void sd_emu_reset_stats(void) {
+    memset(&card.stats, 0, sizeof(card.stats));
+}
+
+void sd_emu_get_stats(sd_emu_stats_t *stats) {
+    *stats = card.stats;
+}
+
+uint8_t *sd_emu_sector(uint32_t sector) {
+    return sector < card.sectors ? card.data + (size_t)sector * SECTOR_SIZE : NULL;
+}
+
+// Same divider search as the SDK: even prescale 2..254, postdiv 1..256
+static uint set_baud(uint baudrate) {
+    uint prescale, postdiv;
+    for (prescale = 2; prescale <= 254; prescale += 2) {
+        if (CLK_PERI < (prescale + 2) * 256 * (uint64_t)baudrate) break;
+    }
+    for (postdiv = 256; postdiv > 1; --postdiv) {
+        if (CLK_PERI / (prescale * (postdiv - 1)) > baudrate) break;
+    }
+    card.baud = CLK_PERI / (prescale * postdiv);
+    update_error_rate();
+    return card.baud;
+}
+
+uint spi_init(spi_inst_t *spi, uint baudrate) {
+    (void)spi;
+    return set_baud(baudrate);
+}
+
+void spi_deinit(spi_inst_t *spi) {
+    (void)spi;
+}
+
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate) {
+    (void)spi;
+    return set_baud(baudrate);
+}
+
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len) {
+    (void)spi;
+    sim_clock_charge_ns(card.t.call_ns);
+    for (size_t i = 0; i < len; i++) xfer(src[i]);
+    return (int)len;
+}
+
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len) {
+    (void)spi;
+    sim_clock_charge_ns(card.t.call_ns);
+    for (size_t i = 0; i < len; i++) dst[i] = xfer(repeated_tx_data);
+    return (int)len;
+}
+
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len) {
+    (void)spi;
+    sim_clock_charge_ns(card.t.call_ns);
+    for (size_t i = 0; i < len; i++) dst[i] = xfer(src[i]);
+    return (int)len;
+}
+
+void gpio_init(uint gpio) {
+    (void)gpio;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    (void)gpio;
+    (void)out;
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+    (void)gpio;
+    (void)fn;
+}
+
+void gpio_put(uint gpio, bool value) {
+    if (gpio != SD_EMU_CS_PIN) return;
+    card.selected = !value;
+    if (!card.selected) card.cmd_len = 0;
+}
@@ -0,0 +1,79 @@
+// sd_emu.h - SPI-mode SD card emulator for host builds of sd_card.c
+//
+// Implements the spi_* and gpio_* shims (host/shim/hardware) as an SDHC
+// card on SD_EMU_CS_PIN, byte by byte: CMD0/8/9/12/17/18/24/25/55/59 and
+// ACMD23/41, data tokens, data responses, busy signalling and CRC7/CRC16
+// checks. The SPI clock is rounded like the RP2040 divider does. Time is
+// virtual - every SPI byte costs 8 clocks at the current baud rate, every
+// blocking call a fixed software overhead, and the card adds access and
+// programming delays from sd_emu_timing_t (busy shows as 0x00 on MISO, a
+// read as 0xFF until the data token). The time is charged to sim_clock.c,
+// which sleep_ms()/time_us_64() also run on, so sd_card.c runs unmodified
+// and throughput is deterministic. On real time (the native publisher and
+// subscriber) the card's delays only count on its own clock.
+//
+// A signal limit models marginal wiring: above it, data block bytes in
+// either direction pick up bit errors at a rate that grows with the clock.
+
+#ifndef SD_EMU_H
+#define SD_EMU_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SD_EMU_CS_PIN 15    // SD_CS in sd_card.c
+
+typedef struct {
+    unsigned call_ns;           // Software overhead per spi_*_blocking call
+    unsigned access_us;         // CMD17 / first CMD18 block: command to data token
+    unsigned stream_us;         // Each further CMD18 block
+    unsigned program_single_us; // Busy after a CMD24 block
+    unsigned program_multi_us;  // Busy after each CMD25 block
+    unsigned stop_us;           // Busy after the CMD25 stop token (pre-erased by ACMD23)
+    unsigned stop_no_erase_us;  // Same without ACMD23
+} sd_emu_timing_t;
+
+typedef struct {
+    uint64_t spi_bytes;
+    uint32_t commands;          // Command frames received
+    uint32_t blocks_read;
+    uint32_t blocks_written;
+    uint64_t busy_us;           // Time the card held MISO busy or withheld data
+    uint32_t crc_errors;        // Commands and write blocks the card rejected
+    uint32_t corrupted_bytes;   // Bit errors injected by the signal limit
+} sd_emu_stats_t;
+
+// Create a card of the given size (zero-filled). timing may be NULL for
+// typical class 10 microSD figures. Returns 0, or -1 if out of memory.
+int sd_emu_init(uint32_t sectors, const sd_emu_timing_t *timing);
+
+// Same, backed by a disk image file shared with the host (mmap): created
+// with the given size if shorter than 512KB, else used at its own size
+// rounded down to 512KB. Writes land in the file. Returns 0, or -1.
+int sd_emu_init_image(const char *path, uint32_t sectors, const sd_emu_timing_t *timing);
+
+// Clean bus up to stable_hz (0 = no errors at any clock)
+void sd_emu_set_signal_limit(uint32_t stable_hz);
+
+// Cut the card's power when the virtual clock reaches us, mid-transfer if
+// need be: sectors already programmed stay, the rest of a write is lost.
+// While off the card ignores the bus (MISO floats high). sd_emu_power_on()
+// brings it back from reset, to be identified again.
+void sd_emu_power_cut_at(uint64_t us);
+bool sd_emu_powered(void);
+void sd_emu_power_on(void);
+
+// Virtual time in microseconds
+uint64_t sd_emu_now_us(void);
+
+// Current SPI clock in Hz
+uint32_t sd_emu_baudrate(void);
+
+void sd_emu_reset_stats(void);
+void sd_emu_get_stats(sd_emu_stats_t *stats);
+
+// Direct access to the card contents (bypasses SPI and timing)
+uint8_t *sd_emu_sector(uint32_t sector);
+
+#endif // SD_EMU_H
@@ -0,0 +1,171 @@
+// seek_bench.c - FatFs fast seek (cluster link map) for chunk retransmission
+//
+// Runs sd_card.c, diskio_sdcard.c and FatFs against the emulated card from
+// sd_emu.c. A retransmission re-reads one 120-byte chunk at an arbitrary
+// offset: without a cluster map f_lseek() follows the FAT chain from the
+// start of the file, with one (f_lseek(fp, CREATE_LINKMAP)) it looks the
+// cluster up in RAM.
+//
+// Files are written interleaved with a second file one cluster at a time,
+// so every cluster is its own fragment - the worst case for a chain walk.
+// Each seek starts from the beginning of the file, as a backward seek does,
+// and from an empty diskio sector cache. The card runs at 12.5MHz; times
+// are the emulator's virtual clock.
+//
+// Usage: seek_bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sd_card.h"
+#include "sd_emu.h"
+#include "diskio_sdcard.h"
+#include "ff.h"
+
+#define CARD_SECTORS  (256u * 2048u)     // 256MB
+#define CARD_CLOCK    12500000
+#define CHUNK         120                // BLOCK_CHUNK_DATA_SIZE
+#define LARGE_SIZE    (8u * 1024 * 1024)
+#define IMAGE_SIZE    150000             // MAX_SUPPORTED_FILE_SIZE
+#define RETX_CHUNKS   50                 // One status message worth
+#define CLMT_SIZE     4096
+
+typedef struct {
+    uint64_t us;
+    uint32_t commands;
+    uint32_t blocks;
+} cost_t;
+
+static uint8_t piece[8192];
+static DWORD clmt[CLMT_SIZE];
+
+static uint8_t pattern(uint32_t pos) {
+    return (uint8_t)(pos * 2654435761u >> 24);
+}
+
+// Write name and a filler file one cluster at a time
+static int write_fragmented(const char *name, const char *filler, uint32_t size, uint32_t cluster) {
+    FIL f, g;
+    UINT n;
+    if (f_open(&f, name, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) return -1;
+    if (f_open(&g, filler, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) return -1;
+    for (uint32_t off = 0; off < size; off += cluster) {
+        uint32_t len = size - off < cluster ? size - off : cluster;
+        for (uint32_t i = 0; i < len; i++) piece[i] = pattern(off + i);
+        if (f_write(&f, piece, len, &n) != FR_OK || n != len || f_sync(&f) != FR_OK) return -1;
+        if (f_write(&g, piece, cluster, &n) != FR_OK || f_sync(&g) != FR_OK) return -1;
+    }
+    f_close(&f);
+    f_close(&g);
+    return 0;
+}
+
+// Seek from the start of the file to offset and read one chunk
+static bool read_chunk(FIL *f, uint32_t offset, cost_t *cost) {
+    uint8_t buf[CHUNK];
+    UINT got;
+    uint32_t len = f_size(f) - offset < CHUNK ? f_size(f) - offset : CHUNK;
+    sd_emu_stats_t st;
+
+    f_lseek(f, 0);
+    disk_cache_set_enabled(true);   // Drop cached FAT sectors
+    sd_emu_reset_stats();
+    uint64_t start = sd_emu_now_us();
+    if (f_lseek(f, offset) != FR_OK || f_read(f, buf, len, &got) != FR_OK || got != len) return false;
+    cost->us += sd_emu_now_us() - start;
+    sd_emu_get_stats(&st);
+    cost->commands += st.commands;
+    cost->blocks += st.blocks_read;
+
+    for (uint32_t i = 0; i < len; i++) {
+        if (buf[i] != pattern(offset + i)) return false;
+    }
+    return true;
+}
+
+// Open a file, with or without a cluster map. Returns the fragment count.
+static int open_file(FIL *f, const char *name, bool fast, uint64_t *map_us) {
+    if (f_open(f, name, FA_READ) != FR_OK) return -1;
+    if (!fast) return 0;
+    clmt[0] = CLMT_SIZE;
+    f->cltbl = clmt;
+    uint64_t start = sd_emu_now_us();
+    if (f_lseek(f, CREATE_LINKMAP) != FR_OK) return -1;
+    *map_us = sd_emu_now_us() - start;
+    return (int)(clmt[0] - 1) / 2;
+}
+
+static bool bench_offsets(const char *name, uint32_t size) {
+    static const double fractions[] = { 0.0, 0.125, 0.25, 0.5, 0.75, 1.0 };
+    FIL plain, fast;
+    uint64_t map_us = 0;
+    if (open_file(&plain, name, false, NULL) != 0) return false;
+    int fragments = open_file(&fast, name, true, &map_us);
+    if (fragments < 0) return false;
+
+    printf("\n%s: %u bytes, %d fragments, cluster map %u entries built in %.1f ms\n\n", name,
+           (unsigned)size, fragments, (unsigned)clmt[0], map_us / 1000.0);
+    printf("%-10s %12s %10s %12s %10s %9s\n", "offset", "chain ms", "sectors", "map ms",
+           "sectors", "speedup");
+
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(fractions) / sizeof(fractions[0]); i++) {
+        uint32_t offset = (uint32_t)(fractions[i] * (size - CHUNK)) / CHUNK * CHUNK;
+        cost_t chain = { 0 }, map = { 0 };
+        ok &= read_chunk(&plain, offset, &chain);
+        ok &= read_chunk(&fast, offset, &map);
+        printf("%-10u %12.2f %10u %12.2f %10u %8.1fx\n", (unsigned)offset, chain.us / 1000.0,
+               chain.blocks, map.us / 1000.0, map.blocks, map.us ? (double)chain.us / map.us : 0.0);
+    }
+
+    // The chunks of one MISSING status message, in the order listed
+    cost_t chain = { 0 }, map = { 0 };
+    uint32_t chunks = (size + CHUNK - 1) / CHUNK;
+    srand(7);
+    for (int i = 0; i < RETX_CHUNKS; i++) {
+        uint32_t offset = (uint32_t)(rand() % chunks) * CHUNK;
+        ok &= read_chunk(&plain, offset, &chain);
+        ok &= read_chunk(&fast, offset, &map);
+    }
+    printf("%-10s %12.2f %10u %12.2f %10u %8.1fx\n", "50 random", chain.us / 1000.0 / RETX_CHUNKS,
+           chain.blocks / RETX_CHUNKS, map.us / 1000.0 / RETX_CHUNKS, map.blocks / RETX_CHUNKS,
+           map.us ? (double)chain.us / map.us : 0.0);
+
+    f_close(&plain);
+    f_close(&fast);
+    return ok;
+}
+
+int main(void) {
+    if (sd_emu_init(CARD_SECTORS, NULL) != 0) return 1;
+    sd_card_set_max_clock(CARD_CLOCK);
+    if (sd_card_init() != 0) return 1;
+    int mounted = sd_card_mount_fat32();
+    if (mounted == -2) mounted = sd_card_format_fat32();
+    if (mounted != 0) return 1;
+
+    FATFS *fs;
+    DWORD free_clusters;
+    if (f_getfree("", &free_clusters, &fs) != FR_OK) return 1;
+    uint32_t cluster = fs->csize * 512u;
+
+    if (write_fragmented("image.jpg", "pad1.bin", IMAGE_SIZE, cluster) != 0 ||
+        write_fragmented("large.bin", "pad2.bin", LARGE_SIZE, cluster) != 0) {
+        printf("❌ Failed to write test files\n");
+        return 1;
+    }
+
+    printf("\nSD at %.1fMHz, %u-byte clusters; per-seek cost of f_lseek() + 120-byte f_read()\n",
+           CARD_CLOCK / 1e6, (unsigned)cluster);
+    bool ok = bench_offsets("image.jpg", IMAGE_SIZE) && bench_offsets("large.bin", LARGE_SIZE);
+
+    if (!ok) {
+        printf("\n❌ A chunk read back wrong\n");
+        return 1;
+    }
+    printf("\n✅ Every chunk read back intact\n");
+    return 0;
+}
@@ -0,0 +1,37 @@
+// hardware/gpio.h - Host shim for the Pico SDK GPIO driver
+//
+// gpio_init/set_dir/set_function/put are implemented by the device
+// emulator the tool links (sd_emu.c watches the SD chip select). The
+// native publisher and subscriber get the input side from pico_host.c,
+// where console keys stand in for buttons.
+
+#ifndef HOST_SHIM_HARDWARE_GPIO_H
+#define HOST_SHIM_HARDWARE_GPIO_H
+
+#include "pico/stdlib.h"
+
+#define GPIO_OUT 1
+#define GPIO_IN  0
+
+#define GPIO_IRQ_EDGE_FALL 0x4u
+#define GPIO_IRQ_EDGE_RISE 0x8u
+
+enum gpio_function {
+    GPIO_FUNC_SPI = 1,
+    GPIO_FUNC_UART = 2,
+    GPIO_FUNC_SIO = 5,
+};
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_put(uint gpio, bool value);
+
+bool gpio_get(uint gpio);
+void gpio_pull_up(uint gpio);
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled,
+                                        gpio_irq_callback_t callback);
+
+#endif // HOST_SHIM_HARDWARE_GPIO_H
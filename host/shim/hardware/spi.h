@@ -0,0 +1,23 @@
+// hardware/spi.h - Host shim for the Pico SDK SPI driver
+//
+// The blocking calls are implemented by the device emulator the tool links
+// (sd_emu.c for the SD card).
+
+#ifndef HOST_SHIM_HARDWARE_SPI_H
+#define HOST_SHIM_HARDWARE_SPI_H
+
+#include "pico/stdlib.h"
+
+typedef struct spi_inst spi_inst_t;
+
+#define spi0 ((spi_inst_t *)0x40003000)
+#define spi1 ((spi_inst_t *)0x40004000)
+
+uint spi_init(spi_inst_t *spi, uint baudrate);
+void spi_deinit(spi_inst_t *spi);
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate);
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len);
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len);
+
+#endif // HOST_SHIM_HARDWARE_SPI_H
@@ -0,0 +1,18 @@
+// lwip/ip4_addr.h - Host shim for the lwIP IPv4 address type
+
+#ifndef HOST_SHIM_LWIP_IP4_ADDR_H
+#define HOST_SHIM_LWIP_IP4_ADDR_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t addr;      // Network byte order
+} ip4_addr_t;
+
+#define ip4_addr_copy(dest, src) ((dest).addr = (src).addr)
+
+// Dotted decimal in a static buffer, like lwIP
+char *ip4addr_ntoa(const ip4_addr_t *addr);
+int ip4addr_aton(const char *cp, ip4_addr_t *addr);
+
+#endif // HOST_SHIM_LWIP_IP4_ADDR_H
@@ -0,0 +1,10 @@
+// lwip/ip_addr.h - Host shim: IPv4 only, as the firmware is built
+
+#ifndef HOST_SHIM_LWIP_IP_ADDR_H
+#define HOST_SHIM_LWIP_IP_ADDR_H
+
+#include "lwip/ip4_addr.h"
+
+typedef ip4_addr_t ip_addr_t;
+
+#endif // HOST_SHIM_LWIP_IP_ADDR_H
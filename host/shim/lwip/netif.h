@@ -0,0 +1,20 @@
+// lwip/netif.h - Host shim: the loopback interface stands in for the station
+
+#ifndef HOST_SHIM_LWIP_NETIF_H
+#define HOST_SHIM_LWIP_NETIF_H
+
+#include "lwip/ip_addr.h"
+
+struct netif {
+    ip4_addr_t ip_addr;
+    ip4_addr_t netmask;
+    ip4_addr_t gw;
+};
+
+extern struct netif *netif_default;
+
+#define netif_ip4_addr(n)     (&(n)->ip_addr)
+#define netif_ip4_netmask(n)  (&(n)->netmask)
+#define netif_ip4_gw(n)       (&(n)->gw)
+
+#endif // HOST_SHIM_LWIP_NETIF_H
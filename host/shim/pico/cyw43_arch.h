@@ -0,0 +1,38 @@
+// pico/cyw43_arch.h - Host shim for the CYW43 Wi-Fi driver
+//
+// The native publisher and subscriber have no radio: pico_host.c reports
+// the station link as up from the first connect, with a fixed RSSI, so
+// wifi_driver.c runs unchanged.
+
+#ifndef HOST_SHIM_PICO_CYW43_ARCH_H
+#define HOST_SHIM_PICO_CYW43_ARCH_H
+
+#include "pico/stdlib.h"
+#include "lwip/netif.h"
+
+#define CYW43_COUNTRY_SINGAPORE  0x4753
+#define CYW43_AUTH_WPA2_AES_PSK  0x00400004
+#define CYW43_ITF_STA            0
+
+#define CYW43_LINK_DOWN     0
+#define CYW43_LINK_JOIN     1
+#define CYW43_LINK_NOIP     2
+#define CYW43_LINK_UP       3
+#define CYW43_LINK_FAIL     (-1)
+#define CYW43_LINK_NONET    (-2)
+#define CYW43_LINK_BADAUTH  (-3)
+
+typedef struct {
+    int link_status;
+} cyw43_t;
+
+extern cyw43_t cyw43_state;
+
+int cyw43_arch_init_with_country(uint32_t country);
+void cyw43_arch_enable_sta_mode(void);
+int cyw43_arch_wifi_connect_timeout_ms(const char *ssid, const char *pw, uint32_t auth, uint32_t timeout_ms);
+int cyw43_tcpip_link_status(cyw43_t *self, int itf);
+int cyw43_wifi_get_rssi(cyw43_t *self, int32_t *rssi);
+void cyw43_arch_poll(void);
+
+#endif // HOST_SHIM_PICO_CYW43_ARCH_H
@@ -0,0 +1,10 @@
+// pico/rand.h - Host shim for the SDK random number generator
+
+#ifndef HOST_SHIM_PICO_RAND_H
+#define HOST_SHIM_PICO_RAND_H
+
+#include <stdint.h>
+
+uint32_t get_rand_32(void);
+
+#endif // HOST_SHIM_PICO_RAND_H
@@ -0,0 +1,41 @@
+// pico/stdlib.h - Host shim for building Pico sources natively
+//
+// Only what the host code compiles against. sleep_ms()/sleep_us()/
+// time_us_64() come from sim_clock.c: its discrete-event virtual clock for
+// the benches, real time for the native publisher and subscriber.
+// Everything else here is derived from them.
+
+#ifndef HOST_SHIM_PICO_STDLIB_H
+#define HOST_SHIM_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef unsigned int uint;
+
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+uint64_t time_us_64(void);
+
+static inline void tight_loop_contents(void) {}
+
+// Microseconds since boot, like the SDK's non-debug absolute_time_t
+typedef uint64_t absolute_time_t;
+
+#define nil_time ((absolute_time_t)0)
+
+static inline absolute_time_t get_absolute_time(void) { return time_us_64(); }
+static inline bool is_nil_time(absolute_time_t t) { return t == nil_time; }
+static inline uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000); }
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+static inline uint32_t time_us_32(void) { return (uint32_t)time_us_64(); }
+
+#define PICO_ERROR_TIMEOUT (-1)
+
+// Console (pico_host.c): stdout unbuffered, stdin polled without blocking
+bool stdio_init_all(void);
+int getchar_timeout_us(uint32_t timeout_us);
+
+#endif // HOST_SHIM_PICO_STDLIB_H
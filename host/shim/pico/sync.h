@@ -0,0 +1,25 @@
+// pico/sync.h - Host shim for the SDK semaphores
+//
+// Implemented by sim_clock.c: on the virtual clock a wait runs scheduled
+// events until a permit is released or the timeout passes.
+
+#ifndef HOST_SHIM_PICO_SYNC_H
+#define HOST_SHIM_PICO_SYNC_H
+
+#include "pico/stdlib.h"
+
+typedef struct {
+    volatile int16_t permits;
+    int16_t max_permits;
+} semaphore_t;
+
+void sem_init(semaphore_t *sem, int16_t initial_permits, int16_t max_permits);
+int sem_available(semaphore_t *sem);
+bool sem_release(semaphore_t *sem);
+void sem_reset(semaphore_t *sem, int16_t permits);
+bool sem_try_acquire(semaphore_t *sem);
+void sem_acquire_blocking(semaphore_t *sem);
+bool sem_acquire_timeout_us(semaphore_t *sem, uint32_t timeout_us);
+bool sem_acquire_timeout_ms(semaphore_t *sem, uint32_t timeout_ms);
+
+#endif // HOST_SHIM_PICO_SYNC_H
@@ -0,0 +1,219 @@
+// sim_clock.c - Real or discrete-event virtual time for host builds (see sim_clock.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+#include "sim_clock.h"
+
+typedef struct {
+    uint64_t at_us;
+    uint32_t seq;               // Ties run in scheduling order
+    sim_event_fn fn;
+    void *ctx;
+} sim_event_t;
+
+static bool real_time;
+static struct timespec boot;
+static double now_ns;           // Virtual time; in real mode, the devices' own clock
+static int depth;               // Events running (0 or 1)
+
+static sim_event_t heap[SIM_CLOCK_MAX_EVENTS];
+static int heap_len;
+static uint32_t next_seq;
+
+void sim_clock_use_real_time(void) {
+    clock_gettime(CLOCK_MONOTONIC, &boot);
+    real_time = true;
+}
+
+bool sim_clock_is_virtual(void) {
+    return !real_time;
+}
+
+static uint64_t real_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - boot.tv_sec) * 1000000u + (now.tv_nsec - boot.tv_nsec) / 1000;
+}
+
+static void real_sleep(uint64_t us) {
+    struct timespec ts = { (time_t)(us / 1000000u), (long)(us % 1000000u) * 1000 };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+uint64_t time_us_64(void) {
+    return real_time ? real_us() : (uint64_t)(now_ns / 1000.0);
+}
+
+double sim_clock_ns(void) {
+    return now_ns;
+}
+
+void sim_clock_charge_ns(double ns) {
+    now_ns += ns;
+}
+
+// Event queue: a binary min-heap on (at_us, seq)
+
+static bool earlier(const sim_event_t *a, const sim_event_t *b) {
+    return a->at_us < b->at_us || (a->at_us == b->at_us && a->seq < b->seq);
+}
+
+int sim_clock_at(uint64_t at_us, sim_event_fn fn, void *ctx) {
+    if (heap_len == SIM_CLOCK_MAX_EVENTS) {
+        printf("[SIM] Event queue full (%d pending)\n", heap_len);
+        return -1;
+    }
+    int i = heap_len++;
+    sim_event_t ev = { at_us, next_seq++, fn, ctx };
+    while (i > 0 && earlier(&ev, &heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = ev;
+    return 0;
+}
+
+int sim_clock_after(uint64_t delay_us, sim_event_fn fn, void *ctx) {
+    return sim_clock_at(time_us_64() + delay_us, fn, ctx);
+}
+
+int sim_clock_pending(void) {
+    return heap_len;
+}
+
+static sim_event_t pop_event(void) {
+    sim_event_t top = heap[0];
+    sim_event_t last = heap[--heap_len];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= heap_len) break;
+        if (child + 1 < heap_len && earlier(&heap[child + 1], &heap[child])) child++;
+        if (!earlier(&heap[child], &last)) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return top;
+}
+
+// Run the next event if it is due by limit_us. The clock moves to its
+// time, never backwards: an event a nested wait overtook runs late.
+static bool run_next(uint64_t limit_us) {
+    if (depth > 0 || heap_len == 0 || heap[0].at_us > limit_us) {
+        return false;
+    }
+    sim_event_t ev = pop_event();
+    if (real_time) {
+        uint64_t now = real_us();
+        if (ev.at_us > now) real_sleep(ev.at_us - now);
+    } else if (ev.at_us * 1000.0 > now_ns) {
+        now_ns = ev.at_us * 1000.0;
+    }
+    depth++;
+    ev.fn(ev.ctx);
+    depth--;
+    return true;
+}
+
+void sleep_us(uint64_t us) {
+    uint64_t until = time_us_64() + us;
+    while (run_next(until)) {
+    }
+    if (real_time) {
+        uint64_t now = real_us();
+        if (until > now) real_sleep(until - now);
+    } else if (until * 1000.0 > now_ns) {
+        now_ns = until * 1000.0;
+    }
+}
+
+void sleep_ms(uint32_t ms) {
+    sleep_us((uint64_t)ms * 1000u);
+}
+
+void sim_clock_run(void) {
+    while (run_next(UINT64_MAX)) {
+    }
+}
+
+// Semaphores. Permits may be released from another thread in real mode.
+
+void sem_init(semaphore_t *sem, int16_t initial_permits, int16_t max_permits) {
+    sem->permits = initial_permits;
+    sem->max_permits = max_permits;
+}
+
+int sem_available(semaphore_t *sem) {
+    return __atomic_load_n(&sem->permits, __ATOMIC_ACQUIRE);
+}
+
+bool sem_release(semaphore_t *sem) {
+    int16_t permits = __atomic_load_n(&sem->permits, __ATOMIC_ACQUIRE);
+    while (permits < sem->max_permits) {
+        if (__atomic_compare_exchange_n(&sem->permits, &permits, permits + 1, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void sem_reset(semaphore_t *sem, int16_t permits) {
+    __atomic_store_n(&sem->permits, permits, __ATOMIC_RELEASE);
+}
+
+bool sem_try_acquire(semaphore_t *sem) {
+    int16_t permits = __atomic_load_n(&sem->permits, __ATOMIC_ACQUIRE);
+    while (permits > 0) {
+        if (__atomic_compare_exchange_n(&sem->permits, &permits, permits - 1, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool acquire_until(semaphore_t *sem, uint64_t until) {
+    for (;;) {
+        if (sem_try_acquire(sem)) {
+            return true;
+        }
+        if (time_us_64() >= until) {
+            return false;
+        }
+        if (real_time) {
+            // Events due meanwhile run inside the sleep
+            uint64_t left = until - time_us_64();
+            sleep_us(left < 1000 ? left : 1000);
+        } else if (!run_next(until)) {
+            // Nothing left that could release it before the deadline
+            if (until * 1000.0 > now_ns) now_ns = until * 1000.0;
+        }
+    }
+}
+
+bool sem_acquire_timeout_us(semaphore_t *sem, uint32_t timeout_us) {
+    return acquire_until(sem, time_us_64() + timeout_us);
+}
+
+bool sem_acquire_timeout_ms(semaphore_t *sem, uint32_t timeout_ms) {
+    return acquire_until(sem, time_us_64() + (uint64_t)timeout_ms * 1000u);
+}
+
+void sem_acquire_blocking(semaphore_t *sem) {
+    while (!sem_try_acquire(sem)) {
+        if (real_time) {
+            sleep_us(1000);
+        } else if (!run_next(UINT64_MAX)) {
+            printf("[SIM] sem_acquire_blocking() with no event left to release it\n");
+            abort();
+        }
+    }
+}
@@ -0,0 +1,51 @@
+// sim_clock.h - Time for host builds: real, or a discrete-event virtual clock
+//
+// Implements the SDK's sleep_ms()/sleep_us()/time_us_64() (and with them
+// get_absolute_time() and to_ms_since_boot() from the stdlib shim) and
+// the semaphores of pico/sync.h, in one of two modes:
+//
+//   virtual  (default) Time stands still until someone waits. A sleep or
+//            a semaphore wait jumps straight to the next scheduled event,
+//            runs it, and carries on until the wait is over, so a 120 s
+//            timeout costs nothing and every run is repeatable. The
+//            benchmarks, and whole publisher/gateway/subscriber setups in
+//            one process, run on it.
+//   real     CLOCK_MONOTONIC and nanosleep(); the native publisher and
+//            subscriber select it before they start.
+//
+// Events run one at a time, from inside whatever wait reaches their time;
+// a wait inside an event only moves the clock, and events that fall due
+// meanwhile run once the current one returns. Device emulators charge the
+// time their work takes with sim_clock_charge_ns(): in virtual mode that
+// is the one clock, in real mode a clock of their own. Not thread-safe:
+// one thread waits at a time.
+
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_CLOCK_MAX_EVENTS 4096
+
+typedef void (*sim_event_fn)(void *ctx);
+
+// Switch to real time (before anything has read the clock)
+void sim_clock_use_real_time(void);
+bool sim_clock_is_virtual(void);
+
+// Run fn(ctx) when the clock reaches at_us, or after delay_us. Events due
+// at the same time run in the order they were scheduled. Returns 0, or -1
+// if SIM_CLOCK_MAX_EVENTS are already pending.
+int sim_clock_at(uint64_t at_us, sim_event_fn fn, void *ctx);
+int sim_clock_after(uint64_t delay_us, sim_event_fn fn, void *ctx);
+int sim_clock_pending(void);
+
+// Advance through every pending event, including ones they schedule
+void sim_clock_run(void);
+
+// Device time in nanoseconds, and work that takes it (no events run)
+double sim_clock_ns(void);
+void sim_clock_charge_ns(double ns);
+
+#endif // SIM_CLOCK_H
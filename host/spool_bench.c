@@ -0,0 +1,267 @@
+// spool_bench.c - image spool throughput and journal resume
+//
+// Runs block_spool.c, image_index.c, sd_card.c, diskio_sdcard.c and FatFs
+// against the emulated card from sd_emu.c. The network is simulated on the
+// emulator's virtual clock: every chunk costs the QoS 1 PUBLISH/PUBACK
+// round trip plus the publisher's inter-chunk pacing. The sender reads
+// the file 8 chunks at a time and reports progress after each read, as
+// the pipeline producer does. Journal writes are counted in full, as if
+// serial with the sends; in a pipelined send they run on core1 alongside
+// core0's publishing. The simulated subscriber keeps every block it has
+// seen.
+//
+//   per press   the old flow: scan the root directory, send one image,
+//               wait for the subscriber's COMPLETE status (save + round
+//               trip) before the next
+//   spool       block_spool_run(): every unsent image back to back
+//
+// Then the resume runs: power is cut partway through the third image, the
+// card is remounted, and the spool runs again; once with the journal as
+// written, once with its newest slot corrupted as if that write had been
+// torn by the power cut. Every image must arrive complete and intact.
+//
+// Usage: spool_bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pico/stdlib.h"
+#include "sd_card.h"
+#include "sd_emu.h"
+#include "image_index.h"
+#include "block_spool.h"
+#include "ff.h"
+
+#define CARD_SECTORS  (4096u * 2048u)    // 4GB: FAT32, as SDHC cards ship
+#define CARD_CLOCK    12500000
+#define IMAGES        20
+#define IMAGE_SIZE    150000             // MAX_SUPPORTED_FILE_SIZE
+#define CHUNK         120                // BLOCK_CHUNK_DATA_SIZE
+#define READ_CHUNKS   8                  // BLOCK_PIPELINE_READ_CHUNKS
+#define MAX_PARTS     ((IMAGE_SIZE + CHUNK - 1) / CHUNK)
+#define PUBACK_US     3000               // QoS 1 round trip
+#define SAVE_US       140000             // Subscriber saving a 150KB block
+#define CUT_CHUNK     (2 * MAX_PARTS + 700)
+
+typedef struct {
+    uint32_t pacing_us;
+    uint32_t cut_at;                     // Chunks on the wire before the power fails (0 = never)
+    uint32_t chunks;                     // Chunks put on the wire
+    uint32_t resent;                     // ... that the subscriber already had
+} link_t;
+
+// Subscriber side, one per block id
+typedef struct {
+    uint16_t total_parts;
+    bool got[MAX_PARTS + 1];
+    uint8_t data[IMAGE_SIZE];
+    uint32_t length;
+} rx_block_t;
+
+static rx_block_t rx[IMAGES + 2];
+static uint16_t next_block_id = 1;
+static uint8_t piece[READ_CHUNKS * CHUNK];
+static uint8_t expect[IMAGE_SIZE];
+
+static void fill(uint8_t *buf, size_t len, uint32_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)((i + seed) * 2654435761u >> 24);
+    }
+}
+
+static void no_progress(void *ctx, uint16_t block_id, uint16_t total_parts, uint16_t acked) {
+    (void)ctx; (void)block_id; (void)total_parts; (void)acked;
+}
+
+// block_spool_send_t standing in for send_image_file_resume()
+static int sim_send(void *ctx, const char *filename, uint16_t block_id, uint16_t resume_after,
+                    block_progress_t progress, void *progress_ctx) {
+    link_t *link = (link_t *)ctx;
+    FIL f;
+    if (f_open(&f, filename, FA_READ) != FR_OK) return -1;
+    uint32_t size = f_size(&f);
+    uint16_t total = (size + CHUNK - 1) / CHUNK;
+
+    if (block_id == 0) block_id = next_block_id;
+    if (block_id >= next_block_id) next_block_id = block_id + 1;
+    if (resume_after >= total) resume_after = 0;
+    if (block_id >= sizeof(rx) / sizeof(rx[0])) return -1;
+
+    rx_block_t *b = &rx[block_id];
+    b->total_parts = total;
+    b->length = size;
+    progress(progress_ctx, block_id, total, resume_after);
+
+    uint16_t part = 0;
+    for (uint32_t offset = 0; offset < size; offset += sizeof(piece)) {
+        UINT got = 0;
+        if (f_read(&f, piece, sizeof(piece), &got) != FR_OK || got == 0) {
+            f_close(&f);
+            return -1;
+        }
+        for (uint32_t pos = 0; pos < got; pos += CHUNK) {
+            if (++part <= resume_after) continue;
+            if (link->cut_at != 0 && link->chunks == link->cut_at) {
+                return -1;                   // Power lost: nothing after this point happens
+            }
+            sleep_us(PUBACK_US + link->pacing_us);
+            uint32_t len = got - pos < CHUNK ? got - pos : CHUNK;
+            if (b->got[part]) link->resent++;
+            b->got[part] = true;
+            memcpy(b->data + offset + pos, piece + pos, len);
+            link->chunks++;
+        }
+        progress(progress_ctx, block_id, total, part);
+    }
+    f_close(&f);
+    return 0;
+}
+
+static int card_up(void) {
+    if (sd_card_init() != 0) return -1;
+    int mounted = sd_card_mount_fat32();
+    if (mounted == -2) mounted = sd_card_format_fat32();
+    return mounted;
+}
+
+static int reboot(void) {
+    image_index_close();
+    f_unmount("");
+    sd_card_deinit();
+    return card_up();
+}
+
+static int setup_card(void) {
+    char name[32];
+    memset(rx, 0, sizeof(rx));
+    next_block_id = 1;
+    if (sd_emu_init(CARD_SECTORS, NULL) != 0) return -1;
+    sd_card_set_max_clock(CARD_CLOCK);
+    if (card_up() != 0) return -1;
+    for (int i = 0; i < IMAGES; i++) {
+        snprintf(name, sizeof(name), "IMG_%04d.jpg", i);
+        fill(expect, IMAGE_SIZE, i);
+        if (sd_card_write_file(name, expect, IMAGE_SIZE) != 0) return -1;
+    }
+    return reboot();
+}
+
+// Every image must have arrived, whole and unchanged, under one block id
+static bool verify(void) {
+    image_index_entry_t e;
+    if (image_index_open() != IMAGES) return false;
+    for (int id = 0; id < IMAGES; id++) {
+        if (image_index_get(id, &e) != 0 || !(e.flags & IMAGE_INDEX_SENT)) return false;
+        int image = atoi(e.name + 4);
+        fill(expect, IMAGE_SIZE, image);
+        bool found = false;
+        for (size_t b = 1; b < sizeof(rx) / sizeof(rx[0]) && !found; b++) {
+            if (rx[b].length != IMAGE_SIZE || memcmp(rx[b].data, expect, IMAGE_SIZE) != 0) continue;
+            found = true;
+            for (int p = 1; p <= rx[b].total_parts; p++) found &= rx[b].got[p];
+        }
+        if (!found) {
+            printf("❌ %s did not arrive intact\n", e.name);
+            return false;
+        }
+    }
+    return true;
+}
+
+// The old flow: one directory scan, send and COMPLETE wait per image
+static bool run_per_press(link_t *link, uint64_t *us) {
+    char name[32];
+    if (setup_card() != 0) return false;
+    uint64_t start = sd_emu_now_us();
+    for (int i = 0; i < IMAGES; i++) {
+        DIR dir;
+        FILINFO fno;
+        if (f_opendir(&dir, "/") != FR_OK) return false;
+        while (f_readdir(&dir, &fno) == FR_OK && fno.fname[0] != 0) {
+        }
+        f_closedir(&dir);
+        snprintf(name, sizeof(name), "IMG_%04d.jpg", i);
+        if (sim_send(link, name, 0, 0, no_progress, NULL) != 0) return false;
+        sleep_us(SAVE_US + 2 * PUBACK_US);
+    }
+    *us = sd_emu_now_us() - start;
+    return true;
+}
+
+static bool run_spool(link_t *link, block_spool_stats_t *st) {
+    if (setup_card() != 0) return false;
+    return block_spool_run(sim_send, link, st) == IMAGES && verify();
+}
+
+// Corrupt the newest journal slot, as a write torn by the power cut would
+static bool tear_journal(void) {
+    FIL f;
+    FATFS *fs;
+    DWORD free_clusters;
+    if (f_getfree("", &free_clusters, &fs) != FR_OK) return false;
+    if (f_open(&f, BLOCK_SPOOL_JOURNAL, FA_READ) != FR_OK) return false;
+    uint32_t lba = fs->database + (f.obj.sclust - 2) * fs->csize;
+    f_close(&f);
+    uint32_t seq0, seq1;
+    memcpy(&seq0, sd_emu_sector(lba) + 4, 4);
+    memcpy(&seq1, sd_emu_sector(lba + 1) + 4, 4);
+    sd_emu_sector(seq0 > seq1 ? lba : lba + 1)[20] ^= 0xFF;
+    return reboot() == 0;
+}
+
+static bool run_resume(bool torn, link_t *link, block_spool_stats_t *st) {
+    if (setup_card() != 0) return false;
+    link->cut_at = CUT_CHUNK;
+    if (block_spool_run(sim_send, link, NULL) != -1 || !block_spool_interrupted()) return false;
+    if (torn ? !tear_journal() : reboot() != 0) return false;
+    link->cut_at = 0;
+    return block_spool_run(sim_send, link, st) == IMAGES - 2 && verify() &&
+           !block_spool_interrupted();
+}
+
+int main(void) {
+    static const uint32_t pacings[] = { 50000, 0 };
+    bool ok = true;
+
+    printf("\nSD at %.1fMHz: %d images of %d bytes, QoS 1 (%d ms PUBACK round trip)\n", CARD_CLOCK / 1e6,
+           IMAGES, IMAGE_SIZE, PUBACK_US / 1000);
+    for (int i = 0; i < 2; i++) {
+        link_t press = { pacings[i] }, spool = { pacings[i] };
+        uint64_t press_us = 0;
+        block_spool_stats_t st;
+        bool press_ok = run_per_press(&press, &press_us);
+        bool spool_ok = run_spool(&spool, &st);
+        ok &= press_ok && spool_ok;
+
+        printf("\n%u ms pacing       %10s %10s %10s %12s\n", (unsigned)(pacings[i] / 1000), "s",
+               "files/min", "KB/s", "journal");
+        printf("  %-18s %10.1f %10.2f %10.2f %12s%s\n", "per press", press_us / 1e6,
+               IMAGES * 60e6 / press_us, IMAGES * (double)IMAGE_SIZE / 1024 / (press_us / 1e6), "-",
+               press_ok ? "" : "  FAILED");
+        printf("  %-18s %10.1f %10.2f %10.2f %5u, %4.2f%%%s\n", "spool", st.elapsed_us / 1e6,
+               st.files * 60e6 / st.elapsed_us, st.bytes / 1024.0 / (st.elapsed_us / 1e6),
+               st.journal_writes, 100.0 * st.journal_us / st.elapsed_us, spool_ok ? "" : "  FAILED");
+    }
+
+    printf("\nPower cut after chunk %d (image 3, chunk %d of %d), then a second run\n", CUT_CHUNK,
+           CUT_CHUNK - 2 * MAX_PARTS, MAX_PARTS);
+    printf("  %-18s %10s %10s %10s\n", "journal", "resumed", "skipped", "resent");
+    for (int torn = 0; torn <= 1; torn++) {
+        link_t link = { 0 };
+        block_spool_stats_t st = { 0 };
+        bool r = run_resume(torn, &link, &st);
+        ok &= r;
+        printf("  %-18s %10u %10u %10u%s\n", torn ? "newest slot torn" : "intact", st.resumed,
+               st.chunks_skipped, link.resent, r ? "" : "  FAILED");
+    }
+
+    if (!ok) {
+        printf("\n❌ A run failed\n");
+        return 1;
+    }
+    printf("\n✅ Every image arrived complete, each under one block id\n");
+    return 0;
+}
@@ -0,0 +1,186 @@
+// trace_export.c - Turn tracepoint dumps into Chrome/Perfetto trace JSON
+//
+// Reads console captures or host trace files holding trace_dump() output
+// (#TRD .. #TRX, other lines are ignored) and writes one JSON trace for
+// chrome://tracing or ui.perfetto.dev. Each dump becomes a process named
+// after its file, each core a thread; timestamps start at 0 per dump, so a
+// device capture and a host run line up side by side.
+//
+// Ends whose begin was overwritten in the ring are dropped.
+//
+// Usage: trace_export [-o trace.json] capture.txt [more captures...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "trace.h"
+
+#define MAX_EVENTS  (TRACE_CORES * TRACE_RING_EVENTS)
+#define MAX_IDS     64
+
+typedef struct {
+    unsigned core;
+    uint32_t ts;
+    char phase;
+    unsigned id;
+    unsigned long arg;
+} event_t;
+
+static event_t events[MAX_EVENTS];
+static int event_count;
+static char names[MAX_IDS][32];
+static int pid;
+static bool first_output = true;
+
+static void emit(FILE *out, const char *fmt_json) {
+    fprintf(out, "%s\n  %s", first_output ? "" : ",", fmt_json);
+    first_output = false;
+}
+
+// Category: the name up to its first underscore (chunk, udp, sd, ...)
+static void category(const char *name, char *cat, size_t size) {
+    size_t n = strcspn(name, "_");
+    if (n >= size) n = size - 1;
+    memcpy(cat, name, n);
+    cat[n] = '\0';
+}
+
+static void write_dump(FILE *out, const char *file, unsigned dump, unsigned long lost) {
+    char line[256];
+    pid++;
+    snprintf(line, sizeof(line),
+             "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s #%u\"}}", pid, file, dump);
+    emit(out, line);
+    for (unsigned c = 0; c < TRACE_CORES; c++) {
+        snprintf(line, sizeof(line),
+                 "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"core%u\"}}",
+                 pid, c, c);
+        emit(out, line);
+    }
+    if (event_count == 0) {
+        return;
+    }
+
+    // Timestamps are 32-bit microseconds: measure everything from the
+    // earliest event, which wrap-safe differences find
+    uint32_t origin = events[0].ts;
+    for (int i = 1; i < event_count; i++) {
+        if ((int32_t)(events[i].ts - origin) < 0) {
+            origin = events[i].ts;
+        }
+    }
+
+    int open[TRACE_CORES][MAX_IDS] = {{0}};
+    int dropped = 0;
+    for (int i = 0; i < event_count; i++) {
+        const event_t *e = &events[i];
+        if (e->core >= TRACE_CORES || e->id >= MAX_IDS) {
+            continue;
+        }
+        if (e->phase == TRACE_PHASE_BEGIN) {
+            open[e->core][e->id]++;
+        } else if (e->phase == TRACE_PHASE_END) {
+            if (open[e->core][e->id] == 0) {
+                dropped++;
+                continue;
+            }
+            open[e->core][e->id]--;
+        }
+        const char *name = names[e->id][0] ? names[e->id] : "?";
+        char cat[32];
+        category(name, cat, sizeof(cat));
+        snprintf(line, sizeof(line),
+                 "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",%s\"ts\":%lu,\"pid\":%d,\"tid\":%u,"
+                 "\"args\":{\"arg\":%lu}}",
+                 name, cat, e->phase, e->phase == TRACE_PHASE_INSTANT ? "\"s\":\"t\"," : "",
+                 (unsigned long)(uint32_t)(e->ts - origin), pid, e->core, e->arg);
+        emit(out, line);
+    }
+    fprintf(stderr, "%s #%u: %d events, %lu lost in the ring, %d unmatched ends dropped\n",
+            file, dump, event_count, lost, dropped);
+}
+
+static int convert(FILE *out, const char *path) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return -1;
+    }
+    const char *file = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    bool in_dump = false;
+    unsigned dump = 0;
+    unsigned long lost = 0;
+    int dumps = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), in)) {
+        // Tags share a prefix: test the longer ones first
+        if (strncmp(line, TRACE_DUMP_TAG " ", strlen(TRACE_DUMP_TAG) + 1) == 0) {
+            sscanf(line + strlen(TRACE_DUMP_TAG), "%u %lu", &dump, &lost);
+            event_count = 0;
+            memset(names, 0, sizeof(names));
+            in_dump = true;
+        } else if (!in_dump) {
+            continue;
+        } else if (strncmp(line, TRACE_NAME_TAG " ", strlen(TRACE_NAME_TAG) + 1) == 0) {
+            unsigned id;
+            char name[32];
+            if (sscanf(line + strlen(TRACE_NAME_TAG), "%u %31s", &id, name) == 2 && id < MAX_IDS) {
+                strcpy(names[id], name);
+            }
+        } else if (strncmp(line, TRACE_END_TAG, strlen(TRACE_END_TAG)) == 0) {
+            write_dump(out, file, dump, lost);
+            dumps++;
+            in_dump = false;
+        } else if (strncmp(line, TRACE_EVENT_TAG " ", strlen(TRACE_EVENT_TAG) + 1) == 0 &&
+                   event_count < MAX_EVENTS) {
+            event_t *e = &events[event_count];
+            unsigned long ts;
+            if (sscanf(line + strlen(TRACE_EVENT_TAG), "%u %lx %c %u %lu", &e->core, &ts, &e->phase, &e->id,
+                       &e->arg) == 5) {
+                e->ts = (uint32_t)ts;
+                event_count++;
+            }
+        }
+    }
+    fclose(in);
+    if (in_dump) {
+        fprintf(stderr, "%s: the last dump is cut short, skipped\n", file);
+    }
+    if (dumps == 0) {
+        fprintf(stderr, "%s: no trace dump found\n", file);
+    }
+    return dumps;
+}
+
+int main(int argc, char **argv) {
+    FILE *out = stdout;
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "-o") == 0) {
+        out = fopen(argv[2], "w");
+        if (out == NULL) {
+            fprintf(stderr, "Cannot write %s\n", argv[2]);
+            return 1;
+        }
+        first = 3;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "Usage: %s [-o trace.json] capture.txt [more captures...]\n", argv[0]);
+        return 1;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    int failures = 0;
+    for (int i = first; i < argc; i++) {
+        if (convert(out, argv[i]) <= 0) {
+            failures++;
+        }
+    }
+    fprintf(out, "\n]}\n");
+    if (out != stdout) {
+        fclose(out);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,666 @@
+// transfer_bench.c - Block transfer benchmark across QoS, loss rate and file size
+//
+// Runs the real publisher and subscriber code in one process:
+// send_block_transfer_qos() on one side, process_block_chunk() and the
+// save to the emulated card on the other. Between them, a model of the
+// MQTT-SN path: publisher -> gateway -> subscriber, each hop with its own
+// delay and independent loss, and the QoS handshakes on the publisher's
+// hop. It runs on sim_clock.c's discrete-event clock: datagrams in flight
+// are events, the client's ack waits are semaphore timeouts, and the
+// chunk pacing and a 5 s timeout take no real time, so a 100KB transfer
+// costs a few milliseconds.
+//
+//   QoS 0   PUBLISH only; a lost chunk is gone
+//   QoS 1   PUBLISH + PUBACK; a lost one costs the client's 5 s PUBACK
+//           wait, then send_chunk_packet() retries
+//   QoS 2   PUBLISH / PUBREC / PUBREL / PUBCOMP; the gateway forwards on
+//           PUBREL, once per message however often the handshake restarts
+//
+// The gateway forwards at the lower of the publish QoS and the QoS the
+// subscriber holds pico/chunks at (-S, default 2 so the swept QoS holds
+// end to end), retrying an unacknowledged forward every 2 s up to 3
+// times as gateway_emu does. -S 0 is subscriber_main.c's subscription:
+// the second hop is then lossy at every QoS, and without NACK repair (a
+// RAM block cannot be re-read) no lossy run completes. Status messages
+// travel back over both hops. The loss PRNG is seeded the same way every
+// run, so results differ only when the code does: keep a CSV from one
+// commit and pass it with -b to the next. -N repeats every configuration
+// with consecutive seeds, for loss patterns in bulk.
+//
+// Chunk size is a compile-time constant; the build makes one binary per
+// size (transfer_bench_64, _128, _256), each sweeping the rest.
+//
+//   transfer_bench_128 [-q 0,1,2] [-l 0,1,5] [-s 10000,50000,100000]
+//                      [-S qos] [-d hop_ms] [-F k:m] [-r seed] [-N runs]
+//                      [-j] [-n]
+//                      [-b baseline.csv] [-t percent]
+//
+//   -q  QoS levels               -l  Loss per hop, percent
+//   -s  File sizes, bytes        -S  Subscription QoS (default 2)
+//   -d  One-way delay per hop (default 5 ms)
+//   -F  FEC group (default off)  -r  Loss PRNG seed (default 1)
+//   -N  Runs per configuration, seeds counting up from -r (default 1)
+//   -j  JSON lines, not CSV      -n  No CSV header (to append rows)
+//   -b  Compare with an earlier CSV; exit 2 on a regression
+//   -t  Regression threshold for goodput and time (default 5%)
+//
+// Columns: time_ms runs from the first chunk to the block saved on the
+// card; goodput_kbps is file bits over that time (0 if the file did not
+// arrive intact); packets counts every datagram on both hops, acks and
+// status included; retransmissions are chunk publishes beyond one per
+// packet; latency is per chunk, first publish to delivery at the
+// subscriber, over the chunks that arrived; seed identifies the run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "pico/stdlib.h"
+#include "block_transfer.h"
+#include "sd_card.h"
+#include "sd_emu.h"
+#include "sd_write_queue.h"
+#include "ff.h"
+#include "pico/sync.h"
+#include "sim_clock.h"
+
+#define CARD_SECTORS    (64u * 2048u)       // 64MB
+#define MAX_LIST        8
+#define MAX_FILE_SIZE   BLOCK_BUFFER_SIZE
+#define MAX_PACKET      512
+#define MAX_DELIVERIES  256
+#define MAX_ROWS        4096
+#define PUBACK_WAIT_MS  5000                // mqttsn_client.c's ack timeout
+#define UDP_OVERHEAD    28                  // IPv4 + UDP headers
+#define PUBLISH_HEADER  7                   // MQTT-SN PUBLISH, short length
+#define ACK_SIZE        4                   // PUBREC/PUBREL/PUBCOMP
+#define PUBACK_SIZE     7
+#define SETTLE_MS       121000              // Past the subscriber's 120 s block timeout
+#define FORWARD_RETRY_MS 2000               // gateway_emu's -r default
+#define FORWARD_RETRIES 3                   // gateway_emu's -n default
+
+#define TOPIC_CHUNKS    "pico/chunks"
+#define TOPIC_STATUS    "pico/block_status"
+
+typedef struct {
+    bool in_use;
+    bool to_subscriber;                 // Otherwise to the publisher (status)
+    uint64_t due_us;
+    uint16_t len;
+    uint8_t data[MAX_PACKET];
+} delivery_t;
+
+typedef struct {
+    uint32_t hop_us;
+    uint32_t loss_ppm;
+    int subscribe_qos;
+    uint64_t rng;
+
+    delivery_t deliveries[MAX_DELIVERIES];  // Datagrams in flight to an endpoint
+    semaphore_t ack;                    // Publisher: the awaited PUBACK/PUBREC/PUBCOMP arrived
+
+    uint32_t packets;
+    uint64_t wire_bytes;
+    uint32_t chunk_publishes;
+    uint32_t chunk_packets;             // Distinct (part) packets offered
+    bool offered[BLOCK_MAX_CHUNKS * 2];
+    uint64_t first_send_us[BLOCK_MAX_CHUNKS * 2];
+    uint32_t latency_us[BLOCK_MAX_CHUNKS * 2];
+    uint32_t delivered;
+
+    uint8_t qos2_part_forwarded;        // QoS 2: current message reached the gateway's PUBREL
+    uint16_t qos2_part;
+} link_t;
+
+typedef struct {
+    uint32_t chunk_size;
+    int qos;
+    double loss_pct;
+    uint32_t file_bytes;
+    bool complete;
+    double time_ms;
+    double goodput_kbps;
+    uint32_t packets;
+    double packets_per_kb;
+    double wire_bytes_per_byte;
+    uint32_t chunk_publishes;
+    uint32_t retransmissions;
+    double latency_p50_ms;
+    double latency_p99_ms;
+    uint32_t delivered;
+    uint32_t chunks;
+    uint64_t seed;
+} result_t;
+
+static link_t net;
+static int current_qos;
+static uint8_t file_data[MAX_FILE_SIZE];
+static uint8_t readback[MAX_FILE_SIZE];
+static uint32_t sorted[BLOCK_MAX_CHUNKS * 2];
+static FILE *out;
+
+// Firmware hooks the benchmark stands in for
+
+int mqttsn_get_qos(void) {
+    return current_qos;
+}
+
+void mqttsn_set_qos(int qos) {
+    current_qos = qos;
+}
+
+void cyw43_arch_poll(void) {
+}
+
+// Block ids the same every run
+uint32_t get_rand_32(void) {
+    static uint32_t state = 0x2545F491u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Link model
+
+static bool hop_lost(void) {
+    // xorshift64*, seeded per run
+    net.rng ^= net.rng >> 12;
+    net.rng ^= net.rng << 25;
+    net.rng ^= net.rng >> 27;
+    uint64_t r = net.rng * 2685821657736338717ull;
+    return (uint32_t)(r >> 32) % 1000000u < net.loss_ppm;
+}
+
+static void count_packet(size_t len) {
+    net.packets++;
+    net.wire_bytes += len + UDP_OVERHEAD;
+}
+
+static void deliver(void *ctx);
+
+static void enqueue(uint64_t due_us, bool to_subscriber, const uint8_t *data, size_t len) {
+    delivery_t *d = NULL;
+    for (int i = 0; i < MAX_DELIVERIES && d == NULL; i++) {
+        if (!net.deliveries[i].in_use) d = &net.deliveries[i];
+    }
+    if (d == NULL || len > MAX_PACKET || sim_clock_at(due_us, deliver, d) != 0) {
+        fprintf(stderr, "too many datagrams in flight - packet dropped\n");
+        return;
+    }
+    d->in_use = true;
+    d->to_subscriber = to_subscriber;
+    d->due_us = due_us;
+    d->len = (uint16_t)len;
+    memcpy(d->data, data, len);
+}
+
+static uint16_t packet_part(const uint8_t *data, size_t len) {
+    block_header_t header;
+    if (len < sizeof(header)) {
+        return 0;
+    }
+    memcpy(&header, data, sizeof(header));
+    return header.part_num;
+}
+
+// Gateway -> subscriber. At QoS 1 a lost PUBACK brings a duplicate,
+// which the subscriber sees; at QoS 2 the handshake filters it out.
+static void forward_chunk(const uint8_t *data, size_t len, uint64_t at_gateway_us, int publish_qos) {
+    int qos = publish_qos < net.subscribe_qos ? publish_qos : net.subscribe_qos;
+    bool delivered = false;
+    for (int attempt = 0; attempt <= (qos > 0 ? FORWARD_RETRIES : 0); attempt++) {
+        uint64_t at = at_gateway_us + (uint64_t)attempt * FORWARD_RETRY_MS * 1000u;
+        count_packet(PUBLISH_HEADER + len);
+        if (hop_lost()) {
+            continue;
+        }
+        if (!delivered || qos == 1) {
+            enqueue(at + net.hop_us, true, data, len);
+            delivered = true;
+        }
+        if (qos == 0) {
+            return;
+        }
+        count_packet(qos == 1 ? PUBACK_SIZE : ACK_SIZE);        // PUBACK / PUBREC
+        if (hop_lost()) {
+            continue;
+        }
+        if (qos == 2) {
+            count_packet(ACK_SIZE);                             // PUBREL
+            count_packet(ACK_SIZE);                             // PUBCOMP
+        }
+        return;
+    }
+}
+
+static void deliver(void *ctx) {
+    delivery_t *d = (delivery_t *)ctx;
+    if (d->to_subscriber) {
+        uint16_t part = packet_part(d->data, d->len);
+        if (part < BLOCK_MAX_CHUNKS * 2 && net.offered[part] && net.latency_us[part] == 0) {
+            net.latency_us[part] = (uint32_t)(d->due_us - net.first_send_us[part]) + 1;
+            net.delivered++;
+        }
+        process_block_chunk(d->data, d->len);
+    } else {
+        process_block_status(d->data, d->len);
+    }
+    d->in_use = false;
+}
+
+static void ack_arrives(void *ctx) {
+    (void)ctx;
+    sem_release(&net.ack);
+}
+
+// One leg of the publisher's handshake: if its packet reached the
+// gateway, the answer back; the client waits for it up to the ack timeout
+static bool handshake_step(bool reached, size_t answer_size) {
+    sem_reset(&net.ack, 0);
+    if (reached) {
+        count_packet(answer_size);
+        if (!hop_lost()) {
+            sim_clock_after(2 * net.hop_us, ack_arrives, NULL);
+        }
+    }
+    return sem_acquire_timeout_ms(&net.ack, PUBACK_WAIT_MS);
+}
+
+static int publish_chunk(const uint8_t *data, size_t len, int qos) {
+    uint16_t part = packet_part(data, len);
+    uint64_t now = time_us_64();
+
+    net.chunk_publishes++;
+    if (part < BLOCK_MAX_CHUNKS * 2 && !net.offered[part]) {
+        net.offered[part] = true;
+        net.first_send_us[part] = now;
+        net.chunk_packets++;
+    }
+
+    count_packet(PUBLISH_HEADER + len);
+    if (qos == 0) {
+        if (!hop_lost()) {
+            forward_chunk(data, len, now + net.hop_us, qos);
+        }
+        return 0;
+    }
+
+    if (qos == 1) {
+        // The gateway forwards on PUBLISH whether or not its PUBACK gets back
+        bool reached = !hop_lost();
+        if (reached) {
+            forward_chunk(data, len, now + net.hop_us, qos);
+        }
+        return handshake_step(reached, PUBACK_SIZE) ? 0 : -1;
+    }
+
+    // QoS 2: a retry restarts the handshake; the gateway knows the
+    // message by its id and forwards it once, on PUBREL
+    if (net.qos2_part != part) {
+        net.qos2_part = part;
+        net.qos2_part_forwarded = 0;
+    }
+    if (!handshake_step(!hop_lost(), ACK_SIZE)) {      // PUBLISH / PUBREC
+        return -1;
+    }
+    count_packet(ACK_SIZE);
+    bool reached = !hop_lost();                         // PUBREL
+    if (reached && !net.qos2_part_forwarded) {
+        net.qos2_part_forwarded = 1;
+        forward_chunk(data, len, time_us_64() + net.hop_us, qos);
+    }
+    return handshake_step(reached, ACK_SIZE) ? 0 : -1; // PUBREL / PUBCOMP
+}
+
+int mqttsn_demo_publish_name(const char *topicname, const uint8_t *payload, int payloadlen) {
+    if (strcmp(topicname, TOPIC_CHUNKS) == 0) {
+        return publish_chunk(payload, (size_t)payloadlen, current_qos);
+    }
+
+    // Status and control messages: sender -> gateway -> the other side.
+    // The first hop's PUBACK is counted but its wait is not: the sender
+    // here is the subscriber, whose time is not being measured.
+    count_packet(PUBLISH_HEADER + payloadlen);
+    if (current_qos > 0) {
+        count_packet(PUBACK_SIZE);
+    }
+    if (strcmp(topicname, TOPIC_STATUS) != 0 || hop_lost()) {
+        return 0;
+    }
+    count_packet(PUBLISH_HEADER + payloadlen);
+    if (!hop_lost()) {
+        enqueue(time_us_64() + 2 * net.hop_us, false, payload, (size_t)payloadlen);
+    }
+    return 0;
+}
+
+// Card
+
+static int fresh_card(void) {
+    if (sd_emu_init(CARD_SECTORS, NULL) != 0 || sd_card_init() != 0) {
+        return -1;
+    }
+    if (sd_card_format_fat32() != 0) {
+        return -1;
+    }
+    return f_mkdir("received") == FR_OK ? 0 : -1;
+}
+
+// Whatever the subscriber saved must be the file that was sent
+static bool received_intact(uint32_t size) {
+    DIR dir;
+    FILINFO info;
+    bool intact = false;
+    if (f_opendir(&dir, "received") != FR_OK) {
+        return false;
+    }
+    while (f_readdir(&dir, &info) == FR_OK && info.fname[0] != '\0') {
+        char path[300];
+        FIL file;
+        UINT got = 0;
+        snprintf(path, sizeof(path), "received/%s", info.fname);
+        if (info.fsize != size || f_open(&file, path, FA_READ) != FR_OK) {
+            continue;
+        }
+        if (f_read(&file, readback, size, &got) == FR_OK && got == size &&
+            memcmp(readback, file_data, size) == 0) {
+            intact = true;
+        }
+        f_close(&file);
+    }
+    f_closedir(&dir);
+    return intact;
+}
+
+// One run
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_ms(uint32_t count, double p) {
+    if (count == 0) {
+        return 0;
+    }
+    uint32_t rank = (uint32_t)(p * count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1] / 1000.0;
+}
+
+static int run(int qos, double loss_pct, uint32_t size, uint32_t hop_ms, int subscribe_qos,
+               uint64_t seed, result_t *r) {
+    if (fresh_card() != 0) {
+        fprintf(stderr, "emulated card not usable\n");
+        return -1;
+    }
+    memset(&net, 0, sizeof(net));
+    sem_init(&net.ack, 0, 1);
+    net.hop_us = hop_ms * 1000u;
+    net.loss_ppm = (uint32_t)(loss_pct * 10000.0 + 0.5);
+    net.subscribe_qos = subscribe_qos;
+    net.rng = seed * 0x9E3779B97F4A7C15ull + (uint64_t)qos * 1000003u + size;
+    if (net.rng == 0) net.rng = 1;
+
+    // A JPEG by its magic, so no compression; the body is incompressible
+    for (uint32_t i = 0; i < size; i++) {
+        file_data[i] = (uint8_t)((i + size) * 2654435761u >> 24);
+    }
+    file_data[0] = 0xFF;
+    file_data[1] = 0xD8;
+    file_data[2] = 0xFF;
+
+    block_transfer_init();
+    uint64_t start = time_us_64();
+    int ret = send_block_transfer_qos(TOPIC_CHUNKS, file_data, size, (uint8_t)qos);
+    sim_clock_run();
+    while (sd_write_queue_poll()) {
+    }
+    uint64_t end = time_us_64();
+
+    // Let a stalled block run into the subscriber's timeout so the next run starts clean
+    sleep_ms(SETTLE_MS);
+    block_transfer_check_timeout();
+    while (sd_write_queue_poll()) {
+    }
+
+    uint32_t count = 0;
+    for (uint32_t part = 0; part < BLOCK_MAX_CHUNKS * 2; part++) {
+        if (net.latency_us[part] != 0) {
+            sorted[count++] = net.latency_us[part] - 1;
+        }
+    }
+    qsort(sorted, count, sizeof(sorted[0]), compare_u32);
+
+    memset(r, 0, sizeof(*r));
+    r->chunk_size = BLOCK_CHUNK_SIZE;
+    r->qos = qos;
+    r->loss_pct = loss_pct;
+    r->file_bytes = size;
+    r->complete = ret == 0 && received_intact(size);
+    r->time_ms = (end - start) / 1000.0;
+    r->goodput_kbps = r->complete && r->time_ms > 0 ? size * 8.0 / r->time_ms : 0;
+    r->packets = net.packets;
+    r->packets_per_kb = net.packets * 1024.0 / size;
+    r->wire_bytes_per_byte = (double)net.wire_bytes / size;
+    r->chunk_publishes = net.chunk_publishes;
+    r->retransmissions = net.chunk_publishes - net.chunk_packets;
+    r->latency_p50_ms = percentile_ms(count, 0.50);
+    r->latency_p99_ms = percentile_ms(count, 0.99);
+    r->delivered = net.delivered;
+    r->chunks = net.chunk_packets;
+    r->seed = seed;
+    return 0;
+}
+
+// Output
+
+static const char *csv_header =
+    "chunk_size,qos,loss_pct,file_bytes,complete,time_ms,goodput_kbps,packets,packets_per_kb,"
+    "wire_bytes_per_byte,chunk_publishes,retransmissions,latency_p50_ms,latency_p99_ms,"
+    "delivered,chunks,seed";
+
+static void print_csv(const result_t *r) {
+    fprintf(out, "%u,%d,%.2f,%u,%d,%.1f,%.2f,%u,%.2f,%.3f,%u,%u,%.1f,%.1f,%u,%u,%llu\n",
+            r->chunk_size, r->qos, r->loss_pct, r->file_bytes, r->complete, r->time_ms,
+            r->goodput_kbps, r->packets, r->packets_per_kb, r->wire_bytes_per_byte,
+            r->chunk_publishes, r->retransmissions, r->latency_p50_ms, r->latency_p99_ms,
+            r->delivered, r->chunks, (unsigned long long)r->seed);
+}
+
+static void print_json(const result_t *r) {
+    fprintf(out, "{\"chunk_size\":%u,\"qos\":%d,\"loss_pct\":%.2f,\"file_bytes\":%u,\"complete\":%s,"
+            "\"time_ms\":%.1f,\"goodput_kbps\":%.2f,\"packets\":%u,\"packets_per_kb\":%.2f,"
+            "\"wire_bytes_per_byte\":%.3f,\"chunk_publishes\":%u,\"retransmissions\":%u,"
+            "\"latency_p50_ms\":%.1f,\"latency_p99_ms\":%.1f,\"delivered\":%u,\"chunks\":%u,\"seed\":%llu}\n",
+            r->chunk_size, r->qos, r->loss_pct, r->file_bytes, r->complete ? "true" : "false",
+            r->time_ms, r->goodput_kbps, r->packets, r->packets_per_kb, r->wire_bytes_per_byte,
+            r->chunk_publishes, r->retransmissions, r->latency_p50_ms, r->latency_p99_ms,
+            r->delivered, r->chunks, (unsigned long long)r->seed);
+}
+
+// Baseline comparison, rows matched on chunk size, QoS, loss, file size and seed
+
+static result_t baseline[MAX_ROWS];
+static int baseline_rows;
+
+static int load_baseline(const char *path) {
+    FILE *f = fopen(path, "r");
+    char line[512];
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f) != NULL && baseline_rows < MAX_ROWS) {
+        result_t *b = &baseline[baseline_rows];
+        int complete;
+        if (sscanf(line, "%u,%d,%lf,%u,%d,%lf,%lf,%u", &b->chunk_size, &b->qos, &b->loss_pct,
+                   &b->file_bytes, &complete, &b->time_ms, &b->goodput_kbps, &b->packets) == 8) {
+            b->complete = complete != 0;
+            b->seed = strtoull(strrchr(line, ',') + 1, NULL, 10);
+            baseline_rows++;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static bool regressed(const result_t *r, double threshold_pct) {
+    for (int i = 0; i < baseline_rows; i++) {
+        const result_t *b = &baseline[i];
+        if (b->chunk_size != r->chunk_size || b->qos != r->qos || b->file_bytes != r->file_bytes ||
+            b->seed != r->seed ||
+            (int)(b->loss_pct * 100 + 0.5) != (int)(r->loss_pct * 100 + 0.5)) {
+            continue;
+        }
+        double limit = threshold_pct / 100.0;
+        bool worse = (b->complete && !r->complete) ||
+                     r->goodput_kbps < b->goodput_kbps * (1.0 - limit) ||
+                     (r->complete && r->time_ms > b->time_ms * (1.0 + limit));
+        if (worse) {
+            fprintf(stderr, "REGRESSION chunk=%u qos=%d loss=%.2f%% size=%u seed=%llu: "
+                    "goodput %.2f -> %.2f kbit/s, time %.1f -> %.1f ms, complete %d -> %d\n",
+                    r->chunk_size, r->qos, r->loss_pct, r->file_bytes, (unsigned long long)r->seed,
+                    b->goodput_kbps,
+                    r->goodput_kbps, b->time_ms, r->time_ms, b->complete, r->complete);
+        }
+        return worse;
+    }
+    return false;
+}
+
+static int parse_list(const char *text, double *values) {
+    int n = 0;
+    char *end;
+    while (*text != '\0' && n < MAX_LIST) {
+        values[n++] = strtod(text, &end);
+        if (end == text) {
+            return -1;
+        }
+        text = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-q 0,1,2] [-l 0,1,5] [-s 10000,50000,100000] [-S qos]\n"
+            "       [-d hop_ms] [-F k:m] [-r seed] [-N runs] [-j] [-n] [-b baseline.csv] [-t percent]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    double qos_list[MAX_LIST] = { 0, 1, 2 };
+    double loss_list[MAX_LIST] = { 0, 1, 5 };
+    double size_list[MAX_LIST] = { 10000, 50000, 100000 };
+    int qos_count = 3, loss_count = 3, size_count = 3;
+    uint32_t hop_ms = 5;
+    int subscribe_qos = 2;
+    uint64_t seed = 1;
+    uint32_t runs = 1;
+    int fec_k = 0, fec_m = 0;
+    bool json = false, header = true;
+    const char *baseline_path = NULL;
+    double threshold_pct = 5;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "q:l:s:S:d:F:r:N:jnb:t:")) != -1) {
+        switch (opt) {
+            case 'q': qos_count = parse_list(optarg, qos_list); break;
+            case 'l': loss_count = parse_list(optarg, loss_list); break;
+            case 's': size_count = parse_list(optarg, size_list); break;
+            case 'S': subscribe_qos = atoi(optarg); break;
+            case 'd': hop_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'F':
+                if (sscanf(optarg, "%d:%d", &fec_k, &fec_m) != 2) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'r': seed = strtoull(optarg, NULL, 0); break;
+            case 'N': runs = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'j': json = true; break;
+            case 'n': header = false; break;
+            case 'b': baseline_path = optarg; break;
+            case 't': threshold_pct = strtod(optarg, NULL); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (qos_count <= 0 || loss_count <= 0 || size_count <= 0 || runs == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    for (int i = 0; i < size_count; i++) {
+        if (size_list[i] < 1 || size_list[i] > MAX_FILE_SIZE) {
+            fprintf(stderr, "File sizes must be 1..%d bytes\n", MAX_FILE_SIZE);
+            return 1;
+        }
+    }
+    for (int i = 0; i < qos_count; i++) {
+        if (qos_list[i] < 0 || qos_list[i] > 2) {
+            fprintf(stderr, "QoS must be 0, 1 or 2\n");
+            return 1;
+        }
+    }
+    if (subscribe_qos < 0 || subscribe_qos > 2) {
+        fprintf(stderr, "QoS must be 0, 1 or 2\n");
+        return 1;
+    }
+    if (baseline_path != NULL && load_baseline(baseline_path) != 0) {
+        return 1;
+    }
+
+    // Results on stdout; the firmware's own logging goes nowhere
+    int results_fd = dup(STDOUT_FILENO);
+    out = fdopen(results_fd, "w");
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (out == NULL || null_fd < 0) {
+        perror("stdout");
+        return 1;
+    }
+    fflush(stdout);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+
+    block_transfer_set_fec((uint8_t)fec_k, (uint8_t)fec_m);
+    block_transfer_set_compression(false);
+    block_transfer_set_delta(false);
+
+    if (!json && header) {
+        fprintf(out, "%s\n", csv_header);
+    }
+    int regressions = 0;
+    for (int s = 0; s < size_count; s++) {
+        for (int q = 0; q < qos_count; q++) {
+            for (int l = 0; l < loss_count; l++) {
+                for (uint32_t n = 0; n < runs; n++) {
+                    result_t r;
+                    if (run((int)qos_list[q], loss_list[l], (uint32_t)size_list[s], hop_ms,
+                            subscribe_qos, seed + n, &r) != 0) {
+                        return 1;
+                    }
+                    if (json) {
+                        print_json(&r);
+                    } else {
+                        print_csv(&r);
+                    }
+                    fflush(out);
+                    if (baseline_path != NULL && regressed(&r, threshold_pct)) {
+                        regressions++;
+                    }
+                }
+            }
+        }
+    }
+    if (baseline_path != NULL) {
+        fprintf(stderr, "%d regression%s against %s (threshold %.1f%%)\n",
+                regressions, regressions == 1 ? "" : "s", baseline_path, threshold_pct);
+    }
+    return regressions > 0 ? 2 : 0;
+}
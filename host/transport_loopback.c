@@ -0,0 +1,386 @@
+// transport_loopback.c - In-memory MQTT-SN transport and inline gateway (see transport_loopback.h)
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "pico/stdlib.h"
+#include "network_errors.h"
+#include "sim_clock.h"
+#include "transport_loopback.h"
+
+#define RECEIVE_STEP_US 1000
+#define MAX_TOPICS      16
+#define MAX_TOPIC_NAME  32
+#define MAX_QOS2_IN     8       // QoS 2 publishes waiting for PUBREL
+
+// MQTT-SN message types
+#define MSG_SEARCHGW    0x01
+#define MSG_GWINFO      0x02
+#define MSG_CONNECT     0x04
+#define MSG_CONNACK     0x05
+#define MSG_REGISTER    0x0A
+#define MSG_REGACK      0x0B
+#define MSG_PUBLISH     0x0C
+#define MSG_PUBACK      0x0D
+#define MSG_PUBCOMP     0x0E
+#define MSG_PUBREC      0x0F
+#define MSG_PUBREL      0x10
+#define MSG_SUBSCRIBE   0x12
+#define MSG_SUBACK      0x13
+#define MSG_PINGREQ     0x16
+#define MSG_PINGRESP    0x17
+#define MSG_DISCONNECT  0x18
+
+#define FLAG_QOS(f)     (((f) >> 5) & 3)
+#define TOPIC_TYPE(f)   ((f) & 3)
+#define TOPIC_NORMAL    0
+#define RC_ACCEPTED     0x00
+#define RC_INVALID_TOPIC 0x02
+
+// One producer, one consumer: head is only written by the producer and
+// tail by the consumer, each published with release ordering
+typedef struct {
+    uint32_t head;
+    uint32_t tail;
+    uint16_t len[LOOPBACK_SLOTS];
+    uint8_t data[LOOPBACK_SLOTS][LOOPBACK_MTU];
+} ring_t;
+
+typedef struct {
+    bool used;
+    uint16_t msgid;
+    uint16_t len;
+    uint8_t packet[LOOPBACK_MTU];   // Already rewritten for forwarding
+} qos2_in_t;
+
+static ring_t to_device;            // Peer or gateway -> device
+static ring_t from_device;          // Device -> peer (no gateway)
+static ring_t forwards;             // Gateway -> deliver callback
+
+static bool opened;
+static loopback_stats_t stats;
+
+static loopback_deliver_fn gateway_deliver;
+static void *gateway_ctx;
+static bool hand_over_scheduled;
+static char topics[MAX_TOPICS][MAX_TOPIC_NAME];
+static int topic_count;
+static qos2_in_t qos2_in[MAX_QOS2_IN];
+
+// Rings
+
+static bool ring_push(ring_t *r, const uint8_t *data, size_t len) {
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    if (len > LOOPBACK_MTU || head - tail == LOOPBACK_SLOTS) {
+        __atomic_fetch_add(&stats.dropped, 1, __ATOMIC_RELAXED);    // Either side's thread
+        return false;
+    }
+    uint32_t slot = head % LOOPBACK_SLOTS;
+    memcpy(r->data[slot], data, len);
+    r->len[slot] = (uint16_t)len;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Length of the datagram taken (cut to max_len), or 0 if there is none
+static size_t ring_pop(ring_t *r, uint8_t *buffer, size_t max_len) {
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        return 0;
+    }
+    uint32_t slot = tail % LOOPBACK_SLOTS;
+    size_t len = r->len[slot] < max_len ? r->len[slot] : max_len;
+    memcpy(buffer, r->data[slot], len);
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    return len;
+}
+
+static void ring_reset(ring_t *r) {
+    __atomic_store_n(&r->head, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&r->tail, 0, __ATOMIC_RELEASE);
+}
+
+// MQTT-SN framing
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static void answer(uint8_t type, const uint8_t *body, size_t body_len) {
+    uint8_t buf[16];
+    buf[0] = (uint8_t)(body_len + 2);
+    buf[1] = type;
+    if (body_len > 0) memcpy(buf + 2, body, body_len);
+    ring_push(&to_device, buf, body_len + 2);
+}
+
+// Topic id for a name, registered on first use; 0 if the table is full
+static uint16_t topic_id(const char *name, size_t len) {
+    if (len == 0 || len >= MAX_TOPIC_NAME) return 0;
+    for (int i = 0; i < topic_count; i++) {
+        if (strlen(topics[i]) == len && memcmp(topics[i], name, len) == 0) {
+            return (uint16_t)(i + 1);
+        }
+    }
+    if (topic_count == MAX_TOPICS) return 0;
+    memcpy(topics[topic_count], name, len);
+    topics[topic_count][len] = '\0';
+    return (uint16_t)++topic_count;
+}
+
+// Gateway
+
+static void hand_over(void *ctx) {
+    (void)ctx;
+    static uint8_t packet[LOOPBACK_MTU];
+    hand_over_scheduled = false;
+    size_t len;
+    while (gateway_deliver != NULL && (len = ring_pop(&forwards, packet, sizeof(packet))) > 0) {
+        gateway_deliver(packet, len, gateway_ctx);
+    }
+}
+
+static void forward(const uint8_t *packet, size_t len) {
+    if (!ring_push(&forwards, packet, len)) {
+        return;
+    }
+    stats.forwarded++;
+    if (!hand_over_scheduled && sim_clock_after(0, hand_over, NULL) == 0) {
+        hand_over_scheduled = true;
+    }
+}
+
+// The PUBLISH as the subscriber gets it: QoS 0, no message id
+static void rewrite_for_subscriber(uint8_t *packet, size_t hdr) {
+    packet[hdr] &= (uint8_t)~(3 << 5);
+    put16(packet + hdr + 3, 0);
+}
+
+static void handle_publish(const uint8_t *data, size_t len, size_t hdr) {
+    const uint8_t *b = data + hdr;
+    if (len < hdr + 5) return;
+    uint8_t flags = b[0];
+    uint16_t topic = get16(b + 1);
+    uint16_t msgid = get16(b + 3);
+    uint8_t qos = FLAG_QOS(flags);
+
+    if (TOPIC_TYPE(flags) == TOPIC_NORMAL && (topic == 0 || topic > topic_count)) {
+        uint8_t ack[5];
+        put16(ack, topic);
+        put16(ack + 2, msgid);
+        ack[4] = RC_INVALID_TOPIC;
+        if (qos == 1 || qos == 2) answer(MSG_PUBACK, ack, sizeof(ack));
+        return;
+    }
+
+    uint8_t packet[LOOPBACK_MTU];
+    memcpy(packet, data, len);
+    rewrite_for_subscriber(packet, hdr);
+
+    if (qos == 1) {
+        uint8_t ack[5];
+        put16(ack, topic);
+        put16(ack + 2, msgid);
+        ack[4] = RC_ACCEPTED;
+        answer(MSG_PUBACK, ack, sizeof(ack));
+        forward(packet, len);
+    } else if (qos == 2) {
+        // Held until PUBREL, once however often it is sent
+        qos2_in_t *slot = NULL;
+        for (int i = 0; i < MAX_QOS2_IN; i++) {
+            if (qos2_in[i].used && qos2_in[i].msgid == msgid) {
+                slot = &qos2_in[i];
+                break;
+            }
+            if (!qos2_in[i].used && slot == NULL) slot = &qos2_in[i];
+        }
+        if (slot == NULL) {
+            stats.dropped++;
+            return;     // No PUBREC: the client sends it again
+        }
+        if (!slot->used) {
+            slot->used = true;
+            slot->msgid = msgid;
+            slot->len = (uint16_t)len;
+            memcpy(slot->packet, packet, len);
+        }
+        uint8_t rec[2];
+        put16(rec, msgid);
+        answer(MSG_PUBREC, rec, sizeof(rec));
+    } else {
+        forward(packet, len);     // QoS 0 and -1
+    }
+}
+
+static void gateway_handle(const uint8_t *data, size_t len) {
+    if (len < 2) return;
+    size_t hdr = 2;
+    size_t total = data[0];
+    uint8_t type = data[1];
+    if (data[0] == 0x01) {
+        if (len < 4) return;
+        hdr = 4;
+        total = get16(data + 1);
+        type = data[3];
+    }
+    if (total > len || total < hdr) {
+        return;
+    }
+    const uint8_t *b = data + hdr;
+    size_t blen = total - hdr;
+
+    switch (type) {
+        case MSG_SEARCHGW: {
+            uint8_t gwid = 1;
+            answer(MSG_GWINFO, &gwid, 1);
+            break;
+        }
+        case MSG_CONNECT: {
+            uint8_t rc = RC_ACCEPTED;
+            memset(qos2_in, 0, sizeof(qos2_in));
+            answer(MSG_CONNACK, &rc, 1);
+            break;
+        }
+        case MSG_REGISTER: {
+            if (blen < 4) break;
+            uint16_t id = topic_id((const char *)b + 4, blen - 4);
+            uint8_t ack[5];
+            put16(ack, id);
+            memcpy(ack + 2, b + 2, 2);
+            ack[4] = id ? RC_ACCEPTED : RC_INVALID_TOPIC;
+            answer(MSG_REGACK, ack, sizeof(ack));
+            break;
+        }
+        case MSG_SUBSCRIBE: {
+            if (blen < 3) break;
+            uint16_t id = TOPIC_TYPE(b[0]) == TOPIC_NORMAL ? topic_id((const char *)b + 3, blen - 3) : get16(b + 3);
+            uint8_t ack[6];
+            ack[0] = b[0] & (3 << 5);
+            put16(ack + 1, id);
+            memcpy(ack + 3, b + 1, 2);
+            ack[5] = id ? RC_ACCEPTED : RC_INVALID_TOPIC;
+            answer(MSG_SUBACK, ack, sizeof(ack));
+            break;
+        }
+        case MSG_PUBLISH:
+            handle_publish(data, total, hdr);
+            break;
+        case MSG_PUBREL: {
+            if (blen < 2) break;
+            uint16_t msgid = get16(b);
+            for (int i = 0; i < MAX_QOS2_IN; i++) {
+                if (qos2_in[i].used && qos2_in[i].msgid == msgid) {
+                    forward(qos2_in[i].packet, qos2_in[i].len);
+                    qos2_in[i].used = false;
+                }
+            }
+            answer(MSG_PUBCOMP, b, 2);
+            break;
+        }
+        case MSG_PINGREQ:
+            answer(MSG_PINGRESP, NULL, 0);
+            break;
+        case MSG_DISCONNECT:
+            answer(MSG_DISCONNECT, NULL, 0);
+            break;
+        default:
+            break;      // Acks from the device (PUBACK/PUBCOMP for a PUBLISH it got): nothing waits on them
+    }
+}
+
+void loopback_gateway_attach(loopback_deliver_fn deliver, void *ctx) {
+    gateway_deliver = deliver;
+    gateway_ctx = ctx;
+    topic_count = 0;
+    memset(qos2_in, 0, sizeof(qos2_in));
+}
+
+// Device side
+
+static int loopback_open(uint16_t local_port) {
+    ring_reset(&to_device);
+    ring_reset(&from_device);
+    ring_reset(&forwards);
+    memset(&stats, 0, sizeof(stats));
+    opened = true;
+    printf("[INFO] Loopback transport open on port %d (%s)\n", local_port,
+           gateway_deliver != NULL ? "inline gateway" : "peer");
+    return WIFI_OK;
+}
+
+static int loopback_send(const char *dest_ip, uint16_t dest_port, const uint8_t *data, size_t len) {
+    if (!opened) {
+        printf("[ERROR] Loopback send failed: transport not open.\n");
+        return WIFI_ESOCKET;
+    }
+    if (dest_ip == NULL || data == NULL || len == 0 || dest_port == 0) {
+        return WIFI_EINVAL;
+    }
+    stats.tx_packets++;
+    stats.tx_bytes += len;
+    if (gateway_deliver != NULL) {
+        gateway_handle(data, len);
+        return WIFI_OK;
+    }
+    return ring_push(&from_device, data, len) ? WIFI_OK : WIFI_ENOMEM;
+}
+
+static int loopback_receive(uint8_t *buffer, size_t max_len, uint32_t timeout_ms) {
+    if (!opened) {
+        return WIFI_ESOCKET;
+    }
+    if (buffer == NULL || max_len == 0) {
+        return WIFI_EINVAL;
+    }
+    uint64_t deadline = time_us_64() + (uint64_t)timeout_ms * 1000u;
+    for (;;) {
+        size_t n = ring_pop(&to_device, buffer, max_len);
+        if (n > 0) {
+            stats.rx_packets++;
+            stats.rx_bytes += n;
+            return (int)n;
+        }
+        if (timeout_ms == 0) {
+            return 0;
+        }
+        uint64_t now = time_us_64();
+        if (now >= deadline) {
+            return WIFI_ETIMEDOUT;
+        }
+        sleep_us(deadline - now < RECEIVE_STEP_US ? deadline - now : RECEIVE_STEP_US);
+    }
+}
+
+static void loopback_close(void) {
+    opened = false;
+}
+
+const mqttsn_transport_ops_t transport_loopback = {
+    .name = "loopback",
+    .open = loopback_open,
+    .send = loopback_send,
+    .receive = loopback_receive,
+    .close = loopback_close,
+};
+
+// Peer side
+
+int loopback_peer_receive(uint8_t *buffer, size_t max_len) {
+    return (int)ring_pop(&from_device, buffer, max_len);
+}
+
+int loopback_peer_send(const uint8_t *data, size_t len) {
+    return ring_push(&to_device, data, len) ? WIFI_OK : WIFI_ENOMEM;
+}
+
+const loopback_stats_t *loopback_get_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,64 @@
+// transport_loopback.h - In-memory MQTT-SN transport for host builds
+//
+// An mqttsn_transport_ops_t backend with no sockets: the device side (the
+// MQTT-SN client, through mqttsn_transport_*) and a peer exchange
+// datagrams through two single-producer/single-consumer rings of fixed
+// slots, lock-free, so the peer may run on another thread. Select it with
+//
+//   mqttsn_transport_set(&transport_loopback);
+//
+// Two ways to use it:
+//
+//   peer     Nothing answers by itself: what the device sends waits in a
+//            ring for loopback_peer_receive(), and what the peer hands to
+//            loopback_peer_send() is what the device receives. For tests
+//            that play the gateway, or a gateway thread of their own.
+//   gateway  loopback_gateway_attach() puts a minimal MQTT-SN gateway in
+//            the device's send path. It answers CONNECT, REGISTER,
+//            SUBSCRIBE, PUBLISH (PUBACK or PUBREC, then PUBCOMP on
+//            PUBREL), PINGREQ and DISCONNECT on the spot, so the client
+//            never waits, and forwards every accepted PUBLISH, as QoS 0,
+//            through a third ring to the deliver callback: the subscriber
+//            side in the same process. QoS 2 messages are forwarded on
+//            PUBREL, once.
+//
+// Forwards are handed over from a sim_clock.c event scheduled at the
+// current time, so they run at the device's next wait (the block sender's
+// chunk pacing, say) rather than inside the client's publish, and the
+// subscriber side may publish (block status) through the same client.
+// Device receives wait in sleep_us() steps, on whichever clock runs.
+
+#ifndef TRANSPORT_LOOPBACK_H
+#define TRANSPORT_LOOPBACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "mqttsn_adapter.h"
+
+#define LOOPBACK_SLOTS  64      // Datagrams per ring (a power of two)
+#define LOOPBACK_MTU    512     // Longest datagram; longer ones are dropped
+
+typedef struct {
+    uint32_t tx_packets;        // Device sends
+    uint32_t tx_bytes;
+    uint32_t rx_packets;        // Device receives
+    uint32_t rx_bytes;
+    uint32_t forwarded;         // Gateway: PUBLISH handed to the deliver callback
+    uint32_t dropped;           // Ring full or datagram over LOOPBACK_MTU
+} loopback_stats_t;
+
+extern const mqttsn_transport_ops_t transport_loopback;
+
+// Peer side: the next datagram the device sent (0 if none, non-blocking),
+// and one for the device to receive (0, or WIFI_ENOMEM if its ring is full)
+int loopback_peer_receive(uint8_t *buffer, size_t max_len);
+int loopback_peer_send(const uint8_t *data, size_t len);
+
+// Built-in gateway; deliver NULL detaches it (back to peer mode)
+typedef void (*loopback_deliver_fn)(const uint8_t *packet, size_t len, void *ctx);
+void loopback_gateway_attach(loopback_deliver_fn deliver, void *ctx);
+
+// Counters since the transport was opened
+const loopback_stats_t *loopback_get_stats(void);
+
+#endif // TRANSPORT_LOOPBACK_H
@@ -0,0 +1,189 @@
+// udp_posix.c - udp_driver.h on a POSIX UDP socket, for the native build
+//
+// Same API, return codes, metrics, tracepoints and wire capture as
+// udp_driver.c; a receive with a timeout waits in poll(). One difference
+// from the lwIP driver: datagrams that arrive while nobody is receiving
+// wait in the kernel's socket buffer instead of being dropped.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "udp_driver.h"
+#include "network_errors.h"
+#include "binlog.h"
+#include "metrics.h"
+#include "trace.h"
+#include "wire_capture.h"
+
+static int udp_fd = -1;
+
+static struct {
+    int tx_packets;
+    int tx_bytes;
+    int tx_errors;
+    int rx_packets;
+    int rx_bytes;
+    int rx_dropped;         // Truncated: longer than the caller's buffer
+} metric = { -1, -1, -1, -1, -1, -1 };
+
+int wifi_udp_create(uint16_t local_port){
+    metric.tx_packets = metrics_counter("udp_tx_packets");
+    metric.tx_bytes = metrics_counter("udp_tx_bytes");
+    metric.tx_errors = metrics_counter("udp_tx_errors");
+    metric.rx_packets = metrics_counter("udp_rx_packets");
+    metric.rx_bytes = metrics_counter("udp_rx_bytes");
+    metric.rx_dropped = metrics_counter("udp_rx_dropped");
+
+    if (udp_fd >= 0){
+        printf("[INFO] Closing existing UDP sockets\n");
+        close(udp_fd);
+        udp_fd = -1;
+    }
+
+    udp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (udp_fd < 0){
+        printf("[ERROR] Failed to create UDP socket (%s)\n", strerror(errno));
+        return WIFI_ENOMEM;
+    }
+
+    struct sockaddr_in local = {0};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(local_port);
+    if (bind(udp_fd, (struct sockaddr *)&local, sizeof(local)) != 0){
+        printf("[ERROR] Failed to bind UDP socket to port %d (%s)\n", local_port, strerror(errno));
+        int err = errno;
+        close(udp_fd);
+        udp_fd = -1;
+        if (err == EADDRINUSE){
+            printf("[INFO] UDP Port already in use\n");
+        }
+        return err == ENOMEM || err == ENOBUFS ? WIFI_ENOMEM : WIFI_ESOCKET;
+    }
+
+    // The station address of the native build is the loopback interface
+    // (pico_host.c); port 0 binds an ephemeral one, so ask which
+    socklen_t local_len = sizeof(local);
+    getsockname(udp_fd, (struct sockaddr *)&local, &local_len);
+    wire_capture_set_local(htonl(INADDR_LOOPBACK), ntohs(local.sin_port));
+    printf("[INFO] UDP Socket created and bound to port %d\n", local_port);
+    return WIFI_OK;
+}
+
+int wifi_udp_send(const char *dest_ip, uint16_t dest_port, const uint8_t *data, size_t len){
+    if (udp_fd < 0){
+        printf("[ERROR] UDP send failed: socket not created.\n");
+        return WIFI_ESOCKET;
+    }
+
+    if (dest_ip == NULL || data == NULL || len == 0){
+        printf("[UDP] Send Failed: Invalid Parameters\n");
+        return WIFI_EINVAL;
+    }
+
+    if (dest_port == 0){
+        printf("[UDP] Send Failed: Invalid Port (0)\n");
+        return WIFI_EINVAL;
+    }
+
+    struct sockaddr_in dest = {0};
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(dest_port);
+    if (inet_pton(AF_INET, dest_ip, &dest.sin_addr) != 1){
+        printf("[UDP] Send Failed: Invalid IP Address '%s'\n", dest_ip);
+        return WIFI_EINVAL;
+    }
+
+    TRACE_BEGIN(TRACE_UDP_SENDTO, len);
+    ssize_t sent = sendto(udp_fd, data, len, 0, (struct sockaddr *)&dest, sizeof(dest));
+    TRACE_END(TRACE_UDP_SENDTO, sent == (ssize_t)len ? len : 0);
+
+    if (sent != (ssize_t)len){
+        metrics_inc(metric.tx_errors);
+        printf("[UDP] Send Failed: sendto error %s\n", strerror(errno));
+        switch (errno){
+            case ENETUNREACH:
+            case EHOSTUNREACH:
+                printf("[UDP] No Route to %s\n", dest_ip);
+                return WIFI_ENOROUTE;
+            case ENOMEM:
+            case ENOBUFS:
+                return WIFI_ENOMEM;
+            default:
+                return WIFI_ESOCKET;
+        }
+    }
+
+    metrics_inc(metric.tx_packets);
+    metrics_add(metric.tx_bytes, len);
+    WIRE_CAPTURE(WIRE_CAPTURE_OUT, dest.sin_addr.s_addr, dest_port, data, len);
+    BLOG_DEBUG("[UDP] Sent %zu bytes to port %d\n", len, dest_port);
+    return WIFI_OK;
+}
+
+int wifi_udp_receive(uint8_t *buffer, size_t max_len, uint32_t timeout_ms) {
+    if (udp_fd < 0){
+        printf("[UDP] Received failed: socket not created\n");
+        return WIFI_ESOCKET;
+    }
+
+    if (buffer == NULL || max_len == 0){
+        printf("[UDP] Received failed: Invalid Buffer\n");
+        return WIFI_EINVAL;
+    }
+
+    struct pollfd pfd = { .fd = udp_fd, .events = POLLIN };
+    if (timeout_ms > 0) {
+        TRACE_BEGIN(TRACE_UDP_RECV_WAIT, timeout_ms);
+    }
+    int ready;
+    do {
+        ready = poll(&pfd, 1, (int)timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+    if (timeout_ms > 0) {
+        TRACE_END(TRACE_UDP_RECV_WAIT, ready > 0);
+    }
+
+    if (ready <= 0) {
+        // Non-blocking mode reports "no data" as 0, like the lwIP driver
+        return timeout_ms == 0 ? 0 : WIFI_ETIMEDOUT;
+    }
+
+    // MSG_TRUNC: the datagram's real length, to count truncated ones
+    struct sockaddr_in peer = {0};
+    socklen_t peer_len = sizeof(peer);
+    ssize_t n = recvfrom(udp_fd, buffer, max_len, MSG_TRUNC, (struct sockaddr *)&peer, &peer_len);
+    if (n < 0) {
+        return timeout_ms == 0 ? 0 : WIFI_ETIMEDOUT;
+    }
+    WIRE_CAPTURE(WIRE_CAPTURE_IN, peer.sin_addr.s_addr, ntohs(peer.sin_port), buffer,
+                 (size_t)n < max_len ? (size_t)n : max_len);
+    if ((size_t)n > max_len) {
+        metrics_inc(metric.rx_dropped);
+        n = (ssize_t)max_len;
+    }
+    TRACE_INSTANT(TRACE_UDP_RX, n);
+    metrics_inc(metric.rx_packets);
+    metrics_add(metric.rx_bytes, n);
+    BLOG_DEBUG("[UDP] Received %d bytes\n", (int)n);
+    return (int)n;
+}
+
+void wifi_udp_close(void){
+    if (udp_fd >= 0){
+        printf("[UDP] Closing socket...\n");
+        close(udp_fd);
+        udp_fd = -1;
+    }
+}
+
+bool is_udp_open(void){
+    return (udp_fd >= 0);
+}
@@ -0,0 +1,218 @@
+// wire_pcap.c - Turn wire capture dumps into a pcap file for Wireshark
+//
+// Reads console captures holding wire_capture_dump() output (#WCD .. #WCX,
+// other lines are ignored) and writes one pcap file of raw IPv4 packets:
+// each datagram gets back the IPv4 and UDP headers it had on the wire,
+// between the device's address and port from the dump and the peer's.
+// Datagrams longer than the dump's snaplen are written cut short, with
+// their real length, as a capture with a snaplen would be. Timestamps are
+// the device's time since boot; dumps follow one another in the order of
+// the files.
+//
+// Wireshark's MQTT-SN dissector decodes the UDP port it is told to
+// (Decode As..., or the dissector's port preference); -p rewrites the
+// gateway side to that port.
+//
+// Usage: wire_pcap [-o capture.pcap] [-l local ip] [-p gateway port] capture.txt [more captures...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <arpa/inet.h>
+
+#include "wire_capture.h"
+
+#define PCAP_MAGIC          0xa1b2c3d4
+#define PCAP_LINKTYPE_RAW   101         // Raw IPv4/IPv6 packets, no link layer
+#define IP_UDP_HEADERS      28
+#define MAX_PAYLOAD         4096
+
+static uint32_t local_override;         // Network byte order; 0: the dump's address
+static unsigned port_override;          // 0: the peer's real port
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void write_header(FILE *out) {
+    uint32_t header[6] = { PCAP_MAGIC, 2 | (4u << 16), 0, 0, 65535, PCAP_LINKTYPE_RAW };
+    fwrite(header, sizeof(header), 1, out);
+}
+
+static uint16_t ip_checksum(const uint8_t *p, size_t len) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        sum += (uint32_t)(p[i] << 8 | p[i + 1]);
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+// One datagram: src/dst in network byte order, ports in host order
+static void write_packet(FILE *out, uint64_t ts_us, uint32_t src, uint16_t src_port, uint32_t dst,
+                         uint16_t dst_port, const uint8_t *data, size_t kept, size_t len) {
+    static uint16_t ip_id;
+    uint8_t headers[IP_UDP_HEADERS] = {0};
+    uint8_t *ip = headers;
+    uint8_t *udp = headers + 20;
+    ip[0] = 0x45;                       // IPv4, 20-byte header
+    put16(ip + 2, (uint16_t)(IP_UDP_HEADERS + len));
+    put16(ip + 4, ip_id++);
+    ip[8] = 64;                         // TTL
+    ip[9] = 17;                         // UDP
+    memcpy(ip + 12, &src, 4);
+    memcpy(ip + 16, &dst, 4);
+    put16(ip + 10, ip_checksum(ip, 20));
+    put16(udp, src_port);
+    put16(udp + 2, dst_port);
+    put16(udp + 4, (uint16_t)(8 + len));  // Checksum 0: not computed
+
+    uint32_t record[4] = { (uint32_t)(ts_us / 1000000u), (uint32_t)(ts_us % 1000000u),
+                           (uint32_t)(IP_UDP_HEADERS + kept), (uint32_t)(IP_UDP_HEADERS + len) };
+    fwrite(record, sizeof(record), 1, out);
+    fwrite(headers, sizeof(headers), 1, out);
+    fwrite(data, 1, kept, out);
+}
+
+static size_t parse_hex(const char *hex, uint8_t *data, size_t max) {
+    size_t n = 0;
+    unsigned byte;
+    while (n < max && sscanf(hex + 2 * n, "%2x", &byte) == 1) {
+        data[n++] = (uint8_t)byte;
+    }
+    return n;
+}
+
+static int convert(FILE *out, const char *path) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return -1;
+    }
+    const char *file = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    bool in_dump = false;
+    unsigned dump = 0;
+    unsigned long lost = 0;
+    uint32_t local_ip = 0;
+    unsigned local_port = 0;
+    int packets = 0;
+    int dumps = 0;
+    char line[2 * MAX_PAYLOAD + 128];
+    while (fgets(line, sizeof(line), in)) {
+        // Tags share a prefix: test the longer ones first
+        if (strncmp(line, WIRE_DUMP_TAG " ", strlen(WIRE_DUMP_TAG) + 1) == 0) {
+            char ip[16] = "0.0.0.0";
+            unsigned snaplen;
+            sscanf(line + strlen(WIRE_DUMP_TAG), "%u %lu %u %15s %u", &dump, &lost, &snaplen, ip, &local_port);
+            if (inet_pton(AF_INET, ip, &local_ip) != 1) {
+                local_ip = 0;
+            }
+            if (local_override) {
+                local_ip = local_override;
+            }
+            packets = 0;
+            in_dump = true;
+        } else if (!in_dump) {
+            continue;
+        } else if (strncmp(line, WIRE_END_TAG, strlen(WIRE_END_TAG)) == 0) {
+            fprintf(stderr, "%s #%u: %d datagrams, %lu lost in the ring\n", file, dump, packets, lost);
+            dumps++;
+            in_dump = false;
+        } else if (strncmp(line, WIRE_RECORD_TAG " ", strlen(WIRE_RECORD_TAG) + 1) == 0) {
+            unsigned long long ts;
+            char dir;
+            char ip[16];
+            unsigned port, len;
+            int hex_at = 0;
+            if (sscanf(line + strlen(WIRE_RECORD_TAG), "%llx %c %15s %u %u %n", &ts, &dir, ip, &port, &len,
+                       &hex_at) < 5) {
+                continue;
+            }
+            uint32_t peer_ip;
+            if (inet_pton(AF_INET, ip, &peer_ip) != 1) {
+                continue;
+            }
+            uint8_t data[MAX_PAYLOAD];
+            size_t kept = parse_hex(line + strlen(WIRE_RECORD_TAG) + hex_at, data, sizeof(data));
+            if (kept > len) {
+                kept = len;
+            }
+            uint16_t peer_port = (uint16_t)(port_override ? port_override : port);
+            if (dir == WIRE_CAPTURE_OUT) {
+                write_packet(out, ts, local_ip, (uint16_t)local_port, peer_ip, peer_port, data, kept, len);
+            } else {
+                write_packet(out, ts, peer_ip, peer_port, local_ip, (uint16_t)local_port, data, kept, len);
+            }
+            packets++;
+        }
+    }
+    fclose(in);
+    if (in_dump) {
+        fprintf(stderr, "%s: the last dump is cut short, skipped\n", file);
+    }
+    if (dumps == 0) {
+        fprintf(stderr, "%s: no wire capture dump found\n", file);
+    }
+    return dumps;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-o capture.pcap] [-l local ip] [-p gateway port] capture.txt [more captures...]\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+    int first = 1;
+    while (first + 1 < argc && argv[first][0] == '-') {
+        const char *opt = argv[first];
+        const char *value = argv[first + 1];
+        if (strcmp(opt, "-o") == 0) {
+            out_path = value;
+        } else if (strcmp(opt, "-l") == 0) {
+            if (inet_pton(AF_INET, value, &local_override) != 1) {
+                fprintf(stderr, "Bad address %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(opt, "-p") == 0) {
+            port_override = (unsigned)strtoul(value, NULL, 10);
+            if (port_override == 0 || port_override > 65535) {
+                fprintf(stderr, "Bad port %s\n", value);
+                return 1;
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        first += 2;
+    }
+    if (first >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (out_path) {
+        out = fopen(out_path, "wb");
+        if (out == NULL) {
+            fprintf(stderr, "Cannot write %s\n", out_path);
+            return 1;
+        }
+    }
+    write_header(out);
+    int failures = 0;
+    for (int i = first; i < argc; i++) {
+        if (convert(out, argv[i]) <= 0) {
+            failures++;
+        }
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    return failures ? 1 : 0;
+}
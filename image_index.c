@@ -0,0 +1,300 @@
+// image_index.c - On-card image index (IMAGES.IDX)
+
+#include "image_index.h"
+#include "ff.h"
+#include "diskio.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <string.h>
+
+#define IMAGE_INDEX_MAGIC   0x58444949u    // "IIDX"
+#define IMAGE_INDEX_VERSION 1
+
+// FAT short-name directory entry
+#define DIR_ENTRY_SIZE  32
+#define DIR_CLUST_HI    20
+#define DIR_MOD_TIME    22
+#define DIR_MOD_DATE    24
+#define DIR_CLUST_LO    26
+#define DIR_FILE_SIZE   28
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t count;             // Records following the header
+    uint32_t next_unsent;       // First record without IMAGE_INDEX_SENT (count if none)
+    uint32_t free_clusters;     // Volume fingerprint when the index was last written
+    uint8_t reserved[12];
+} index_header_t;
+
+_Static_assert(sizeof(index_header_t) == 32, "index header layout");
+_Static_assert(sizeof(image_index_entry_t) == 80, "index record layout");
+
+static FIL idx_file;            // Kept open: reopening means a root directory search
+static bool idx_open = false;
+static index_header_t hdr;
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return (uint32_t)get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+static bool is_image(const char *name) {
+    size_t len = strlen(name);
+    return (len > 4 && strcasecmp(&name[len - 4], ".jpg") == 0) ||
+           (len > 5 && strcasecmp(&name[len - 5], ".jpeg") == 0);
+}
+
+// A remount invalidates the open file
+static bool index_ready(void) {
+    return idx_open && idx_file.obj.fs != NULL && idx_file.obj.fs->fs_type != 0 &&
+           idx_file.obj.id == idx_file.obj.fs->id;
+}
+
+static int read_at(FIL *file, FSIZE_t offset, void *buf, UINT len) {
+    UINT n = 0;
+    if (f_lseek(file, offset) != FR_OK || f_read(file, buf, len, &n) != FR_OK || n != len) return -1;
+    return 0;
+}
+
+static int write_at(FIL *file, FSIZE_t offset, const void *buf, UINT len) {
+    UINT n = 0;
+    if (f_lseek(file, offset) != FR_OK || f_write(file, buf, len, &n) != FR_OK || n != len) return -1;
+    return 0;
+}
+
+static FSIZE_t record_offset(uint32_t id) {
+    return sizeof(index_header_t) + (FSIZE_t)id * sizeof(image_index_entry_t);
+}
+
+static bool entry_matches(const uint8_t *ent, const FILINFO *fno) {
+    return get32(ent + DIR_FILE_SIZE) == fno->fsize && get16(ent + DIR_MOD_DATE) == fno->fdate &&
+           get16(ent + DIR_MOD_TIME) == fno->ftime;
+}
+
+// First cluster of the file f_readdir() just returned, from its short-name
+// entry, without a directory search per file. f_readdir() leaves dptr one
+// entry past it (on it at the end of the directory) and its sector in the
+// volume window, unless stepping on crossed into the next sector: then it
+// is the sector before, or the last one of the cluster the read started
+// in. The entry's size and timestamp must match before it is trusted;
+// anything else opens the file.
+static uint32_t entry_cluster(DIR *dir, const FILINFO *fno, DWORD start_clust) {
+    static uint8_t sector[FF_MAX_SS];
+    FATFS *fs = dir->obj.fs;
+    const uint8_t *ent = NULL;
+
+    if (dir->sect != 0 && dir->dptr % FF_MAX_SS != 0) {
+        if (fs->winsect == dir->sect) ent = fs->win + (dir->dptr - DIR_ENTRY_SIZE) % FF_MAX_SS;
+    } else if (dir->sect != 0) {
+        LBA_t prev = dir->sect - 1;
+        if ((dir->dptr / FF_MAX_SS) % fs->csize == 0) {
+            prev = fs->database + (LBA_t)(start_clust - 2) * fs->csize + fs->csize - 1;
+        }
+        if (fs->winsect == prev) {
+            ent = fs->win + FF_MAX_SS - DIR_ENTRY_SIZE;
+        } else if (disk_read(fs->pdrv, sector, prev, 1) == RES_OK) {
+            ent = sector + FF_MAX_SS - DIR_ENTRY_SIZE;
+        }
+    }
+    if (ent != NULL && entry_matches(ent, fno)) {
+        return ((uint32_t)get16(ent + DIR_CLUST_HI) << 16) | get16(ent + DIR_CLUST_LO);
+    }
+
+    FIL file;
+    if (f_open(&file, fno->fname, FA_READ) != FR_OK) return 0;
+    uint32_t cluster = file.obj.sclust;
+    f_close(&file);
+    return cluster;
+}
+
+static int load_index(void) {
+    if (f_open(&idx_file, IMAGE_INDEX_FILE, FA_READ | FA_WRITE) != FR_OK) return -1;
+    idx_open = true;
+    if (read_at(&idx_file, 0, &hdr, sizeof(hdr)) != 0 || hdr.magic != IMAGE_INDEX_MAGIC ||
+        hdr.version != IMAGE_INDEX_VERSION || hdr.record_size != sizeof(image_index_entry_t) ||
+        f_size(&idx_file) != record_offset(hdr.count)) {
+        printf("[INDEX] ⚠ %s is not a valid index - rebuilding\n", IMAGE_INDEX_FILE);
+        image_index_close();
+        return -1;
+    }
+    return 0;
+}
+
+// Scan the root directory into IMAGES.TMP, carrying sent flags over from
+// the open index (if any), then replace IMAGES.IDX with it
+static int refresh(void) {
+    FIL out;
+    DIR dir;
+    FILINFO fno;
+    image_index_entry_t rec, old;
+    index_header_t h = { IMAGE_INDEX_MAGIC, IMAGE_INDEX_VERSION, sizeof(image_index_entry_t) };
+    uint32_t old_count = index_ready() ? hdr.count : 0;
+    uint32_t old_pos = 0, kept = 0;
+    bool have_unsent = false;
+    uint64_t start = time_us_64();
+
+    if (f_open(&out, IMAGE_INDEX_TMP, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+        printf("[INDEX] ❌ Cannot create %s\n", IMAGE_INDEX_TMP);
+        return -1;
+    }
+    if (write_at(&out, 0, &h, sizeof(h)) != 0 || f_opendir(&dir, "/") != FR_OK) goto fail;
+
+    for (;;) {
+        DWORD start_clust = dir.clust;
+        if (f_readdir(&dir, &fno) != FR_OK) {
+            f_closedir(&dir);
+            goto fail;
+        }
+        if (fno.fname[0] == 0) break;
+        if ((fno.fattrib & AM_DIR) || !is_image(fno.fname)) continue;
+        if (strlen(fno.fname) >= IMAGE_INDEX_NAME_MAX) {
+            printf("[INDEX] ⚠ Skipping '%s': name too long\n", fno.fname);
+            continue;
+        }
+
+        memset(&rec, 0, sizeof(rec));
+        strcpy(rec.name, fno.fname);
+        rec.size = fno.fsize;
+        rec.fdate = fno.fdate;
+        rec.ftime = fno.ftime;
+        rec.first_cluster = entry_cluster(&dir, &fno, start_clust);
+
+        // Directory order is stable: look for the file a little ahead of
+        // the last match, skipping records of deleted files
+        for (uint32_t j = old_pos; j < old_count && j < old_pos + IMAGE_INDEX_LOOKAHEAD; j++) {
+            if (read_at(&idx_file, record_offset(j), &old, sizeof(old)) != 0) break;
+            if (strcmp(old.name, rec.name) != 0) continue;
+            if (old.size == rec.size && old.fdate == rec.fdate && old.ftime == rec.ftime) {
+                rec.flags = old.flags;
+                if (old.flags & IMAGE_INDEX_SENT) kept++;
+            }
+            old_pos = j + 1;
+            break;
+        }
+
+        if (!have_unsent && !(rec.flags & IMAGE_INDEX_SENT)) {
+            h.next_unsent = h.count;
+            have_unsent = true;
+        }
+        if (write_at(&out, record_offset(h.count), &rec, sizeof(rec)) != 0) {
+            f_closedir(&dir);
+            goto fail;
+        }
+        h.count++;
+    }
+    f_closedir(&dir);
+
+    if (!have_unsent) h.next_unsent = h.count;
+    if (write_at(&out, 0, &h, sizeof(h)) != 0 || f_close(&out) != FR_OK) {
+        f_unlink(IMAGE_INDEX_TMP);
+        return -1;
+    }
+    image_index_close();
+    FRESULT res = f_unlink(IMAGE_INDEX_FILE);
+    if ((res != FR_OK && res != FR_NO_FILE) || f_rename(IMAGE_INDEX_TMP, IMAGE_INDEX_FILE) != FR_OK ||
+        load_index() != 0) {
+        printf("[INDEX] ❌ Cannot replace %s\n", IMAGE_INDEX_FILE);
+        return -1;
+    }
+
+    // Fingerprint the volume as it is now, with the index in place
+    FATFS *fs;
+    DWORD free_clusters;
+    if (f_getfree("", &free_clusters, &fs) != FR_OK) return -1;
+    hdr.free_clusters = free_clusters;
+    if (write_at(&idx_file, 0, &hdr, sizeof(hdr)) != 0 || f_sync(&idx_file) != FR_OK) return -1;
+
+    printf("[INDEX] Indexed %lu image(s) in %lu ms (%lu already sent)\n", (unsigned long)hdr.count,
+           (unsigned long)((time_us_64() - start) / 1000), (unsigned long)kept);
+    return 0;
+
+fail:
+    f_close(&out);
+    f_unlink(IMAGE_INDEX_TMP);
+    printf("[INDEX] ❌ Directory scan failed\n");
+    return -1;
+}
+
+int image_index_open(void) {
+    FATFS *fs;
+    DWORD free_clusters;
+    if (f_getfree("", &free_clusters, &fs) != FR_OK) return -1;
+
+    if (!index_ready()) {
+        idx_open = false;
+        load_index();
+    }
+    if (index_ready() && hdr.free_clusters == free_clusters) return (int)hdr.count;
+
+    if (index_ready()) printf("[INDEX] Card changed since the index was written - rescanning\n");
+    return refresh() == 0 ? (int)hdr.count : -1;
+}
+
+int image_index_rebuild(void) {
+    if (!index_ready()) {
+        idx_open = false;
+        load_index();
+    }
+    return refresh() == 0 ? (int)hdr.count : -1;
+}
+
+uint32_t image_index_count(void) {
+    return index_ready() ? hdr.count : 0;
+}
+
+int image_index_get(uint32_t id, image_index_entry_t *entry) {
+    if (!index_ready() || id >= hdr.count) return -1;
+    if (read_at(&idx_file, record_offset(id), entry, sizeof(*entry)) != 0) return -1;
+    entry->name[IMAGE_INDEX_NAME_MAX - 1] = '\0';
+    return 0;
+}
+
+int image_index_next(image_index_entry_t *entry) {
+    if (!index_ready() || hdr.next_unsent >= hdr.count) return -1;
+    if (image_index_get(hdr.next_unsent, entry) != 0) return -1;
+    return (int)hdr.next_unsent;
+}
+
+int image_index_mark_sent(uint32_t id) {
+    image_index_entry_t rec;
+    if (image_index_get(id, &rec) != 0) return -1;
+    if (!(rec.flags & IMAGE_INDEX_SENT)) {
+        rec.flags |= IMAGE_INDEX_SENT;
+        if (write_at(&idx_file, record_offset(id), &rec, sizeof(rec)) != 0) return -1;
+    }
+
+    // Every record before next_unsent is sent, so it only moves forward
+    if (id == hdr.next_unsent) {
+        while (++hdr.next_unsent < hdr.count) {
+            if (image_index_get(hdr.next_unsent, &rec) != 0) return -1;
+            if (!(rec.flags & IMAGE_INDEX_SENT)) break;
+        }
+        if (write_at(&idx_file, 0, &hdr, sizeof(hdr)) != 0) return -1;
+    }
+    return f_sync(&idx_file) == FR_OK ? 0 : -1;
+}
+
+int image_index_reset_sent(void) {
+    if (!index_ready()) return -1;
+    image_index_entry_t rec;
+    for (uint32_t id = 0; id < hdr.count; id++) {
+        if (image_index_get(id, &rec) != 0) return -1;
+        if (rec.flags & IMAGE_INDEX_SENT) {
+            rec.flags &= ~IMAGE_INDEX_SENT;
+            if (write_at(&idx_file, record_offset(id), &rec, sizeof(rec)) != 0) return -1;
+        }
+    }
+    hdr.next_unsent = 0;
+    if (write_at(&idx_file, 0, &hdr, sizeof(hdr)) != 0) return -1;
+    return f_sync(&idx_file) == FR_OK ? 0 : -1;
+}
+
+void image_index_close(void) {
+    if (index_ready()) f_close(&idx_file);
+    idx_open = false;
+}
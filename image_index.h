@@ -0,0 +1,55 @@
+// image_index.h - Persistent index of the images on the SD card
+//
+// IMAGES.IDX in the root directory holds one fixed-size record per .jpg /
+// .jpeg file: name, size, first cluster, FAT date/time and whether it has
+// been sent. Selecting the next image to send is a header read plus one
+// record read, however many images the card holds.
+//
+// The index is built by one directory scan and rebuilt only when the card
+// has changed since it was written. FAT has no directory modification
+// time, so the volume's free cluster count (kept in FSINFO, no I/O) is the
+// change fingerprint. A rescan merges with the old index in directory
+// order, so sent flags survive for files whose size and timestamp did not
+// change. A rename that leaves the free count unchanged is only picked up
+// by image_index_rebuild().
+
+#ifndef IMAGE_INDEX_H
+#define IMAGE_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define IMAGE_INDEX_FILE      "IMAGES.IDX"
+#define IMAGE_INDEX_TMP       "IMAGES.TMP"
+#define IMAGE_INDEX_NAME_MAX  64        // Longer names are skipped
+#define IMAGE_INDEX_LOOKAHEAD 16        // Old records searched per file when merging
+
+// Record flags
+#define IMAGE_INDEX_SENT      0x01
+
+typedef struct {
+    char name[IMAGE_INDEX_NAME_MAX];
+    uint32_t size;
+    uint32_t first_cluster;
+    uint16_t fdate;
+    uint16_t ftime;
+    uint8_t flags;
+    uint8_t reserved[3];
+} image_index_entry_t;
+
+// Open the index, building or refreshing it if the card changed. Returns
+// the number of images, or -1.
+int image_index_open(void);
+// Rescan the directory even if the fingerprint matches
+int image_index_rebuild(void);
+
+uint32_t image_index_count(void);
+// First image not yet sent. Returns its id, or -1 if every image was sent.
+int image_index_next(image_index_entry_t *entry);
+int image_index_get(uint32_t id, image_index_entry_t *entry);
+int image_index_mark_sent(uint32_t id);
+// Clear every sent flag, so the next image is the first one again
+int image_index_reset_sent(void);
+void image_index_close(void);
+
+#endif // IMAGE_INDEX_H
@@ -4,6 +4,7 @@
 
 #include "ff.h"
 #include "diskio.h"
+#include "diskio_sdcard.h"
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -12,8 +13,181 @@
 extern int sd_card_init(void);
 extern int sd_card_read_sector(uint32_t sector, uint8_t *buffer);
 extern int sd_card_write_sector(uint32_t sector, const uint8_t *buffer);
+extern int sd_card_read_sectors(uint32_t sector, uint8_t *buffer, uint32_t count);
+extern int sd_card_write_sectors(uint32_t sector, const uint8_t *buffer, uint32_t count);
+extern int sd_card_get_sector_count(uint32_t *count);
 extern bool sd_card_is_initialized(void);  // Check hardware only, not filesystem
 
+/*-----------------------------------------------------------------------*/
+/* Sector cache                                                          */
+/*-----------------------------------------------------------------------*/
+// Write-back LRU cache for single-sector requests: FatFs reads FAT and
+// directory sectors through its window one at a time, over and over, and
+// partial-sector file reads arrive the same way. Multi-sector transfers
+// bypass it (they are file data and would only flush the metadata out).
+// Sectors of a streaming read are marked cold: once handed to FatFs they
+// are evicted first, even after a hit, so a stream cycles through a few
+// slots instead of evicting the FAT. Read-ahead sectors not yet requested
+// age like any other entry.
+
+typedef struct {
+    LBA_t lba;
+    uint32_t last_use;      // LRU stamp, 0 = free slot
+    bool dirty;
+    bool cold;              // Streamed data: evicted first once requested
+    bool prefetched;        // Read ahead and not yet requested
+    BYTE data[512];
+} cache_entry_t;
+
+static cache_entry_t cache[DISK_CACHE_SECTORS];
+static BYTE readahead_buf[DISK_READAHEAD * 512];
+static uint32_t cache_clock = 1;
+static bool cache_enabled = true;
+static disk_cache_stats_t cache_stats;
+static LBA_t next_sequential;   // Sector a streaming reader would ask for next
+static int sequential_misses;
+
+static cache_entry_t *cache_find(LBA_t lba) {
+    for (int i = 0; i < DISK_CACHE_SECTORS; i++) {
+        if (cache[i].last_use != 0 && cache[i].lba == lba) return &cache[i];
+    }
+    return NULL;
+}
+
+static int cache_write_back(cache_entry_t *e) {
+    if (!e->dirty) return 0;
+    if (sd_card_write_sector(e->lba, e->data) != 0) return -1;
+    e->dirty = false;
+    cache_stats.writebacks++;
+    return 0;
+}
+
+// Eviction rank: free slots, then consumed stream data, then everything else
+static int cache_rank(const cache_entry_t *e) {
+    if (e->last_use == 0) return 0;
+    return (e->cold && !e->prefetched) ? 1 : 2;
+}
+
+// Lowest rank, least recently used within it; written back if dirty.
+// NULL if that write fails.
+static cache_entry_t *cache_victim(void) {
+    cache_entry_t *victim = &cache[0];
+    for (int i = 1; i < DISK_CACHE_SECTORS; i++) {
+        cache_entry_t *e = &cache[i];
+        int rank = cache_rank(e), best = cache_rank(victim);
+        if (rank < best || (rank == best && e->last_use < victim->last_use)) {
+            victim = e;
+        }
+    }
+    if (cache_write_back(victim) != 0) return NULL;
+    victim->last_use = 0;
+    return victim;
+}
+
+// Write back every dirty sector in LBA order
+static int cache_flush(void) {
+    for (;;) {
+        cache_entry_t *next = NULL;
+        for (int i = 0; i < DISK_CACHE_SECTORS; i++) {
+            if (cache[i].last_use != 0 && cache[i].dirty && (next == NULL || cache[i].lba < next->lba)) {
+                next = &cache[i];
+            }
+        }
+        if (next == NULL) return 0;
+        if (cache_write_back(next) != 0) return -1;
+    }
+}
+
+static void cache_invalidate(void) {
+    memset(cache, 0, sizeof(cache));
+    cache_clock = 1;
+    sequential_misses = 0;
+}
+
+static cache_entry_t *cache_insert(LBA_t lba, const BYTE *data, bool cold, bool prefetched) {
+    cache_entry_t *e = cache_victim();
+    if (e == NULL) return NULL;
+    e->lba = lba;
+    e->dirty = false;
+    e->cold = cold;
+    e->prefetched = prefetched;
+    e->last_use = ++cache_clock;
+    memcpy(e->data, data, 512);
+    return e;
+}
+
+// Single-sector read through the cache
+static int cache_read(LBA_t sector, BYTE *buff) {
+    bool sequential = (sector == next_sequential);
+    next_sequential = sector + 1;
+    
+    cache_entry_t *e = cache_find(sector);
+    if (e != NULL) {
+        cache_stats.hits++;
+        if (e->prefetched) {
+            cache_stats.readahead_hits++;
+            e->prefetched = false;
+        }
+        if (!e->cold) {
+            // Streamed data is rarely read twice: it keeps its place
+            e->last_use = ++cache_clock;
+        }
+        memcpy(buff, e->data, 512);
+        return 0;
+    }
+    
+    cache_stats.misses++;
+    sequential_misses = sequential ? sequential_misses + 1 : 0;
+    
+    if (sequential_misses >= DISK_STREAM_TRIGGER &&
+        sd_card_read_sectors(sector, readahead_buf, DISK_READAHEAD) == 0) {
+        // One CMD18 for this sector and the next few; cached copies win
+        memcpy(buff, readahead_buf, 512);
+        if (cache_insert(sector, buff, true, false) == NULL) return -1;
+        for (int i = 1; i < DISK_READAHEAD; i++) {
+            if (cache_find(sector + i) != NULL) continue;
+            if (cache_insert(sector + i, readahead_buf + i * 512, true, true) == NULL) return -1;
+            cache_stats.readahead++;
+        }
+        return 0;
+    }
+    
+    if (sd_card_read_sector(sector, buff) != 0) return -1;
+    return cache_insert(sector, buff, sequential_misses > 0, false) != NULL ? 0 : -1;
+}
+
+// Single-sector write: absorbed by the cache until eviction or CTRL_SYNC
+static int cache_write(LBA_t sector, const BYTE *buff) {
+    cache_entry_t *e = cache_find(sector);
+    if (e != NULL) {
+        cache_stats.write_hits++;
+    } else {
+        e = cache_victim();
+        if (e == NULL) return -1;
+        e->lba = sector;
+    }
+    memcpy(e->data, buff, 512);
+    e->dirty = true;
+    e->cold = false;
+    e->prefetched = false;
+    e->last_use = ++cache_clock;
+    return 0;
+}
+
+void disk_cache_set_enabled(bool enable) {
+    if (!enable) cache_flush();
+    cache_invalidate();
+    cache_enabled = enable;
+}
+
+void disk_cache_get_stats(disk_cache_stats_t *stats) {
+    *stats = cache_stats;
+}
+
+void disk_cache_reset_stats(void) {
+    memset(&cache_stats, 0, sizeof(cache_stats));
+}
+
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
 /*-----------------------------------------------------------------------*/
@@ -35,6 +209,13 @@ DSTATUS disk_initialize (
 {
     if (pdrv != 0) return STA_NOINIT;
     
+    // Mounting may follow a card swap: nothing cached is trusted
+    cache_invalidate();
+    
+    // f_mount() right after sd_card_init() must not re-run identification
+    // and clock negotiation; callers that need a fresh start deinit first
+    if (sd_card_is_initialized()) return 0;
+    
     if (sd_card_init() == 0) {
         return 0;  // Success
     }
@@ -54,9 +235,23 @@ DRESULT disk_read (
     if (pdrv != 0) return RES_PARERR;
     if (!sd_card_is_initialized()) return RES_NOTRDY;
     
-    for (UINT i = 0; i < count; i++) {
-        if (sd_card_read_sector(sector + i, buff + (i * 512)) != 0) {
-            return RES_ERROR;
+    if (cache_enabled && count == 1) {
+        return cache_read(sector, buff) == 0 ? RES_OK : RES_ERROR;
+    }
+    
+    // One CMD18 stream for multi-sector reads instead of a CMD17 per sector
+    if (sd_card_read_sectors(sector, buff, count) != 0) {
+        return RES_ERROR;
+    }
+    
+    if (cache_enabled) {
+        // Dirty cached sectors are newer than the card
+        cache_stats.bypass_reads++;
+        for (int i = 0; i < DISK_CACHE_SECTORS; i++) {
+            if (cache[i].last_use != 0 && cache[i].dirty &&
+                cache[i].lba >= sector && cache[i].lba < sector + count) {
+                memcpy(buff + (cache[i].lba - sector) * 512, cache[i].data, 512);
+            }
         }
     }
     
@@ -77,9 +272,23 @@ DRESULT disk_write (
     if (pdrv != 0) return RES_PARERR;
     if (!sd_card_is_initialized()) return RES_NOTRDY;
     
-    for (UINT i = 0; i < count; i++) {
-        if (sd_card_write_sector(sector + i, buff + (i * 512)) != 0) {
-            return RES_ERROR;
+    if (cache_enabled && count == 1) {
+        return cache_write(sector, buff) == 0 ? RES_OK : RES_ERROR;
+    }
+    
+    // One pre-erased CMD25 write for multi-sector writes instead of a CMD24 per sector
+    if (sd_card_write_sectors(sector, buff, count) != 0) {
+        return RES_ERROR;
+    }
+    
+    if (cache_enabled) {
+        // Cached copies of the range now match the card
+        cache_stats.bypass_writes++;
+        for (int i = 0; i < DISK_CACHE_SECTORS; i++) {
+            if (cache[i].last_use != 0 && cache[i].lba >= sector && cache[i].lba < sector + count) {
+                memcpy(cache[i].data, buff + (cache[i].lba - sector) * 512, 512);
+                cache[i].dirty = false;
+            }
         }
     }
     
@@ -100,11 +309,16 @@ DRESULT disk_ioctl (
     
     switch (cmd) {
         case CTRL_SYNC:
-            return RES_OK;
+            // f_sync()/f_close()/f_mkdir() end here: nothing may stay dirty
+            return cache_flush() == 0 ? RES_OK : RES_ERROR;
             
-        case GET_SECTOR_COUNT:
-            *(LBA_t*)buff = 0;  // Will be detected automatically
+        case GET_SECTOR_COUNT: {
+            // Needed by f_mkfs; read from the card's CSD register
+            uint32_t sectors;
+            if (sd_card_get_sector_count(&sectors) != 0) return RES_ERROR;
+            *(LBA_t*)buff = sectors;
             return RES_OK;
+        }
             
         case GET_SECTOR_SIZE:
             *(WORD*)buff = 512;
@@ -0,0 +1,31 @@
+/*-----------------------------------------------------------------------*/
+/* Pico W SD Card disk I/O: sector cache controls                        */
+/*-----------------------------------------------------------------------*/
+
+#ifndef DISKIO_SDCARD_H
+#define DISKIO_SDCARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DISK_CACHE_SECTORS  8   // Cached sectors (512 bytes each)
+#define DISK_READAHEAD      4   // Sectors fetched per read-ahead (one CMD18)
+#define DISK_STREAM_TRIGGER 2   // Sequential single-sector misses before read-ahead starts
+
+typedef struct {
+    uint32_t hits;              // Single-sector reads served from the cache
+    uint32_t misses;            // Single-sector reads that went to the card
+    uint32_t readahead;         // Sectors fetched ahead of a streaming reader
+    uint32_t readahead_hits;    // ... that were later read
+    uint32_t write_hits;        // Single-sector writes absorbed by a cached sector
+    uint32_t writebacks;        // Dirty sectors written to the card
+    uint32_t bypass_reads;      // Multi-sector reads (not cached)
+    uint32_t bypass_writes;     // Multi-sector writes (not cached)
+} disk_cache_stats_t;
+
+// Off writes back dirty sectors and passes every request to the card
+void disk_cache_set_enabled(bool enable);
+void disk_cache_get_stats(disk_cache_stats_t *stats);
+void disk_cache_reset_stats(void);
+
+#endif // DISKIO_SDCARD_H
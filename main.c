@@ -14,8 +14,15 @@
 #include "udp_driver.h"
 #include "network_errors.h"
 #include "mqttsn_client.h"
+#include "mqttsn_adapter.h"
+#include "fault_inject.h"
 #include "block_transfer.h"
 #include "sd_card.h"
+#include "block_spool.h"
+#include "binlog.h"
+#include "metrics.h"
+#include "trace.h"
+#include "wire_capture.h"
 
 #define QOS_TOGGLE 22  // GP22
 #define BLOCK_TRANSFER 21  // GP22
@@ -81,14 +88,30 @@ static bool block_transfer_button_pressed(void){
     return false;
 }
 
-static void app_start_block_transfer(void){
-    if (!app_init_sd_card_once()) {
-        printf("[APP] Cannot start image transfer: SD initialisation failed\n");
-        return;
+static void process_publish_message(unsigned char *buf, int len);
+
+// Status messages the subscriber sent while a file was going out
+static void app_poll_messages(void){
+    unsigned char buf[512];
+    int rc;
+    while ((rc = mqttsn_transport_receive(buf, sizeof(buf), 0)) > 0) {
+        if (mqttsn_packet_type(buf, rc) == 0x0C) {  // PUBLISH
+            process_publish_message(buf, rc);
+        }
     }
+}
+
+// block_spool sender: the next file goes out as soon as the last one is done
+static int app_spool_send(void *ctx, const char *filename, uint16_t block_id, uint16_t resume_after,
+                          block_progress_t progress, void *progress_ctx){
+    (void)ctx;
+    app_poll_messages();
+    return send_image_file_resume("pico/chunks", filename, (uint8_t)mqttsn_get_qos(),
+                                  block_id, resume_after, progress, progress_ctx);
+}
 
-    // Scan SD card for image files and get the first one
-    printf("\n[APP] Scanning SD card for images...\n");
+// Every image already sent: send the first one again
+static void app_send_first_image(const char *topic, int qos){
     const char *filename = sd_card_get_first_image();
 
     if (filename == NULL) {
@@ -97,6 +120,27 @@ static void app_start_block_transfer(void){
         return;
     }
 
+    printf("\n[APP] Block transfer requested (file='%s', topic='%s', QoS='%d')\n", filename, topic, qos);
+    printf("[APP] Sending image from SD card via MQTT-SN...\n");
+
+    int rc = send_image_file_qos(topic, filename, (uint8_t)qos);
+    if (rc == 0){
+        printf("[APP] ✓ Block Transfer completed successfully\n");
+        printf("[APP] Image '%s' sent via MQTT-SN\n", filename);
+        if (sd_card_mark_image_sent() != 0) {
+            printf("[APP] ⚠ Could not mark '%s' as sent in the image index\n", filename);
+        }
+    } else {
+        printf("[APP] ✗ Block Transfer failed (rc=%d)\n", rc);
+    }
+}
+
+static void app_start_block_transfer(void){
+    if (!app_init_sd_card_once()) {
+        printf("[APP] Cannot start image transfer: SD initialisation failed\n");
+        return;
+    }
+
     const char *topic = "pico/chunks";  // Send to pico/chunks for receiver to save to repo
     int qos = mqttsn_get_qos();
 
@@ -107,15 +151,15 @@ static void app_start_block_transfer(void){
         return;
     }
 
-    printf("\n[APP] Block transfer requested (file='%s', topic='%s', QoS='%d')\n", filename, topic, qos);
-    printf("[APP] Sending image from SD card via MQTT-SN...\n");
-
-    int rc = send_image_file_qos(topic, filename, (uint8_t)qos);
-    if (rc == 0){
-        printf("[APP] ✓ Block Transfer completed successfully\n");
-        printf("[APP] Image '%s' sent via MQTT-SN\n", filename);
+    // Every unsent image on the card, back to back
+    printf("\n[APP] Spooling unsent images from SD card (topic='%s', QoS='%d')...\n", topic, qos);
+    int sent = block_spool_run(app_spool_send, NULL, NULL);
+    if (sent > 0) {
+        printf("[APP] ✓ %d image(s) sent via MQTT-SN\n", sent);
+    } else if (sent == 0) {
+        app_send_first_image(topic, qos);
     } else {
-        printf("[APP] ✗ Block Transfer failed (rc=%d)\n", rc);
+        printf("[APP] ✗ Spool stopped - it resumes from its journal on the next press or reconnect\n");
     }
 }
 
@@ -135,27 +179,31 @@ void buttons_init() {
 
 // Process incoming PUBLISH messages (for block status)
 static unsigned short status_topicid = 0;  // Store subscribed topic ID
+static unsigned short sig_topicid = 0;     // Delta signatures from the subscriber
+#if FAULT_INJECT_ENABLED
+static unsigned short fault_topicid = 0;   // Fault injection specs
+#endif
 static void process_publish_message(unsigned char *buf, int len) {
-    if (len < 7) return;
-    
-    // Parse PUBLISH packet to get topic ID and payload
-    unsigned char msg_type = buf[1];
-    if (msg_type != 0x0C) return; // Not a PUBLISH
-    
-    // Extract topic ID (bytes 2-3 in little endian for short topic ID)
-    unsigned short topic_id = buf[2] | (buf[3] << 8);
-    
-    // Payload starts after header (typically byte 7 for short topic ID)
-    int header_len = 7;
-    int payload_len = len - header_len;
-    unsigned char *payload = buf + header_len;
+    // Topic ID and payload (signature lists use the long length form)
+    mqttsn_publish_t pub;
+    if (mqttsn_parse_publish(buf, len, &pub) != 0) {
+        printf("[PUBLISHER] ⚠ Malformed PUBLISH (%d bytes) dropped\n", len);
+        return;
+    }
     
-    printf("[PUBLISHER] Received message on TopicID=%u, len=%d\n", topic_id, payload_len);
+    printf("[PUBLISHER] Received message on TopicID=%u, len=%d\n", pub.topicid, pub.payload_len);
     
     // Route to block status handler if it matches our subscribed topic
-    if (topic_id == status_topicid) {
-        process_block_status(payload, payload_len);
+    if (pub.topicid == status_topicid) {
+        process_block_status(pub.payload, pub.payload_len);
+    } else if (pub.topicid == sig_topicid) {
+        process_block_signatures(pub.payload, pub.payload_len);
     }
+#if FAULT_INJECT_ENABLED
+    else if (pub.topicid == fault_topicid && fault_topicid != 0) {
+        fault_inject_control(pub.payload, (size_t)pub.payload_len);
+    }
+#endif
 }
 
 int main(){
@@ -184,15 +232,48 @@ int main(){
 
     block_transfer_init();
 
+    // Application metrics (the drivers and block transfer register their own)
+    static const uint32_t publish_ms_bounds[] = { 10, 20, 50, 100, 200, 500, 1000, 5000 };
+    int metric_publish_ms = metrics_histogram("publish_ms", publish_ms_bounds,
+                                              sizeof(publish_ms_bounds) / sizeof(publish_ms_bounds[0]));
+    int metric_publish_failures = metrics_counter("publish_failures");
+    int metric_mqtt_connected = metrics_gauge("mqtt_connected");
+    int metric_connected_s = metrics_gauge("connected_s");
+    int metric_qos = metrics_gauge("qos");
+
     // Main Loop
     bool was_connected = wifi_is_connected();
-    absolute_time_t last_status_print = get_absolute_time();
+    absolute_time_t last_metrics_publish = get_absolute_time();
     bool mqtt_demo_started = false;
     uint32_t last_publish = 0;
     uint32_t connection_start_time = 0;
 
     while (true){
         uint32_t now = to_ms_since_boot(get_absolute_time());
+        
+        // Deferred log output, a few records at a time
+        binlog_drain(BINLOG_DRAIN_BATCH);
+        
+        // 't' on the USB console dumps the tracepoint rings (host/trace_export),
+        // 'c' turns wire capture on and off and 'w' dumps it (host/wire_pcap),
+        // 'f' takes a fault injection spec (fault_inject.h)
+        int key = getchar_timeout_us(0);
+        if (key == 't') {
+            binlog_flush();
+            trace_dump();
+        }
+        if (key == 'c') {
+            wire_capture_enable(!wire_capture_enabled);
+        }
+        if (key == 'w') {
+            binlog_flush();
+            wire_capture_dump();
+        }
+#if FAULT_INJECT_ENABLED
+        if (key == 'f') {
+            fault_inject_console();
+        }
+#endif
 
         // ========================= WiFi Reconnection Handling =========================
         wifi_auto_reconnect();  
@@ -238,7 +319,29 @@ int main(){
                         printf("[PUBLISHER] ✗ Failed to subscribe to pico/block_status (rc=%d)\n", status_sub_rc);
                     }
                     
+                    // Subscribe to block_sig so edited files can be sent as deltas
+                    int sig_sub_rc = mqttsn_demo_subscribe("pico/block_sig", 104, &sig_topicid);
+                    if (sig_sub_rc > 0) {
+                        printf("[PUBLISHER] ✓ Subscribed to pico/block_sig (TopicID=%u)\n", sig_topicid);
+                    } else {
+                        printf("[PUBLISHER] ✗ Failed to subscribe to pico/block_sig (rc=%d)\n", sig_sub_rc);
+                    }
+                    
+#if FAULT_INJECT_ENABLED
+                    // Fault injection specs published to pico/fault
+                    if (mqttsn_demo_subscribe(FAULT_INJECT_TOPIC, 105, &fault_topicid) > 0) {
+                        fault_inject_set_control_topic(fault_topicid);
+                        printf("[PUBLISHER] ✓ Subscribed to %s (TopicID=%u)\n", FAULT_INJECT_TOPIC, fault_topicid);
+                    }
+#endif
+                    
                     mqtt_demo_started = true;
+
+                    // A spool cut short by a power loss or disconnect carries on
+                    if (app_init_sd_card_once() && block_spool_interrupted()) {
+                        printf("[APP] Resuming interrupted image spool...\n");
+                        app_start_block_transfer();
+                    }
                 } else {
                     printf("[MQTT-SN] ✗ MQTT-SN Demo initialization failed, retrying...\n");
                     sleep_ms(10000);
@@ -249,7 +352,7 @@ int main(){
                 int rc = mqttsn_transport_receive(buf, sizeof(buf), 100);
                 
                 if (rc > 0) {
-                    uint8_t msg_type = buf[1];
+                    int msg_type = mqttsn_packet_type(buf, rc);
                     
                     if (msg_type == 0x0C) {  // PUBLISH
                         process_publish_message(buf, rc);
@@ -286,8 +389,10 @@ int main(){
                     uint32_t pub_end = to_ms_since_boot(get_absolute_time());
                     
                     if (pub_result == 0) {
+                        metrics_observe(metric_publish_ms, pub_end - pub_start);
                         printf("[MQTTSN] ✓ SUCCESS: Message published (latency=%lums)\n", pub_end - pub_start);
                     } else {
+                        metrics_inc(metric_publish_failures);
                         printf("[MQTTSN] ✗ WARNING: Publish failed (rc=%d)\n", pub_result);
                         mqtt_demo_started = false;
                         mqttsn_demo_close();
@@ -299,6 +404,16 @@ int main(){
                     printf("[BUTTON] Block Transfer button pressed.\n");
                     app_start_block_transfer();
                 }
+
+                // A subscriber could not rebuild a delta: send that file in full
+                const char *full_resend = block_transfer_take_full_resend();
+                if (full_resend != NULL) {
+                    printf("\n[APP] Sending '%s' again in full\n", full_resend);
+                    int rc = send_image_file_qos("pico/chunks", full_resend, (uint8_t)mqttsn_get_qos());
+                    if (rc != 0) {
+                        printf("[APP] ✗ Full send of '%s' failed (rc=%d)\n", full_resend, rc);
+                    }
+                }
             }
 
         } else {
@@ -307,16 +422,20 @@ int main(){
             }
         }
 
-        // Print stats every 30 seconds
-        if (absolute_time_diff_us(last_status_print, get_absolute_time()) > 30000000) {
-            printf("\n=== System Statistics ===\n");
-            wifi_print_stats();
-            printf("MQTT-SN Status: %s\n", mqtt_demo_started ? "Connected" : "Disconnected");
-            printf("Current QoS Level: %d\n", mqttsn_get_qos());
+        // Publish the metrics every 30 seconds (host/metrics_decode reads them)
+        if (absolute_time_diff_us(last_metrics_publish, get_absolute_time()) > METRICS_PUBLISH_MS * 1000LL) {
+            metrics_set(metric_mqtt_connected, mqtt_demo_started);
+            metrics_set(metric_connected_s, is_connected ? (int32_t)((now - connection_start_time) / 1000) : 0);
+            metrics_set(metric_qos, mqttsn_get_qos());
             if (mqtt_demo_started) {
-                printf("Uptime: %lu seconds\n", (now - connection_start_time) / 1000);
+                int payloads = metrics_publish();
+                if (payloads < 0) {
+                    printf("[METRICS] ✗ Publish to %s failed\n", METRICS_TOPIC);
+                } else {
+                    printf("[METRICS] Published to %s (%d payloads)\n", METRICS_TOPIC, payloads);
+                }
             }
-            last_status_print = get_absolute_time();
+            last_metrics_publish = get_absolute_time();
         }
 
         cyw43_arch_poll();
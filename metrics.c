@@ -0,0 +1,280 @@
+// metrics.c - Metrics registry and its binary encoding
+
+#include "metrics.h"
+#include "crc32c.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifndef METRICS_HOST
+#include "pico/stdlib.h"
+#include "mqttsn_client.h"
+#endif
+
+#define METRICS_MAX_HISTOGRAMS  6
+#define ENTRY_MAX               (2 + METRICS_NAME_MAX + 1 + 5 * (METRICS_MAX_BOUNDS + 1))
+
+typedef struct {
+    char name[METRICS_NAME_MAX];
+    uint8_t type;
+    uint8_t hist;               // Index into histograms[] (METRIC_HISTOGRAM)
+    volatile uint32_t value;    // Counter, gauge (two's complement) or observation count
+} metric_t;
+
+typedef struct {
+    uint8_t nbounds;
+    uint32_t bounds[METRICS_MAX_BOUNDS];
+    uint32_t buckets[METRICS_MAX_BOUNDS + 1];
+    uint32_t sum;
+} histogram_t;
+
+static metric_t metrics[METRICS_MAX];
+static uint8_t metric_count;
+static histogram_t histograms[METRICS_MAX_HISTOGRAMS];
+static uint8_t histogram_count;
+static uint32_t schema_crc;
+
+_Static_assert(METRICS_HEADER_SIZE + ENTRY_MAX <= METRICS_PAYLOAD_MAX, "a metric must fit a payload");
+
+static size_t put_varint(uint8_t *out, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static void put_u16(uint8_t *out, uint16_t v) {
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *out, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static size_t encode_schema_entry(const metric_t *m, uint8_t *out) {
+    size_t name_len = strlen(m->name);
+    size_t n = 0;
+    out[n++] = m->type;
+    out[n++] = (uint8_t)name_len;
+    memcpy(out + n, m->name, name_len);
+    n += name_len;
+    if (m->type == METRIC_HISTOGRAM) {
+        const histogram_t *h = &histograms[m->hist];
+        out[n++] = h->nbounds;
+        for (uint8_t i = 0; i < h->nbounds; i++) {
+            n += put_varint(out + n, h->bounds[i]);
+        }
+    }
+    return n;
+}
+
+static size_t encode_value_entry(const metric_t *m, uint8_t *out) {
+    if (m->type == METRIC_COUNTER) {
+        return put_varint(out, m->value);
+    }
+    if (m->type == METRIC_GAUGE) {
+        int32_t v = (int32_t)m->value;
+        return put_varint(out, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+    }
+    const histogram_t *h = &histograms[m->hist];
+    size_t n = 0;
+    for (uint8_t i = 0; i <= h->nbounds; i++) {
+        n += put_varint(out + n, h->buckets[i]);
+    }
+    n += put_varint(out + n, h->sum);
+    return n;
+}
+
+// The schema CRC names the registry layout in every payload, so a decoder
+// holding another schema ignores values it cannot map
+static void update_schema_crc(void) {
+    uint8_t entry[ENTRY_MAX];
+    uint32_t crc = 0;
+    for (uint8_t i = 0; i < metric_count; i++) {
+        crc = crc32c_update(crc, entry, encode_schema_entry(&metrics[i], entry));
+    }
+    schema_crc = crc;
+}
+
+static int find(const char *name) {
+    for (uint8_t i = 0; i < metric_count; i++) {
+        if (strcmp(metrics[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int add_metric(const char *name, uint8_t type) {
+    int id = find(name);
+    if (id >= 0) {
+        return metrics[id].type == type ? id : -1;
+    }
+    if (metric_count == METRICS_MAX || strlen(name) >= METRICS_NAME_MAX) {
+        printf("[METRICS] ⚠️  Cannot register '%s'\n", name);
+        return -1;
+    }
+    metric_t *m = &metrics[metric_count];
+    memset(m, 0, sizeof(*m));
+    strcpy(m->name, name);
+    m->type = type;
+    return metric_count++;
+}
+
+int metrics_counter(const char *name) {
+    int id = add_metric(name, METRIC_COUNTER);
+    update_schema_crc();
+    return id;
+}
+
+int metrics_gauge(const char *name) {
+    int id = add_metric(name, METRIC_GAUGE);
+    update_schema_crc();
+    return id;
+}
+
+int metrics_histogram(const char *name, const uint32_t *bounds, uint8_t nbounds) {
+    int id = find(name);
+    if (id >= 0) {
+        return metrics[id].type == METRIC_HISTOGRAM ? id : -1;
+    }
+    if (nbounds == 0 || nbounds > METRICS_MAX_BOUNDS || histogram_count == METRICS_MAX_HISTOGRAMS) {
+        printf("[METRICS] ⚠️  Cannot register histogram '%s'\n", name);
+        return -1;
+    }
+    id = add_metric(name, METRIC_HISTOGRAM);
+    if (id < 0) {
+        return -1;
+    }
+    histogram_t *h = &histograms[histogram_count];
+    memset(h, 0, sizeof(*h));
+    h->nbounds = nbounds;
+    memcpy(h->bounds, bounds, nbounds * sizeof(bounds[0]));
+    metrics[id].hist = histogram_count++;
+    update_schema_crc();
+    return id;
+}
+
+void metrics_add(int id, uint32_t n) {
+    if (id >= 0 && id < metric_count) {
+        metrics[id].value += n;
+    }
+}
+
+void metrics_set(int id, int32_t value) {
+    if (id >= 0 && id < metric_count) {
+        metrics[id].value = (uint32_t)value;
+    }
+}
+
+void metrics_observe(int id, uint32_t value) {
+    if (id < 0 || id >= metric_count || metrics[id].type != METRIC_HISTOGRAM) {
+        return;
+    }
+    histogram_t *h = &histograms[metrics[id].hist];
+    uint8_t bucket = 0;
+    while (bucket < h->nbounds && value > h->bounds[bucket]) {
+        bucket++;
+    }
+    h->buckets[bucket]++;
+    h->sum += value;
+    metrics[id].value++;
+}
+
+int32_t metrics_value(int id) {
+    return (id >= 0 && id < metric_count) ? (int32_t)metrics[id].value : 0;
+}
+
+int metrics_encode(uint8_t kind, uint8_t first, uint16_t seq, uint32_t uptime_s, uint8_t *out, size_t size,
+                   uint8_t *next) {
+    *next = first;
+    if (first >= metric_count || size < METRICS_HEADER_SIZE) {
+        return 0;
+    }
+    out[0] = METRICS_VERSION;
+    out[1] = kind;
+    put_u32(out + 2, schema_crc);
+    put_u16(out + 6, seq);
+    put_u32(out + 8, uptime_s);
+    out[12] = first;
+
+    size_t len = METRICS_HEADER_SIZE;
+    uint8_t i = first;
+    uint8_t entry[ENTRY_MAX];
+    while (i < metric_count) {
+        size_t n = (kind == METRICS_KIND_SCHEMA) ? encode_schema_entry(&metrics[i], entry)
+                                                 : encode_value_entry(&metrics[i], entry);
+        if (len + n > size) {
+            break;
+        }
+        memcpy(out + len, entry, n);
+        len += n;
+        i++;
+    }
+    out[13] = i - first;
+    *next = i;
+    return (int)len;
+}
+
+#ifndef METRICS_HOST
+
+static uint16_t publish_seq;
+static uint32_t published_schema_crc;
+static bool schema_published;
+static uint8_t since_schema;
+
+// Send every metric of a kind, in as many payloads as it takes
+static int publish_kind(uint8_t kind, uint32_t uptime_s) {
+    uint8_t payload[METRICS_PAYLOAD_MAX];
+    uint8_t first = 0;
+    int sent = 0;
+    while (first < metric_count) {
+        uint8_t next;
+        int len = metrics_encode(kind, first, publish_seq, uptime_s, payload, sizeof(payload), &next);
+        if (len <= 0 || next == first) {
+            return -1;
+        }
+        if (mqttsn_demo_publish_name(METRICS_TOPIC, payload, len) != 0) {
+            return -1;
+        }
+        sent++;
+        first = next;
+    }
+    return sent;
+}
+
+int metrics_publish(void) {
+    if (mqttsn_metrics_topicid == 0 || metric_count == 0) {
+        return -1;
+    }
+    uint32_t uptime_s = to_ms_since_boot(get_absolute_time()) / 1000;
+    bool schema = !schema_published || published_schema_crc != schema_crc ||
+                  since_schema >= METRICS_SCHEMA_EVERY;
+
+    // Telemetry is periodic: QoS 0, and no PUBACK wait that could swallow a chunk
+    int saved_qos = mqttsn_get_qos();
+    mqttsn_set_qos(0);
+    int schema_sent = schema ? publish_kind(METRICS_KIND_SCHEMA, uptime_s) : 0;
+    int values_sent = schema_sent < 0 ? -1 : publish_kind(METRICS_KIND_VALUES, uptime_s);
+    mqttsn_set_qos(saved_qos);
+
+    publish_seq++;
+    if (schema && schema_sent > 0) {
+        schema_published = true;
+        published_schema_crc = schema_crc;
+        since_schema = 0;
+    } else {
+        since_schema++;
+    }
+    if (schema_sent < 0 || values_sent < 0) {
+        return -1;
+    }
+    return schema_sent + values_sent;
+}
+
+#endif // METRICS_HOST
@@ -0,0 +1,76 @@
+// metrics.h - Registry of counters, gauges and histograms
+//
+// Modules register their metrics by name once, usually from their init
+// function, and update them by id. Registering a name again returns the
+// same id, so re-initialising after a reconnect is harmless. A failed
+// registration returns -1 and updates to -1 are ignored, so call sites do
+// not check. Each metric should be updated from one context only (the
+// UDP receive callback or the main loop, not both); 32-bit updates are
+// not atomic across them.
+//
+// metrics_publish() sends the registry to METRICS_TOPIC at QoS 0, in
+// payloads of at most METRICS_PAYLOAD_MAX bytes. Names and histogram
+// bounds go in schema payloads, sent on the first publish, after the
+// registry changes and every METRICS_SCHEMA_EVERY publishes; values
+// payloads carry only numbers, in registration order. host/metrics_decode
+// turns both back into one JSON line per publish.
+//
+// Payload layout (little-endian; varints are LEB128, gauges zigzag-coded):
+//
+//   [version][kind][schema crc32c u32][seq u16][uptime s u32][first id][count]
+//   schema: per metric [type][name length][name], histograms add
+//           [bound count][bounds as varints]
+//   values: counter varint | gauge zigzag varint | histogram: one count
+//           varint per bucket (bounds + 1, the last one unbounded), then
+//           the sum
+//
+// A publish that needs more than one payload of a kind splits it; the
+// parts share seq and continue at first id.
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define METRICS_TOPIC           "pico/metrics"
+#define METRICS_MAX             40
+#define METRICS_NAME_MAX        24      // Including the terminator
+#define METRICS_MAX_BOUNDS      8       // Histogram buckets, plus one above the last bound
+#define METRICS_PUBLISH_MS      30000
+#define METRICS_SCHEMA_EVERY    10      // Publishes between schema resends
+#define METRICS_PAYLOAD_MAX     240     // Keeps the MQTT-SN length byte short
+
+#define METRICS_VERSION         1
+#define METRICS_KIND_SCHEMA     1
+#define METRICS_KIND_VALUES     2
+#define METRICS_HEADER_SIZE     14
+
+#define METRIC_COUNTER          1
+#define METRIC_GAUGE            2
+#define METRIC_HISTOGRAM        3
+
+int metrics_counter(const char *name);
+int metrics_gauge(const char *name);
+// bounds: ascending upper limits of the first nbounds buckets
+int metrics_histogram(const char *name, const uint32_t *bounds, uint8_t nbounds);
+
+void metrics_add(int id, uint32_t n);
+static inline void metrics_inc(int id) { metrics_add(id, 1); }
+void metrics_set(int id, int32_t value);
+void metrics_observe(int id, uint32_t value);
+
+// Current value of a counter or gauge (histograms: observation count)
+int32_t metrics_value(int id);
+
+// Encode metrics first.. of a kind into out. Returns the bytes written
+// (0 if nothing is left), *next is the first metric not included.
+int metrics_encode(uint8_t kind, uint8_t first, uint16_t seq, uint32_t uptime_s, uint8_t *out, size_t size,
+                   uint8_t *next);
+
+// Publish the registry (schema first when due). Returns the payloads
+// sent, or -1 if publishing failed.
+int metrics_publish(void);
+
+#endif // METRICS_H
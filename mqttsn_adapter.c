@@ -1,21 +1,49 @@
-// mqttsn_adapter.c - SIMPLE VERSION
+// mqttsn_adapter.c - MQTT-SN transport calls, dispatched to the selected backend
 #include "mqttsn_adapter.h"
 #include "udp_driver.h"
+#include "fault_inject.h"
 #include <stdio.h>
 #include <stdbool.h>
 
+const mqttsn_transport_ops_t mqttsn_transport_udp = {
+    .name = "udp",
+    .open = wifi_udp_create,
+    .send = wifi_udp_send,
+    .receive = wifi_udp_receive,
+    .close = wifi_udp_close,
+};
+
+static const mqttsn_transport_ops_t *transport = &mqttsn_transport_udp;
+
+void mqttsn_transport_set(const mqttsn_transport_ops_t *ops){
+    transport = (ops != NULL) ? ops : &mqttsn_transport_udp;
+    printf("[MQTTSN] Transport: %s\n", transport->name);
+}
+
+const mqttsn_transport_ops_t *mqttsn_transport_get(void){
+    return transport;
+}
+
 int mqttsn_transport_open(uint16_t local_port){
-    return wifi_udp_create(local_port);
+    return transport->open(local_port);
 }
 
 int mqttsn_transport_send(const char *dest_ip, uint16_t dest_port, const uint8_t *data, size_t len){
-    return wifi_udp_send(dest_ip, dest_port, data, len);
+#if FAULT_INJECT_ENABLED
+    return fault_inject_send(transport, dest_ip, dest_port, data, len);
+#else
+    return transport->send(dest_ip, dest_port, data, len);
+#endif
 }
 
 int mqttsn_transport_receive(uint8_t *buffer, size_t max_len, uint32_t timeout_ms){
-    return wifi_udp_receive(buffer, max_len, timeout_ms);
+#if FAULT_INJECT_ENABLED
+    return fault_inject_receive(transport, buffer, max_len, timeout_ms);
+#else
+    return transport->receive(buffer, max_len, timeout_ms);
+#endif
 }
 
 void mqttsn_transport_close(void){
-    wifi_udp_close();
-}
\ No newline at end of file
+    transport->close();
+}
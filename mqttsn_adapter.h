@@ -1,5 +1,8 @@
 // mqttsn_adapter.h
-// Simple transport adapter that wraps existing UDP driver for MQTT-SN usage
+// Transport adapter for MQTT-SN: the calls below go to the selected
+// backend, the UDP driver unless another one is installed (host builds
+// plug in an in-memory loopback, see host/transport_loopback.h), through
+// the fault injection layer when it is built in (fault_inject.h)
 
 #ifndef MQTTSN_ADAPTER_H
 #define MQTTSN_ADAPTER_H
@@ -7,6 +10,22 @@
 #include <stdint.h>
 #include <stddef.h>
 
+// A transport backend; the same contract as the calls below
+typedef struct {
+    const char *name;
+    int (*open)(uint16_t local_port);
+    int (*send)(const char *dest_ip, uint16_t dest_port, const uint8_t *data, size_t len);
+    int (*receive)(uint8_t *buffer, size_t max_len, uint32_t timeout_ms);
+    void (*close)(void);
+} mqttsn_transport_ops_t;
+
+// udp_driver.c (the default)
+extern const mqttsn_transport_ops_t mqttsn_transport_udp;
+
+// Select the backend before mqttsn_transport_open(); NULL restores UDP
+void mqttsn_transport_set(const mqttsn_transport_ops_t *ops);
+const mqttsn_transport_ops_t *mqttsn_transport_get(void);
+
 // Open transport (bind a local UDP port)
 int mqttsn_transport_open(uint16_t local_port);
 
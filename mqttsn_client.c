@@ -8,7 +8,10 @@
 #include <string.h>
 #include "pico/stdlib.h"
 #include "mqttsn_adapter.h"
+#include "mqttsn_client.h"
 #include "network_config.h"
+#include "binlog.h"
+#include "trace.h"
 
 #ifdef HAVE_PAHO
 #include "MQTTSNPacket.h"
@@ -22,6 +25,9 @@ static bool mqttsn_initialized = false;
 static bool mqttsn_connected = false;
 static unsigned short mqttsn_registered_topicid = 0;  // For pico/test
 unsigned short mqttsn_chunks_topicid = 0;             // For pico/chunks (exported)
+unsigned short mqttsn_metrics_topicid = 0;            // For pico/metrics (exported)
+static unsigned short mqttsn_status_topicid = 0;      // For pico/block_status
+static unsigned short mqttsn_sig_topicid = 0;         // For pico/block_sig
 static unsigned short mqttsn_msg_id = 1;
 static int current_qos = 0;  // Default to QoS 0
 
@@ -40,6 +46,37 @@ void mqttsn_set_qos(int qos) {
     }
 }
 
+#ifdef HAVE_PAHO
+// Register a topic besides pico/test; a rejection leaves *topicid at 0
+static void register_extra_topic(const char *topic, unsigned short *topicid) {
+    unsigned char buf[64];
+    printf("[MQTTSN] Registering topic '%s'...\n", topic);
+    MQTTSNString topic_string = MQTTSNString_initializer;
+    topic_string.cstring = (char*)topic;
+    topic_string.lenstring.len = strlen(topic);
+    
+    int len = MQTTSNSerialize_register(buf, sizeof(buf), 0, mqttsn_msg_id, &topic_string);
+    if (len <= 0 || mqttsn_transport_send(MQTTSN_GATEWAY_IP, MQTTSN_GATEWAY_PORT, buf, len) != 0) {
+        return;
+    }
+    int r = mqttsn_transport_receive(buf, sizeof(buf), 5000);
+    if (r > 0) {
+        unsigned short regack_topicid = 0;
+        unsigned short regack_msgid = 0;
+        unsigned char regack_rc = 0;
+        if (MQTTSNDeserialize_regack(&regack_topicid, &regack_msgid, &regack_rc, buf, r) == 1) {
+            if (regack_rc == MQTTSN_RC_ACCEPTED) {
+                *topicid = regack_topicid;
+                printf("[MQTTSN] ✓ Topic '%s' registered (TopicID=%u)\n", topic, regack_topicid);
+                mqttsn_msg_id++;
+            } else {
+                printf("[MQTTSN] ⚠ Topic '%s' registration rejected (code=%d)\n", topic, regack_rc);
+            }
+        }
+    }
+}
+#endif
+
 int mqttsn_demo_init(uint16_t local_port, const char *client_id){
     int rc = mqttsn_transport_open(local_port);
     if (rc != 0){
@@ -172,34 +209,11 @@ int mqttsn_demo_init(uint16_t local_port, const char *client_id){
 
     mqttsn_msg_id++;
     
-    // Also register pico/chunks topic for block transfers
-    printf("[MQTTSN] Registering topic 'pico/chunks' for block transfers...\n");
-    const char *chunks_topic = "pico/chunks";
-    MQTTSNString chunks_topic_string = MQTTSNString_initializer;
-    chunks_topic_string.cstring = (char*)chunks_topic;
-    chunks_topic_string.lenstring.len = strlen(chunks_topic);
-    
-    len = MQTTSNSerialize_register(buf, sizeof(buf), 0, mqttsn_msg_id, &chunks_topic_string);
-    if (len > 0) {
-        s = mqttsn_transport_send(MQTTSN_GATEWAY_IP, MQTTSN_GATEWAY_PORT, buf, len);
-        if (s == 0) {
-            r = mqttsn_transport_receive(buf, sizeof(buf), 5000);
-            if (r > 0) {
-                unsigned short chunks_topicid = 0;
-                unsigned short chunks_msgid = 0;
-                unsigned char chunks_rc = 0;
-                if (MQTTSNDeserialize_regack(&chunks_topicid, &chunks_msgid, &chunks_rc, buf, r) == 1) {
-                    if (chunks_rc == MQTTSN_RC_ACCEPTED) {
-                        mqttsn_chunks_topicid = chunks_topicid;
-                        printf("[MQTTSN] ✓ Topic 'pico/chunks' registered (TopicID=%u)\n", chunks_topicid);
-                        mqttsn_msg_id++;
-                    } else {
-                        printf("[MQTTSN] ⚠ Topic 'pico/chunks' registration rejected (code=%d)\n", chunks_rc);
-                    }
-                }
-            }
-        }
-    }
+    // Also register the topics for block transfers, metrics and the block status replies
+    register_extra_topic("pico/chunks", &mqttsn_chunks_topicid);
+    register_extra_topic("pico/metrics", &mqttsn_metrics_topicid);
+    register_extra_topic("pico/block_status", &mqttsn_status_topicid);
+    register_extra_topic("pico/block_sig", &mqttsn_sig_topicid);
 #else
     printf("[MQTTSN] Paho not available at build time\n");
 #endif
@@ -236,6 +250,37 @@ int mqttsn_demo_receive(uint8_t *buffer, size_t max_len, uint32_t timeout_ms){
     return mqttsn_transport_receive(buffer, max_len, timeout_ms);
 }
 
+// Length field of a packet: [len] or, past 255 bytes, [0x01][len MSB][len LSB]
+static int packet_header(const uint8_t *buf, int len, int *packet_len) {
+    if (len >= 3 && buf[0] == 0x01) {
+        *packet_len = (buf[1] << 8) | buf[2];
+        return 3;
+    }
+    if (len < 2) return -1;
+    *packet_len = buf[0];
+    return 1;
+}
+
+int mqttsn_packet_type(const uint8_t *buf, int len) {
+    int packet_len;
+    int at = packet_header(buf, len, &packet_len);
+    if (at < 0 || at >= len) return -1;
+    return buf[at];
+}
+
+int mqttsn_parse_publish(const uint8_t *buf, int len, mqttsn_publish_t *pub) {
+    int packet_len;
+    int at = packet_header(buf, len, &packet_len);
+    // Type, flags, topic id and msg id follow the length field
+    if (at < 0 || packet_len > len || packet_len < at + 6 || buf[at] != 0x0C) return -1;
+    pub->flags = buf[at + 1];
+    pub->topicid = (unsigned short)((buf[at + 2] << 8) | buf[at + 3]);
+    pub->msgid = (unsigned short)((buf[at + 4] << 8) | buf[at + 5]);
+    pub->payload = buf + at + 6;
+    pub->payload_len = packet_len - (at + 6);
+    return 0;
+}
+
 #ifdef HAVE_PAHO
 // Subscribe to a topic name. Returns topic id (>0) on success, or negative on error.
 int mqttsn_demo_subscribe(const char *topicname, unsigned short packetid, unsigned short *out_topicid){
@@ -270,6 +315,15 @@ int mqttsn_demo_subscribe(const char *topicname, unsigned short packetid, unsign
     return (int)topicid;
 }
 
+// Four packet bytes as one word for a deferred hex dump (zeros past len)
+static uint32_t dump_word(const unsigned char *buf, int len, int offset) {
+    uint32_t w = 0;
+    for (int i = offset; i < offset + 4; i++) {
+        w = (w << 8) | (i < len ? buf[i] : 0);
+    }
+    return w;
+}
+
 // Publish payload to a topic name (uses long topic name). qos and packetid ignored for QoS0.
 int mqttsn_demo_publish_name(const char *topicname, const uint8_t *payload, int payloadlen){
     if (!mqttsn_initialized) {
@@ -281,13 +335,16 @@ int mqttsn_demo_publish_name(const char *topicname, const uint8_t *payload, int
         return -2;
     }
 
-    // Print payload
-    printf("[PUBLISHER] Payload (%d bytes): %.*s\n", payloadlen, payloadlen, (const char*)payload);
-    
     // Select appropriate topic ID based on topic name
     unsigned short topic_id_to_use = 0;
     if (strcmp(topicname, "pico/chunks") == 0) {
         topic_id_to_use = mqttsn_chunks_topicid;
+    } else if (strcmp(topicname, "pico/metrics") == 0) {
+        topic_id_to_use = mqttsn_metrics_topicid;
+    } else if (strcmp(topicname, "pico/block_status") == 0) {
+        topic_id_to_use = mqttsn_status_topicid;
+    } else if (strcmp(topicname, "pico/block_sig") == 0) {
+        topic_id_to_use = mqttsn_sig_topicid;
     } else if (strcmp(topicname, "pico/test") == 0 || strcmp(topicname, "pico/block") == 0) {
         topic_id_to_use = mqttsn_registered_topicid;
     } else {
@@ -299,6 +356,14 @@ int mqttsn_demo_publish_name(const char *topicname, const uint8_t *payload, int
         printf("[MQTTSN] ✗ Cannot publish to '%s' - topic not registered\n", topicname);
         return -3;
     }
+    
+    // Print payload (block chunks, metrics, status and signatures are binary, and there are a lot of chunks)
+    if (topic_id_to_use == mqttsn_chunks_topicid || topic_id_to_use == mqttsn_metrics_topicid ||
+        topic_id_to_use == mqttsn_status_topicid || topic_id_to_use == mqttsn_sig_topicid) {
+        BLOG_DEBUG("[PUBLISHER] Binary payload (%d bytes)\n", payloadlen);
+    } else {
+        printf("[PUBLISHER] Payload (%d bytes): %.*s\n", payloadlen, payloadlen, (const char*)payload);
+    }
 
     unsigned char buf[512];
     MQTTSN_topicid topic;
@@ -309,6 +374,7 @@ int mqttsn_demo_publish_name(const char *topicname, const uint8_t *payload, int
     // For QoS 0, MsgId = 0; for QoS 1 and 2, use sequential message ID
     unsigned short msgid = (current_qos == 0) ? 0 : mqttsn_msg_id;
 
+    TRACE_BEGIN(TRACE_MQTTSN_SERIALIZE, payloadlen);
     int len = MQTTSNSerialize_publish(buf, sizeof(buf), 
                                        0,           // dup = 0
                                        current_qos, // qos = current QoS level
@@ -317,45 +383,41 @@ int mqttsn_demo_publish_name(const char *topicname, const uint8_t *payload, int
                                        topic, 
                                        (unsigned char*)payload, 
                                        payloadlen);
+    TRACE_END(TRACE_MQTTSN_SERIALIZE, len);
     if (len <= 0) {
-        printf("[MQTTSN] Failed to serialize PUBLISH (rc=%d)\n", len);
+        BLOG_ERROR("[MQTTSN] Failed to serialize PUBLISH (rc=%d)\n", len);
         return -4;
     }
 
-    printf("[DEBUG] PUBLISH packet (%d bytes, QoS=%d): ", len, current_qos);
-    for(int i = 0; i < len && i < 30; i++) {
-        printf("%02x ", buf[i]);
-    }
-    printf("...\n");
+    BLOG_DEBUG("[DEBUG] PUBLISH packet (%d bytes, QoS=%d): %08x %08x %08x %08x ...\n", len, current_qos,
+               dump_word(buf, len, 0), dump_word(buf, len, 4), dump_word(buf, len, 8), dump_word(buf, len, 12));
 
     int s = mqttsn_transport_send(MQTTSN_GATEWAY_IP, MQTTSN_GATEWAY_PORT, buf, len);
     if (s != 0) {
-        printf("[MQTTSN] PUBLISH send failed (err=%d)\n", s);
+        BLOG_ERROR("[MQTTSN] PUBLISH send failed (err=%d)\n", s);
         return -5;
     }
     
     if (current_qos == 0) {
         // QoS 0: Fire and forget - no acknowledgment, returns success immediately
         // WARNING: This does NOT guarantee delivery - packets may be lost
-        printf("[MQTTSN] ✓ PUBLISH sent (QoS 0, no ACK) to '%s' (TopicID=%u, len=%d)\n", 
-               topicname, topic_id_to_use, payloadlen);
+        BLOG_INFO("[MQTTSN] ✓ PUBLISH sent (QoS 0, no ACK) (TopicID=%u, len=%d)\n", 
+                  topic_id_to_use, payloadlen);
         return 0;  // QoS 0 returns immediately without waiting
     }
     
-    printf("[MQTTSN] ✓ PUBLISH sent to '%s' (TopicID=%u, MsgID=%u, QoS=%d, len=%d)\n", 
-           topicname, topic_id_to_use, msgid, current_qos, payloadlen);
+    BLOG_INFO("[MQTTSN] ✓ PUBLISH sent (TopicID=%u, MsgID=%u, QoS=%d, len=%d)\n", 
+              topic_id_to_use, msgid, current_qos, payloadlen);
     
     // Wait for acknowledgment for QoS 1 and 2
     if (current_qos == 1) {
         // Wait for PUBACK
-        printf("[MQTTSN] Waiting for PUBACK (QoS 1)...\n");
+        BLOG_DEBUG("[MQTTSN] Waiting for PUBACK (QoS 1)...\n");
+        TRACE_BEGIN(TRACE_MQTTSN_ACK_WAIT, 1);
         int r = mqttsn_transport_receive(buf, sizeof(buf), 10000);
+        TRACE_END(TRACE_MQTTSN_ACK_WAIT, r);
         if (r > 0) {
-            printf("[DEBUG] Received %d bytes: ", r);
-            for(int i = 0; i < r && i < 20; i++) {
-                printf("%02x ", buf[i]);
-            }
-            printf("\n");
+            BLOG_DEBUG("[DEBUG] Received %d bytes: %08x %08x\n", r, dump_word(buf, r, 0), dump_word(buf, r, 4));
             
             // PUBACK format: [Length][0x0D][TopicId MSB][TopicId LSB][MsgId MSB][MsgId LSB][ReturnCode]
             if (r >= 7 && buf[1] == 0x0D) {  // 0x0D = PUBACK
@@ -364,17 +426,17 @@ int mqttsn_demo_publish_name(const char *topicname, const uint8_t *payload, int
                 unsigned char return_code = buf[6];
                 
                 if (return_code == 0x00) {
-                    printf("[MQTTSN] ✓ PUBACK received (TopicID=%u, MsgID=%u)\n", 
+                    BLOG_INFO("[MQTTSN] ✓ PUBACK received (TopicID=%u, MsgID=%u)\n", 
                            ack_topicid, ack_msgid);
                 } else {
-                    printf("[MQTTSN] ✗ PUBACK with error code=%d\n", return_code);
+                    BLOG_ERROR("[MQTTSN] ✗ PUBACK with error code=%d\n", return_code);
                     return -6;
                 }
             } else {
-                printf("[MQTTSN] ✗ Expected PUBACK but received different message\n");
+                BLOG_ERROR("[MQTTSN] ✗ Expected PUBACK but received different message\n");
             }
         } else {
-            printf("[MQTTSN] ✗ PUBACK not received (timeout)\n");
+            BLOG_ERROR("[MQTTSN] ✗ PUBACK not received (timeout)\n");
             return -7;
         }
         
@@ -382,19 +444,17 @@ int mqttsn_demo_publish_name(const char *topicname, const uint8_t *payload, int
         
     } else if (current_qos == 2) {
         // QoS 2: Wait for PUBREC
-        printf("[MQTTSN] Waiting for PUBREC (QoS 2)...\n");
+        BLOG_DEBUG("[MQTTSN] Waiting for PUBREC (QoS 2)...\n");
+        TRACE_BEGIN(TRACE_MQTTSN_ACK_WAIT, 2);
         int r = mqttsn_transport_receive(buf, sizeof(buf), 5000);
+        TRACE_END(TRACE_MQTTSN_ACK_WAIT, r);
         if (r > 0) {
-            printf("[DEBUG] Received %d bytes: ", r);
-            for(int i = 0; i < r && i < 20; i++) {
-                printf("%02x ", buf[i]);
-            }
-            printf("\n");
+            BLOG_DEBUG("[DEBUG] Received %d bytes: %08x %08x\n", r, dump_word(buf, r, 0), dump_word(buf, r, 4));
             
             // PUBREC format: [Length][0x0F][MsgId MSB][MsgId LSB]
             if (r >= 4 && buf[1] == 0x0F) {  // 0x0F = PUBREC
                 unsigned short rec_msgid = (buf[2] << 8) | buf[3];
-                printf("[MQTTSN] ✓ PUBREC received (MsgID=%u)\n", rec_msgid);
+                BLOG_INFO("[MQTTSN] ✓ PUBREC received (MsgID=%u)\n", rec_msgid);
                 
                 // Send PUBREL
                 unsigned char pubrel[4];
@@ -404,36 +464,34 @@ int mqttsn_demo_publish_name(const char *topicname, const uint8_t *payload, int
                 pubrel[3] = (msgid & 0xFF);
                 
                 mqttsn_transport_send(MQTTSN_GATEWAY_IP, MQTTSN_GATEWAY_PORT, pubrel, sizeof(pubrel));
-                printf("[MQTTSN] → PUBREL sent (MsgID=%u)\n", msgid);
+                BLOG_INFO("[MQTTSN] → PUBREL sent (MsgID=%u)\n", msgid);
                 
                 // Wait for PUBCOMP
-                printf("[MQTTSN] Waiting for PUBCOMP...\n");
+                BLOG_DEBUG("[MQTTSN] Waiting for PUBCOMP...\n");
+                TRACE_BEGIN(TRACE_MQTTSN_ACK_WAIT, 2);
                 r = mqttsn_transport_receive(buf, sizeof(buf), 5000);
+                TRACE_END(TRACE_MQTTSN_ACK_WAIT, r);
                 if (r > 0) {
-                    printf("[DEBUG] Received %d bytes: ", r);
-                    for(int i = 0; i < r && i < 20; i++) {
-                        printf("%02x ", buf[i]);
-                    }
-                    printf("\n");
+                    BLOG_DEBUG("[DEBUG] Received %d bytes: %08x %08x\n", r, dump_word(buf, r, 0), dump_word(buf, r, 4));
                     
                     // PUBCOMP format: [Length][0x0E][MsgId MSB][MsgId LSB]
                     if (r >= 4 && buf[1] == 0x0E) {  // 0x0E = PUBCOMP
                         unsigned short comp_msgid = (buf[2] << 8) | buf[3];
-                        printf("[MQTTSN] ✓ PUBCOMP received (MsgID=%u) - QoS 2 complete\n", comp_msgid);
+                        BLOG_INFO("[MQTTSN] ✓ PUBCOMP received (MsgID=%u) - QoS 2 complete\n", comp_msgid);
                     } else {
-                        printf("[MQTTSN] ✗ Expected PUBCOMP but received different message\n");
+                        BLOG_ERROR("[MQTTSN] ✗ Expected PUBCOMP but received different message\n");
                         return -8;
                     }
                 } else {
-                    printf("[MQTTSN] ✗ PUBCOMP not received (timeout)\n");
+                    BLOG_ERROR("[MQTTSN] ✗ PUBCOMP not received (timeout)\n");
                     return -9;
                 }
             } else {
-                printf("[MQTTSN] ✗ Expected PUBREC but received different message\n");
+                BLOG_ERROR("[MQTTSN] ✗ Expected PUBREC but received different message\n");
                 return -10;
             }
         } else {
-            printf("[MQTTSN] ✗ PUBREC not received (timeout)\n");
+            BLOG_ERROR("[MQTTSN] ✗ PUBREC not received (timeout)\n");
             return -11;
         }
         
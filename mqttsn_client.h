@@ -18,11 +18,26 @@ int mqttsn_demo_subscribe(const char *topicname, unsigned short packetid, unsign
 int mqttsn_demo_publish_name(const char *topicname, const uint8_t *payload, int payloadlen);
 int mqttsn_demo_process_once(uint32_t timeout_ms);
 
+// A received PUBLISH (short or long length form; topic and msg id are big-endian on the wire)
+typedef struct {
+    uint8_t flags;
+    unsigned short topicid;
+    unsigned short msgid;
+    const uint8_t *payload;
+    int payload_len;
+} mqttsn_publish_t;
+
+// Message type of a received packet, or -1 if it is too short
+int mqttsn_packet_type(const uint8_t *buf, int len);
+// Split a received PUBLISH; -1 if it is not one or is cut short
+int mqttsn_parse_publish(const uint8_t *buf, int len, mqttsn_publish_t *pub);
+
 // QoS management
 int mqttsn_get_qos(void);
 void mqttsn_set_qos(int qos);
 
 // Topic IDs (exported for checking registration status)
 extern unsigned short mqttsn_chunks_topicid;
+extern unsigned short mqttsn_metrics_topicid;
 
 #endif // MQTTSN_CLIENT_H
@@ -8,4 +8,14 @@
 #define MQTTSN_GATEWAY_IP "172.20.10.2"  // Your laptop's IP address (found using `ipconfig /all` for windows / `ip a` for linux)
 #define MQTTSN_GATEWAY_PORT 1884
 
+#ifdef PICOW_HOST
+// Native build (host/): the gateway address comes from the command line
+#undef MQTTSN_GATEWAY_IP
+#undef MQTTSN_GATEWAY_PORT
+extern const char *picow_host_gateway_ip;
+extern unsigned short picow_host_gateway_port;
+#define MQTTSN_GATEWAY_IP picow_host_gateway_ip
+#define MQTTSN_GATEWAY_PORT picow_host_gateway_port
+#endif
+
 #endif // WIFI_DRIVER_H
\ No newline at end of file
@@ -8,6 +8,221 @@ import struct
 import os
 from datetime import datetime
 
+# Wire format v2 trailer (see block_transfer.h): [version][flags][fields...][crc32c]
+BLOCK_WIRE_VERSION = 2
+BLOCK_FLAG_DIGEST = 0x01
+BLOCK_FLAG_FEC = 0x02
+BLOCK_FLAG_FOUNTAIN = 0x04
+BLOCK_FLAG_COMPRESSED = 0x08
+BLOCK_FLAG_DELTA = 0x10
+BLOCK_TRAILER_SIZE = 6
+
+# Delta transfers (see block_delta.h): signatures of the last saved file go to the publisher
+DELTA_SIG_TOPIC = "pico/block_sig"
+DELTA_MAX_SIGS = 600
+DELTA_MAX_BLOCK = 4096
+DELTA_SIGS_PER_MSG = 48
+
+
+def _crc32c_table():
+    table = []
+    for i in range(256):
+        c = i
+        for _ in range(8):
+            c = (c >> 1) ^ 0x82F63B78 if c & 1 else c >> 1
+        table.append(c)
+    return table
+
+
+_CRC32C_TABLE = _crc32c_table()
+
+
+def crc32c(data, crc=0):
+    crc ^= 0xFFFFFFFF
+    for b in data:
+        crc = _CRC32C_TABLE[(crc ^ b) & 0xFF] ^ (crc >> 8)
+    return crc ^ 0xFFFFFFFF
+
+
+def parse_trailer(payload, data_len):
+    """Return (ok, flags, block_crc, fountain, raw_len, delta). v1 chunks (no trailer) are always ok;
+    a trailer that is truncated or carries an unknown version is not.
+    fountain is (generation, coefficient mask, block length) for fountain symbols;
+    raw_len is the uncompressed block size for LZ4-compressed blocks;
+    delta is (basis CRC-32C, basis block size) for delta blocks."""
+    pos = 8 + data_len
+    if len(payload) == pos:
+        return True, 0, None, None, None, None
+    if len(payload) < pos + BLOCK_TRAILER_SIZE or payload[pos] != BLOCK_WIRE_VERSION:
+        return False, 0, None, None, None, None
+    flags = payload[pos + 1]
+    end = pos + 2
+    block_crc = None
+    if flags & BLOCK_FLAG_DIGEST:
+        block_crc = struct.unpack('<I', payload[end:end + 4])[0]
+        end += 4
+    if flags & BLOCK_FLAG_FEC:
+        end += 2  # FEC K, M
+    fountain = None
+    if flags & BLOCK_FLAG_FOUNTAIN:
+        fountain = struct.unpack('<HQI', payload[end:end + 14])
+        end += 14
+    raw_len = None
+    if flags & BLOCK_FLAG_COMPRESSED:
+        raw_len = struct.unpack('<I', payload[end:end + 4])[0]
+        end += 4
+    delta = None
+    if flags & BLOCK_FLAG_DELTA:
+        delta = struct.unpack('<IH', payload[end:end + 6])
+        end += 6
+    if len(payload) != end + 4:
+        return False, flags, None, None, None, None
+    ok = crc32c(payload[:end]) == struct.unpack('<I', payload[end:end + 4])[0]
+    return ok, flags, block_crc, fountain, raw_len, delta
+
+
+def delta_weak(block):
+    """rsync weak checksum, as block_delta_weak()."""
+    a = sum(block) & 0xFFFF
+    b = sum((len(block) - i) * x for i, x in enumerate(block)) & 0xFFFF
+    return a | (b << 16)
+
+
+def delta_block_size(basis_len):
+    size = 64
+    while size < DELTA_MAX_BLOCK and basis_len // size > DELTA_MAX_SIGS:
+        size *= 2
+    return size
+
+
+def delta_signature_msgs(basis):
+    """Signature messages for a basis file, or [] if it is too large to describe."""
+    block_size = delta_block_size(len(basis))
+    blocks = len(basis) // block_size
+    if blocks == 0 or blocks > DELTA_MAX_SIGS:
+        return []
+    basis_crc = crc32c(basis)
+    msgs = []
+    for first in range(0, blocks, DELTA_SIGS_PER_MSG):
+        count = min(DELTA_SIGS_PER_MSG, blocks - first)
+        msg = bytearray(struct.pack('<IIHHH', basis_crc, len(basis), block_size, first, count))
+        for i in range(first, first + count):
+            block = basis[i * block_size:(i + 1) * block_size]
+            msg += struct.pack('<II', delta_weak(block), crc32c(block))
+        msgs.append(bytes(msg))
+    return msgs
+
+
+def delta_apply(basis, block_size, delta):
+    """Rebuild a file from its basis and a delta stream. Raises ValueError if corrupt."""
+    out = bytearray()
+    blocks = len(basis) // block_size
+    pos = 0
+    while pos < len(delta):
+        op = delta[pos]
+        if op == 0x00:
+            n = struct.unpack('<H', delta[pos + 1:pos + 3])[0]
+            if pos + 3 + n > len(delta):
+                raise ValueError("truncated literal")
+            out += delta[pos + 3:pos + 3 + n]
+            pos += 3 + n
+        elif op == 0x01:
+            first, n = struct.unpack('<HH', delta[pos + 1:pos + 5])
+            if first + n > blocks:
+                raise ValueError("copy past end of basis")
+            out += basis[first * block_size:(first + n) * block_size]
+            pos += 5
+        else:
+            raise ValueError("bad delta op")
+    return bytes(out)
+
+
+def lz4_decompress(src, raw_len):
+    """Decode an LZ4 block (see block_lz.h) of raw_len bytes. Raises ValueError if corrupt."""
+    out = bytearray()
+    pos = 0
+    while len(out) < raw_len:
+        token = src[pos]
+        pos += 1
+        lit_len = token >> 4
+        if lit_len == 15:
+            while True:
+                b = src[pos]
+                pos += 1
+                lit_len += b
+                if b != 255:
+                    break
+        out += src[pos:pos + lit_len]
+        pos += lit_len
+        if len(out) >= raw_len:
+            break
+        offset = src[pos] | (src[pos + 1] << 8)
+        pos += 2
+        match_len = token & 0x0F
+        if match_len == 15:
+            while True:
+                b = src[pos]
+                pos += 1
+                match_len += b
+                if b != 255:
+                    break
+        match_len += 4
+        if offset == 0 or offset > len(out):
+            raise ValueError("bad match offset")
+        start = len(out) - offset
+        for i in range(match_len):
+            out.append(out[start + i])
+    if len(out) != raw_len:
+        raise ValueError("length mismatch")
+    return bytes(out)
+
+
+class FountainDecoder:
+    """GF(2) decoder for fountain symbols (see block_fountain.h)."""
+    GEN_SIZE = 64
+    CHUNK_SIZE = 120
+
+    def __init__(self, total_parts, block_len):
+        self.total_parts = total_parts
+        self.block_len = block_len
+        self.rows = {}  # chunk index -> (mask, payload) of the row with that pivot
+
+    def add(self, gen, coef, symbol):
+        """Returns True if the symbol was innovative."""
+        first = gen * self.GEN_SIZE
+        value = int.from_bytes(symbol, 'little')
+        while coef:
+            low = (coef & -coef).bit_length() - 1
+            row = self.rows.get(first + low)
+            if row is None:
+                self.rows[first + low] = (coef, value)
+                return True
+            coef ^= row[0]
+            value ^= row[1]
+        return False
+
+    def done(self):
+        return len(self.rows) == self.total_parts
+
+    def chunks(self):
+        """Back-substitute every generation and return {part_num: bytes}."""
+        solved = {}
+        for index in range(self.total_parts - 1, -1, -1):
+            first = index - index % self.GEN_SIZE
+            coef, value = self.rows[index]
+            coef &= coef - 1  # Drop the pivot bit
+            while coef:
+                low = (coef & -coef).bit_length() - 1
+                value ^= solved[first + low]
+                coef &= coef - 1
+            solved[index] = value
+        parts = {}
+        for index in range(self.total_parts):
+            length = min(self.CHUNK_SIZE, self.block_len - index * self.CHUNK_SIZE)
+            parts[index + 1] = solved[index].to_bytes(self.CHUNK_SIZE, 'little')[:length]
+        return parts
+
+
 class BlockReceiver:
     def __init__(self, broker="localhost", port=1883):
         self.client = mqtt.Client()
@@ -21,6 +236,13 @@ class BlockReceiver:
         self.total_parts = 0
         self.parts = {}
         self.start_time = None
+        self.block_crc = None
+        self.crc_errors = 0
+        self.fountain = None
+        self.raw_len = None
+        self.delta = None
+        self.basis = None
+        self.last_saved = None
         
     def on_connect(self, client, userdata, flags, rc):
         if rc == 0:
@@ -29,6 +251,8 @@ class BlockReceiver:
             client.subscribe("pico/block")   # Notifications
             print("📡 Subscribed to pico/chunks and pico/block")
             print(f"💾 Blocks will be saved to: {os.getcwd()}/received/\n")
+            self.load_basis()
+            self.publish_signatures()
         else:
             print(f"❌ Connection failed: {rc}")
             exit(1)
@@ -54,7 +278,17 @@ class BlockReceiver:
             
             if len(chunk_data) != data_len:
                 return
+
+            ok, flags, block_crc, fountain, raw_len, delta = parse_trailer(msg.payload, data_len)
+            if not ok:
+                self.crc_errors += 1
+                print(f"⚠️  Chunk {part_num}/{total_parts} failed CRC check - dropped ({self.crc_errors} total)")
+                return
             
+            # Fountain symbols keep coming after a block has been decoded
+            if fountain and self.block_id != block_id and self.last_saved == (block_id, block_crc):
+                return
+
             # New block
             if self.block_id != block_id:
                 if self.block_id is not None:
@@ -62,9 +296,39 @@ class BlockReceiver:
                 self.block_id = block_id
                 self.total_parts = total_parts
                 self.parts = {}
+                self.block_crc = None
+                self.fountain = None
+                self.raw_len = None
+                self.delta = None
                 self.start_time = datetime.now()
                 print(f"\n🆕 Receiving block {block_id}: {total_parts} parts")
             
+            if block_crc is not None:
+                self.block_crc = block_crc
+            if raw_len is not None:
+                self.raw_len = raw_len
+            if delta is not None:
+                self.delta = delta
+
+            # Fountain symbols go through the decoder instead of straight into parts
+            if fountain:
+                gen, coef, block_len = fountain
+                if self.fountain is None:
+                    self.fountain = FountainDecoder(total_parts, block_len)
+                if self.fountain.add(gen, coef, chunk_data):
+                    rank = len(self.fountain.rows)
+                    if rank % 50 == 0 or self.fountain.done():
+                        print(f"⛲ rank {rank}/{total_parts} after {part_num} symbols")
+                if self.fountain.done():
+                    self.parts = self.fountain.chunks()
+                    self.save_block()
+                return
+
+            # FEC parity chunks (numbered after the data chunks) are only
+            # used by the Pico subscriber; the host relies on retransmission
+            if part_num > total_parts:
+                return
+
             # Store chunk
             if part_num not in self.parts:
                 self.parts[part_num] = chunk_data
@@ -92,6 +356,47 @@ class BlockReceiver:
             
             if len(image_data) == 0:
                 return
+
+            # Compressed blocks are inflated before the digest (which covers the raw data)
+            if self.raw_len is not None:
+                compressed_len = len(image_data)
+                try:
+                    image_data = lz4_decompress(image_data, self.raw_len)
+                except (ValueError, IndexError):
+                    print(f"❌ Block {self.block_id} failed to decompress - discarded")
+                    self.block_id = None
+                    self.parts = {}
+                    return
+                print(f"🗜️  Decompressed {compressed_len} -> {len(image_data)} bytes")
+
+            # Delta blocks are rebuilt from the basis the publisher matched against
+            if self.delta is not None:
+                basis_crc, block_size = self.delta
+                if self.basis is None or crc32c(self.basis) != basis_crc:
+                    print(f"❌ Block {self.block_id} is a delta against basis {basis_crc:08x}, "
+                          f"which is not held here - discarded")
+                    self.block_id = None
+                    self.parts = {}
+                    return
+                delta_len = len(image_data)
+                try:
+                    image_data = delta_apply(self.basis, block_size, image_data)
+                except (ValueError, struct.error):
+                    print(f"❌ Block {self.block_id} delta is corrupt - discarded")
+                    self.block_id = None
+                    self.parts = {}
+                    return
+                print(f"🧩 Rebuilt {len(image_data)} bytes from a {delta_len}-byte delta")
+
+            if self.block_crc is not None:
+                actual = crc32c(image_data)
+                if actual != self.block_crc:
+                    print(f"❌ Block {self.block_id} digest mismatch "
+                          f"(expected {self.block_crc:08x}, got {actual:08x}) - discarded")
+                    self.block_id = None
+                    self.parts = {}
+                    return
+                print(f"🔒 Block digest verified ({actual:08x})")
             
             # Detect file type
             ext = ".bin"
@@ -123,13 +428,40 @@ class BlockReceiver:
             print(f"💾 Saved: received/{filename} ({len(image_data)} bytes, {elapsed:.1f}s)\n")
             
             # Reset
+            self.last_saved = (self.block_id, self.block_crc)
             self.block_id = None
             self.parts = {}
+
+            # The saved file is the basis for the next delta
+            self.basis = bytes(image_data)
+            self.publish_signatures()
         except Exception as e:
             print(f"❌ Error saving: {e}")
             import traceback
             traceback.print_exc()
     
+    def load_basis(self):
+        """Use the newest file in received/ as the delta basis."""
+        received_dir = os.path.join(os.getcwd(), "received")
+        if self.basis is not None or not os.path.isdir(received_dir):
+            return
+        files = [os.path.join(received_dir, f) for f in os.listdir(received_dir)]
+        files = [f for f in files if os.path.isfile(f)]
+        if files:
+            newest = max(files, key=os.path.getmtime)
+            with open(newest, 'rb') as f:
+                self.basis = f.read()
+            print(f"🧩 Delta basis: received/{os.path.basename(newest)} ({len(self.basis)} bytes)")
+
+    def publish_signatures(self):
+        if self.basis is None:
+            return
+        msgs = delta_signature_msgs(self.basis)
+        for m in msgs:
+            self.client.publish(DELTA_SIG_TOPIC, m, qos=1)
+        if msgs:
+            print(f"🧩 Published {len(msgs)} signature messages for the delta basis")
+
     def start(self):
         try:
             print("="*60)
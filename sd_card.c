@@ -4,6 +4,8 @@
 #include "hardware/gpio.h"
 #include "ff.h"  // FatFs library
 #include "diskio.h"  // For disk_status and STA_* flags
+#include "image_index.h"
+#include "trace.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -22,16 +24,51 @@
 #define CMD0  0x40  // Software reset
 #define CMD1  0x41  // Send operating condition
 #define CMD8  0x48  // Send interface condition
+#define CMD9  0x49  // Send CSD register
+#define CMD12 0x4C  // Stop transmission (ends CMD18)
 #define CMD17 0x51  // Read single block
+#define CMD18 0x52  // Read multiple blocks
 #define CMD24 0x58  // Write single block
+#define CMD25 0x59  // Write multiple blocks
 #define CMD55 0x77  // Application command prefix
+#define CMD59 0x7B  // CRC on/off
+#define ACMD23 0x57 // Pre-erase count for the next CMD25
 #define ACMD41 0x69 // Application command 41
 
+// Clock negotiation: the card's TRAN_SPEED caps the first step tried; a
+// step is kept once SD_CLOCK_PROBES reads pass their CRC16. At run time a
+// CRC error drops one step and retries the transfer. The RP2040 rounds each
+// request down to clk_peri / (even divider), so steps can collapse.
+#define SD_INIT_CLOCK   400000
+#define SD_CLOCK_PROBES 8
+#define SD_CRC_RETRIES  3       // Steps down before a transfer gives up
+#define SD_CRC_ERROR    -2      // Internal result: data failed its CRC check
+
+static const uint32_t sd_clock_steps[] = {
+    25000000, 20000000, 15000000, 12500000, 10000000, 8000000, 5000000, 2000000, 1000000
+};
+#define SD_CLOCK_STEPS (sizeof(sd_clock_steps) / sizeof(sd_clock_steps[0]))
+
+// Received blocks: one f_expand() extent written with raw multi-sector
+// writes of this many sectors, polling WiFi in between
+#define SD_SAVE_BURST_SECTORS 32
+
+// Data tokens
+#define TOKEN_START_BLOCK  0xFE  // Single-block write / every read block
+#define TOKEN_MULTI_WRITE  0xFC  // Each block of a CMD25 write
+#define TOKEN_STOP_TRAN    0xFD  // Ends a CMD25 write
+
 // Static variables
 static bool sd_detected = false;
 static bool sd_initialized = false;
 static bool is_sdhc = false;  // SDHC/SDXC vs SDSC addressing
 static bool fat32_mounted = false;
+static bool multi_block = true;  // CMD18/CMD25 for multi-sector transfers
+static bool contiguous_save = true;  // sd_card_save_block() pre-allocates and writes raw sectors
+static uint32_t sd_clock_hz = SD_INIT_CLOCK;  // Current SPI clock (actual)
+static uint32_t max_clock_hz = 0;   // Cap from sd_card_set_max_clock(), 0 = card's TRAN_SPEED
+static int clock_step = -1;         // Index into sd_clock_steps, -1 = init clock
+static uint32_t crc_errors = 0;
 static FATFS fs;  // FatFs filesystem object
 static uint8_t file_data[MAX_FILE_SIZE];
 static char file_names[10][SD_MAX_FILENAME];
@@ -39,92 +76,68 @@ static size_t file_sizes[10];
 static int file_count = 0;
 
 static char selected_image[64] = "download.jpg";
+static int selected_image_id = -1;  // Record in the image index
 static bool sd_card_mounted = false;
-static int image_file_count = 0;
-static char image_files[10][64]; // Store up to 10 image filenames
 
 // Copied Codes
-// Scan SD card for image files and automatically select the first one found
+// Select the next image to send from the on-card index (image_index.h),
+// building or refreshing the index first if the card changed
 bool scan_and_select_image() {
     if (!sd_card_is_mounted()) {
         printf("  ⚠ SD card not mounted\n");
         return false;
     }
-    
-    DIR dir;
-    FILINFO fno;
-    image_file_count = 0;
-    
-    printf("\n📸 Scanning for image files...\n");
-    
-    FRESULT res = f_opendir(&dir, "/");
-    if (res != FR_OK) {
-        printf("  ✗ Failed to open directory (FR: %d)\n", res);
+
+    int count = image_index_open();
+    if (count < 0) {
+        printf("  ✗ Failed to open the image index\n");
         return false;
     }
-    
-    // Scan for .jpg and .jpeg files
-    while (f_readdir(&dir, &fno) == FR_OK && fno.fname[0] != 0) {
-        if (!(fno.fattrib & AM_DIR)) {
-            size_t len = strlen(fno.fname);
-            // Check for .jpg or .jpeg extension (case insensitive)
-            if (len > 4) {
-                const char *ext = &fno.fname[len - 4];
-                if (strcasecmp(ext, ".jpg") == 0 || 
-                    (len > 5 && strcasecmp(&fno.fname[len - 5], ".jpeg") == 0)) {
-                    if (image_file_count < 10) {
-                        strncpy(image_files[image_file_count], fno.fname, 63);
-                        image_files[image_file_count][63] = '\0';
-                        printf("  [%d] %s (%lu bytes)\n", 
-                               image_file_count + 1, fno.fname, fno.fsize);
-                        image_file_count++;
-                    }
-                }
-            }
-        }
-    }
-    f_closedir(&dir);
-    
-    if (image_file_count == 0) {
+    if (count == 0) {
         printf("  ⚠ No .jpg/.jpeg files found on SD card\n");
         return false;
     }
-    
-    // Auto-select the first image found
-    strncpy(selected_image, image_files[0], 63);
-    selected_image[63] = '\0';
-    
-    printf("\n  ✓ Auto-selected: %s\n", selected_image);
-    if (image_file_count > 1) {
-        printf("  ℹ Found %d image file(s) - using first one\n", image_file_count);
+
+    image_index_entry_t entry;
+    int id = image_index_next(&entry);
+    if (id < 0) {
+        // Everything was sent once: clear the sent flags and start again
+        printf("  ℹ All %d image(s) sent - starting over\n", count);
+        if (image_index_reset_sent() != 0) {
+            printf("  ✗ Failed to reset the image index\n");
+            return false;
+        }
+        id = image_index_next(&entry);
+        if (id < 0) return false;
     }
-    printf("\n");
-    
+
+    strncpy(selected_image, entry.name, 63);
+    selected_image[63] = '\0';
+    selected_image_id = id;
+
+    printf("  ✓ Selected: %s (%lu bytes, image %d of %d)\n", selected_image,
+           (unsigned long)entry.size, id + 1, count);
     return true;
 }
 
-// Get the first image filename found during scan
+// Next image to send (the first not yet marked sent)
 const char* sd_card_get_first_image(void) {
     // First check if SD card is mounted
     if (!sd_card_is_mounted()) {
         printf("  ⚠ Cannot scan: SD card not mounted\n");
         return NULL;
     }
-    
-    // If no scan has been done yet, scan now
-    if (image_file_count == 0) {
-        if (!scan_and_select_image()) {
-            // Scan failed
-            return NULL;
-        }
-    }
-    
-    // Return first image if available
-    if (image_file_count > 0 && image_files[0][0] != '\0') {
-        return image_files[0];
+
+    if (!scan_and_select_image()) {
+        return NULL;  // No image found
     }
-    
-    return NULL;  // No image found
+    return selected_image;
+}
+
+// Record that the selected image went out, so the next press sends the next one
+int sd_card_mark_image_sent(void) {
+    if (selected_image_id < 0) return -1;
+    return image_index_mark_sent((uint32_t)selected_image_id);
 }
 
 // Check if SD card is accessible (returns true if mounted and working)
@@ -317,11 +330,57 @@ static uint8_t sd_spi_transfer(uint8_t data) {
     return result;
 }
 
-static uint8_t sd_command(uint8_t cmd, uint32_t arg, uint8_t crc) {
-    uint8_t buf[6] = {cmd, arg >> 24, arg >> 16, arg >> 8, arg, crc};
+// CRC7 of a command frame (polynomial x^7 + x^3 + 1)
+static uint8_t sd_crc7(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t d = data[i];
+        for (int b = 0; b < 8; b++) {
+            crc <<= 1;
+            if ((d ^ crc) & 0x80) crc ^= 0x09;
+            d <<= 1;
+        }
+    }
+    return crc & 0x7F;
+}
+
+// CRC16-CCITT of a data block, table generated into RAM on first use
+static uint16_t crc16_table[256];
+static bool crc16_table_ready = false;
+
+static uint16_t sd_crc16(const uint8_t *data, size_t len) {
+    if (!crc16_table_ready) {
+        for (int i = 0; i < 256; i++) {
+            uint16_t c = i << 8;
+            for (int b = 0; b < 8; b++) {
+                c = (c & 0x8000) ? (c << 1) ^ 0x1021 : (c << 1);
+            }
+            crc16_table[i] = c;
+        }
+        crc16_table_ready = true;
+    }
+    
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc << 8) ^ crc16_table[((crc >> 8) ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+static void sd_command_frame(uint8_t *buf, uint8_t cmd, uint32_t arg) {
+    buf[0] = cmd;
+    buf[1] = arg >> 24;
+    buf[2] = arg >> 16;
+    buf[3] = arg >> 8;
+    buf[4] = arg;
+    buf[5] = (sd_crc7(buf, 5) << 1) | 0x01;
+}
+
+static uint8_t sd_command(uint8_t cmd, uint32_t arg) {
+    uint8_t buf[6];
     uint8_t resp = 0xFF;
-    uint8_t dummy = 0xFF;
     
+    sd_command_frame(buf, cmd, arg);
     sd_cs_select();
     spi_write_blocking(SD_SPI, buf, 6);
     
@@ -346,6 +405,8 @@ void sd_card_deinit(void) {
 // Track if we've already shown the init message to avoid spam
 static bool init_msg_shown = false;
 
+static void sd_negotiate_clock(void);
+
 // Initialize SD card hardware
 int sd_card_init(void) {
     // Only show detailed initialization message once per session
@@ -367,7 +428,8 @@ int sd_card_init(void) {
     sleep_ms(100);
     
     // Initialize SPI at low speed for SD card initialization
-    spi_init(SD_SPI, 400000); // 400kHz
+    sd_clock_hz = spi_init(SD_SPI, SD_INIT_CLOCK); // 400kHz
+    clock_step = -1;
     
     // Configure GPIO pins
     gpio_set_function(SD_MISO, GPIO_FUNC_SPI);
@@ -389,7 +451,7 @@ int sd_card_init(void) {
     }
     
     // Send CMD0 - Reset to idle state
-    uint8_t resp = sd_command(CMD0, 0, 0x95);
+    uint8_t resp = sd_command(CMD0, 0);
     sd_cs_deselect();
     spi_write_blocking(SD_SPI, &dummy, 1);
     
@@ -399,11 +461,11 @@ int sd_card_init(void) {
             return -1;
         } else if (resp == 0x3F) {
             // Try even slower SPI
-            spi_set_baudrate(SD_SPI, 100000); // 100kHz
+            sd_clock_hz = spi_set_baudrate(SD_SPI, 100000); // 100kHz
             sleep_ms(100);
             
             // Try CMD0 again at slower speed
-            resp = sd_command(CMD0, 0, 0x95);
+            resp = sd_command(CMD0, 0);
             sd_cs_deselect();
             spi_write_blocking(SD_SPI, &dummy, 1);
             
@@ -423,7 +485,7 @@ int sd_card_init(void) {
     sd_detected = true;
     
     // CMD8 - Test voltage and SDHC support
-    resp = sd_command(CMD8, 0x1AA, 0x87);
+    resp = sd_command(CMD8, 0x1AA);
     uint8_t r7[4];
     for (int i = 0; i < 4; i++) {
         spi_read_blocking(SD_SPI, 0xFF, &r7[i], 1);
@@ -440,17 +502,27 @@ int sd_card_init(void) {
     // ACMD41 loop - Initialize card
     for (int i = 0; i < 100; i++) {
         // CMD55 prefix for application command
-        sd_command(CMD55, 0, 0xFF);
+        sd_command(CMD55, 0);
         sd_cs_deselect();
         spi_write_blocking(SD_SPI, &dummy, 1);
         
         // ACMD41 with HCS bit for SDHC support
-        resp = sd_command(ACMD41, 0x40000000, 0xFF);
+        resp = sd_command(ACMD41, 0x40000000);
         sd_cs_deselect();
         spi_write_blocking(SD_SPI, &dummy, 1);
         
         if (resp == 0x00) {
             sd_initialized = true;
+            
+            // CMD59: have the card check command and write-data CRCs too
+            resp = sd_command(CMD59, 1);
+            sd_cs_deselect();
+            spi_write_blocking(SD_SPI, &dummy, 1);
+            if (resp != 0x00) {
+                printf("  ⚠ CMD59 (CRC on) rejected: 0x%02X\n", resp);
+            }
+            
+            sd_negotiate_clock();
             return 0;
         }
         sleep_ms(10);
@@ -489,7 +561,7 @@ int sd_card_simple_detect(void) {
     // Try CMD0 several times
     printf("Testing CMD0 response...\n");
     for (int attempt = 0; attempt < 10; attempt++) {
-        uint8_t resp = sd_command(CMD0, 0, 0x95);
+        uint8_t resp = sd_command(CMD0, 0);
         sd_cs_deselect();
         spi_write_blocking(SD_SPI, &dummy, 1);
         
@@ -610,103 +682,410 @@ int sd_card_format_fat32(void) {
 }
 
 // Raw sector operations
-int sd_card_read_sector(uint32_t sector, uint8_t *buffer) {
-    if (!sd_initialized) {
-        printf("SD card not initialized\n");
+
+// Wait for the data token, then read a block and check its CRC16.
+// Returns 0, -1 on timeout, SD_CRC_ERROR on a mismatch.
+static int sd_read_data_block(uint8_t *buffer, size_t len) {
+    uint8_t token = 0xFF;
+    for (int i = 0; i < 50000; i++) {
+        spi_read_blocking(SD_SPI, 0xFF, &token, 1);
+        if (token == TOKEN_START_BLOCK) break;
+    }
+    if (token != TOKEN_START_BLOCK) {
         return -1;
     }
     
-    uint8_t token;
+    uint8_t crc[2];
+    spi_read_blocking(SD_SPI, 0xFF, buffer, len);
+    spi_read_blocking(SD_SPI, 0xFF, crc, 2);
+    if ((((uint16_t)crc[0] << 8) | crc[1]) != sd_crc16(buffer, len)) {
+        crc_errors++;
+        return SD_CRC_ERROR;
+    }
+    return 0;
+}
+
+// Send one block after its token; returns the data response result
+static int sd_write_data_block(uint8_t token, const uint8_t *buffer) {
+    uint16_t crc16 = sd_crc16(buffer, 512);
+    uint8_t crc[2] = {crc16 >> 8, crc16 & 0xFF};
+    uint8_t resp;
+    
+    spi_write_blocking(SD_SPI, &token, 1);
+    spi_write_blocking(SD_SPI, buffer, 512);
+    spi_write_blocking(SD_SPI, crc, 2);
+    
+    spi_read_blocking(SD_SPI, 0xFF, &resp, 1);
+    if ((resp & 0x1F) == 0x05) return 0;
+    if ((resp & 0x1F) == 0x0B) {
+        // Card saw a CRC error on the block
+        crc_errors++;
+        return SD_CRC_ERROR;
+    }
+    printf("Write data response failed: 0x%02X\n", resp);
+    return -1;
+}
+
+// Clock the card until it releases MISO (busy after a write or CMD12)
+static bool sd_wait_ready(void) {
+    uint8_t busy;
+    for (int i = 0; i < 65000; i++) {
+        spi_read_blocking(SD_SPI, 0xFF, &busy, 1);
+        if (busy == 0xFF) return true;
+    }
+    return false;
+}
+
+// CMD12 = Stop Transmission. The byte after the command is a stuff byte
+// that may look like a valid R1, so skip it before polling for the response.
+static uint8_t sd_stop_transmission(void) {
+    uint8_t buf[6];
+    uint8_t resp = 0xFF;
+    
+    sd_command_frame(buf, CMD12, 0);
+    spi_write_blocking(SD_SPI, buf, 6);
+    spi_read_blocking(SD_SPI, 0xFF, &resp, 1);
+    for (int i = 0; i < 10; i++) {
+        spi_read_blocking(SD_SPI, 0xFF, &resp, 1);
+        if (!(resp & 0x80)) break;
+    }
+    sd_wait_ready();
+    return resp;
+}
+
+// R1 with the command CRC error bit set counts as a CRC failure
+static int sd_command_failed(const char *name, uint8_t resp) {
+    if (resp & 0x08) {
+        crc_errors++;
+        return SD_CRC_ERROR;
+    }
+    printf("%s failed: 0x%02X\n", name, resp);
+    return -1;
+}
+
+// Read a 16-byte register (CSD/CID) that arrives as a data block
+static int sd_read_register(uint8_t cmd, uint8_t *reg) {
+    uint8_t dummy = 0xFF;
+    int result = -1;
+    
+    uint8_t resp = sd_command(cmd, 0);
+    if (resp == 0x00) {
+        result = sd_read_data_block(reg, 16);
+    }
+    sd_cs_deselect();
+    spi_write_blocking(SD_SPI, &dummy, 1);
+    return result;
+}
+
+static int sd_read_single(uint32_t sector, uint8_t *buffer) {
     uint8_t dummy = 0xFF;
     
     // Convert addressing: SDHC uses block numbers, SDSC uses byte addresses
     uint32_t addr = is_sdhc ? sector : sector * 512;
     
     // CMD17 = Read Single Block
-    uint8_t resp = sd_command(CMD17, addr, 0xFF);
+    uint8_t resp = sd_command(CMD17, addr);
     if (resp != 0x00) {
-        printf("CMD17 failed: 0x%02X\n", resp);
         sd_cs_deselect();
-        return -1;
+        return sd_command_failed("CMD17", resp);
     }
     
-    // Wait for start token 0xFE
-    for (int i = 0; i < 50000; i++) {
-        spi_read_blocking(SD_SPI, 0xFF, &token, 1);
-        if (token == 0xFE) break;
-    }
+    // Start token, 512 bytes of data, CRC16 (a timeout likely means no card)
+    int result = sd_read_data_block(buffer, 512);
+    
+    sd_cs_deselect();
+    spi_write_blocking(SD_SPI, &dummy, 1);
+    return result;
+}
+
+static int sd_read_multi(uint32_t sector, uint8_t *buffer, uint32_t count) {
+    uint8_t dummy = 0xFF;
+    uint32_t addr = is_sdhc ? sector : sector * 512;
     
-    if (token != 0xFE) {
-        // Read timeout - likely no SD card (silent failure)
+    // CMD18 = Read Multiple Blocks: the card streams blocks until CMD12
+    uint8_t resp = sd_command(CMD18, addr);
+    if (resp != 0x00) {
         sd_cs_deselect();
-        return -1;
+        return sd_command_failed("CMD18", resp);
     }
     
-    // Read 512 bytes of data
-    spi_read_blocking(SD_SPI, 0xFF, buffer, 512);
+    int result = 0;
+    for (uint32_t i = 0; i < count && result == 0; i++) {
+        result = sd_read_data_block(buffer + i * 512, 512);
+        if (result == -1) {
+            printf("CMD18 read timeout at sector %lu\n", (unsigned long)(sector + i));
+        }
+    }
     
-    // Read CRC (required even though we don't verify it)
-    uint8_t crc[2];
-    spi_read_blocking(SD_SPI, 0xFF, crc, 2);
+    // Always stop the stream, even after an error
+    resp = sd_stop_transmission();
+    if (resp != 0x00 && result == 0) {
+        printf("CMD12 failed: 0x%02X\n", resp);
+        result = -1;
+    }
     
     sd_cs_deselect();
     spi_write_blocking(SD_SPI, &dummy, 1);
-    
-    return 0;
+    return result;
 }
 
-int sd_card_write_sector(uint32_t sector, const uint8_t *buffer) {
-    if (!sd_initialized) {
-        printf("SD card not initialized\n");
-        return -1;
-    }
-    
+static int sd_write_single(uint32_t sector, const uint8_t *buffer) {
     uint8_t dummy = 0xFF;
     
     // Convert addressing: SDHC uses block numbers, SDSC uses byte addresses  
     uint32_t addr = is_sdhc ? sector : sector * 512;
     
     // CMD24 = Write Single Block
-    uint8_t resp = sd_command(CMD24, addr, 0xFF);
+    uint8_t resp = sd_command(CMD24, addr);
     if (resp != 0x00) {
-        printf("CMD24 failed: 0x%02X\n", resp);
         sd_cs_deselect();
-        return -1;
+        return sd_command_failed("CMD24", resp);
     }
     
-    // Send start token
-    uint8_t token = 0xFE;
-    spi_write_blocking(SD_SPI, &token, 1);
+    int result = sd_write_data_block(TOKEN_START_BLOCK, buffer);
     
-    // Send 512 bytes of data
-    spi_write_blocking(SD_SPI, buffer, 512);
+    // Wait for card to finish internal write operation
+    if (result == 0 && !sd_wait_ready()) {
+        printf("CMD24 busy timeout at sector %lu\n", (unsigned long)sector);
+        result = -1;
+    }
     
-    // Send dummy CRC (2 bytes)
-    uint8_t crc[2] = {0xFF, 0xFF};
-    spi_write_blocking(SD_SPI, crc, 2);
+    sd_cs_deselect();
+    spi_write_blocking(SD_SPI, &dummy, 1);
+    return result;
+}
+
+static int sd_write_multi(uint32_t sector, const uint8_t *buffer, uint32_t count) {
+    uint8_t dummy = 0xFF;
+    uint32_t addr = is_sdhc ? sector : sector * 512;
     
-    // Read data response
-    spi_read_blocking(SD_SPI, 0xFF, &resp, 1);
-    if ((resp & 0x1F) != 0x05) {
-        printf("Write data response failed: 0x%02X\n", resp);
+    // ACMD23 = pre-erase the blocks about to be written (a hint; ignored on failure)
+    sd_command(CMD55, 0);
+    sd_cs_deselect();
+    spi_write_blocking(SD_SPI, &dummy, 1);
+    sd_command(ACMD23, count & 0x7FFFFF);
+    sd_cs_deselect();
+    spi_write_blocking(SD_SPI, &dummy, 1);
+    
+    // CMD25 = Write Multiple Blocks
+    uint8_t resp = sd_command(CMD25, addr);
+    if (resp != 0x00) {
         sd_cs_deselect();
-        return -1;
+        return sd_command_failed("CMD25", resp);
     }
     
-    // Wait for card to finish internal write operation
-    uint8_t busy;
-    for (int i = 0; i < 65000; i++) {
-        spi_read_blocking(SD_SPI, 0xFF, &busy, 1);
-        if (busy == 0xFF) break;
+    int result = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        // Data response, then busy while the card takes the block
+        result = sd_write_data_block(TOKEN_MULTI_WRITE, buffer + i * 512);
+        if (result != 0) break;
+        if (!sd_wait_ready()) {
+            printf("CMD25 busy timeout at sector %lu\n", (unsigned long)(sector + i));
+            result = -1;
+            break;
+        }
+    }
+    
+    // Stop token ends the write; the card stays busy while it programs the rest
+    uint8_t stop = TOKEN_STOP_TRAN;
+    spi_write_blocking(SD_SPI, &stop, 1);
+    spi_read_blocking(SD_SPI, 0xFF, &resp, 1);  // Skip one byte before busy
+    if (!sd_wait_ready() && result == 0) {
+        printf("CMD25 stop busy timeout\n");
+        result = -1;
     }
     
     sd_cs_deselect();
     spi_write_blocking(SD_SPI, &dummy, 1);
+    return result;
+}
+
+// Set the clock to a step. Returns false if the SPI divider rounds it to a
+// rate that is not below limit_hz (already tried, or too fast).
+static bool sd_set_clock_step(int step, uint32_t limit_hz) {
+    uint32_t hz = spi_set_baudrate(SD_SPI, sd_clock_steps[step]);
+    if (hz >= limit_hz) {
+        spi_set_baudrate(SD_SPI, sd_clock_hz);
+        return false;
+    }
+    sd_clock_hz = hz;
+    clock_step = step;
+    return true;
+}
+
+// Drop to the next slower clock step after a CRC error. Returns false at the bottom.
+static bool sd_clock_step_down(void) {
+    for (int step = clock_step + 1; step < (int)SD_CLOCK_STEPS; step++) {
+        if (sd_set_clock_step(step, sd_clock_hz)) {
+            printf("⚠️  SD CRC error: clock down to %lu kHz\n", (unsigned long)(sd_clock_hz / 1000));
+            return true;
+        }
+    }
+    return false;
+}
+
+// TRAN_SPEED (CSD byte 3): time value x rate unit
+static uint32_t sd_tran_speed(uint8_t tran_speed) {
+    static const uint8_t tenths[16] = {0, 10, 12, 13, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 70, 80};
+    uint32_t unit = 10000;  // 100kbit/s in tenths
+    for (int i = 0; i < (tran_speed & 0x07); i++) unit *= 10;
+    return tenths[(tran_speed >> 3) & 0x0F] * unit;
+}
+
+// A clock is kept if the CSD and SD_CLOCK_PROBES reads of sector 0 pass their CRC
+static bool sd_clock_probe(const uint8_t *csd) {
+    uint8_t reg[16];
+    if (sd_read_register(CMD9, reg) != 0 || memcmp(reg, csd, 16) != 0) return false;
+    for (int i = 0; i < SD_CLOCK_PROBES; i++) {
+        if (sd_read_single(0, file_data) != 0) return false;  // file_data as scratch
+    }
+    return true;
+}
+
+// Raise the SPI clock from the identification rate to the fastest step the
+// card allows and the bus carries cleanly
+static void sd_negotiate_clock(void) {
+    uint8_t csd[16];
+    uint32_t init_hz = sd_clock_hz;
+    
+    if (sd_read_register(CMD9, csd) != 0) {
+        printf("  ⚠ CSD unreadable, staying at %lu kHz\n", (unsigned long)(sd_clock_hz / 1000));
+        return;
+    }
+    uint32_t card_max = sd_tran_speed(csd[3]);
+    uint32_t limit = card_max;
+    if (max_clock_hz != 0 && max_clock_hz < limit) limit = max_clock_hz;
+    
+    uint32_t tried = limit + 1;
+    for (int step = 0; step < (int)SD_CLOCK_STEPS; step++) {
+        if (sd_clock_steps[step] > limit || !sd_set_clock_step(step, tried)) continue;
+        tried = sd_clock_hz;
+        if (sd_clock_probe(csd)) {
+            printf("  ✓ SD clock %lu kHz (card max %lu kHz)\n",
+                   (unsigned long)(sd_clock_hz / 1000), (unsigned long)(card_max / 1000));
+            return;
+        }
+        printf("  ⚠ CRC errors at %lu kHz, trying slower\n", (unsigned long)(sd_clock_hz / 1000));
+    }
+    
+    sd_clock_hz = spi_set_baudrate(SD_SPI, init_hz);
+    clock_step = -1;
+    printf("  ⚠ No faster SD clock passed, staying at %lu kHz\n", (unsigned long)(sd_clock_hz / 1000));
+}
+
+void sd_card_set_max_clock(uint32_t hz) {
+    max_clock_hz = hz;
+}
+
+uint32_t sd_card_get_clock(void) {
+    return sd_clock_hz;
+}
+
+uint32_t sd_card_get_crc_errors(void) {
+    return crc_errors;
+}
+
+int sd_card_get_sector_count(uint32_t *count) {
+    if (!sd_initialized) {
+        printf("SD card not initialized\n");
+        return -1;
+    }
     
-    printf("Wrote sector %lu successfully\n", sector);
+    uint8_t csd[16];
+    if (sd_read_register(CMD9, csd) != 0) {
+        printf("CMD9 (read CSD) failed\n");
+        return -1;
+    }
+    
+    if ((csd[0] >> 6) == 1) {
+        // CSD version 2.0 (SDHC/SDXC): capacity = (C_SIZE + 1) * 512KB
+        uint32_t c_size = ((uint32_t)(csd[7] & 0x3F) << 16) | ((uint32_t)csd[8] << 8) | csd[9];
+        *count = (c_size + 1) * 1024;
+    } else {
+        // CSD version 1.0 (SDSC): (C_SIZE + 1) * 2^(C_SIZE_MULT + 2) blocks of 2^READ_BL_LEN
+        uint32_t c_size = ((uint32_t)(csd[6] & 0x03) << 10) | ((uint32_t)csd[7] << 2) | (csd[8] >> 6);
+        uint32_t c_size_mult = ((csd[9] & 0x03) << 1) | (csd[10] >> 7);
+        uint32_t read_bl_len = csd[5] & 0x0F;
+        *count = (c_size + 1) << (c_size_mult + 2 + read_bl_len - 9);
+    }
     return 0;
 }
 
+void sd_card_set_multi_block(bool enable) {
+    multi_block = enable;
+}
+
+int sd_card_read_sector(uint32_t sector, uint8_t *buffer) {
+    return sd_card_read_sectors(sector, buffer, 1);
+}
+
+int sd_card_write_sector(uint32_t sector, const uint8_t *buffer) {
+    return sd_card_write_sectors(sector, buffer, 1);
+}
+
+static int read_sectors(uint32_t sector, uint8_t *buffer, uint32_t count) {
+    if (!sd_initialized) {
+        printf("SD card not initialized\n");
+        return -1;
+    }
+    
+    if (count > 1 && !multi_block) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (read_sectors(sector + i, buffer + i * 512, 1) != 0) return -1;
+        }
+        return 0;
+    }
+    
+    // CRC errors step the clock down and retry the whole transfer
+    for (int attempt = 0;; attempt++) {
+        int result = (count == 1) ? sd_read_single(sector, buffer)
+                                  : sd_read_multi(sector, buffer, count);
+        if (result != SD_CRC_ERROR) return result;
+        if (attempt == SD_CRC_RETRIES || !sd_clock_step_down()) {
+            printf("CRC error reading sector %lu\n", (unsigned long)sector);
+            return -1;
+        }
+    }
+}
+
+static int write_sectors(uint32_t sector, const uint8_t *buffer, uint32_t count) {
+    if (!sd_initialized) {
+        printf("SD card not initialized\n");
+        return -1;
+    }
+    
+    if (count > 1 && !multi_block) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (write_sectors(sector + i, buffer + i * 512, 1) != 0) return -1;
+        }
+        return 0;
+    }
+    
+    for (int attempt = 0;; attempt++) {
+        int result = (count == 1) ? sd_write_single(sector, buffer)
+                                  : sd_write_multi(sector, buffer, count);
+        if (result != SD_CRC_ERROR) return result;
+        if (attempt == SD_CRC_RETRIES || !sd_clock_step_down()) {
+            printf("CRC error writing sector %lu\n", (unsigned long)sector);
+            return -1;
+        }
+    }
+}
+
+int sd_card_read_sectors(uint32_t sector, uint8_t *buffer, uint32_t count) {
+    TRACE_BEGIN(TRACE_SD_READ, count);
+    int result = read_sectors(sector, buffer, count);
+    TRACE_END(TRACE_SD_READ, count);
+    return result;
+}
+
+int sd_card_write_sectors(uint32_t sector, const uint8_t *buffer, uint32_t count) {
+    TRACE_BEGIN(TRACE_SD_WRITE, count);
+    int result = write_sectors(sector, buffer, count);
+    TRACE_END(TRACE_SD_WRITE, count);
+    return result;
+}
+
 // High-level file operations using FAT32
 int sd_card_write_file(const char *filename, const uint8_t *data, size_t size) {
     if (!fat32_mounted) {
@@ -715,7 +1094,7 @@ int sd_card_write_file(const char *filename, const uint8_t *data, size_t size) {
     }
     
     FIL file;
-    UINT bytes_written;
+    UINT bytes_written = 0;
     
     // Debug: Check disk status
     DSTATUS stat = disk_status(0);
@@ -898,8 +1277,92 @@ int sd_card_send_file(const char *filename, const char *topic) {
     return 0;
 }
 
+void sd_card_set_contiguous_save(bool enable) {
+    contiguous_save = enable;
+}
+
+// Allocate one contiguous extent for a file just created with
+// FA_CREATE_ALWAYS. The FAT chain is written once here and the directory
+// entry once by f_close(). Returns 1 if the card has no contiguous free
+// area that large (the file is left empty and can be written with f_write).
+int sd_card_expand_file(FIL *file, size_t size) {
+    FRESULT res = f_expand(file, size, 1);
+    if (res == FR_DENIED) return 1;
+    return res == FR_OK ? 0 : -1;
+}
+
+// Write part of an expanded file straight to its sectors. offset must be a
+// multiple of 512; a piece ending inside a sector is zero padded, so only
+// the last piece of the file may do that.
+int sd_card_write_extent(FIL *file, size_t offset, const uint8_t *data, size_t len) {
+    FATFS *vol = file->obj.fs;
+    LBA_t lba = vol->database + (LBA_t)(file->obj.sclust - 2) * vol->csize + offset / 512;
+    size_t full_sectors = len / 512;
+    
+    for (size_t done = 0; done < full_sectors; ) {
+        UINT count = full_sectors - done;
+        if (count > SD_SAVE_BURST_SECTORS) count = SD_SAVE_BURST_SECTORS;
+        if (disk_write(vol->pdrv, data + done * 512, lba + done, count) != RES_OK) {
+            printf("Failed writing sectors %lu-%lu\n", (unsigned long)(lba + done),
+                   (unsigned long)(lba + done + count - 1));
+            return -1;
+        }
+        done += count;
+        
+        #ifdef __PICO__
+        extern void cyw43_arch_poll(void);
+        cyw43_arch_poll();
+        #endif
+    }
+    
+    // Last partial sector, zero padded
+    size_t tail = len % 512;
+    if (tail > 0) {
+        memset(file_data, 0, 512);
+        memcpy(file_data, data + full_sectors * 512, tail);
+        if (disk_write(vol->pdrv, file_data, lba + full_sectors, 1) != RES_OK) {
+            printf("Failed writing sector %lu\n", (unsigned long)(lba + full_sectors));
+            return -1;
+        }
+    }
+    return 0;
+}
+
 int sd_card_save_block(const char *filename, const uint8_t *data, size_t size) {
-    return sd_card_write_file(filename, data, size);
+    if (!contiguous_save || size == 0) {
+        return sd_card_write_file(filename, data, size);
+    }
+    if (!fat32_mounted) {
+        printf("FAT32 not mounted\n");
+        return -1;
+    }
+    
+    FIL file;
+    printf("Opening file: %s\n", filename);
+    FRESULT res = f_open(&file, filename, FA_CREATE_ALWAYS | FA_WRITE);
+    if (res != FR_OK) {
+        printf("Failed to open file: %s (FatFs error %d)\n", filename, res);
+        return -1;
+    }
+    
+    int rc = sd_card_expand_file(&file, size);
+    if (rc == 0) {
+        rc = sd_card_write_extent(&file, 0, data, size);
+    } else if (rc > 0) {
+        f_close(&file);
+        printf("⚠️  No contiguous free area for %zu bytes - writing through FatFs\n", size);
+        return sd_card_write_file(filename, data, size);
+    }
+    
+    res = f_close(&file);
+    if (rc != 0 || res != FR_OK) {
+        printf("Failed to write file: %s (error %d)\n", filename, res);
+        f_unlink(filename);
+        return -1;
+    }
+    
+    printf("✅ Wrote %zu bytes to file %s (contiguous)\n", size, filename);
+    return 0;
 }
 
 int sd_card_create_test_file(const char *filename) {
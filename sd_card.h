@@ -4,12 +4,14 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "ff.h"
 
 void wait_for_sd_card();
 bool initialize_sd_card();
 bool check_sd_card_status();
 bool scan_and_select_image();
-const char* sd_card_get_first_image(void);  // Get first image filename from scan
+const char* sd_card_get_first_image(void);  // Next unsent image from the on-card index
+int sd_card_mark_image_sent(void);          // Mark the image last returned as sent
 
 // SD card function prototypes
 void sd_card_deinit(void);
@@ -18,6 +20,16 @@ int sd_card_init_with_detection(void);
 int sd_card_simple_detect(void);
 int sd_card_read_sector(uint32_t sector, uint8_t *buffer);
 int sd_card_write_sector(uint32_t sector, const uint8_t *buffer);
+// Multi-sector transfers: CMD18/CMD25 when count > 1, per-sector otherwise
+int sd_card_read_sectors(uint32_t sector, uint8_t *buffer, uint32_t count);
+int sd_card_write_sectors(uint32_t sector, const uint8_t *buffer, uint32_t count);
+void sd_card_set_multi_block(bool enable);  // Default on; off falls back to CMD17/CMD24 loops
+int sd_card_get_sector_count(uint32_t *count);  // Capacity from the CSD register
+// SPI clock: negotiated up from 400kHz at init (CSD TRAN_SPEED, CRC16-checked
+// probe reads) and stepped down on CRC errors
+void sd_card_set_max_clock(uint32_t hz);        // Cap for the next init, 0 = card maximum
+uint32_t sd_card_get_clock(void);
+uint32_t sd_card_get_crc_errors(void);
 bool sd_card_is_mounted(void);
 bool sd_card_is_initialized(void);  // Hardware initialized (for diskio)
 void sd_card_check_status(void);
@@ -33,5 +45,10 @@ int sd_card_create_test_file(const char *filename);
 int sd_card_send_file(const char *filename, const char *mqtt_topic);
 void sd_card_list_files(void);
 int sd_card_save_block(const char *filename, const uint8_t *data, size_t size);
+void sd_card_set_contiguous_save(bool enable);  // Default on; off saves blocks with f_write
+// Contiguous extents: expand a file just opened with FA_CREATE_ALWAYS, then
+// write it straight to its sectors (offsets multiple of 512)
+int sd_card_expand_file(FIL *file, size_t size);  // 1 = no contiguous free area
+int sd_card_write_extent(FIL *file, size_t offset, const uint8_t *data, size_t len);
 
 #endif // SD_CARD_H
\ No newline at end of file
@@ -0,0 +1,160 @@
+// sd_write_queue.c - Step-wise write-behind queue on top of FatFs
+
+#include "sd_write_queue.h"
+#include "sd_card.h"
+#include "ff.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <string.h>
+
+_Static_assert(SD_WRITE_QUEUE_STEP % 512 == 0, "SD_WRITE_QUEUE_STEP must be whole sectors");
+
+typedef struct {
+    char filename[SD_WRITE_QUEUE_NAME_MAX];
+    uint32_t offset;
+    const uint8_t *data;
+    size_t len;
+    uint8_t flags;
+    sd_write_done_t done;
+    void *ctx;
+} write_job_t;
+
+static write_job_t jobs[SD_WRITE_QUEUE_DEPTH];
+static int job_head;            // Oldest job
+static int job_count;
+static sd_write_queue_stats_t stats;
+
+// Progress of the oldest job
+static FIL job_file;
+static bool job_open;
+static bool job_raw;            // Written straight to a contiguous extent
+static size_t job_pos;
+
+int sd_write_queue_submit(const char *filename, uint32_t offset, const uint8_t *data, size_t len,
+                          uint8_t flags, sd_write_done_t done, void *ctx) {
+    if (strlen(filename) >= SD_WRITE_QUEUE_NAME_MAX || ((flags & SD_WQ_CREATE) && offset != 0)) {
+        printf("[WQ] Invalid job for '%s'\n", filename);
+        return -1;
+    }
+    if (job_count == SD_WRITE_QUEUE_DEPTH) {
+        stats.rejected++;
+        return -1;
+    }
+
+    write_job_t *job = &jobs[(job_head + job_count) % SD_WRITE_QUEUE_DEPTH];
+    strcpy(job->filename, filename);
+    job->offset = offset;
+    job->data = data;
+    job->len = len;
+    job->flags = flags;
+    job->done = done;
+    job->ctx = ctx;
+
+    job_count++;
+    stats.jobs++;
+    if ((uint32_t)job_count > stats.max_depth) stats.max_depth = job_count;
+    return 0;
+}
+
+static int job_start(write_job_t *job) {
+    job_raw = false;
+    job_pos = 0;
+
+    if (job->flags & SD_WQ_CREATE) {
+        if (f_open(&job_file, job->filename, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) return -1;
+        job_open = true;
+        int rc = (job->len > 0) ? sd_card_expand_file(&job_file, job->len) : 1;
+        if (rc < 0) return -1;
+        job_raw = (rc == 0);
+        return 0;
+    }
+
+    if (f_open(&job_file, job->filename, FA_OPEN_ALWAYS | FA_WRITE) != FR_OK) return -1;
+    job_open = true;
+    return f_lseek(&job_file, job->offset) == FR_OK ? 0 : -1;
+}
+
+static int job_step(write_job_t *job) {
+    size_t n = job->len - job_pos;
+    if (n > SD_WRITE_QUEUE_STEP) n = SD_WRITE_QUEUE_STEP;
+
+    if (job_raw) {
+        if (sd_card_write_extent(&job_file, job_pos, job->data + job_pos, n) != 0) return -1;
+    } else {
+        UINT written = 0;
+        if (f_write(&job_file, job->data + job_pos, n, &written) != FR_OK || written != n) return -1;
+    }
+    job_pos += n;
+    stats.bytes += n;
+    return 0;
+}
+
+static void job_finish(write_job_t *job, int result) {
+    if (job_open) {
+        if (f_close(&job_file) != FR_OK) result = -1;
+        job_open = false;
+    }
+    if (result != 0) {
+        stats.failed++;
+        printf("[WQ] ❌ Write of '%s' failed at byte %zu\n", job->filename, job_pos);
+        if (job->flags & SD_WQ_CREATE) f_unlink(job->filename);
+    }
+
+    // The callback may queue the next job into this slot
+    sd_write_done_t done = job->done;
+    void *ctx = job->ctx;
+    job_head = (job_head + 1) % SD_WRITE_QUEUE_DEPTH;
+    job_count--;
+    if (done) done(ctx, result);
+}
+
+// Each call does one of: open the file (and allocate its extent), write
+// one step, or close it (FAT, directory entry and cache flush)
+bool sd_write_queue_poll(void) {
+    if (job_count == 0) return false;
+
+    write_job_t *job = &jobs[job_head];
+    uint64_t start = time_us_64();
+    int rc;
+
+    if (!job_open) {
+        rc = job_start(job);
+        if (rc != 0) job_finish(job, rc);
+    } else if (job_pos < job->len) {
+        rc = job_step(job);
+        if (rc != 0) job_finish(job, rc);
+    } else {
+        job_finish(job, 0);
+    }
+
+    uint32_t elapsed = time_us_64() - start;
+    stats.steps++;
+    stats.write_us += elapsed;
+    if (elapsed > stats.max_step_us) stats.max_step_us = elapsed;
+    return job_count > 0;
+}
+
+int sd_write_queue_flush(void) {
+    if (job_count == 0) return 0;
+
+    uint32_t failed = stats.failed;
+    uint64_t start = time_us_64();
+    while (sd_write_queue_poll()) {
+        tight_loop_contents();
+    }
+    stats.stalls++;
+    stats.stall_us += time_us_64() - start;
+    return stats.failed == failed ? 0 : -1;
+}
+
+int sd_write_queue_depth(void) {
+    return job_count;
+}
+
+void sd_write_queue_get_stats(sd_write_queue_stats_t *out) {
+    *out = stats;
+}
+
+void sd_write_queue_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
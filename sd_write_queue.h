@@ -0,0 +1,58 @@
+// sd_write_queue.h - Write-behind queue for SD card writes
+//
+// Jobs are (file, offset, data) writes that the main loop drains one step
+// at a time with sd_write_queue_poll(), so a 150KB save never leaves the
+// receive loop blind for longer than one SD_WRITE_QUEUE_STEP write. A job
+// that creates a file is written as one contiguous extent (see
+// sd_card_expand_file()) when the card has room for it.
+//
+// Data is not copied - the Pico has no RAM for a second block buffer. The
+// caller keeps it unchanged until the job's callback has run; a full queue
+// refuses new jobs so the caller can push back on the network instead.
+
+#ifndef SD_WRITE_QUEUE_H
+#define SD_WRITE_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SD_WRITE_QUEUE_DEPTH    4       // Jobs queued at once
+#define SD_WRITE_QUEUE_STEP     4096    // Bytes written per poll (multiple of 512)
+#define SD_WRITE_QUEUE_NAME_MAX 64
+
+// Job flags
+#define SD_WQ_CREATE    0x01    // Create or truncate the file first (offset must be 0)
+
+typedef struct {
+    uint32_t jobs;              // Jobs accepted
+    uint32_t failed;            // Jobs that ended with an error
+    uint32_t rejected;          // Submits refused because the queue was full
+    uint32_t bytes;             // Bytes written
+    uint32_t steps;             // Poll calls that did work
+    uint32_t max_depth;         // Most jobs queued at once
+    uint32_t max_step_us;       // Longest single step (receive loop blind time)
+    uint64_t write_us;          // Time spent in steps
+    uint32_t stalls;            // sd_write_queue_flush() calls that had to wait
+    uint64_t stall_us;          // Time callers spent waiting in sd_write_queue_flush()
+} sd_write_queue_stats_t;
+
+// Called from sd_write_queue_poll() when a job ends: result 0 or -1
+typedef void (*sd_write_done_t)(void *ctx, int result);
+
+// Queue a write. Returns 0, or -1 if the queue is full or the job invalid.
+int sd_write_queue_submit(const char *filename, uint32_t offset, const uint8_t *data, size_t len,
+                          uint8_t flags, sd_write_done_t done, void *ctx);
+
+// Do one step of the oldest job. Returns true while jobs remain.
+bool sd_write_queue_poll(void);
+
+// Drain every job (blocking). Time spent is counted as a stall. Returns 0
+// if all of them succeeded.
+int sd_write_queue_flush(void);
+
+int sd_write_queue_depth(void);
+void sd_write_queue_get_stats(sd_write_queue_stats_t *stats);
+void sd_write_queue_reset_stats(void);
+
+#endif // SD_WRITE_QUEUE_H
@@ -8,8 +8,15 @@
 #include "network_config.h"
 #include "wifi_driver.h"
 #include "mqttsn_client.h"
+#include "mqttsn_adapter.h"
+#include "fault_inject.h"
 #include "block_transfer.h"
 #include "sd_card.h"
+#include "sd_write_queue.h"
+#include "binlog.h"
+#include "metrics.h"
+#include "trace.h"
+#include "wire_capture.h"
 
 #ifdef HAVE_PAHO
 #include "MQTTSNPacket.h"
@@ -24,10 +31,17 @@
 static bool mqtt_subscriber_ready = false;
 static unsigned short subscribed_topicid = 0;
 static unsigned short chunks_topicid = 0;  // Topic ID for pico/chunks (block transfer)
+#if FAULT_INJECT_ENABLED
+static unsigned short fault_topicid = 0;   // Topic ID for fault injection specs
+#endif
+
+// QoS 1 chunks left unacknowledged while a block save is in progress
+static int metric_chunks_deferred = -1;
 
 // Process received PUBLISH messages
 static void process_publish_message(unsigned char *buf, int len) {
     #ifdef HAVE_PAHO
+    static bool deferring_chunks = false;  // Deferral logged once per save
     unsigned char dup, retained;
     unsigned short msgid;
     int qos;
@@ -42,7 +56,7 @@ static void process_publish_message(unsigned char *buf, int len) {
     if (rc == 1) {
         // Debug: Print received topic ID to verify matching
         if (topic.type == MQTTSN_TOPIC_TYPE_NORMAL) {
-            printf("[DEBUG] Received PUBLISH: TopicID=%u, Expected chunks_topicid=%u\n", 
+            BLOG_DEBUG("[DEBUG] Received PUBLISH: TopicID=%u, Expected chunks_topicid=%u\n", 
                    topic.data.id, chunks_topicid);
         }
         
@@ -54,6 +68,20 @@ static void process_publish_message(unsigned char *buf, int len) {
             // Poll WiFi stack to prevent buffer overflow during heavy traffic
             cyw43_arch_poll();
             
+            // Back-pressure: while the last block is still being written from
+            // the reassembly buffer, leave QoS 1 chunks unacknowledged so the
+            // gateway delivers them again later. QoS 0 chunks cannot be
+            // redelivered; process_block_chunk() waits for the write instead.
+            if (qos == 1 && block_transfer_save_pending()) {
+                metrics_inc(metric_chunks_deferred);
+                if (!deferring_chunks) {
+                    BLOG_INFO("[WQ] Block save in progress - deferring QoS 1 chunks (no PUBACK)\n");
+                    deferring_chunks = true;
+                }
+                return;
+            }
+            deferring_chunks = false;
+            
             // QoS 1: Process chunk FIRST, then send PUBACK (proper QoS 1 semantics)
             // This ensures PUBACK is only sent after successful processing
             process_block_chunk(payload, payloadlen);
@@ -82,6 +110,12 @@ static void process_publish_message(unsigned char *buf, int len) {
             return;  // Skip normal message processing for block chunks
         }
         
+#if FAULT_INJECT_ENABLED
+        if (topic.data.id == fault_topicid && fault_topicid != 0) {
+            fault_inject_control(payload, (size_t)payloadlen);
+        }
+#endif
+        
         printf("\n[SUBSCRIBER] ✓ Message received:\n");
         printf("  TopicID: %u\n", topic.data.id);
         printf("  QoS: %d\n", qos);
@@ -233,6 +267,7 @@ int main() {
     gpio_set_dir(LED_PIN, GPIO_OUT);
     gpio_put(LED_PIN, 0);
     printf("[INIT] LED initialized on GPIO %d\n", LED_PIN);
+    metric_chunks_deferred = metrics_counter("chunks_deferred");
     
     // Initialize SD card
     printf("[INIT] Initializing SD card...\n");
@@ -266,6 +301,7 @@ int main() {
     
     // Main loop
     bool was_connected = false;
+    absolute_time_t last_metrics_publish = get_absolute_time();
     
     while (true) {
         wifi_auto_reconnect();
@@ -310,8 +346,21 @@ int main() {
                             chunks_topicid = chunks_topic_id_temp;
                             printf("[SUBSCRIBER] ✓ Subscribed to pico/chunks (TopicID=%u)\n", chunks_topicid);
                             
+#if FAULT_INJECT_ENABLED
+                            // Fault injection specs published to pico/fault
+                            if (mqttsn_demo_subscribe(FAULT_INJECT_TOPIC, 105, &fault_topicid) > 0) {
+                                fault_inject_set_control_topic(fault_topicid);
+                                printf("[SUBSCRIBER] ✓ Subscribed to %s (TopicID=%u)\n", FAULT_INJECT_TOPIC, fault_topicid);
+                            }
+#endif
+                            
                             mqtt_subscriber_ready = true;
                             printf("[SUBSCRIBER] ✓✓✓ Ready to receive messages and blocks ✓✓✓\n");
+                            
+                            // A block cut short by a reboot or reconnect continues from the card
+                            if (block_transfer_resume_partial() > 0) {
+                                printf("[SUBSCRIBER] ✓ Resumed a partially received block\n");
+                            }
                         } else {
                             printf("[SUBSCRIBER] ✗ Failed to subscribe to pico/chunks (rc=%d)\n", chunks_sub_rc);
                             printf("[SUBSCRIBER] Will retry on next connection...\n");
@@ -328,9 +377,10 @@ int main() {
                     sleep_ms(10000);
                 }
             } else {
-                // Listen for incoming messages
+                // Listen for incoming messages; only peek while SD writes are queued
                 unsigned char buf[512];
-                int rc = mqttsn_transport_receive(buf, sizeof(buf), 100);
+                bool writing = sd_write_queue_depth() > 0;
+                int rc = mqttsn_transport_receive(buf, sizeof(buf), writing ? 1 : 100);
                 
                 if (rc > 0) {
                     uint8_t msg_type = buf[1];
@@ -351,9 +401,46 @@ int main() {
                 
                 // Check for block transfer timeouts
                 block_transfer_check_timeout();
+                
+                // Publish the metrics every 30 seconds (QoS 0, so no ACK wait eats a chunk)
+                if (absolute_time_diff_us(last_metrics_publish, get_absolute_time()) > METRICS_PUBLISH_MS * 1000LL) {
+                    if (metrics_publish() < 0) {
+                        printf("[METRICS] ✗ Publish to %s failed\n", METRICS_TOPIC);
+                    }
+                    last_metrics_publish = get_absolute_time();
+                }
             }
         }
         
+        // Deferred log output, a few records at a time
+        binlog_drain(BINLOG_DRAIN_BATCH);
+        
+        // 't' on the USB console dumps the tracepoint rings (host/trace_export),
+        // 'c' turns wire capture on and off and 'w' dumps it (host/wire_pcap),
+        // 'f' takes a fault injection spec (fault_inject.h)
+        int key = getchar_timeout_us(0);
+        if (key == 't') {
+            binlog_flush();
+            trace_dump();
+        }
+        if (key == 'c') {
+            wire_capture_enable(!wire_capture_enabled);
+        }
+        if (key == 'w') {
+            binlog_flush();
+            wire_capture_dump();
+        }
+#if FAULT_INJECT_ENABLED
+        if (key == 'f') {
+            fault_inject_console();
+        }
+#endif
+        
+        // One step of any queued SD writes (a block save is ~37 of them)
+        if (sd_write_queue_poll()) {
+            continue;
+        }
+        
         sleep_ms(10);
     }
     
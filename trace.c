@@ -0,0 +1,143 @@
+// trace.c - Tracepoint rings and their dump
+
+#include "trace.h"
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#ifdef TRACE_HOST
+#include <pthread.h>
+#else
+#include "hardware/sync.h"
+#endif
+
+#define RING_MASK (TRACE_RING_EVENTS - 1)
+
+_Static_assert((TRACE_RING_EVENTS & RING_MASK) == 0, "TRACE_RING_EVENTS must be a power of two");
+_Static_assert(TRACE_ID_COUNT <= 64, "trace ids are 6 bits");
+
+// Event word: id (6 bits), phase (2 bits), argument (low 24 bits)
+#define EVENT_WORD(id, phase, arg)  (((uint32_t)(id) << 26) | ((uint32_t)(phase) << 24) | ((arg) & 0xFFFFFF))
+#define EVENT_ID(w)                 ((uint8_t)((w) >> 26))
+#define EVENT_PHASE(w)              ((uint8_t)(((w) >> 24) & 0x3))
+#define EVENT_ARG(w)                ((w) & 0xFFFFFF)
+
+typedef struct {
+    uint32_t ts;
+    uint32_t word;
+} trace_record_t;
+
+// One ring per core, each written only by its own core
+typedef struct {
+    trace_record_t events[TRACE_RING_EVENTS];
+    uint32_t head;              // Events ever taken; the ring holds the last TRACE_RING_EVENTS
+} trace_ring_t;
+
+static trace_ring_t rings[TRACE_CORES];
+static volatile bool paused;
+static uint32_t dump_count;
+
+static const char phase_chars[] = { TRACE_PHASE_BEGIN, TRACE_PHASE_END, TRACE_PHASE_INSTANT };
+
+static const char *const names[TRACE_ID_COUNT] = {
+    [TRACE_CHUNK_SEND]       = "chunk_send",
+    [TRACE_CHUNK_BUILD]      = "chunk_build",
+    [TRACE_FEC_ENCODE]       = "fec_encode",
+    [TRACE_PACE]             = "pace",
+    [TRACE_MQTTSN_SERIALIZE] = "mqttsn_serialize",
+    [TRACE_MQTTSN_ACK_WAIT]  = "mqttsn_ack_wait",
+    [TRACE_UDP_PBUF_ALLOC]   = "pbuf_alloc",
+    [TRACE_UDP_SENDTO]       = "udp_sendto",
+    [TRACE_UDP_RECV_WAIT]    = "udp_recv_wait",
+    [TRACE_UDP_RX]           = "udp_rx",
+    [TRACE_CHUNK_RECEIVE]    = "chunk_receive",
+    [TRACE_FEC_DECODE]       = "fec_decode",
+    [TRACE_BLOCK_FINISH]     = "block_finish",
+    [TRACE_SD_READ]          = "sd_read",
+    [TRACE_SD_WRITE]         = "sd_write",
+};
+
+#ifdef TRACE_HOST
+static FILE *output;
+static pthread_t main_thread;
+
+// The thread that loads the tool plays core0, any other (the pipeline
+// producer) core1
+__attribute__((constructor)) static void trace_host_init(void) {
+    main_thread = pthread_self();
+}
+
+static inline unsigned current_core(void) { return pthread_equal(pthread_self(), main_thread) ? 0 : 1; }
+static inline uint32_t lock_ring(void) { return 0; }
+static inline void unlock_ring(uint32_t saved) { (void)saved; }
+static inline uint32_t now_us(void) { return (uint32_t)time_us_64(); }
+
+void trace_set_output(FILE *out) {
+    output = out;
+}
+
+#define TRACE_PRINTF(...) fprintf(output ? output : stdout, __VA_ARGS__)
+#else
+static inline unsigned current_core(void) { return get_core_num(); }
+static inline uint32_t lock_ring(void) { return save_and_disable_interrupts(); }
+static inline void unlock_ring(uint32_t saved) { restore_interrupts(saved); }
+static inline uint32_t now_us(void) { return time_us_32(); }
+
+#define TRACE_PRINTF(...) printf(__VA_ARGS__)
+#endif
+
+static uint8_t phase_code(uint8_t phase) {
+    return phase == TRACE_PHASE_BEGIN ? 0 : phase == TRACE_PHASE_END ? 1 : 2;
+}
+
+void trace_event(uint8_t id, uint8_t phase, uint32_t arg) {
+    if (paused) {
+        return;
+    }
+    trace_ring_t *ring = &rings[current_core()];
+    // Interrupts off so the receive callback cannot interleave with this core's write
+    uint32_t saved = lock_ring();
+    trace_record_t *e = &ring->events[ring->head & RING_MASK];
+    e->ts = now_us();
+    e->word = EVENT_WORD(id, phase_code(phase), arg);
+    ring->head++;
+    unlock_ring(saved);
+}
+
+const char *trace_name(uint8_t id) {
+    return (id < TRACE_ID_COUNT && names[id]) ? names[id] : "?";
+}
+
+void trace_clear(void) {
+    paused = true;
+    for (unsigned c = 0; c < TRACE_CORES; c++) {
+        rings[c].head = 0;
+    }
+    paused = false;
+}
+
+void trace_dump(void) {
+    paused = true;
+    uint32_t lost = 0;
+    for (unsigned c = 0; c < TRACE_CORES; c++) {
+        if (rings[c].head > TRACE_RING_EVENTS) {
+            lost += rings[c].head - TRACE_RING_EVENTS;
+        }
+    }
+
+    TRACE_PRINTF("%s %lu %lu\n", TRACE_DUMP_TAG, (unsigned long)++dump_count, (unsigned long)lost);
+    for (uint8_t id = 1; id < TRACE_ID_COUNT; id++) {
+        TRACE_PRINTF("%s %u %s\n", TRACE_NAME_TAG, id, trace_name(id));
+    }
+    for (unsigned c = 0; c < TRACE_CORES; c++) {
+        trace_ring_t *ring = &rings[c];
+        uint32_t first = ring->head > TRACE_RING_EVENTS ? ring->head - TRACE_RING_EVENTS : 0;
+        for (uint32_t i = first; i != ring->head; i++) {
+            const trace_record_t *e = &ring->events[i & RING_MASK];
+            TRACE_PRINTF("%s %u %08lx %c %u %lu\n", TRACE_EVENT_TAG, c, (unsigned long)e->ts,
+                         phase_chars[EVENT_PHASE(e->word)], EVENT_ID(e->word), (unsigned long)EVENT_ARG(e->word));
+        }
+        ring->head = 0;
+    }
+    TRACE_PRINTF("%s\n", TRACE_END_TAG);
+    paused = false;
+}
@@ -0,0 +1,88 @@
+// trace.h - Timestamped begin/end tracepoints for the hot paths
+//
+// TRACE_BEGIN()/TRACE_END() mark a span, TRACE_INSTANT() a point in time;
+// each takes one of the ids below and an argument (a part number, a byte
+// or sector count; 24 bits are kept). An event is a microsecond timestamp
+// and one word, stored in a per-core RAM ring that keeps the most recent
+// TRACE_RING_EVENTS events, so taking one costs a few dozen cycles and no
+// I/O.
+//
+// trace_dump() writes the rings to the console as text lines, on demand
+// (press 't' on the USB console of either Pico); host/trace_export turns
+// one or more captures into Chrome/Perfetto trace JSON. Host builds
+// (TRACE_HOST) take the same events on their own clock - the sd_emu
+// virtual clock for the tools that link it - so a simulated timeline can
+// be loaded next to a device one.
+//
+// Build with TRACE_ENABLED=0 to compile every tracepoint out.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED       1
+#endif
+
+#define TRACE_RING_EVENTS   512     // Per core, power of two; 8 bytes each
+#define TRACE_CORES         2
+
+#define TRACE_PHASE_BEGIN   'B'
+#define TRACE_PHASE_END     'E'
+#define TRACE_PHASE_INSTANT 'i'
+
+// Lines written by trace_dump()
+#define TRACE_DUMP_TAG      "#TRD"  // #TRD <dump number> <lost events>: a dump starts
+#define TRACE_NAME_TAG      "#TRN"  // #TRN <id> <name>
+#define TRACE_EVENT_TAG     "#TR"   // #TR <core> <timestamp us, hex> <phase> <id> <arg>
+#define TRACE_END_TAG       "#TRX"  // End of the dump
+
+// Tracepoint ids; the names are in trace.c and go out with every dump
+typedef enum {
+    TRACE_CHUNK_SEND = 1,       // send_chunk_packet(): publish incl. retries and ACK wait (part)
+    TRACE_CHUNK_BUILD,          // Header, data copy and CRC-32C trailer (part)
+    TRACE_FEC_ENCODE,           // Parity update for one chunk (part)
+    TRACE_PACE,                 // Inter-chunk pacing wait (ms)
+    TRACE_MQTTSN_SERIALIZE,     // MQTTSNSerialize_publish (payload bytes)
+    TRACE_MQTTSN_ACK_WAIT,      // PUBACK / PUBREC / PUBCOMP wait (QoS)
+    TRACE_UDP_PBUF_ALLOC,       // pbuf_alloc + copy (bytes)
+    TRACE_UDP_SENDTO,           // udp_sendto (bytes)
+    TRACE_UDP_RECV_WAIT,        // wifi_udp_receive() (timeout ms)
+    TRACE_UDP_RX,               // Instant: packet copied in the receive callback (bytes)
+    TRACE_CHUNK_RECEIVE,        // process_block_chunk() on the subscriber (bytes)
+    TRACE_FEC_DECODE,           // Reed-Solomon group rebuild (group)
+    TRACE_BLOCK_FINISH,         // Verify and hand a complete block to the SD card (block id)
+    TRACE_SD_READ,              // sd_card_read_sectors() (sectors)
+    TRACE_SD_WRITE,             // sd_card_write_sectors() (sectors)
+    TRACE_ID_COUNT
+} trace_id_t;
+
+#if TRACE_ENABLED
+void trace_event(uint8_t id, uint8_t phase, uint32_t arg);
+#define TRACE_BEGIN(id, arg)    trace_event((id), TRACE_PHASE_BEGIN, (uint32_t)(arg))
+#define TRACE_END(id, arg)      trace_event((id), TRACE_PHASE_END, (uint32_t)(arg))
+#define TRACE_INSTANT(id, arg)  trace_event((id), TRACE_PHASE_INSTANT, (uint32_t)(arg))
+#else
+#define TRACE_BEGIN(id, arg)    do { (void)sizeof(arg); } while (0)
+#define TRACE_END(id, arg)      do { (void)sizeof(arg); } while (0)
+#define TRACE_INSTANT(id, arg)  do { (void)sizeof(arg); } while (0)
+#endif
+
+// Write both rings out (oldest event first) and empty them. Tracing is
+// paused while it runs.
+void trace_dump(void);
+
+// Drop every event in the rings
+void trace_clear(void);
+
+const char *trace_name(uint8_t id);
+
+#ifdef TRACE_HOST
+#include <stdio.h>
+// Where trace_dump() writes (default stdout)
+void trace_set_output(FILE *out);
+#endif
+
+#endif // TRACE_H
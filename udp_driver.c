@@ -13,6 +13,10 @@
 
 #include "udp_driver.h"
 #include "network_errors.h"
+#include "binlog.h"
+#include "metrics.h"
+#include "trace.h"
+#include "wire_capture.h"
 
 // UDP State
 static struct udp_pcb *udp_pcb = NULL;
@@ -21,6 +25,17 @@ static size_t recv_buffer_size = 0;
 static size_t recv_len = 0;
 static bool data_received = false;
 
+// Metric ids (see metrics.h). The rx ones are only updated from the
+// receive callback, the tx ones only from wifi_udp_send().
+static struct {
+    int tx_packets;
+    int tx_bytes;
+    int tx_errors;
+    int rx_packets;
+    int rx_bytes;
+    int rx_dropped;         // Arrived while the last packet was unread or nobody was receiving
+} metric = { -1, -1, -1, -1, -1, -1 };
+
 // Semaphore for signaling data arrival
 static semaphore_t recv_sem;
 static bool sem_initialized = false;
@@ -33,6 +48,7 @@ static bool mutex_initialized = false;
 static void udp_recv_callback(void *arg, struct udp_pcb *pcb, struct pbuf *p,
                                const ip_addr_t *addr, u16_t port) {
     if (p != NULL) {
+        WIRE_CAPTURE(WIRE_CAPTURE_IN, ip4_addr_get_u32(ip_2_ip4(addr)), port, p->payload, p->len);
         // printf("[UDP CALLBACK] Received %d bytes from port %s:%d\n", p->len, ip4addr_ntoa(addr),port);
 
         if (mutex_initialized){
@@ -46,6 +62,9 @@ static void udp_recv_callback(void *arg, struct udp_pcb *pcb, struct pbuf *p,
             // Update recv_len to the actual amount copied
             recv_len = copy_len;
             data_received = true;
+            TRACE_INSTANT(TRACE_UDP_RX, copy_len);
+            metrics_inc(metric.rx_packets);
+            metrics_add(metric.rx_bytes, copy_len);
             
             // printf("[UDP CALLBACK] Copied %d bytes to buffer\n", copy_len);
 
@@ -55,6 +74,7 @@ static void udp_recv_callback(void *arg, struct udp_pcb *pcb, struct pbuf *p,
             }
 
         } else {
+            metrics_inc(metric.rx_dropped);
             // Uncomment for debugging dropped packets:
             // if (data_received){
             //     printf("[UDP CALLBACK] Buffer already has data, dropping packet\n");
@@ -73,6 +93,13 @@ static void udp_recv_callback(void *arg, struct udp_pcb *pcb, struct pbuf *p,
 
 
 int wifi_udp_create(uint16_t local_port){
+    metric.tx_packets = metrics_counter("udp_tx_packets");
+    metric.tx_bytes = metrics_counter("udp_tx_bytes");
+    metric.tx_errors = metrics_counter("udp_tx_errors");
+    metric.rx_packets = metrics_counter("udp_rx_packets");
+    metric.rx_bytes = metrics_counter("udp_rx_bytes");
+    metric.rx_dropped = metrics_counter("udp_rx_dropped");
+
     // Initialize semaphore on first call
     if (!sem_initialized) {
         sem_init(&recv_sem, 0, 1);  // Binary semaphore, initial count 0
@@ -121,6 +148,9 @@ int wifi_udp_create(uint16_t local_port){
 
     // Register receive callback
     udp_recv(udp_pcb, udp_recv_callback, NULL);
+    // Port 0 binds an ephemeral one: report the port the stack picked
+    wire_capture_set_local(netif_default ? ip4_addr_get_u32(netif_ip4_addr(netif_default)) : 0,
+                           udp_pcb->local_port);
 
     printf("[INFO] UDP Socket created and bound to port %d\n", local_port);
     return WIFI_OK;                        
@@ -149,18 +179,24 @@ int wifi_udp_send(const char *dest_ip, uint16_t dest_port, const uint8_t *data,
         }
 
         // Alloate packet buffer
+        TRACE_BEGIN(TRACE_UDP_PBUF_ALLOC, len);
         struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
         if (p == NULL){
+            TRACE_END(TRACE_UDP_PBUF_ALLOC, 0);
             printf("[UDP] Send Failed: Could not allocate pbuf (%zu bytes)\n", len);
             return WIFI_ENOMEM;
         }
 
         memcpy(p->payload, data, len);
+        TRACE_END(TRACE_UDP_PBUF_ALLOC, len);
 
+        TRACE_BEGIN(TRACE_UDP_SENDTO, len);
         err_t err = udp_sendto(udp_pcb, p, &dest_addr, dest_port);
         pbuf_free(p);
+        TRACE_END(TRACE_UDP_SENDTO, err == ERR_OK ? len : 0);
 
         if (err != ERR_OK){
+            metrics_inc(metric.tx_errors);
             printf("[UDP] Send Failed: udp_sendto error %d\n", err);
 
             switch (err){
@@ -175,7 +211,10 @@ int wifi_udp_send(const char *dest_ip, uint16_t dest_port, const uint8_t *data,
             }
         }
 
-        printf("[UDP] Sent %zu bytes to %s:%d\n", len, dest_ip, dest_port);
+        metrics_inc(metric.tx_packets);
+        metrics_add(metric.tx_bytes, len);
+        WIRE_CAPTURE(WIRE_CAPTURE_OUT, ip4_addr_get_u32(ip_2_ip4(&dest_addr)), dest_port, data, len);
+        BLOG_DEBUG("[UDP] Sent %zu bytes to port %d\n", len, dest_port);
         return WIFI_OK;
 }
 
@@ -217,7 +256,7 @@ int wifi_udp_receive(uint8_t *buffer, size_t max_len, uint32_t timeout_ms) {
         if (data_received) {
             result = recv_len;
             data_received = false;
-            printf("[UDP] Non-blocking receive: %d bytes\n", result);
+            BLOG_DEBUG("[UDP] Non-blocking receive: %d bytes\n", result);
             
         } else {
             result = 0;
@@ -231,7 +270,9 @@ int wifi_udp_receive(uint8_t *buffer, size_t max_len, uint32_t timeout_ms) {
     } else {
         // Blocking mode with timeout
         // Wait on semaphore with timeout
+        TRACE_BEGIN(TRACE_UDP_RECV_WAIT, timeout_ms);
         bool acquired = sem_acquire_timeout_ms(&recv_sem, timeout_ms);
+        TRACE_END(TRACE_UDP_RECV_WAIT, acquired);
 
         // Lock mutex to read result
         if (mutex_initialized) {
@@ -241,7 +282,7 @@ int wifi_udp_receive(uint8_t *buffer, size_t max_len, uint32_t timeout_ms) {
         if (acquired && data_received) {
             result = recv_len;
             data_received = false;
-            printf("[UDP] Received %d bytes\n", result);
+            BLOG_DEBUG("[UDP] Received %d bytes\n", result);
         } else {
             result = WIFI_ETIMEDOUT;
             // Timeout is normal, don't spam console
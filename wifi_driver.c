@@ -6,8 +6,11 @@
 
 #include "wifi_driver.h"
 #include "network_errors.h"
+#include "metrics.h"
 
 static simple_wifi_t wifi_state = {0};
+static int metric_disconnects = -1;
+static int metric_reconnects = -1;
 
 // Initialize WiFi with credentials
 int wifi_init(const char *ssid, const char *password) {
@@ -31,6 +34,8 @@ int wifi_init(const char *ssid, const char *password) {
     wifi_state.last_reconnect_time = nil_time;
     wifi_state.reconnect_count = 0;
     wifi_state.disconnect_count = 0;
+    metric_disconnects = metrics_counter("wifi_disconnects");
+    metric_reconnects = metrics_counter("wifi_reconnects");
     
     printf("[INFO] WiFi initialized\n");
     printf("[INFO] SSID: %s\n", wifi_state.ssid);
@@ -49,6 +54,7 @@ bool wifi_is_connected(void) {
         printf("[DEBUG] Link status changed to: %s\n", wifi_get_status());
         wifi_state.connected = false;
         wifi_state.disconnect_count++;
+        metrics_inc(metric_disconnects);
     }
     
     return currently_connected;
@@ -151,6 +157,7 @@ void wifi_auto_reconnect(void) {
                 
                 wifi_state.last_reconnect_time = now;
                 wifi_state.reconnect_count++;
+                metrics_inc(metric_reconnects);
                 
                 printf("\n[INFO] Re-Connection Attempt #%lu\n", 
                        wifi_state.reconnect_count);
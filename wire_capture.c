@@ -0,0 +1,115 @@
+// wire_capture.c - Datagram capture ring and its dump (see wire_capture.h)
+
+#include "wire_capture.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#ifndef WIRE_CAPTURE_HOST
+#include "hardware/sync.h"
+#endif
+
+#define RING_MASK (WIRE_CAPTURE_RECORDS - 1)
+
+_Static_assert((WIRE_CAPTURE_RECORDS & RING_MASK) == 0, "WIRE_CAPTURE_RECORDS must be a power of two");
+
+typedef struct {
+    uint64_t ts;
+    uint32_t peer_ip;
+    uint16_t peer_port;
+    uint16_t len;               // On the wire; data holds up to WIRE_CAPTURE_SNAPLEN of it
+    char dir;
+    uint8_t data[WIRE_CAPTURE_SNAPLEN];
+} wire_record_t;
+
+// One ring: every UDP call and the receive callback run on core0
+static wire_record_t records[WIRE_CAPTURE_RECORDS];
+static uint32_t head;           // Records ever taken; the ring holds the last WIRE_CAPTURE_RECORDS
+static uint32_t dump_count;
+static uint32_t local_ip;
+static uint16_t local_port;
+
+volatile bool wire_capture_enabled;
+
+#ifdef WIRE_CAPTURE_HOST
+static FILE *output;
+
+static inline uint32_t lock_ring(void) { return 0; }
+static inline void unlock_ring(uint32_t saved) { (void)saved; }
+
+void wire_capture_set_output(FILE *out) {
+    output = out;
+}
+
+#define WIRE_PRINTF(...) fprintf(output ? output : stdout, __VA_ARGS__)
+#else
+static inline uint32_t lock_ring(void) { return save_and_disable_interrupts(); }
+static inline void unlock_ring(uint32_t saved) { restore_interrupts(saved); }
+
+#define WIRE_PRINTF(...) printf(__VA_ARGS__)
+#endif
+
+void wire_capture_record(char dir, uint32_t peer_ip, uint16_t peer_port, const uint8_t *data, size_t len) {
+    size_t keep = len < WIRE_CAPTURE_SNAPLEN ? len : WIRE_CAPTURE_SNAPLEN;
+    // Interrupts off so the receive callback cannot interleave with a send
+    uint32_t saved = lock_ring();
+    wire_record_t *r = &records[head & RING_MASK];
+    r->ts = time_us_64();
+    r->peer_ip = peer_ip;
+    r->peer_port = peer_port;
+    r->len = len > UINT16_MAX ? UINT16_MAX : (uint16_t)len;
+    r->dir = dir;
+    memcpy(r->data, data, keep);
+    head++;
+    unlock_ring(saved);
+}
+
+void wire_capture_enable(bool on) {
+    wire_capture_enabled = on;
+    printf("[WIRE] Capture %s (%lu datagrams in the ring)\n", on ? "on" : "off",
+           (unsigned long)(head < WIRE_CAPTURE_RECORDS ? head : WIRE_CAPTURE_RECORDS));
+}
+
+void wire_capture_set_local(uint32_t ip, uint16_t port) {
+    local_ip = ip;
+    local_port = port;
+}
+
+void wire_capture_clear(void) {
+    bool was_enabled = wire_capture_enabled;
+    wire_capture_enabled = false;
+    head = 0;
+    wire_capture_enabled = was_enabled;
+}
+
+// Dotted quad of an address in network byte order
+static void format_ip(uint32_t ip, char *text, size_t size) {
+    const uint8_t *b = (const uint8_t *)&ip;
+    snprintf(text, size, "%u.%u.%u.%u", b[0], b[1], b[2], b[3]);
+}
+
+void wire_capture_dump(void) {
+    bool was_enabled = wire_capture_enabled;
+    wire_capture_enabled = false;
+    uint32_t lost = head > WIRE_CAPTURE_RECORDS ? head - WIRE_CAPTURE_RECORDS : 0;
+
+    char ip[16];
+    format_ip(local_ip, ip, sizeof(ip));
+    WIRE_PRINTF("%s %lu %lu %u %s %u\n", WIRE_DUMP_TAG, (unsigned long)++dump_count, (unsigned long)lost,
+                WIRE_CAPTURE_SNAPLEN, ip, local_port);
+    for (uint32_t i = lost; i != head; i++) {
+        const wire_record_t *r = &records[i & RING_MASK];
+        size_t keep = r->len < WIRE_CAPTURE_SNAPLEN ? r->len : WIRE_CAPTURE_SNAPLEN;
+        char hex[2 * WIRE_CAPTURE_SNAPLEN + 1];
+        for (size_t j = 0; j < keep; j++) {
+            snprintf(&hex[2 * j], 3, "%02x", r->data[j]);
+        }
+        hex[2 * keep] = '\0';
+        format_ip(r->peer_ip, ip, sizeof(ip));
+        WIRE_PRINTF("%s %llx %c %s %u %u %s\n", WIRE_RECORD_TAG, (unsigned long long)r->ts, r->dir, ip,
+                    r->peer_port, r->len, hex);
+    }
+    head = 0;
+    WIRE_PRINTF("%s\n", WIRE_END_TAG);
+    wire_capture_enabled = was_enabled;
+}
@@ -0,0 +1,66 @@
+// wire_capture.h - RAM ring of the datagrams on the MQTT-SN socket
+//
+// While capture is on, the UDP driver records every datagram it sends or
+// receives: a microsecond timestamp, the direction, the peer address and
+// port, the length on the wire and its first WIRE_CAPTURE_SNAPLEN bytes,
+// enough for the MQTT-SN header and the block chunk header behind it. The
+// ring keeps the most recent WIRE_CAPTURE_RECORDS datagrams. With capture
+// off, WIRE_CAPTURE() is one test of a flag.
+//
+// On the USB console of either Pico, 'c' turns capture on and off and 'w'
+// dumps the ring as text lines (and empties it); host/wire_pcap turns one
+// or more dumps into a pcap file for Wireshark, with IPv4 and UDP headers
+// put back around each datagram.
+
+#ifndef WIRE_CAPTURE_H
+#define WIRE_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef WIRE_CAPTURE_RECORDS
+#define WIRE_CAPTURE_RECORDS    128     // Power of two; WIRE_CAPTURE_SNAPLEN + 24 bytes each
+#endif
+#ifndef WIRE_CAPTURE_SNAPLEN
+#define WIRE_CAPTURE_SNAPLEN    48      // Bytes kept per datagram
+#endif
+
+#define WIRE_CAPTURE_OUT        't'     // Sent by the device
+#define WIRE_CAPTURE_IN         'r'     // Received by the device
+
+// Lines written by wire_capture_dump()
+#define WIRE_DUMP_TAG   "#WCD"  // #WCD <dump number> <lost records> <snaplen> <local ip> <local port>: a dump starts
+#define WIRE_RECORD_TAG "#WC"   // #WC <timestamp us, hex> <t|r> <peer ip> <peer port> <wire length> <bytes, hex>
+#define WIRE_END_TAG    "#WCX"  // End of the dump
+
+extern volatile bool wire_capture_enabled;
+
+// Record a datagram (ip in network byte order, as lwIP keeps it)
+void wire_capture_record(char dir, uint32_t peer_ip, uint16_t peer_port, const uint8_t *data, size_t len);
+
+#define WIRE_CAPTURE(dir, peer_ip, peer_port, data, len) \
+    do { \
+        if (wire_capture_enabled) wire_capture_record((dir), (peer_ip), (peer_port), (data), (len)); \
+    } while (0)
+
+// Turn capture on or off; the ring keeps what it holds either way
+void wire_capture_enable(bool on);
+
+// Our own address and port, reported with every dump (set by wifi_udp_create())
+void wire_capture_set_local(uint32_t ip, uint16_t port);
+
+// Write the ring out (oldest datagram first) and empty it. Capture is
+// paused while it runs.
+void wire_capture_dump(void);
+
+// Drop every record in the ring
+void wire_capture_clear(void);
+
+#ifdef WIRE_CAPTURE_HOST
+#include <stdio.h>
+// Where wire_capture_dump() writes (default stdout)
+void wire_capture_set_output(FILE *out);
+#endif
+
+#endif // WIRE_CAPTURE_H